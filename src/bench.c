@@ -0,0 +1,747 @@
+/******************************************************************
+*
+* bench.c               - Microbenchmarks for the mod_litbook core
+*                         (litbook-bench).
+*
+* Copyright 2022 by Sean Conner.  All Rights Reserved.
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*
+* Comments, questions and criticisms can be sent to: sean@conman.org
+*
+* -----------------------------------------------------------------
+*
+* Each benchmark is run over two tables---the translation file given on
+* the command line, and a generated table of 10,000 names---and reports
+* nanoseconds per operation as tab separated values:
+*
+*       benchmark table keys ns/op baseline change status
+*
+* If a baseline file is given (the saved output of a previous run) the
+* results are compared against it, and anything more than -t percent
+* (default 10) slower is marked REGRESSION (and the exit status is 1).
+*
+* The keys for the lookup benchmarks are built by running a set of
+* variations of each name (the name itself, the abbreviation, vowels
+* changed, leading letters swapped for ones that sound the same) through
+* lb_find_book() and sorting them by which tier found them.
+*
+* If a book directory is given, chapters are read and rendered from it as
+* well.
+*
+********************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <ctype.h>
+#include <time.h>
+#include <errno.h>
+#include <assert.h>
+
+#include <unistd.h>
+
+#include "litbook.h"
+#include "metaphone.h"
+#include "soundex.h"
+
+#define MBUFSIZ         512
+#define GENBOOKS        10000
+#define MINTIME         100000000uLL    /* ns per measurement */
+#define RUNS            3
+
+/***************************************************************/
+
+struct keys
+{
+  char   **key;
+  size_t   n;
+  size_t   size;
+};
+
+struct table
+{
+  char const       *name;
+  struct lbtrans    trans;
+  char const       *bookdir;
+  struct keys       names;
+  struct keys       tier[LB_TIER_METAPHONE + 1];
+  struct keys       refs;
+  struct lbrequest *reqs;
+  size_t            nreqs;
+};
+
+struct benchmark
+{
+  char const *name;
+  size_t    (*count)(struct table *);
+  void      (*run)  (struct table *,size_t);
+};
+
+struct baseline
+{
+  char   name [64];
+  char   table[64];
+  double ns;
+};
+
+/*************************************************************/
+
+static bool      load_table             (struct table *,char const *,char const *);
+static bool      gen_table              (struct table *,size_t);
+static void      make_keys              (struct table *);
+static void      add_key                (struct keys *,char const *);
+static void      normalize              (char *,char const *);
+static double    measure                (struct benchmark const *,struct table *,size_t);
+static void      read_baseline          (char const *);
+static double    find_baseline          (char const *,char const *);
+static uint64_t  now                    (void);
+static uint64_t  rnd                    (void);
+static int       write_null             (void *,char const *,size_t);
+
+static size_t    count_names            (struct table *);
+static size_t    count_fullname         (struct table *);
+static size_t    count_abrev            (struct table *);
+static size_t    count_soundex          (struct table *);
+static size_t    count_metaphone        (struct table *);
+static size_t    count_none             (struct table *);
+static size_t    count_refs             (struct table *);
+static size_t    count_reqs             (struct table *);
+static size_t    count_verse            (struct table *);
+static size_t    count_chapter          (struct table *);
+
+static void      run_soundex            (struct table *,size_t);
+static void      run_metaphone          (struct table *,size_t);
+static void      lookup                 (struct table *,enum lbtier,size_t);
+static void      run_fullname           (struct table *,size_t);
+static void      run_abrev              (struct table *,size_t);
+static void      run_tsoundex           (struct table *,size_t);
+static void      run_tmetaphone         (struct table *,size_t);
+static void      run_none               (struct table *,size_t);
+static void      run_parse              (struct table *,size_t);
+static void      run_redirect           (struct table *,size_t);
+static void      run_verse              (struct table *,size_t);
+static void      run_chapter            (struct table *,size_t);
+
+/*************************************************************/
+
+static struct benchmark const c_benchmarks[] =
+{
+  { "soundex"          , count_names     , run_soundex    } ,
+  { "metaphone"        , count_names     , run_metaphone  } ,
+  { "lookup-fullname"  , count_fullname  , run_fullname   } ,
+  { "lookup-abbrev"    , count_abrev     , run_abrev      } ,
+  { "lookup-soundex"   , count_soundex   , run_tsoundex   } ,
+  { "lookup-metaphone" , count_metaphone , run_tmetaphone } ,
+  { "lookup-miss"      , count_none      , run_none       } ,
+  { "parse"            , count_refs      , run_parse      } ,
+  { "redirect"         , count_reqs      , run_redirect   } ,
+  { "render-verse"     , count_verse     , run_verse      } ,
+  { "show-chapter"     , count_chapter   , run_chapter    } ,
+};
+
+#define MAXBENCH        (sizeof(c_benchmarks) / sizeof(c_benchmarks[0]))
+
+static char const *const c_swaps[][2] =
+{
+  { "Ph" , "F"  } , { "F"  , "Ph" } , { "C"  , "K"  } , { "K"  , "C"  } ,
+  { "Ch" , "K"  } , { "Wh" , "W"  } , { "W"  , "Wh" } , { "G"  , "J"  } ,
+  { "J"  , "G"  } , { "S"  , "C"  } , { "Z"  , "S"  } , { "X"  , "Z"  } ,
+  { "Q"  , "K"  } , { "Kn" , "N"  } , { "N"  , "Kn" } , { "Ps" , "S"  } ,
+};
+
+static char const *const c_onset[] =
+{
+  "b" , "br" , "ch" , "d" , "f" , "g" , "h" , "j" , "k" , "kh" , "l" ,
+  "m" , "n" , "p" , "ph" , "r" , "s" , "sh" , "t" , "th" , "v" , "z" ,
+  "c" , "qu" , "gr" , "st" , "",
+};
+
+static char const *const c_vowel[] =
+{
+  "a" , "e" , "i" , "o" , "u" , "ai" , "ea" , "ia" , "ei" , "y",
+};
+
+static char const *const c_coda[] =
+{
+  "" , "" , "" , "n" , "s" , "th" , "m" , "l" , "r" , "sh" , "k" , "d",
+};
+
+static struct baseline *m_base;
+static size_t           m_nbase;
+static uint64_t         m_seed = 1;
+static volatile size_t  m_sink;
+
+/************************************************************/
+
+int main(int argc,char *argv[])
+{
+  struct table  tables[2];
+  char const   *fbase     = NULL;
+  double        threshold = 10.0;
+  bool          regress   = false;
+  int           c;
+  
+  while((c = getopt(argc,argv,"b:t:h")) != EOF)
+  {
+    switch(c)
+    {
+      case 'b': fbase     = optarg;                break;
+      case 't': threshold = strtod(optarg,NULL);   break;
+      case 'h':
+      default:
+           fprintf(stderr,"usage: %s [-b baseline] [-t percent] <booklist> [bookdir]\n",argv[0]);
+           return(2);
+    }
+  }
+  
+  if (argc - optind < 1)
+  {
+    fprintf(stderr,"usage: %s [-b baseline] [-t percent] <booklist> [bookdir]\n",argv[0]);
+    return(2);
+  }
+  
+  if (fbase != NULL)
+    read_baseline(fbase);
+    
+  if (!load_table(&tables[0],argv[optind],argv[optind + 1]))
+    return(2);
+  if (!gen_table(&tables[1],GENBOOKS))
+    return(2);
+    
+  printf("# benchmark\ttable\tkeys\tns/op\tbaseline\tchange\tstatus\n");
+  
+  for (size_t t = 0 ; t < sizeof(tables) / sizeof(tables[0]) ; t++)
+  {
+    for (size_t i = 0 ; i < MAXBENCH ; i++)
+    {
+      size_t n = (*c_benchmarks[i].count)(&tables[t]);
+      double ns;
+      double base;
+      
+      if (n == 0)
+        continue;
+        
+      ns   = measure(&c_benchmarks[i],&tables[t],n);
+      base = find_baseline(c_benchmarks[i].name,tables[t].name);
+      
+      if (base > 0.0)
+      {
+        double change = (ns - base) / base * 100.0;
+        bool   worse  = change > threshold;
+        
+        printf(
+                "%s\t%s\t%zu\t%.1f\t%.1f\t%+.1f%%\t%s\n",
+                c_benchmarks[i].name,
+                tables[t].name,
+                n,
+                ns,
+                base,
+                change,
+                worse ? "REGRESSION" : "ok"
+              );
+        regress |= worse;
+      }
+      else
+        printf("%s\t%s\t%zu\t%.1f\t-\t-\tnew\n",c_benchmarks[i].name,tables[t].name,n,ns);
+      fflush(stdout);
+    }
+  }
+  
+  return(regress ? 1 : 0);
+}
+
+/********************************************************************/
+
+static bool load_table(struct table *pt,char const *fname,char const *bookdir)
+{
+  size_t line;
+  int    rc;
+  
+  assert(pt    != NULL);
+  assert(fname != NULL);
+  
+  memset(pt,0,sizeof(struct table));
+  pt->name    = strrchr(fname,'/') ? strrchr(fname,'/') + 1 : fname;
+  pt->bookdir = bookdir;
+  
+  rc = lb_trans_load(&pt->trans,fname,&lb_malloc,&line);
+  if (rc != 0)
+  {
+    if (rc == EINVAL)
+      fprintf(stderr,"%s: corrupted on or around line %zu\n",fname,line + 1);
+    else
+      fprintf(stderr,"%s: %s\n",fname,strerror(rc));
+    return(false);
+  }
+  
+  make_keys(pt);
+  return(true);
+}
+
+/********************************************************************
+;
+; Generate a table of made up names.  These are built from syllables, so
+; there are plenty of names that sound alike, and one in ten has a
+; leading digit like 1Kings and 2Kings.  The table goes through a file
+; so it's loaded the same way a real translation file is.
+;
+*********************************************************************/
+
+static bool gen_table(struct table *pt,size_t max)
+{
+  char  fname[] = "/tmp/litbook-bench.XXXXXX";
+  FILE *fp;
+  int   fh;
+  int   rc;
+  
+  assert(pt != NULL);
+  
+  memset(pt,0,sizeof(struct table));
+  pt->name = "gen10k";
+  
+  fh = mkstemp(fname);
+  if ((fh == -1) || ((fp = fdopen(fh,"w")) == NULL))
+  {
+    perror(fname);
+    return(false);
+  }
+  
+  for (size_t i = 0 ; i < max ; i++)
+  {
+    char   name[128];
+    char   abrev[16];
+    size_t syl = 2 + rnd() % 3;
+    char  *p   = name;
+    
+    if (rnd() % 10 == 0)
+      p += sprintf(p,"%d",(int)(rnd() % 3) + 1);
+      
+    for (size_t s = 0 ; s < syl ; s++)
+    {
+      p += sprintf(
+                    p,
+                    "%s%s%s",
+                    c_onset[rnd() % (sizeof(c_onset) / sizeof(c_onset[0]))],
+                    c_vowel[rnd() % (sizeof(c_vowel) / sizeof(c_vowel[0]))],
+                    s == syl - 1 ? c_coda[rnd() % (sizeof(c_coda) / sizeof(c_coda[0]))] : ""
+                  );
+    }
+    
+    /*-----------------------------------------------------------------
+    ; Capitalize the first letter, and make the abbreviation unique by
+    ; tacking on the entry number.
+    ;------------------------------------------------------------------*/
+    
+    p = isdigit(name[0]) ? &name[1] : &name[0];
+    *p = toupper(*p);
+    snprintf(abrev,sizeof(abrev),"%.3s%zu",name,i);
+    fprintf(fp,"%s\t, %s\n",abrev,name);
+  }
+  
+  fclose(fp);
+  rc = lb_trans_load(&pt->trans,fname,&lb_malloc,NULL);
+  unlink(fname);
+  
+  if (rc != 0)
+  {
+    fprintf(stderr,"%s: %s\n",fname,strerror(rc));
+    return(false);
+  }
+  
+  make_keys(pt);
+  return(true);
+}
+
+/********************************************************************/
+
+static void make_keys(struct table *pt)
+{
+  assert(pt != NULL);
+  
+  for (size_t i = 0 ; i < pt->trans.maxbook ; i++)
+  {
+    struct lbbookname *pb = &pt->trans.books[i];
+    char               var[8][MBUFSIZ];
+    char               key[MBUFSIZ];
+    char               ref[MBUFSIZ * 2];
+    size_t             nvar = 0;
+    
+    add_key(&pt->names,pb->fullname);
+    
+    /*---------------------------------------------------------------
+    ; The variations:  the name, the abbreviation, a vowel changed,
+    ; the leading sound swapped for one that sounds the same, and junk.
+    ;----------------------------------------------------------------*/
+    
+    snprintf(var[nvar++],MBUFSIZ,"%s",pb->fullname);
+    snprintf(var[nvar++],MBUFSIZ,"%s",pb->abrev);
+    
+    snprintf(var[nvar],MBUFSIZ,"%s",pb->fullname);
+    for (char *p = var[nvar] + 1 ; *p ; p++)
+    {
+      char *v = strchr("aeiou",*p);
+      if (v != NULL)
+      {
+        *p = v[1] ? v[1] : 'a';
+        break;
+      }
+    }
+    nvar++;
+    
+    for (size_t s = 0 ; s < sizeof(c_swaps) / sizeof(c_swaps[0]) ; s++)
+    {
+      char const *name = isdigit(pb->fullname[0]) ? &pb->fullname[1] : pb->fullname;
+      size_t      len  = strlen(c_swaps[s][0]);
+      
+      if (strncmp(name,c_swaps[s][0],len) == 0)
+      {
+        snprintf(var[nvar++],MBUFSIZ,"%s%s",c_swaps[s][1],name + len);
+        break;
+      }
+    }
+    
+    snprintf(var[nvar++],MBUFSIZ,"Xq%s",pb->fullname);
+    
+    for (size_t v = 0 ; v < nvar ; v++)
+    {
+      enum lbtier tier;
+      
+      normalize(key,var[v]);
+      if (strlen(key) < 2)
+        continue;
+      lb_find_book(&pt->trans,key,&tier);
+      add_key(&pt->tier[tier],key);
+    }
+    
+    /*----------------------------------------------------------------
+    ; References to parse, and the ones that parse for redirecting.
+    ;-----------------------------------------------------------------*/
+    
+    snprintf(ref,sizeof(ref),"%s.%zu:%zu",pb->fullname,i % 50 + 1,i % 30 + 1);
+    add_key(&pt->refs,ref);
+    snprintf(ref,sizeof(ref),"%s.%zu:%zu-%zu:%zu",pb->abrev,i % 20 + 1,i % 10 + 1,i % 20 + 2,i % 7 + 1);
+    add_key(&pt->refs,ref);
+    snprintf(ref,sizeof(ref),"%s.%zu-",var[2],i % 40 + 1);
+    add_key(&pt->refs,ref);
+  }
+  
+  pt->reqs = malloc(pt->refs.n * sizeof(struct lbrequest));
+  if (pt->reqs == NULL)
+  {
+    perror("malloc()");
+    exit(2);
+  }
+  
+  for (size_t i = 0 ; i < pt->refs.n ; i++)
+  {
+    lb_translate_request(&pt->reqs[pt->nreqs],&pt->trans,pt->refs.key[i]);
+    if (pt->reqs[pt->nreqs].name != NULL)
+      pt->nreqs++;
+  }
+}
+
+/********************************************************************/
+
+static void add_key(struct keys *pk,char const *key)
+{
+  assert(pk  != NULL);
+  assert(key != NULL);
+  
+  if (pk->n == pk->size)
+  {
+    pk->size += 1024;
+    pk->key   = realloc(pk->key,pk->size * sizeof(char *));
+    if (pk->key == NULL)
+    {
+      perror("realloc()");
+      exit(2);
+    }
+  }
+  
+  pk->key[pk->n++] = strdup(key);
+}
+
+/********************************************************************
+;
+; Normalize a name the way lb_translate_request() does before looking
+; it up.
+;
+*********************************************************************/
+
+static void normalize(char *dest,char const *src)
+{
+  char *p = dest;
+  
+  assert(dest != NULL);
+  assert(src  != NULL);
+  
+  for ( ; (*src) && (!ispunct(*src)) && (p < dest + MBUFSIZ - 1) ; src++)
+    *p++ = tolower(*src);
+  *p = '\0';
+  
+  if (isdigit(dest[0]))
+    dest[1] = toupper(dest[1]);
+  else
+    dest[0] = toupper(dest[0]);
+}
+
+/********************************************************************
+;
+; Time a benchmark.  The number of operations is doubled until it takes
+; at least MINTIME, then the best of RUNS runs is reported.
+;
+*********************************************************************/
+
+static double measure(struct benchmark const *pb,struct table *pt,size_t n)
+{
+  size_t ops  = n;
+  double best = 0.0;
+  
+  assert(pb != NULL);
+  assert(pt != NULL);
+  assert(n  >  0);
+  
+  while(true)
+  {
+    uint64_t start = now();
+    
+    for (size_t i = 0 ; i < ops ; i++)
+      (*pb->run)(pt,i % n);
+      
+    if (now() - start >= MINTIME)
+      break;
+    ops *= 2;
+  }
+  
+  for (int r = 0 ; r < RUNS ; r++)
+  {
+    uint64_t start = now();
+    double   ns;
+    
+    for (size_t i = 0 ; i < ops ; i++)
+      (*pb->run)(pt,i % n);
+      
+    ns = (double)(now() - start) / (double)ops;
+    if ((r == 0) || (ns < best))
+      best = ns;
+  }
+  
+  return(best);
+}
+
+/********************************************************************/
+
+static void read_baseline(char const *fname)
+{
+  FILE   *fp;
+  char    buffer[BUFSIZ];
+  size_t  size = 0;
+  
+  assert(fname != NULL);
+  
+  fp = fopen(fname,"r");
+  if (fp == NULL)
+  {
+    perror(fname);
+    return;
+  }
+  
+  while(fgets(buffer,sizeof(buffer),fp))
+  {
+    struct baseline b;
+    
+    if (buffer[0] == '#')
+      continue;
+    if (sscanf(buffer,"%63s %63s %*s %lf",b.name,b.table,&b.ns) != 3)
+      continue;
+      
+    if (m_nbase == size)
+    {
+      size  += 32;
+      m_base = realloc(m_base,size * sizeof(struct baseline));
+      if (m_base == NULL)
+      {
+        perror("realloc()");
+        exit(2);
+      }
+    }
+    
+    m_base[m_nbase++] = b;
+  }
+  
+  fclose(fp);
+}
+
+/********************************************************************/
+
+static double find_baseline(char const *name,char const *table)
+{
+  for (size_t i = 0 ; i < m_nbase ; i++)
+  {
+    if ((strcmp(m_base[i].name,name) == 0) && (strcmp(m_base[i].table,table) == 0))
+      return(m_base[i].ns);
+  }
+  return(0.0);
+}
+
+/********************************************************************/
+
+static uint64_t now(void)
+{
+  struct timespec ts;
+  
+  clock_gettime(CLOCK_MONOTONIC,&ts);
+  return((uint64_t)ts.tv_sec * 1000000000uLL + ts.tv_nsec);
+}
+
+/********************************************************************/
+
+static uint64_t rnd(void)
+{
+  m_seed ^= m_seed >> 12;
+  m_seed ^= m_seed << 25;
+  m_seed ^= m_seed >> 27;
+  return(m_seed * 2685821657736338717ULL);
+}
+
+/********************************************************************/
+
+static int write_null(void *ud,char const *buf,size_t len)
+{
+  (void)ud;
+  (void)buf;
+  (void)len;
+  return(0);
+}
+
+/*********************************************************************
+*       KEY COUNTS
+*********************************************************************/
+
+static size_t count_names    (struct table *pt) { return(pt->names.n); }
+static size_t count_fullname (struct table *pt) { return(pt->tier[LB_TIER_FULLNAME].n); }
+static size_t count_abrev    (struct table *pt) { return(pt->tier[LB_TIER_ABREV].n); }
+static size_t count_soundex  (struct table *pt) { return(pt->tier[LB_TIER_SOUNDEX].n); }
+static size_t count_metaphone(struct table *pt) { return(pt->tier[LB_TIER_METAPHONE].n); }
+static size_t count_none     (struct table *pt) { return(pt->tier[LB_TIER_NONE].n); }
+static size_t count_refs     (struct table *pt) { return(pt->refs.n); }
+static size_t count_reqs     (struct table *pt) { return(pt->nreqs); }
+static size_t count_verse    (struct table *pt) { return(pt->names.n); }
+
+/********************************************************************/
+
+static size_t count_chapter(struct table *pt)
+{
+  return(pt->bookdir != NULL ? pt->trans.maxbook : 0);
+}
+
+/*********************************************************************
+*       BENCHMARKS
+*********************************************************************/
+
+static void run_soundex(struct table *pt,size_t i)
+{
+  m_sink += Soundex(pt->names.key[i]).value;
+}
+
+/********************************************************************/
+
+static void run_metaphone(struct table *pt,size_t i)
+{
+  char mp[MBUFSIZ];
+  
+  m_sink += make_metaphone(pt->names.key[i],mp,sizeof(mp));
+}
+
+/********************************************************************/
+
+static void lookup(struct table *pt,enum lbtier tier,size_t i)
+{
+  enum lbtier found;
+  
+  m_sink += (size_t)lb_find_book(&pt->trans,pt->tier[tier].key[i],&found);
+}
+
+/********************************************************************/
+
+static void run_fullname  (struct table *pt,size_t i) { lookup(pt,LB_TIER_FULLNAME,i);  }
+static void run_abrev     (struct table *pt,size_t i) { lookup(pt,LB_TIER_ABREV,i);     }
+static void run_tsoundex  (struct table *pt,size_t i) { lookup(pt,LB_TIER_SOUNDEX,i);   }
+static void run_tmetaphone(struct table *pt,size_t i) { lookup(pt,LB_TIER_METAPHONE,i); }
+static void run_none      (struct table *pt,size_t i) { lookup(pt,LB_TIER_NONE,i);      }
+
+/********************************************************************/
+
+static void run_parse(struct table *pt,size_t i)
+{
+  struct lbrequest br;
+  
+  lb_translate_request(&br,&pt->trans,pt->refs.key[i]);
+  m_sink += br.c1;
+}
+
+/********************************************************************/
+
+static void run_redirect(struct table *pt,size_t i)
+{
+  char buffer[MBUFSIZ];
+  
+  m_sink += lb_redirect_request(buffer,sizeof(buffer),&pt->reqs[i]);
+}
+
+/********************************************************************/
+
+static void run_verse(struct table *pt,size_t i)
+{
+  static char const text[] =
+        "And God said, Let there be light: and there was light.  And God saw"
+        " the light, that it was good: and God divided the light from the"
+        " darkness.";
+        
+  struct lbctx ctx =
+  {
+    .alloc  = &lb_malloc,
+    .render = &lb_render_html,
+    .write  = write_null,
+    .ud     = NULL,
+    .bytes  = 0,
+  };
+  
+  (void)pt;
+  (*ctx.render->verse)(&ctx,i + 1,text,sizeof(text) - 1);
+  m_sink += ctx.bytes;
+}
+
+/********************************************************************/
+
+static void run_chapter(struct table *pt,size_t i)
+{
+  struct lbctx ctx =
+  {
+    .alloc  = &lb_malloc,
+    .render = &lb_render_html,
+    .write  = write_null,
+    .ud     = NULL,
+    .bytes  = 0,
+  };
+  
+  lb_show_chapter(&ctx,pt->bookdir,pt->trans.books[i].fullname,1,1,LB_END);
+  m_sink += ctx.bytes;
+}
+
+/********************************************************************/
@@ -0,0 +1,583 @@
+/******************************************************************
+*
+* fsck.c                - Program to verify the mod_litbook data files
+*                         against a translation file (litbook-fsck).
+*
+* Copyright 2022 by Sean Conner.  All Rights Reserved.
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*
+* Comments, questions and criticisms can be sent to: sean@conman.org
+*
+* -----------------------------------------------------------------
+*
+* For every book listed in the translation file, check that the book
+* directory exists, that the chapters run 1 .. n with no gaps, and for
+* each chapter (see DATA-FORMAT):
+*
+*       - the index file is exactly (count + 2) longs long
+*       - the verse count is sane (no more than -m, default 2000; the
+*         module itself takes any count the index size agrees with)
+*       - the offsets start at 0 and never decrease
+*       - the last offset is the size of the text file
+*       - the text is valid UTF-8
+*
+* Books are checked in parallel, and a checksum (64-bit FNV-1a) of every
+* index and text file is computed along the way, so two copies of a
+* library can be compared by their checksums.  The exit status is 0 if
+* everything checks out, 1 if problems were found and 2 for usage errors.
+*
+********************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdarg.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <limits.h>
+#include <assert.h>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <pthread.h>
+
+#include "litbook.h"
+
+#define MAXVERSES       2000
+#define FNV_OFFSET      14695981039346656037ULL
+#define FNV_PRIME       1099511628211ULL
+
+/***************************************************************/
+
+struct book
+{
+  char     *name;
+  size_t    chapters;
+  size_t    verses;
+  size_t    bytes;
+  size_t    errors;
+  uint64_t  sum;
+  char     *log;
+  size_t    loglen;
+};
+
+/*************************************************************/
+
+static bool      read_booklist          (char const *);
+static void     *worker                 (void *);
+static void      check_book             (struct book *);
+static bool      check_chapter          (struct book *,char const *,size_t);
+static bool      valid_utf8             (unsigned char const *,size_t,size_t *);
+static uint64_t  fnv1a                  (uint64_t,void const *,size_t);
+static void      report                 (struct book *,char const *,...) __attribute__((format(printf,2,3)));
+
+/*************************************************************/
+
+static char const      *m_bookdir;
+static struct book     *m_books;
+static size_t           m_maxbook;
+static size_t           m_next;
+static bool             m_verbose;
+static size_t           m_maxverses = MAXVERSES;
+static pthread_mutex_t  m_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/************************************************************/
+
+int main(int argc,char *argv[])
+{
+  pthread_t *threads;
+  long       nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+  size_t     errors   = 0;
+  size_t     chapters = 0;
+  size_t     verses   = 0;
+  size_t     bytes    = 0;
+  uint64_t   sum      = FNV_OFFSET;
+  int        c;
+  
+  while((c = getopt(argc,argv,"j:m:vh")) != EOF)
+  {
+    switch(c)
+    {
+      case 'j': nthreads    = strtol(optarg,NULL,10); break;
+      case 'm': m_maxverses = strtoul(optarg,NULL,10); break;
+      case 'v': m_verbose   = true; break;
+      case 'h':
+      default:
+           fprintf(stderr,"usage: %s [-j threads] [-m maxverses] [-v] <booklist> <bookdir>\n",argv[0]);
+           return(2);
+    }
+  }
+  
+  if (argc - optind < 2)
+  {
+    fprintf(stderr,"usage: %s [-j threads] [-m maxverses] [-v] <booklist> <bookdir>\n",argv[0]);
+    return(2);
+  }
+  
+  if (!read_booklist(argv[optind]))
+    return(2);
+    
+  m_bookdir = argv[optind + 1];
+  
+  if (nthreads < 1)
+    nthreads = 1;
+  if ((size_t)nthreads > m_maxbook)
+    nthreads = m_maxbook;
+    
+  threads = malloc(nthreads * sizeof(pthread_t));
+  if (threads == NULL)
+  {
+    perror("malloc()");
+    return(2);
+  }
+  
+  for (long i = 0 ; i < nthreads ; i++)
+    pthread_create(&threads[i],NULL,worker,NULL);
+  for (long i = 0 ; i < nthreads ; i++)
+    pthread_join(threads[i],NULL);
+    
+  /*-------------------------------------------------------------
+  ; The books are checked in whatever order the threads get to them, but
+  ; the report (and the library checksum) are in translation file order.
+  ;--------------------------------------------------------------*/
+  
+  for (size_t i = 0 ; i < m_maxbook ; i++)
+  {
+    struct book *pb = &m_books[i];
+    
+    if (pb->log != NULL)
+      fputs(pb->log,stdout);
+    if (m_verbose)
+      printf(
+              "%-20s %4zu chapters %6zu verses %9zu bytes %016llx\n",
+              pb->name,
+              pb->chapters,
+              pb->verses,
+              pb->bytes,
+              (unsigned long long)pb->sum
+            );
+            
+    errors   += pb->errors;
+    chapters += pb->chapters;
+    verses   += pb->verses;
+    bytes    += pb->bytes;
+    sum       = fnv1a(sum,&pb->sum,sizeof(pb->sum));
+  }
+  
+  printf(
+          "%zu books, %zu chapters, %zu verses, %zu bytes, %zu errors, checksum %016llx\n",
+          m_maxbook,
+          chapters,
+          verses,
+          bytes,
+          errors,
+          (unsigned long long)sum
+        );
+        
+  return(errors ? 1 : 0);
+}
+
+/********************************************************************/
+
+static void *worker(void *data)
+{
+  (void)data;
+  
+  while(true)
+  {
+    size_t i;
+    
+    pthread_mutex_lock(&m_lock);
+    i = m_next++;
+    pthread_mutex_unlock(&m_lock);
+    
+    if (i >= m_maxbook)
+      return(NULL);
+    check_book(&m_books[i]);
+  }
+}
+
+/********************************************************************/
+
+static void check_book(struct book *pb)
+{
+  char           dname[FILENAME_MAX];
+  DIR           *dir;
+  struct dirent *de;
+  size_t         maxc = 0;
+  
+  assert(pb != NULL);
+  
+  snprintf(dname,sizeof(dname),"%s/%s",m_bookdir,pb->name);
+  dir = opendir(dname);
+  if (dir == NULL)
+  {
+    report(pb,"%s: missing book directory",pb->name);
+    return;
+  }
+  
+  /*------------------------------------------------------------
+  ; Find the highest numbered chapter so we can spot any gaps.
+  ;-------------------------------------------------------------*/
+  
+  while((de = readdir(dir)) != NULL)
+  {
+    char   *p;
+    size_t  n;
+    
+    if (!isdigit(de->d_name[0]))
+      continue;
+    n = strtoul(de->d_name,&p,10);
+    if ((*p != '\0') && (strcmp(p,".index") != 0))
+    {
+      report(pb,"%s/%s: unexpected file",pb->name,de->d_name);
+      continue;
+    }
+    if (n > maxc)
+      maxc = n;
+  }
+  closedir(dir);
+  
+  if (maxc == 0)
+    report(pb,"%s: no chapters",pb->name);
+    
+  for (size_t i = 1 ; i <= maxc ; i++)
+    if (check_chapter(pb,dname,i))
+      pb->chapters++;
+}
+
+/********************************************************************/
+
+static bool check_chapter(struct book *pb,char const *dname,size_t chapter)
+{
+  char            fname[FILENAME_MAX];
+  struct stat     status;
+  long int       *idx   = NULL;
+  unsigned char  *text  = NULL;
+  size_t          isize = 0;
+  size_t          tsize = 0;
+  size_t          max;
+  size_t          bad;
+  bool            okay  = false;
+  int             fh;
+  
+  assert(pb    != NULL);
+  assert(dname != NULL);
+  
+  if (snprintf(fname,sizeof(fname),"%s/%zu.index",dname,chapter) >= (int)sizeof(fname))
+  {
+    report(pb,"%s/%zu.index: path too long",pb->name,chapter);
+    return(false);
+  }
+  fh = open(fname,O_RDONLY);
+  if (fh == -1)
+  {
+    report(pb,"%s/%zu.index: missing",pb->name,chapter);
+    return(false);
+  }
+  if (fstat(fh,&status) < 0)
+  {
+    report(pb,"%s/%zu.index: %s",pb->name,chapter,strerror(errno));
+    close(fh);
+    return(false);
+  }
+  isize = status.st_size;
+  if (isize > 0)
+  {
+    idx = mmap(NULL,isize,PROT_READ,MAP_PRIVATE,fh,0);
+    if (idx == MAP_FAILED) idx = NULL;
+  }
+  close(fh);
+  
+  if (snprintf(fname,sizeof(fname),"%s/%zu",dname,chapter) >= (int)sizeof(fname))
+  {
+    report(pb,"%s/%zu: path too long",pb->name,chapter);
+    goto done;
+  }
+  fh = open(fname,O_RDONLY);
+  if (fh == -1)
+  {
+    report(pb,"%s/%zu: missing",pb->name,chapter);
+    goto done;
+  }
+  if (fstat(fh,&status) < 0)
+  {
+    report(pb,"%s/%zu: %s",pb->name,chapter,strerror(errno));
+    close(fh);
+    goto done;
+  }
+  tsize = status.st_size;
+  if (tsize > 0)
+  {
+    text = mmap(NULL,tsize,PROT_READ,MAP_PRIVATE,fh,0);
+    if (text == MAP_FAILED) text = NULL;
+    else madvise(text,tsize,MADV_SEQUENTIAL);
+  }
+  close(fh);
+  
+  if ((idx == NULL) || (isize < sizeof(long)))
+  {
+    report(pb,"%s/%zu.index: empty",pb->name,chapter);
+    goto done;
+  }
+  
+  /*-------------------------------------------------------------
+  ; -m 0 leaves only the limit that keeps the size below from
+  ; overflowing, which lb_chapter_open() enforces as well.
+  ;--------------------------------------------------------------*/
+  
+  max = idx[0];
+  if (
+          (idx[0] < 1)
+       || (max > (LONG_MAX / sizeof(long)) - 2)
+       || ((m_maxverses > 0) && (max > m_maxverses))
+     )
+  {
+    report(pb,"%s/%zu.index: insane verse count %ld",pb->name,chapter,idx[0]);
+    goto done;
+  }
+  
+  if (isize != (max + 2) * sizeof(long))
+  {
+    report(
+            pb,
+            "%s/%zu.index: %s (%zu bytes, expected %zu for %zu verses)",
+            pb->name,
+            chapter,
+            isize < (max + 2) * sizeof(long) ? "truncated" : "trailing garbage",
+            isize,
+            (max + 2) * sizeof(long),
+            max
+          );
+    goto done;
+  }
+  
+  if (idx[1] != 0)
+  {
+    report(pb,"%s/%zu.index: first verse at offset %ld, not 0",pb->name,chapter,idx[1]);
+    goto done;
+  }
+  
+  for (size_t i = 2 ; i <= max + 1 ; i++)
+  {
+    if (idx[i] < idx[i-1])
+    {
+      report(pb,"%s/%zu.index: offset for verse %zu goes backwards (%ld < %ld)",pb->name,chapter,i-1,idx[i],idx[i-1]);
+      goto done;
+    }
+  }
+  
+  if ((size_t)idx[max + 1] != tsize)
+  {
+    report(pb,"%s/%zu.index: last offset %ld but text is %zu bytes",pb->name,chapter,idx[max + 1],tsize);
+    goto done;
+  }
+  
+  if (!valid_utf8(text,tsize,&bad))
+  {
+    size_t v;
+    
+    for (v = 1 ; (v < max) && ((size_t)idx[v + 1] <= bad) ; v++)
+      ;
+    report(pb,"%s/%zu: invalid UTF-8 at byte %zu (verse %zu)",pb->name,chapter,bad,v);
+    goto done;
+  }
+  
+  pb->verses += max;
+  pb->bytes  += tsize;
+  okay        = true;
+  
+done:
+  if (idx != NULL)
+  {
+    pb->sum = fnv1a(pb->sum,idx,isize);
+    munmap(idx,isize);
+  }
+  if (text != NULL)
+  {
+    pb->sum = fnv1a(pb->sum,text,tsize);
+    munmap(text,tsize);
+  }
+  return(okay);
+}
+
+/********************************************************************
+;
+; Returns false (and the offset of the bad sequence) for overlong
+; encodings, surrogates, values past U+10FFFF and truncated sequences.
+;
+*********************************************************************/
+
+static bool valid_utf8(unsigned char const *s,size_t len,size_t *pbad)
+{
+  size_t i = 0;
+  
+  assert(pbad != NULL);
+  
+  while(i < len)
+  {
+    unsigned char c = s[i];
+    size_t        n;
+    uint32_t      cp;
+    
+    /*-----------------------------------------------------------
+    ; Most text is plain ASCII; check it eight bytes at a time.
+    ;------------------------------------------------------------*/
+    
+    if ((c < 0x80) && (i + 8 <= len))
+    {
+      uint64_t w;
+      
+      memcpy(&w,&s[i],sizeof(w));
+      if ((w & 0x8080808080808080ULL) == 0)
+      {
+        i += 8;
+        continue;
+      }
+    }
+    
+    if (c < 0x80)
+    {
+      i++;
+      continue;
+    }
+    else if ((c & 0xE0) == 0xC0) { n = 1; cp = c & 0x1F; }
+    else if ((c & 0xF0) == 0xE0) { n = 2; cp = c & 0x0F; }
+    else if ((c & 0xF8) == 0xF0) { n = 3; cp = c & 0x07; }
+    else
+    {
+      *pbad = i;
+      return(false);
+    }
+    
+    for (size_t j = 1 ; j <= n ; j++)
+    {
+      if ((i + j >= len) || ((s[i + j] & 0xC0) != 0x80))
+      {
+        *pbad = i;
+        return(false);
+      }
+      cp = (cp << 6) | (s[i + j] & 0x3F);
+    }
+    
+    if (
+            ((n == 1) && (cp < 0x80))
+         || ((n == 2) && (cp < 0x800))
+         || ((n == 3) && (cp < 0x10000))
+         || (cp > 0x10FFFF)
+         || ((cp >= 0xD800) && (cp <= 0xDFFF))
+       )
+    {
+      *pbad = i;
+      return(false);
+    }
+    
+    i += n + 1;
+  }
+  
+  return(true);
+}
+
+/********************************************************************/
+
+static uint64_t fnv1a(uint64_t hash,void const *data,size_t len)
+{
+  unsigned char const *p = data;
+  
+  for (size_t i = 0 ; i < len ; i++)
+  {
+    hash ^= p[i];
+    hash *= FNV_PRIME;
+  }
+  return(hash);
+}
+
+/********************************************************************/
+
+static void report(struct book *pb,char const *fmt,...)
+{
+  char    buffer[BUFSIZ];
+  va_list args;
+  int     len;
+  
+  assert(pb  != NULL);
+  assert(fmt != NULL);
+  
+  va_start(args,fmt);
+  len = vsnprintf(buffer,sizeof(buffer) - 1,fmt,args);
+  va_end(args);
+  
+  if (len < 0) return;
+  if ((size_t)len > sizeof(buffer) - 2) len = sizeof(buffer) - 2;
+  buffer[len++] = '\n';
+  buffer[len]   = '\0';
+  
+  pb->log = realloc(pb->log,pb->loglen + len + 1);
+  if (pb->log == NULL)
+  {
+    perror("realloc()");
+    exit(2);
+  }
+  memcpy(&pb->log[pb->loglen],buffer,len + 1);
+  pb->loglen += len;
+  pb->errors++;
+}
+
+/********************************************************************/
+
+static bool read_booklist(char const *fname)
+{
+  struct lbtrans trans;
+  size_t         line;
+  int            rc;
+  
+  assert(fname != NULL);
+  
+  rc = lb_trans_load(&trans,fname,&lb_malloc,&line);
+  if (rc != 0)
+  {
+    if (rc == EINVAL)
+      fprintf(stderr,"%s: corrupted on or around line %zu\n",fname,line + 1);
+    else
+      fprintf(stderr,"%s: %s\n",fname,strerror(rc));
+    return(false);
+  }
+  
+  m_maxbook = trans.maxbook;
+  m_books   = calloc(m_maxbook,sizeof(struct book));
+  if (m_books == NULL)
+  {
+    perror("calloc()");
+    return(false);
+  }
+  
+  for (size_t i = 0 ; i < m_maxbook ; i++)
+  {
+    m_books[i].name = strdup(trans.books[i].fullname);
+    m_books[i].sum  = FNV_OFFSET;
+  }
+  
+  lb_trans_free(&trans,&lb_malloc);
+  return(m_maxbook > 0);
+}
+
+/*******************************************************************/
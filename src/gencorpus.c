@@ -0,0 +1,740 @@
+/******************************************************************
+*
+* gencorpus.c           - Program to generate a synthetic library in
+*                         the mod_litbook format, for scale testing
+*                         (litbook-gencorpus).
+*
+* Copyright 2022 by Sean Conner.  All Rights Reserved.
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*
+* Comments, questions and criticisms can be sent to: sean@conman.org
+*
+* -----------------------------------------------------------------
+*
+* The books, chapters and verses are made up, but the shape of the
+* library is controlled with distributions:
+*
+*       fixed:n                 always n
+*       uniform:lo:hi           anything from lo to hi
+*       normal:mean:sd          normal, clamped to at least 1
+*       lognormal:median:sd     log-normal (sd in log space)
+*       zipf:max:s              1 .. max, with 1 most likely
+*
+* for the number of chapters per book (-c), verses per chapter (-v) and
+* bytes per verse (-l).  Generation stops after -b books, or when -m
+* bytes of text have been written, whichever comes first.
+*
+* The verses are drawn from a made up vocabulary of -w words, the way
+* real text is:  by rank, Zipf distributed with exponent -z, and with
+* the common words the short ones.  That keeps the size of the search
+* index in proportion to the text, as it is for a real work.
+*
+* The book names are built from syllables, and some are made to collide
+* the way real ones do:  numbered books (1Kings, 2Kings), and names that
+* are spelled differently but sound the same, so the Soundex and
+* metaphone lookups have something to chew on.  The translation file is
+* written in the same order as the books.
+*
+* The output is written with the same code breakout uses (writer.c) so
+* it is in whatever format breakout produces.
+*
+********************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+#include <errno.h>
+#include <assert.h>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "types.h"
+#include "reader.h"
+#include "writer.h"
+#include "indexer.h"
+#include "search.h"
+
+#define MAXNAME         64
+#define MAXWORD         16
+#define MAXVERSES       2000
+#define MAXVLEN         8192
+
+/************************************************************/
+
+enum dtype
+{
+  D_FIXED,
+  D_UNIFORM,
+  D_NORMAL,
+  D_LOGNORMAL,
+  D_ZIPF,
+};
+
+struct dist
+{
+  enum dtype  type;
+  double      a;
+  double      b;
+  double     *cdf;                      /* zipf only */
+};
+
+struct name
+{
+  char full [MAXNAME];
+  char abrev[MAXNAME];
+};
+
+/************************************************************/
+
+static bool      parse_dist             (struct dist *,char const *);
+static size_t    sample                 (struct dist *,size_t);
+static double    uniform                (void);
+static double    gaussian               (void);
+static uint64_t  rnd                    (void);
+static void      make_names             (struct name *,size_t);
+static void      make_word              (char *,size_t);
+static void      make_sound_alike       (char *,char const *);
+static void      make_abrev             (struct name *,struct name *,size_t);
+static bool      name_used              (struct name *,size_t,char const *,bool);
+static void      make_vocab             (size_t);
+static void      make_verse             (char *,size_t);
+static uint64_t  parse_size             (char const *);
+static void      usage                  (char const *);
+
+/************************************************************/
+
+static char const *const c_onset[] =
+{
+  "b" , "br" , "ch" , "d" , "f" , "g" , "h" , "j" , "k" , "l" , "m" ,
+  "n" , "p" , "ph" , "r" , "s" , "sh" , "t" , "th" , "v" , "z" , "c" ,
+  "gr" , "st" , "tr" , "",
+};
+
+static char const *const c_vowel[] =
+{
+  "a" , "e" , "i" , "o" , "u" , "ai" , "ea" , "ia" , "ei" , "y",
+};
+
+static char const *const c_coda[] =
+{
+  "" , "" , "" , "n" , "s" , "th" , "m" , "l" , "r" , "sh" , "k" , "d",
+};
+
+static char const *const c_alike[][2] =
+{
+  { "ph" , "f"  } , { "f"  , "ph" } , { "c"  , "k"  } , { "k"  , "c"  } ,
+  { "ei" , "ai" } , { "ai" , "ei" } , { "ea" , "ee" } , { "y"  , "i"  } ,
+  { "i"  , "y"  } , { "th" , "t"  } , { "z"  , "s"  } , { "s"  , "z"  } ,
+};
+
+#define NELEM(a)        (sizeof(a) / sizeof(a[0]))
+
+static uint64_t      m_seed = 1;
+static char        (*m_words)[MAXWORD];
+static struct dist   m_dword;
+
+/************************************************************/
+
+int main(int argc,char *argv[])
+{
+  struct dist  dchap;
+  struct dist  dverse;
+  struct dist  dlen;
+  size_t       books    = 66;
+  size_t       nwords   = 20000;
+  double       zexp     = 1.0;
+  uint64_t     maxbytes = 0;
+  uint64_t     bytes    = 0;
+  struct name *names;
+  FILE        *fptrans;
+  Writer       w;
+  Indexer      ix       = NULL;
+  bool         index    = false;
+  Record       rec;
+  char        *text;
+  size_t       i;
+  int          c;
+  
+  parse_dist(&dchap, "uniform:1:50");
+  parse_dist(&dverse,"normal:26:12");
+  parse_dist(&dlen,  "normal:130:60");
+  
+  while((c = getopt(argc,argv,"b:c:v:l:m:s:w:z:ih")) != EOF)
+  {
+    switch(c)
+    {
+      case 'i': index    = true;                    break;
+      case 'b': books    = strtoul(optarg,NULL,10); break;
+      case 'w': nwords   = strtoul(optarg,NULL,10); break;
+      case 'z': zexp     = strtod(optarg,NULL);     break;
+      case 'm': maxbytes = parse_size(optarg);      break;
+      case 's': m_seed   = strtoull(optarg,NULL,10); if (m_seed == 0) m_seed = 1; break;
+      case 'c':
+           if (!parse_dist(&dchap,optarg)) { usage(argv[0]); return(1); }
+           break;
+      case 'v':
+           if (!parse_dist(&dverse,optarg)) { usage(argv[0]); return(1); }
+           break;
+      case 'l':
+           if (!parse_dist(&dlen,optarg)) { usage(argv[0]); return(1); }
+           break;
+      case 'h':
+      default:
+           usage(argv[0]);
+           return(1);
+    }
+  }
+  
+  if ((argc - optind < 2) || (books == 0) || (nwords == 0))
+  {
+    usage(argv[0]);
+    return(1);
+  }
+  
+  {
+    char spec[64];
+    
+    snprintf(spec,sizeof(spec),"zipf:%zu:%g",nwords,zexp);
+    if (!parse_dist(&m_dword,spec))
+    {
+      usage(argv[0]);
+      return(1);
+    }
+  }
+  
+  names = calloc(books,sizeof(struct name));
+  text  = malloc(MAXVLEN + 1);
+  if ((names == NULL) || (text == NULL))
+  {
+    perror("malloc()");
+    return(1);
+  }
+  
+  make_names(names,books);
+  make_vocab(nwords);
+  
+  fptrans = fopen(argv[optind + 1],"w");
+  if (fptrans == NULL)
+  {
+    perror(argv[optind + 1]);
+    return(1);
+  }
+  
+  if ((mkdir(argv[optind],0777) != 0) && (errno != EEXIST))
+  {
+    perror(argv[optind]);
+    return(1);
+  }
+  
+  if (chdir(argv[optind]) != 0)
+  {
+    perror(argv[optind]);
+    return(1);
+  }
+  
+  w = WriterCreate();
+  if (index)
+    ix = IndexCreate(true);
+    
+  for (i = 0 ; i < books ; i++)
+  {
+    size_t chapters = sample(&dchap,0);
+    
+    if ((maxbytes > 0) && (bytes >= maxbytes))
+      break;
+      
+    fprintf(fptrans,"%s\t, %s\n",names[i].abrev,names[i].full);
+    rec.book = names[i].full;
+    
+    for (size_t ch = 1 ; ch <= chapters ; ch++)
+    {
+      size_t verses = sample(&dverse,MAXVERSES);
+      
+      rec.chapter = ch;
+      for (size_t v = 1 ; v <= verses ; v++)
+      {
+        make_verse(text,sample(&dlen,MAXVLEN));
+        rec.verse = v;
+        rec.text  = text;
+        WriterRecord(w,&rec);
+        if (ix != NULL)
+          IndexRecord(ix,&rec);
+        bytes += strlen(text);
+      }
+    }
+  }
+  
+  fprintf(
+           stderr,
+           "%lu books, %lu chapters, %lu verses, %llu bytes\n",
+           (unsigned long)WriterBooks(w),
+           (unsigned long)WriterChapters(w),
+           (unsigned long)WriterVerses(w),
+           (unsigned long long)bytes
+         );
+         
+  WriterFinish(w);
+  
+  if (ix != NULL)
+  {
+    IndexWrite(ix,LB_INDEX_NAME);
+    IndexFree(ix);
+  }
+  
+  fclose(fptrans);
+  free(m_dword.cdf);
+  free(m_words);
+  free(text);
+  free(names);
+  return(0);
+}
+
+/********************************************************************/
+
+static void usage(char const *prog)
+{
+  fprintf(
+           stderr,
+           "usage: %s [options] <bookdir> <translationfile>\n"
+           "\t-b books      number of books (default 66)\n"
+           "\t-m size       stop after this much text (K, M, G suffixes)\n"
+           "\t-c dist       chapters per book (default uniform:1:50)\n"
+           "\t-v dist       verses per chapter (default normal:26:12)\n"
+           "\t-l dist       bytes per verse (default normal:130:60)\n"
+           "\t-w words      size of the vocabulary (default 20000)\n"
+           "\t-z exponent   Zipf exponent for the words (default 1.0)\n"
+           "\t-s seed       random seed (default 1)\n"
+           "\t-i            also write the search index\n"
+           "\tdist is fixed:n, uniform:lo:hi, normal:mean:sd,\n"
+           "\t\tlognormal:median:sd or zipf:max:s\n",
+           prog
+         );
+}
+
+/********************************************************************/
+
+static bool parse_dist(struct dist *pd,char const *spec)
+{
+  char   type[16];
+  int    n;
+  
+  assert(pd   != NULL);
+  assert(spec != NULL);
+  
+  pd->a   = 0.0;
+  pd->b   = 0.0;
+  pd->cdf = NULL;
+  n       = sscanf(spec,"%15[a-z]:%lf:%lf",type,&pd->a,&pd->b);
+  
+  if (n < 2)
+    return(false);
+    
+  if (strcmp(type,"fixed") == 0)
+    pd->type = D_FIXED;
+  else if ((strcmp(type,"uniform") == 0) && (n == 3) && (pd->b >= pd->a))
+    pd->type = D_UNIFORM;
+  else if ((strcmp(type,"normal") == 0) && (n == 3))
+    pd->type = D_NORMAL;
+  else if ((strcmp(type,"lognormal") == 0) && (n == 3) && (pd->a > 0.0))
+    pd->type = D_LOGNORMAL;
+  else if ((strcmp(type,"zipf") == 0) && (n == 3) && (pd->a >= 1.0))
+  {
+    size_t max = pd->a;
+    double sum = 0.0;
+    
+    pd->type = D_ZIPF;
+    pd->cdf  = malloc(max * sizeof(double));
+    if (pd->cdf == NULL)
+      return(false);
+    for (size_t i = 0 ; i < max ; i++)
+    {
+      sum        += 1.0 / pow((double)(i + 1),pd->b);
+      pd->cdf[i]  = sum;
+    }
+  }
+  else
+    return(false);
+    
+  return(true);
+}
+
+/********************************************************************
+;
+; Return a sample from the distribution, at least 1, and no more than
+; max (if max isn't 0).
+;
+*********************************************************************/
+
+static size_t sample(struct dist *pd,size_t max)
+{
+  double x;
+  
+  assert(pd != NULL);
+  
+  switch(pd->type)
+  {
+    case D_FIXED:
+         x = pd->a;
+         break;
+         
+    case D_UNIFORM:
+         x = floor(pd->a + uniform() * (pd->b - pd->a + 1.0));
+         break;
+         
+    case D_NORMAL:
+         x = floor(pd->a + gaussian() * pd->b + 0.5);
+         break;
+         
+    case D_LOGNORMAL:
+         x = floor(exp(log(pd->a) + gaussian() * pd->b) + 0.5);
+         break;
+         
+    case D_ZIPF:
+         {
+           size_t n  = pd->a;
+           double u  = uniform() * pd->cdf[n - 1];
+           size_t lo = 0;
+           size_t hi = n - 1;
+           
+           while(lo < hi)
+           {
+             size_t mid = (lo + hi) / 2;
+             if (pd->cdf[mid] < u)
+               lo = mid + 1;
+             else
+               hi = mid;
+           }
+           x = lo + 1;
+         }
+         break;
+         
+    default:
+         assert(0);
+         x = 1;
+         break;
+  }
+  
+  if (x < 1.0) x = 1.0;
+  if ((max > 0) && (x > (double)max)) x = max;
+  return((size_t)x);
+}
+
+/********************************************************************/
+
+static double uniform(void)
+{
+  return((double)(rnd() >> 11) / 9007199254740992.0);
+}
+
+/********************************************************************/
+
+static double gaussian(void)
+{
+  double u1 = uniform();
+  double u2 = uniform();
+  
+  if (u1 < 1e-300) u1 = 1e-300;
+  return(sqrt(-2.0 * log(u1)) * cos(2.0 * M_PI * u2));
+}
+
+/********************************************************************/
+
+static uint64_t rnd(void)
+{
+  m_seed ^= m_seed >> 12;
+  m_seed ^= m_seed << 25;
+  m_seed ^= m_seed >> 27;
+  return(m_seed * 2685821657736338717ULL);
+}
+
+/********************************************************************
+;
+; Make up the book names.  About one in ten starts a numbered series
+; (1Name, 2Name ...) and about one in eight sounds like a name that's
+; already been made.  Full names are unique (they're directory names).
+;
+*********************************************************************/
+
+static void make_names(struct name *names,size_t max)
+{
+  size_t i = 0;
+  
+  assert(names != NULL);
+  
+  while(i < max)
+  {
+    char   base[MAXNAME];
+    size_t r = rnd() % 100;
+    
+    if ((r < 12) && (i > 0))
+      make_sound_alike(base,names[rnd() % i].full);
+    else
+      make_word(base,2 + rnd() % 3);
+      
+    if (isdigit(base[0]) || name_used(names,i,base,true))
+      continue;
+      
+    if ((r >= 12) && (r < 22))
+    {
+      size_t series = 2 + rnd() % 2;
+      
+      for (size_t s = 1 ; (s <= series) && (i < max) ; s++)
+      {
+        if (snprintf(names[i].full,MAXNAME,"%zu%s",s,base) >= MAXNAME)
+          break;                        /* no room for the number */
+        make_abrev(&names[i],names,i);
+        i++;
+      }
+    }
+    else
+    {
+      snprintf(names[i].full,MAXNAME,"%s",base);
+      make_abrev(&names[i],names,i);
+      i++;
+    }
+  }
+}
+
+/********************************************************************/
+
+static void make_word(char *dest,size_t syllables)
+{
+  char *p = dest;
+  
+  assert(dest != NULL);
+  
+  for (size_t s = 0 ; s < syllables ; s++)
+  {
+    p += sprintf(
+                  p,
+                  "%s%s%s",
+                  c_onset[rnd() % NELEM(c_onset)],
+                  c_vowel[rnd() % NELEM(c_vowel)],
+                  s == syllables - 1 ? c_coda[rnd() % NELEM(c_coda)] : ""
+                );
+  }
+  dest[0] = toupper(dest[0]);
+}
+
+/********************************************************************/
+
+static void make_sound_alike(char *dest,char const *src)
+{
+  char lower[MAXNAME];
+  
+  assert(dest != NULL);
+  assert(src  != NULL);
+  
+  if (isdigit(*src)) src++;
+  for (size_t i = 0 ; (i < MAXNAME - 1) && (src[i] != '\0') ; i++)
+  {
+    lower[i]     = tolower(src[i]);
+    lower[i + 1] = '\0';
+  }
+  
+  for (size_t t = 0 ; t < NELEM(c_alike) ; t++)
+  {
+    size_t      k = (rnd() + t) % NELEM(c_alike);
+    char const *p = strstr(lower,c_alike[k][0]);
+    
+    if (p != NULL)
+    {
+      snprintf(
+                dest,
+                MAXNAME,
+                "%.*s%s%s",
+                (int)(p - lower),
+                lower,
+                c_alike[k][1],
+                p + strlen(c_alike[k][0])
+              );
+      dest[0] = toupper(dest[0]);
+      return;
+    }
+  }
+  
+  snprintf(dest,MAXNAME,"%s",src);      /* caller rejects the duplicate */
+}
+
+/********************************************************************
+;
+; Abbreviations are the first few letters (keeping any leading digit),
+; made longer until they're unique.
+;
+*********************************************************************/
+
+static void make_abrev(struct name *pn,struct name *names,size_t max)
+{
+  size_t len   = isdigit(pn->full[0]) ? 3 : 2;
+  size_t total = strlen(pn->full);
+  
+  assert(pn    != NULL);
+  assert(names != NULL);
+  
+  for ( ; len <= total ; len++)
+  {
+    snprintf(pn->abrev,MAXNAME,"%.*s",(int)len,pn->full);
+    if (!name_used(names,max,pn->abrev,false))
+      return;
+  }
+  
+  for (size_t n = 2 ; ; n++)
+  {
+    snprintf(pn->abrev,MAXNAME,"%.40s%zu",pn->full,n);
+    if (!name_used(names,max,pn->abrev,false))
+      return;
+  }
+}
+
+/********************************************************************/
+
+static bool name_used(struct name *names,size_t max,char const *s,bool full)
+{
+  for (size_t i = 0 ; i < max ; i++)
+  {
+    if (strcmp(full ? names[i].full : names[i].abrev,s) == 0)
+      return(true);
+    if (full && isdigit(names[i].full[0]) && (strcmp(&names[i].full[1],s) == 0))
+      return(true);
+  }
+  return(false);
+}
+
+/********************************************************************
+;
+; Make up the vocabulary, most common word first.  As in real text, the
+; common words are short:  one syllable for the first couple of hundred,
+; up to two for the next few thousand, two or three after that.  Words
+; are all different (checked with a hash table of indices, 0 empty).
+;
+*********************************************************************/
+
+static void make_vocab(size_t max)
+{
+  size_t  hsize = 1;
+  size_t *seen;
+  size_t  i     = 0;
+  
+  while(hsize < 2 * max)
+    hsize <<= 1;
+    
+  m_words = malloc(max * sizeof(m_words[0]));
+  seen    = calloc(hsize,sizeof(size_t));
+  if ((m_words == NULL) || (seen == NULL))
+  {
+    perror("malloc()");
+    exit(1);
+  }
+  
+  while(i < max)
+  {
+    size_t      syllables = i < 200 ? 1 : i < 5000 ? 1 + rnd() % 2 : 2 + rnd() % 2;
+    uint64_t    hash      = 14695981039346656037ULL;
+    size_t      h;
+    bool        dup       = false;
+    
+    make_word(m_words[i],syllables);
+    m_words[i][0] = tolower(m_words[i][0]);
+    
+    for (char const *s = m_words[i] ; *s ; s++)
+      hash = (hash ^ (unsigned char)*s) * 1099511628211ULL;
+      
+    for (h = hash & (hsize - 1) ; seen[h] != 0 ; h = (h + 1) & (hsize - 1))
+    {
+      if (strcmp(m_words[seen[h] - 1],m_words[i]) == 0)
+      {
+        dup = true;
+        break;
+      }
+    }
+    
+    if (!dup)
+      seen[h] = ++i;
+  }
+  
+  free(seen);
+}
+
+/********************************************************************/
+
+static void make_verse(char *dest,size_t len)
+{
+  char   *p     = dest;
+  char   *end   = dest + len;
+  bool    first = true;
+  
+  assert(dest != NULL);
+  
+  while(p < end)
+  {
+    char   word[MAXWORD];
+    size_t wlen;
+    
+    strcpy(word,m_words[sample(&m_dword,0) - 1]);
+    if (first)
+      word[0] = toupper(word[0]);
+    wlen = strlen(word);
+    if (p + wlen + 2 > end)
+      break;
+      
+    memcpy(p,word,wlen);
+    p    += wlen;
+    first = false;
+    
+    switch(rnd() % 12)
+    {
+      case 0:  *p++ = ','; break;
+      case 1:  *p++ = ';'; break;
+      case 2:  *p++ = '.'; first = true; break;
+      default: break;
+    }
+    *p++ = ' ';
+  }
+  
+  if (p == dest)
+    *p++ = 'A';
+  else
+    p--;                                /* the trailing space */
+  if (p[-1] == ',' || p[-1] == ';')
+    p--;
+  if ((p > dest) && (p[-1] != '.'))
+    *p++ = '.';
+  *p = '\0';
+}
+
+/********************************************************************/
+
+static uint64_t parse_size(char const *s)
+{
+  char     *end;
+  uint64_t  size = strtoull(s,&end,10);
+  
+  switch(toupper(*end))
+  {
+    case 'G': size *= 1024;     /* FALLTHROUGH */
+    case 'M': size *= 1024;     /* FALLTHROUGH */
+    case 'K': size *= 1024;     break;
+    default:  break;
+  }
+  return(size);
+}
+
+/********************************************************************/
@@ -0,0 +1,730 @@
+/******************************************************************
+*
+* indexer.c             - Build the full text search index (see search.h)
+*                         from a stream of verse records.
+*
+* Copyright 2022 by Sean Conner.  All Rights Reserved.
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*
+* Comments, questions and criticisms can be sent to: sean@conman.org
+*
+* -----------------------------------------------------------------
+*
+* Records are fed in the same order as to the writer, and every verse
+* gets the next ordinal.  The vocabulary is kept in a hash table, and
+* each word's postings list is kept already compressed, so the memory
+* needed is about that of the finished index.  The words are only
+* sorted when it's written out.
+*
+* With positions, each word also gets a list per verse of where in the
+* verse it appears (counting words from 0), again compressed.  Since
+* the number of times a word shows up in a verse isn't known until the
+* verse is done, each list ends with a 0 instead (see search.h).
+*
+* The skip entries are made as the postings go by, since that's when
+* the offsets are known.  The sounds of the words (Soundex and
+* metaphone) are worked out once, when the index is written, so a
+* search never has to code the vocabulary.
+*
+* The counts of each word by book and chapter are kept the same way as
+* the postings, an entry added whenever the book or chapter changes, so
+* they come out already in order.  The verse text is just appended.
+*
+********************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <ctype.h>
+#include <assert.h>
+
+#include "util.h"
+#include "soundex.h"
+#include "metaphone.h"
+#include "search.h"
+#include "indexer.h"
+
+/*****************************************************************/
+
+struct vbuf
+{
+  Byte   *data;
+  size_t  len;
+  size_t  max;
+};
+
+struct fbuf
+{
+  struct lbixfreq *f;
+  size_t           n;
+  size_t           max;
+};
+
+struct word
+{
+  char            *word;
+  struct vbuf      post;
+  struct vbuf      pos;
+  struct lbixskip *skip;
+  size_t           skips;
+  size_t           maxskips;
+  struct fbuf      bookf;
+  struct fbuf      chapf;
+  uint32_t         last;
+  uint32_t         lastpos;
+  uint32_t         verses;
+  uint32_t         count;
+};
+
+struct sound
+{
+  uint32_t    code;                     /* Soundex */
+  char const *mph;
+  uint32_t    word;
+  uint32_t    verses;
+};
+
+struct book
+{
+  char     *name;
+  uint32_t  chapter;
+  uint32_t  chapters;
+};
+
+struct indexer
+{
+  struct word     *hash;
+  size_t           hsize;
+  size_t           words;
+  struct book     *books;
+  size_t           nbooks;
+  size_t           maxbooks;
+  struct lbixchap *chaps;
+  size_t           nchaps;
+  size_t           maxchaps;
+  Size             chapter;
+  uint32_t         verses;
+  uint32_t         tokens;
+  bool             positions;
+  struct vbuf      text;
+  uint32_t        *texttab;
+  size_t           maxtext;
+};
+
+/*****************************************************************/
+
+static void        *xrealloc            (void *,size_t);
+static size_t       hash                (char const *);
+static struct word *lookup              (Indexer,char const *);
+static void         add_varint          (struct vbuf *,uint32_t);
+static void         add_bytes           (struct vbuf *,void const *,size_t);
+static void         add_freq            (struct fbuf *,uint32_t,bool);
+static int          wordcmp             (void const *,void const *);
+static int          soundcmp            (struct sound const *,struct sound const *);
+static int          sdxcmp              (void const *,void const *);
+static int          mphcmp              (void const *,void const *);
+
+/*****************************************************************/
+
+Indexer IndexCreate(bool positions)
+{
+  Indexer ix = xrealloc(NULL,sizeof(struct indexer));
+  
+  memset(ix,0,sizeof(struct indexer));
+  ix->positions = positions;
+  ix->hsize    = 4096;
+  ix->hash     = xrealloc(NULL,ix->hsize * sizeof(struct word));
+  ix->maxchaps = 1024;
+  ix->chaps    = xrealloc(NULL,ix->maxchaps * sizeof(struct lbixchap));
+  memset(ix->hash,0,ix->hsize * sizeof(struct word));
+  return(ix);
+}
+
+/*****************************************************************/
+
+void IndexRecord(Indexer ix,Record const *rec)
+{
+  char        name[BUFSIZ];
+  char        word[LB_WORDMAX];
+  char       *d = name;
+  char const *s;
+  uint32_t    at;
+  
+  assert(ix         != NULL);
+  assert(rec        != NULL);
+  assert(rec->book  != NULL);
+  assert(rec->text  != NULL);
+  
+  /*------------------------------------------------------------
+  ; book names have the spaces stripped, same as the writer
+  ;-------------------------------------------------------------*/
+  
+  for (s = rec->book ; (*s) && (d < &name[sizeof(name) - 1]) ; s++)
+    if (!isspace(*s))
+      *d++ = *s;
+  *d = '\0';
+  
+  if ((ix->nbooks == 0) || (strcmp(ix->books[ix->nbooks - 1].name,name) != 0))
+  {
+    if (ix->nbooks == ix->maxbooks)
+    {
+      ix->maxbooks = ix->maxbooks ? ix->maxbooks * 2 : 128;
+      ix->books    = xrealloc(ix->books,ix->maxbooks * sizeof(struct book));
+    }
+    ix->books[ix->nbooks].name     = dup_string(name);
+    ix->books[ix->nbooks].chapter  = ix->nchaps;
+    ix->books[ix->nbooks].chapters = 0;
+    ix->nbooks++;
+    ix->chapter = 0;
+  }
+  
+  if (rec->chapter != ix->chapter)
+  {
+    if (ix->nchaps + 1 >= ix->maxchaps)
+    {
+      ix->maxchaps *= 2;
+      ix->chaps    = xrealloc(ix->chaps,ix->maxchaps * sizeof(struct lbixchap));
+    }
+    ix->chaps[ix->nchaps].verse  = ix->verses;
+    ix->chaps[ix->nchaps].book   = ix->nbooks - 1;
+    ix->chaps[ix->nchaps].number = rec->chapter;
+    ix->nchaps++;
+    ix->books[ix->nbooks - 1].chapters++;
+    ix->chapter = rec->chapter;
+  }
+  
+  if (ix->verses + 2 > ix->maxtext)
+  {
+    ix->maxtext = ix->maxtext ? ix->maxtext * 2 : 1024;
+    ix->texttab = xrealloc(ix->texttab,ix->maxtext * sizeof(uint32_t));
+  }
+  ix->texttab[ix->verses] = ix->text.len;
+  add_bytes(&ix->text,rec->text,strlen(rec->text) + 1);
+  
+  s = rec->text;
+  for (at = 0 ; lb_token(word,sizeof(word),&s) > 0 ; at++)
+  {
+    struct word *pw       = lookup(ix,word);
+    bool         newverse = (pw->verses == 0) || (pw->last != ix->verses);
+    
+    pw->count++;
+    ix->tokens++;
+    add_freq(&pw->bookf,ix->nbooks - 1,newverse);
+    add_freq(&pw->chapf,ix->nchaps - 1,newverse);
+    
+    if (newverse)
+    {
+      if (ix->positions && (pw->verses > 0))
+        add_varint(&pw->pos,0);
+      add_varint(&pw->post,pw->verses == 0 ? ix->verses : ix->verses - pw->last);
+      
+      if ((pw->verses > 0) && (pw->verses % LB_SKIPSTEP == 0))
+      {
+        if (pw->skips == pw->maxskips)
+        {
+          pw->maxskips = pw->maxskips ? pw->maxskips * 2 : 4;
+          pw->skip     = xrealloc(pw->skip,pw->maxskips * sizeof(struct lbixskip));
+        }
+        pw->skip[pw->skips].ord  = ix->verses;
+        pw->skip[pw->skips].post = pw->post.len;
+        pw->skip[pw->skips].pos  = pw->pos.len;
+        pw->skips++;
+      }
+      
+      pw->last = ix->verses;
+      pw->verses++;
+      
+      if (ix->positions)
+        add_varint(&pw->pos,at + 1);
+    }
+    else if (ix->positions)
+      add_varint(&pw->pos,at - pw->lastpos);
+      
+    pw->lastpos = at;
+  }
+  
+  ix->verses++;
+}
+
+/*****************************************************************/
+
+void IndexWrite(Indexer ix,char const *fname)
+{
+  struct lbixhdr   hdr;
+  struct word    **list;
+  size_t           n;
+  uint32_t         strings;
+  uint32_t         post;
+  uint32_t         pos;
+  uint32_t         skip;
+  uint32_t         freq;
+  char const     **names;
+  SOUNDEX         *sdx;
+  char            *mph;
+  struct sound    *bysdx;
+  struct sound    *bymph;
+  size_t           ns;
+  FILE            *fp;
+  
+  assert(ix    != NULL);
+  assert(fname != NULL);
+  
+  list = xrealloc(NULL,(ix->words + 1) * sizeof(struct word *));
+  for (size_t i = n = 0 ; i < ix->hsize ; i++)
+    if (ix->hash[i].word != NULL)
+      list[n++] = &ix->hash[i];
+  assert(n == ix->words);
+  qsort(list,n,sizeof(struct word *),wordcmp);
+  
+  /*-----------------------------------------------------------------
+  ; The sounds of the words that start with a letter, sorted both ways.
+  ;------------------------------------------------------------------*/
+  
+  names = xrealloc(NULL,(n + 1) * sizeof(char const *));
+  bysdx = xrealloc(NULL,(n + 1) * sizeof(struct sound));
+  bymph = xrealloc(NULL,(n + 1) * sizeof(struct sound));
+  
+  for (size_t i = ns = 0 ; i < n ; i++)
+  {
+    if (isalpha((unsigned char)list[i]->word[0]))
+    {
+      names[ns]         = list[i]->word;
+      bysdx[ns].word    = i;
+      bysdx[ns].verses  = list[i]->verses;
+      ns++;
+    }
+  }
+  
+  sdx = xrealloc(NULL,(ns + 1) * sizeof(SOUNDEX));
+  mph = xrealloc(NULL,(ns + 1) * LB_WORDMAX);
+  SoundexMany(sdx,names,ns);
+  make_metaphones(names,ns,mph,LB_WORDMAX);
+  
+  for (size_t i = 0 ; i < ns ; i++)
+  {
+    bysdx[i].code = (uint32_t)sdx[i].value;
+    bysdx[i].mph  = &mph[i * LB_WORDMAX];
+  }
+  
+  memcpy(bymph,bysdx,ns * sizeof(struct sound));
+  qsort(bysdx,ns,sizeof(struct sound),sdxcmp);
+  qsort(bymph,ns,sizeof(struct sound),mphcmp);
+  
+  /*-----------------------------------------------------------------
+  ; Close off the position list of the last verse of each word.
+  ;------------------------------------------------------------------*/
+  
+  if (ix->positions)
+    for (size_t i = 0 ; i < n ; i++)
+      add_varint(&list[i]->pos,0);
+      
+  /*-----------------------------------------------------------------
+  ; Layout:  header, books, chapters (plus one past the end), words,
+  ; skip entries, the two sound tables, word counts, where each verse
+  ; starts, strings (book names, words, then metaphone codes, each only
+  ; once), the postings, which start on a four byte boundary, the
+  ; positions, if any, and the text.
+  ;------------------------------------------------------------------*/
+  
+  memset(&hdr,0,sizeof(hdr));
+  memcpy(hdr.magic,LB_INDEX_MAGIC,sizeof(hdr.magic));
+  hdr.version  = LB_INDEX_VER;
+  hdr.books    = ix->nbooks;
+  hdr.chapters = ix->nchaps;
+  hdr.verses   = ix->verses;
+  hdr.words    = n;
+  hdr.tokens   = ix->tokens;
+  hdr.booktab  = sizeof(struct lbixhdr);
+  hdr.chaptab  = hdr.booktab + hdr.books * sizeof(struct lbixbook);
+  hdr.wordtab  = hdr.chaptab + (hdr.chapters + 1) * sizeof(struct lbixchap);
+  hdr.skiptab  = hdr.wordtab + hdr.words * sizeof(struct lbixword);
+  
+  for (size_t i = 0 ; i < n ; i++)
+    hdr.skips += list[i]->skips;
+  hdr.sounds   = ns;
+  hdr.sdxtab   = hdr.skiptab + hdr.skips * sizeof(struct lbixskip);
+  hdr.mphtab   = hdr.sdxtab + hdr.sounds * sizeof(struct lbixsound);
+  hdr.freqtab  = hdr.mphtab + hdr.sounds * sizeof(struct lbixsound);
+  
+  for (size_t i = 0 ; i < n ; i++)
+    hdr.freqs += list[i]->bookf.n + list[i]->chapf.n;
+  hdr.texttab  = hdr.freqtab + hdr.freqs * sizeof(struct lbixfreq);
+  hdr.strings  = hdr.texttab + (hdr.verses + 1) * sizeof(uint32_t);
+  
+  strings = 0;
+  for (size_t i = 0 ; i < ix->nbooks ; i++)
+    strings += strlen(ix->books[i].name) + 1;
+  for (size_t i = 0 ; i < n ; i++)
+    strings += strlen(list[i]->word) + 1;
+  for (size_t i = 0 ; i < ns ; i++)
+    if ((i == 0) || (strcmp(bymph[i].mph,bymph[i - 1].mph) != 0))
+      strings += strlen(bymph[i].mph) + 1;
+      
+  hdr.postings = (hdr.strings + strings + 3) & ~3u;
+  hdr.size     = hdr.postings;
+  for (size_t i = 0 ; i < n ; i++)
+    hdr.size += list[i]->post.len;
+    
+  if (ix->positions)
+  {
+    hdr.positions = hdr.size;
+    for (size_t i = 0 ; i < n ; i++)
+      hdr.size += list[i]->pos.len;
+  }
+  
+  hdr.text  = hdr.size;
+  hdr.size += ix->text.len;
+  
+  fp = fopen(fname,"wb");
+  if (fp == NULL)
+  {
+    perror(fname);
+    exit(1);
+  }
+  
+  fwrite(&hdr,sizeof(hdr),1,fp);
+  
+  strings = 0;
+  for (size_t i = 0 ; i < ix->nbooks ; i++)
+  {
+    struct lbixbook b;
+    
+    b.name     = strings;
+    b.chapter  = ix->books[i].chapter;
+    b.chapters = ix->books[i].chapters;
+    fwrite(&b,sizeof(b),1,fp);
+    strings += strlen(ix->books[i].name) + 1;
+  }
+  
+  ix->chaps[ix->nchaps].verse  = ix->verses;
+  ix->chaps[ix->nchaps].book   = 0;
+  ix->chaps[ix->nchaps].number = 0;
+  fwrite(ix->chaps,sizeof(struct lbixchap),ix->nchaps + 1,fp);
+  
+  post = hdr.postings;
+  pos  = hdr.positions;
+  skip = 0;
+  freq = 0;
+  for (size_t i = 0 ; i < n ; i++)
+  {
+    struct lbixword w;
+    
+    w.word   = strings;
+    w.verses = list[i]->verses;
+    w.count  = list[i]->count;
+    w.post   = post;
+    w.len    = list[i]->post.len;
+    w.pos    = pos;
+    w.poslen = list[i]->pos.len;
+    w.skip   = skip;
+    w.skips  = list[i]->skips;
+    w.freq   = freq;
+    w.fbooks = list[i]->bookf.n;
+    w.fchaps = list[i]->chapf.n;
+    fwrite(&w,sizeof(w),1,fp);
+    strings += strlen(list[i]->word) + 1;
+    post    += list[i]->post.len;
+    pos     += list[i]->pos.len;
+    skip    += list[i]->skips;
+    freq    += list[i]->bookf.n + list[i]->chapf.n;
+  }
+  
+  for (size_t i = 0 ; i < n ; i++)
+    fwrite(list[i]->skip,sizeof(struct lbixskip),list[i]->skips,fp);
+    
+  for (size_t i = 0 ; i < ns ; i++)
+  {
+    struct lbixsound s;
+    
+    s.code = bysdx[i].code;
+    s.word = bysdx[i].word;
+    fwrite(&s,sizeof(s),1,fp);
+  }
+  
+  for (size_t i = 0 ; i < ns ; i++)
+  {
+    struct lbixsound s;
+    
+    if ((i > 0) && (strcmp(bymph[i].mph,bymph[i - 1].mph) != 0))
+      strings += strlen(bymph[i - 1].mph) + 1;
+    s.code = strings;
+    s.word = bymph[i].word;
+    fwrite(&s,sizeof(s),1,fp);
+  }
+  if (ns > 0)
+    strings += strlen(bymph[ns - 1].mph) + 1;
+    
+  for (size_t i = 0 ; i < n ; i++)
+  {
+    fwrite(list[i]->bookf.f,sizeof(struct lbixfreq),list[i]->bookf.n,fp);
+    fwrite(list[i]->chapf.f,sizeof(struct lbixfreq),list[i]->chapf.n,fp);
+  }
+  
+  ix->texttab[ix->verses] = ix->text.len;
+  fwrite(ix->texttab,sizeof(uint32_t),ix->verses + 1,fp);
+  
+  for (size_t i = 0 ; i < ix->nbooks ; i++)
+    fwrite(ix->books[i].name,1,strlen(ix->books[i].name) + 1,fp);
+  for (size_t i = 0 ; i < n ; i++)
+    fwrite(list[i]->word,1,strlen(list[i]->word) + 1,fp);
+  for (size_t i = 0 ; i < ns ; i++)
+    if ((i == 0) || (strcmp(bymph[i].mph,bymph[i - 1].mph) != 0))
+      fwrite(bymph[i].mph,1,strlen(bymph[i].mph) + 1,fp);
+  for (size_t pad = hdr.postings - hdr.strings - strings ; pad > 0 ; pad--)
+    fputc('\0',fp);
+    
+  for (size_t i = 0 ; i < n ; i++)
+    fwrite(list[i]->post.data,1,list[i]->post.len,fp);
+  for (size_t i = 0 ; i < n ; i++)
+    fwrite(list[i]->pos.data,1,list[i]->pos.len,fp);
+  fwrite(ix->text.data,1,ix->text.len,fp);
+  
+  if (ferror(fp) || (fclose(fp) != 0))
+  {
+    perror(fname);
+    exit(1);
+  }
+  
+  free(bymph);
+  free(bysdx);
+  free(mph);
+  free(sdx);
+  free(names);
+  free(list);
+}
+
+/*****************************************************************/
+
+Size IndexWords(Indexer ix)
+{
+  assert(ix != NULL);
+  return(ix->words);
+}
+
+/*****************************************************************/
+
+void IndexFree(Indexer ix)
+{
+  assert(ix != NULL);
+  
+  for (size_t i = 0 ; i < ix->hsize ; i++)
+  {
+    free(ix->hash[i].word);
+    free(ix->hash[i].post.data);
+    free(ix->hash[i].pos.data);
+    free(ix->hash[i].skip);
+    free(ix->hash[i].bookf.f);
+    free(ix->hash[i].chapf.f);
+  }
+  for (size_t i = 0 ; i < ix->nbooks ; i++)
+    free(ix->books[i].name);
+    
+  free(ix->hash);
+  free(ix->books);
+  free(ix->chaps);
+  free(ix->text.data);
+  free(ix->texttab);
+  free(ix);
+}
+
+/*****************************************************************/
+
+static void *xrealloc(void *p,size_t size)
+{
+  p = realloc(p,size);
+  if (p == NULL)
+  {
+    perror("out of memory---aborting");
+    exit(1);
+  }
+  return(p);
+}
+
+/*****************************************************************/
+
+static size_t hash(char const *s)
+{
+  size_t h = 2166136261u;
+  
+  while(*s)
+    h = (h ^ (unsigned char)*s++) * 16777619u;
+  return(h);
+}
+
+/*****************************************************************
+;
+; Find a word, adding it if it isn't there.  Open addressing, with the
+; table doubled when it gets over half full.
+;
+******************************************************************/
+
+static struct word *lookup(Indexer ix,char const *word)
+{
+  size_t i;
+  
+  assert(ix   != NULL);
+  assert(word != NULL);
+  
+  for (i = hash(word) & (ix->hsize - 1) ; ix->hash[i].word != NULL ; i = (i + 1) & (ix->hsize - 1))
+    if (strcmp(ix->hash[i].word,word) == 0)
+      return(&ix->hash[i]);
+      
+  if (ix->words * 2 >= ix->hsize)
+  {
+    struct word *old   = ix->hash;
+    size_t       osize = ix->hsize;
+    
+    ix->hsize *= 2;
+    ix->hash   = xrealloc(NULL,ix->hsize * sizeof(struct word));
+    memset(ix->hash,0,ix->hsize * sizeof(struct word));
+    
+    for (size_t j = 0 ; j < osize ; j++)
+    {
+      if (old[j].word == NULL)
+        continue;
+      for (i = hash(old[j].word) & (ix->hsize - 1) ; ix->hash[i].word != NULL ; i = (i + 1) & (ix->hsize - 1))
+        ;
+      ix->hash[i] = old[j];
+    }
+    free(old);
+    
+    for (i = hash(word) & (ix->hsize - 1) ; ix->hash[i].word != NULL ; i = (i + 1) & (ix->hsize - 1))
+      ;
+  }
+  
+  ix->hash[i].word = dup_string((char *)word);
+  ix->words++;
+  return(&ix->hash[i]);
+}
+
+/*****************************************************************/
+
+static void add_varint(struct vbuf *pv,uint32_t value)
+{
+  assert(pv != NULL);
+  
+  if (pv->len + 5 > pv->max)
+  {
+    pv->max  = pv->max ? pv->max * 2 : 16;
+    pv->data = xrealloc(pv->data,pv->max);
+  }
+  
+  while(value >= 0x80)
+  {
+    pv->data[pv->len++] = (value & 0x7F) | 0x80;
+    value >>= 7;
+  }
+  pv->data[pv->len++] = value;
+}
+
+/*****************************************************************/
+
+static void add_bytes(struct vbuf *pv,void const *data,size_t len)
+{
+  assert(pv   != NULL);
+  assert(data != NULL);
+  
+  if (pv->len + len > pv->max)
+  {
+    while(pv->len + len > pv->max)
+      pv->max = pv->max ? pv->max * 2 : 65536;
+    pv->data = xrealloc(pv->data,pv->max);
+  }
+  
+  memcpy(&pv->data[pv->len],data,len);
+  pv->len += len;
+}
+
+/*****************************************************************
+;
+; Count a word in a book or chapter.  Books and chapters are only ever
+; added at the end, so it's either the last entry or a new one.
+;
+******************************************************************/
+
+static void add_freq(struct fbuf *pf,uint32_t unit,bool newverse)
+{
+  assert(pf != NULL);
+  
+  if ((pf->n == 0) || (pf->f[pf->n - 1].unit != unit))
+  {
+    if (pf->n == pf->max)
+    {
+      pf->max = pf->max ? pf->max * 2 : 4;
+      pf->f   = xrealloc(pf->f,pf->max * sizeof(struct lbixfreq));
+    }
+    pf->f[pf->n].unit   = unit;
+    pf->f[pf->n].verses = 0;
+    pf->f[pf->n].count  = 0;
+    pf->n++;
+  }
+  
+  pf->f[pf->n - 1].count++;
+  if (newverse)
+    pf->f[pf->n - 1].verses++;
+}
+
+/*****************************************************************/
+
+static int wordcmp(void const *o1,void const *o2)
+{
+  struct word const *const *w1 = o1;
+  struct word const *const *w2 = o2;
+  
+  return(strcmp((*w1)->word,(*w2)->word));
+}
+
+/*****************************************************************
+;
+; Sounds sort by code, then the more common words first (the word
+; itself breaking ties, so the order doesn't depend on qsort()).
+;
+******************************************************************/
+
+static int soundcmp(struct sound const *s1,struct sound const *s2)
+{
+  if (s1->verses != s2->verses)
+    return(s1->verses > s2->verses ? -1 : 1);
+  return(s1->word < s2->word ? -1 : s1->word > s2->word);
+}
+
+/*****************************************************************/
+
+static int sdxcmp(void const *o1,void const *o2)
+{
+  struct sound const *s1 = o1;
+  struct sound const *s2 = o2;
+  
+  if (s1->code != s2->code)
+    return(s1->code < s2->code ? -1 : 1);
+  return(soundcmp(s1,s2));
+}
+
+/*****************************************************************/
+
+static int mphcmp(void const *o1,void const *o2)
+{
+  struct sound const *s1 = o1;
+  struct sound const *s2 = o2;
+  int                 rc = strcmp(s1->mph,s2->mph);
+  
+  if (rc != 0)
+    return(rc);
+  return(soundcmp(s1,s2));
+}
+
+/*****************************************************************/
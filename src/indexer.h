@@ -0,0 +1,44 @@
+/******************************************************************
+*
+* indexer.h             - API for building the full text search index
+*                         (see search.h) from a stream of verse records.
+*
+* Copyright 2022 by Sean Conner.  All Rights Reserved.
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*
+* Comments, questions and criticisms can be sent to: sean@conman.org
+*
+********************************************************************/
+
+#ifndef INDEXER_H
+#define INDEXER_H
+
+#include <stdbool.h>
+
+#include "types.h"
+#include "reader.h"
+
+typedef struct indexer *Indexer;
+
+/*********************************************************************/
+
+Indexer          IndexCreate            (bool);
+void             IndexRecord            (Indexer,Record const *);
+void             IndexWrite             (Indexer,char const *);
+Size             IndexWords             (Indexer);
+void             IndexFree              (Indexer);
+
+#endif
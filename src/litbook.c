@@ -0,0 +1,2084 @@
+/******************************************************************
+*
+* litbook.c             - The mod_litbook core (liblitbook), shared by
+*                         the Apache module and the tools.
+*
+* Copyright 2022 by Sean Conner.  All Rights Reserved.
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*
+* Comments, questions and criticisms can be sent to: sean@conman.org
+*
+* -----------------------------------------------------------------
+*
+* This used to exist twice, once in mod_litbook.c and once in testmod.c,
+* and the two copies had drifted apart.  The code here follows what the
+* module did.
+*
+*******************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <time.h>
+#include <limits.h>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "litbook.h"
+#include "metaphone.h"
+#include "soundex.h"
+#include "probes.h"
+
+#define MBUFSIZ 512
+
+/************************************************************************/
+
+static void *lbm_alloc(void *ud,size_t size)
+{
+  (void)ud;
+  return malloc(size);
+}
+
+/************************************************************************/
+
+static void lbm_free(void *ud,void *ptr)
+{
+  (void)ud;
+  free(ptr);
+}
+
+/************************************************************************/
+
+struct lballoc const lb_malloc =
+{
+  .alloc = lbm_alloc,
+  .free  = lbm_free,
+  .ud    = NULL,
+};
+
+/************************************************************************
+*       MISC UTIL SUBROUTINES
+************************************************************************/
+
+static char *trim_lspace(char *s)
+{
+  for ( ; (*s) && (isspace(*s)) ; s++)
+    ;
+  return s;
+}
+
+/********************************************************************/
+
+static char *trim_tspace(char *s)
+{
+  char *p;
+  
+  for (p = s + strlen(s) - 1 ; (p > s) && (isspace(*p)) ; p--)
+    ;
+  p[1] = '\0';
+  return s;
+}
+
+/********************************************************************/
+
+static char *trim_space(char *s)
+{
+  return trim_tspace(trim_lspace(s));
+}
+
+/********************************************************************/
+
+static int empty_string(char *s)
+{
+  for ( ; *s ; s++)
+  {
+    if (isprint(*s)) return 0;
+  }
+  return 1;
+}
+
+/********************************************************************/
+
+static char *lb_strdup(struct lballoc const *alloc,char const *s)
+{
+  size_t  len = strlen(s) + 1;
+  char   *d   = (*alloc->alloc)(alloc->ud,len);
+  
+  if (d != NULL)
+    memcpy(d,s,len);
+  return d;
+}
+
+/******************************************************************
+*       TRANSLATION TABLE
+******************************************************************/
+
+/*******************************************************************
+;
+; Read an entire file into memory with one read(), and NUL terminate
+; it.  Returns 0 or an errno value.
+;
+********************************************************************/
+
+static int clt_slurp(
+                      char const           *fname,
+                      struct lballoc const *alloc,
+                      char                **pbuf,
+                      size_t               *psize
+                    )
+{
+  struct stat  status;
+  char        *buf;
+  size_t       size = 0;
+  int          fh;
+  int          rc;
+  
+  if ((fh = open(fname,O_RDONLY)) == -1)
+    return errno;
+    
+  if (fstat(fh,&status) == -1)
+  {
+    rc = errno;
+    close(fh);
+    return rc;
+  }
+  
+  if ((buf = (*alloc->alloc)(alloc->ud,(size_t)status.st_size + 1)) == NULL)
+  {
+    close(fh);
+    return ENOMEM;
+  }
+  
+  /*-------------------------------------------------------------------
+  ; A regular file comes in with the first read(); the loop is only for
+  ; signals and the odd short read.
+  ;--------------------------------------------------------------------*/
+  
+  while (size < (size_t)status.st_size)
+  {
+    ssize_t bytes = read(fh,&buf[size],(size_t)status.st_size - size);
+    
+    if (bytes == 0)
+      break;
+    if (bytes < 0)
+    {
+      if (errno == EINTR)
+        continue;
+      rc = errno;
+      close(fh);
+      if (alloc->free) (*alloc->free)(alloc->ud,buf);
+      return rc;
+    }
+    size += bytes;
+  }
+  
+  close(fh);
+  buf[size] = '\0';
+  *pbuf     = buf;
+  *psize    = size;
+  return 0;
+}
+
+/*******************************************************************/
+
+static size_t clt_linecount(char const *buf,size_t size)
+{
+  char const *end    = &buf[size];
+  size_t      lcount = 0;
+  
+  for (char const *p = buf ; (p = memchr(p,'\n',end - p)) != NULL ; p++)
+    lcount++;
+    
+  /*----------------------------------------------------
+  ; (1.0.5) if the last line in the file does not end
+  ; with a '\n', count it anyway.
+  ;-----------------------------------------------------*/
+  
+  if ((size > 0) && (buf[size - 1] != '\n'))
+    lcount++;
+  return lcount;
+}
+
+/*******************************************************************
+;
+; Return the next line from a buffer read in by clt_slurp(), with the
+; '\n' replaced by a NUL, or NULL when there are no more.
+;
+********************************************************************/
+
+static char *clt_nextline(char **pnext)
+{
+  char *line = *pnext;
+  char *nl;
+  
+  if (*line == '\0')
+    return NULL;
+    
+  if ((nl = strchr(line,'\n')) != NULL)
+  {
+    *nl    = '\0';
+    *pnext = nl + 1;
+  }
+  else
+    *pnext = line + strlen(line);
+    
+  return line;
+}
+
+/**********************************************************************/
+
+static int clt_sort_abrev(const void *o1,const void *o2)
+{
+  return strcmp(
+                 (*((struct lbbookname **)o1))->abrev,
+                 (*((struct lbbookname **)o2))->abrev
+               );
+}
+
+/*******************************************************************/
+
+static int clt_sort_fullname(const void *o1,const void *o2)
+{
+  return strcmp(
+                 (*((struct lbbookname **)o1))->fullname,
+                 (*((struct lbbookname **)o2))->fullname
+               );
+}
+
+/*********************************************************************/
+
+static int clt_sort_soundex(const void *o1,const void *o2)
+{
+  return SoundexCompare(
+                         (*((struct lbbookname **)o1))->sdx,
+                         (*((struct lbbookname **)o2))->sdx
+                       );
+}
+
+/********************************************************************/
+
+static int clt_sort_metaphone(const void *o1,const void *o2)
+{
+  return strcmp(
+                 (*((struct lbbookname **)o1))->mp,
+                 (*((struct lbbookname **)o2))->mp
+               );
+}
+
+/*********************************************************************
+;
+; Load a translation file.  Returns 0 on success, otherwise an errno
+; value.  EINVAL means the file is corrupt, and *pline is set to the
+; line number on (or around) which the problem is.
+;
+**********************************************************************/
+
+int lb_trans_load(
+                   struct lbtrans       *ptrans,
+                   char const           *fname,
+                   struct lballoc const *alloc,
+                   size_t               *pline
+                 )
+{
+  char   *buffer;
+  char   *next;
+  char   *line;
+  size_t  size;
+  size_t  i;
+  int     rc;
+  
+  if ((rc = clt_slurp(fname,alloc,&buffer,&size)) != 0)
+    return rc;
+    
+  ptrans->maxbook  = clt_linecount(buffer,size); /* so we allocate once */
+  ptrans->books    = (*alloc->alloc)(alloc->ud,ptrans->maxbook * sizeof(struct lbbookname));
+  ptrans->abrev    = (*alloc->alloc)(alloc->ud,ptrans->maxbook * sizeof(struct lbbookname *));
+  ptrans->fullname = (*alloc->alloc)(alloc->ud,ptrans->maxbook * sizeof(struct lbbookname *));
+  ptrans->soundex  = (*alloc->alloc)(alloc->ud,ptrans->maxbook * sizeof(struct lbbookname *));
+  ptrans->metaphone= (*alloc->alloc)(alloc->ud,ptrans->maxbook * sizeof(struct lbbookname *));
+  
+  if (
+          (ptrans->books     == NULL)
+       || (ptrans->abrev     == NULL)
+       || (ptrans->fullname  == NULL)
+       || (ptrans->soundex   == NULL)
+       || (ptrans->metaphone == NULL)
+     )
+  {
+    if (alloc->free) (*alloc->free)(alloc->ud,buffer);
+    return ENOMEM;
+  }
+  
+  next = buffer;
+  for (i = 0 ; (i < ptrans->maxbook) && ((line = clt_nextline(&next)) != NULL) ; i++)
+  {
+    char *abrev;
+    char *fulln;
+    char *state;
+    char  mp[MBUFSIZ];
+    
+    if (empty_string(line))
+    {
+      ptrans->maxbook--;
+      break;
+    }
+    abrev = strtok_r(line,",",&state);
+    fulln = strtok_r(NULL,",\n",&state);
+    
+    if ((abrev == NULL) || (fulln == NULL)) break;
+    
+    abrev = lb_strdup(alloc,trim_space(abrev));
+    fulln = lb_strdup(alloc,trim_space(fulln));
+    if ((abrev == NULL) || (fulln == NULL))
+    {
+      rc = ENOMEM;
+      break;
+    }
+    make_metaphone(fulln,mp,sizeof(mp));
+    
+    ptrans->books[i].abrev    = abrev;
+    ptrans->books[i].fullname = fulln;
+    ptrans->books[i].sdx      = isdigit(*fulln) ? Soundex(fulln+1) : Soundex(fulln);
+    ptrans->books[i].mp       = lb_strdup(alloc,mp);
+    ptrans->abrev[i]          = ptrans->fullname [i] = ptrans->soundex[i] = ptrans->metaphone[i] = &ptrans->books [i];
+  }
+  
+  if (alloc->free) (*alloc->free)(alloc->ud,buffer);
+  
+  if ((rc == 0) && (i != ptrans->maxbook))
+  {
+    if (pline) *pline = i;
+    rc = EINVAL;
+  }
+  
+  if (rc != 0)
+  {
+    ptrans->maxbook = i;
+    lb_trans_free(ptrans,alloc);
+    return rc;
+  }
+  
+  qsort(ptrans->abrev,    ptrans->maxbook,sizeof(struct lbbookname *),clt_sort_abrev);
+  qsort(ptrans->fullname, ptrans->maxbook,sizeof(struct lbbookname *),clt_sort_fullname);
+  qsort(ptrans->soundex,  ptrans->maxbook,sizeof(struct lbbookname *),clt_sort_soundex);
+  qsort(ptrans->metaphone,ptrans->maxbook,sizeof(struct lbbookname *),clt_sort_metaphone);
+  
+  return 0;
+}
+
+/*******************************************************************/
+
+void lb_trans_free(struct lbtrans *ptrans,struct lballoc const *alloc)
+{
+  if (alloc->free == NULL)
+    return;
+    
+  for (size_t i = 0 ; i < ptrans->maxbook ; i++)
+  {
+    (*alloc->free)(alloc->ud,ptrans->books[i].abrev);
+    (*alloc->free)(alloc->ud,ptrans->books[i].fullname);
+    (*alloc->free)(alloc->ud,ptrans->books[i].mp);
+  }
+  
+  (*alloc->free)(alloc->ud,ptrans->books);
+  (*alloc->free)(alloc->ud,ptrans->abrev);
+  (*alloc->free)(alloc->ud,ptrans->fullname);
+  (*alloc->free)(alloc->ud,ptrans->soundex);
+  (*alloc->free)(alloc->ud,ptrans->metaphone);
+  memset(ptrans,0,sizeof(struct lbtrans));
+}
+
+/*******************************************************************
+*       VERSIFICATION
+*******************************************************************/
+
+struct vline
+{
+  size_t   book;
+  size_t   chapter;
+  size_t   v1;
+  size_t   v2;
+  uint32_t to;                          /* LB_VPACK() or LB_VNONE */
+};
+
+/*******************************************************************/
+
+static bool vm_ref(char const *s,size_t *pc,size_t *pv1,size_t *pv2)
+{
+  char          *end;
+  unsigned long  c;
+  unsigned long  v1;
+  unsigned long  v2;
+  
+  c = strtoul(s,&end,10);
+  if (*end != ':') return false;
+  v1 = strtoul(end + 1,&end,10);
+  v2 = v1;
+  if ((pv2 != NULL) && (*end == '-'))
+    v2 = strtoul(end + 1,&end,10);
+  if (*end != '\0') return false;
+  if ((c < 1) || (c > LB_VMAX) || (v1 < 1) || (v2 < v1) || (v2 > LB_VMAX))
+    return false;
+    
+  *pc  = c;
+  *pv1 = v1;
+  if (pv2 != NULL) *pv2 = v2;
+  return true;
+}
+
+/*******************************************************************/
+
+static bool vm_parse(struct vline *pv,struct lbtrans const *ptrans,char *buffer)
+{
+  struct lbbookname *book;
+  enum lbtier        tier;
+  char              *name;
+  char              *from;
+  char              *to;
+  char              *state;
+  size_t             c;
+  size_t             v;
+  
+  /*-----------------------------------------------------------------
+  ; strtok_r(), since mod_litbook loads library works on request
+  ; threads.
+  ;------------------------------------------------------------------*/
+  
+  name = strtok_r(buffer," \t\r\n",&state);
+  from = strtok_r(NULL," \t\r\n",&state);
+  to   = strtok_r(NULL," \t\r\n",&state);
+  
+  if ((name == NULL) || (from == NULL) || (to == NULL) || (strtok_r(NULL," \t\r\n",&state) != NULL))
+    return false;
+    
+  book = lb_find_book(ptrans,name,&tier);
+  if ((book == NULL) || ((tier != LB_TIER_FULLNAME) && (tier != LB_TIER_ABREV)))
+    return false;
+  pv->book = book - ptrans->books;
+  
+  if (!vm_ref(from,&pv->chapter,&pv->v1,&pv->v2))
+    return false;
+    
+  if (strcmp(to,"-") == 0)
+    pv->to = LB_VNONE;
+  else if (!vm_ref(to,&c,&v,NULL) || (v + (pv->v2 - pv->v1) > LB_VMAX))
+    return false;
+  else
+    pv->to = LB_VPACK(c,v);
+    
+  return true;
+}
+
+/*******************************************************************
+;
+; Load a versification map for a translation.  Each line is a book (as
+; named in the translation file), a canonical chapter and verse or range
+; of verses, and where the first of them is in the translation---the
+; rest follow in order---or `-' if they're not there at all:
+;
+;       Mal     4:1-6   3:19
+;       3Jn     1:15    -
+;
+; Blank lines and lines starting with `#' are skipped.  Returns 0 or an
+; errno value, EINVAL meaning the file is corrupt on or around *pline.
+;
+********************************************************************/
+
+int lb_vmap_load(
+                  struct lbvmap        *pmap,
+                  struct lbtrans const *ptrans,
+                  char const           *fname,
+                  struct lballoc const *alloc,
+                  size_t               *pline
+                )
+{
+  char         *buffer;
+  char         *next;
+  char         *p;
+  struct vline *list;
+  size_t        size;
+  size_t        n  = 0;
+  int           rc;
+  
+  if ((rc = clt_slurp(fname,alloc,&buffer,&size)) != 0)
+    return rc;
+    
+  pmap->maxbook = ptrans->maxbook;
+  pmap->books   = (*alloc->alloc)(alloc->ud,ptrans->maxbook * sizeof(struct lbvbook));
+  list          = (*alloc->alloc)(alloc->ud,(clt_linecount(buffer,size) + 1) * sizeof(struct vline));
+  
+  if ((pmap->books == NULL) || (list == NULL))
+  {
+    if (alloc->free) (*alloc->free)(alloc->ud,buffer);
+    return ENOMEM;
+  }
+  
+  memset(pmap->books,0,ptrans->maxbook * sizeof(struct lbvbook));
+  
+  next = buffer;
+  for (size_t line = 1 ; (p = clt_nextline(&next)) != NULL ; line++)
+  {
+    p = trim_lspace(p);
+    
+    if ((*p == '\0') || (*p == '#'))
+      continue;
+      
+    if (!vm_parse(&list[n],ptrans,p))
+    {
+      if (pline) *pline = line;
+      rc = EINVAL;
+      break;
+    }
+    
+    if (list[n].chapter > pmap->books[list[n].book].chapters)
+      pmap->books[list[n].book].chapters = list[n].chapter;
+    n++;
+  }
+  
+  /*-------------------------------------------------------------------
+  ; start[c] first holds how many verses canonical chapter c has in the
+  ; map, then is turned into where the chapter ends in verse[].
+  ;--------------------------------------------------------------------*/
+  
+  for (size_t b = 0 ; (rc == 0) && (b < pmap->maxbook) ; b++)
+  {
+    struct lbvbook *vb = &pmap->books[b];
+    
+    if (vb->chapters == 0)
+      continue;
+      
+    vb->start = (*alloc->alloc)(alloc->ud,(vb->chapters + 1) * sizeof(uint32_t));
+    if (vb->start == NULL)
+    {
+      rc = ENOMEM;
+      break;
+    }
+    
+    memset(vb->start,0,(vb->chapters + 1) * sizeof(uint32_t));
+    for (size_t i = 0 ; i < n ; i++)
+      if ((list[i].book == b) && (list[i].v2 > vb->start[list[i].chapter]))
+        vb->start[list[i].chapter] = list[i].v2;
+        
+    for (size_t c = 1 ; c <= vb->chapters ; c++)
+      vb->start[c] += vb->start[c - 1];
+      
+    vb->verse = (*alloc->alloc)(alloc->ud,(vb->start[vb->chapters] + 1) * sizeof(uint32_t));
+    if (vb->verse == NULL)
+    {
+      rc = ENOMEM;
+      break;
+    }
+    
+    memset(vb->verse,0,(vb->start[vb->chapters] + 1) * sizeof(uint32_t));
+    for (size_t i = 0 ; i < n ; i++)
+    {
+      if (list[i].book != b)
+        continue;
+      for (size_t v = list[i].v1 ; v <= list[i].v2 ; v++)
+      {
+        uint32_t *pe = &vb->verse[vb->start[list[i].chapter - 1] + v - 1];
+        *pe = list[i].to == LB_VNONE ? LB_VNONE : list[i].to + (v - list[i].v1);
+      }
+    }
+  }
+  
+  if (alloc->free != NULL)
+  {
+    (*alloc->free)(alloc->ud,buffer);
+    (*alloc->free)(alloc->ud,list);
+  }
+  
+  if (rc != 0)
+    lb_vmap_free(pmap,alloc);
+  return rc;
+}
+
+/*******************************************************************/
+
+void lb_vmap_free(struct lbvmap *pmap,struct lballoc const *alloc)
+{
+  if (alloc->free == NULL)
+    return;
+    
+  for (size_t i = 0 ; i < pmap->maxbook ; i++)
+  {
+    if (pmap->books[i].start != NULL) (*alloc->free)(alloc->ud,pmap->books[i].start);
+    if (pmap->books[i].verse != NULL) (*alloc->free)(alloc->ud,pmap->books[i].verse);
+  }
+  
+  (*alloc->free)(alloc->ud,pmap->books);
+  memset(pmap,0,sizeof(struct lbvmap));
+}
+
+/*******************************************************************
+;
+; The map for a book (by its index in the translation), or NULL if the
+; book is numbered the same.
+;
+********************************************************************/
+
+struct lbvbook const *lb_vmap_book(struct lbvmap const *pmap,size_t book)
+{
+  if ((pmap == NULL) || (book >= pmap->maxbook) || (pmap->books[book].chapters == 0))
+    return NULL;
+  return &pmap->books[book];
+}
+
+/*******************************************************************
+*       LOOKUP
+*******************************************************************/
+
+static int hr_find_abrev(const void *key,const void *datum)
+{
+  return strcmp(key,(*((struct lbbookname **)datum))->abrev);
+}
+
+/**********************************************************************/
+
+static int hr_find_fullname(const void *key,const void *datum)
+{
+  return strcmp(key,(*((struct lbbookname **)datum))->fullname);
+}
+
+/*********************************************************************/
+
+static int hr_find_soundex(const void *key,const void *datum)
+{
+  return SoundexCompare(*((SOUNDEX *)key),(*((struct lbbookname **)datum))->sdx);
+}
+
+/**********************************************************************/
+
+static int hr_find_metaphone(const void *key,const void *datum)
+{
+  return strcmp(key,(*((struct lbbookname **)datum))->mp);
+}
+
+/*********************************************************************
+;
+; Find a book given a name normalized by lb_translate_request().
+;
+;     if not found fullname
+;       if not found abrev
+;         if not found soundex
+;           if not found metaphone
+;             return NOT FOUND;
+;
+**********************************************************************/
+
+struct lbbookname *lb_find_book(
+                                 struct lbtrans const *ptrans,
+                                 char const           *name,
+                                 enum lbtier          *ptier
+                               )
+{
+  struct lbbookname **pres;
+  
+  *ptier = LB_TIER_FULLNAME;
+  pres   = bsearch(
+                    name,
+                    ptrans->fullname,
+                    ptrans->maxbook,
+                    sizeof(struct lbbookname *),
+                    hr_find_fullname
+                  );
+  if (pres != NULL) return *pres;
+  
+  *ptier = LB_TIER_ABREV;
+  pres   = bsearch(
+                    name,
+                    ptrans->abrev,
+                    ptrans->maxbook,
+                    sizeof(struct lbbookname *),
+                    hr_find_abrev
+                  );
+  if (pres != NULL) return *pres;
+  
+  {
+    SOUNDEX sdx = Soundex(name);
+    
+    *ptier = LB_TIER_SOUNDEX;
+    pres   = bsearch(
+                      &sdx,
+                      ptrans->soundex,
+                      ptrans->maxbook,
+                      sizeof(struct lbbookname *),
+                      hr_find_soundex
+                    );
+    if (pres != NULL) return *pres;
+  }
+  
+  {
+    char mp[MBUFSIZ];
+    
+    *ptier = LB_TIER_NONE;
+    if (!make_metaphone(name,mp,sizeof(mp)))
+      return NULL;
+      
+    *ptier = LB_TIER_METAPHONE;
+    pres   = bsearch(
+                      mp,
+                      ptrans->metaphone,
+                      ptrans->maxbook,
+                      sizeof(struct lbbookname *),
+                      hr_find_metaphone
+                    );
+    if (pres != NULL) return *pres;
+  }
+  
+  *ptier = LB_TIER_NONE;
+  return NULL;
+}
+
+/*********************************************************************/
+
+char const *lb_tier_name(enum lbtier tier)
+{
+  switch(tier)
+  {
+    case LB_TIER_FULLNAME:  return "fullname";
+    case LB_TIER_ABREV:     return "abbrev";
+    case LB_TIER_SOUNDEX:   return "soundex";
+    case LB_TIER_METAPHONE: return "metaphone";
+    case LB_TIER_NONE:
+    default:                return "none";
+  }
+}
+
+/*******************************************************************
+*       REFERENCE PARSING
+*******************************************************************/
+
+static void translate(
+                       struct lbrequest     *pbr,
+                       struct lbtrans const *ptrans,
+                       char const           *or,
+                       bool                  timed
+                     )
+{
+  char               buffer[MBUFSIZ];
+  char              *p;
+  char              *r;
+  size_t             size;
+  struct lbbookname *book;
+  uint64_t           start = 0;
+  
+  pbr->name     = NULL;
+  pbr->c1       = 1;
+  pbr->v1       = 1;
+  pbr->c2       = LB_END;
+  pbr->v2       = LB_END;
+  pbr->redirect = 0;
+  pbr->tier     = LB_TIER_NONE;
+  pbr->book     = 0;
+  pbr->nslookup = 0;
+  
+  buffer[0] = '\0';
+  for (
+        p = buffer , r = (char *)or , size = 0 ;
+        (*r) && (!ispunct(*r)) && (size < sizeof(buffer) - 1) ;
+        r++ , size++
+      )
+  {
+    *p++ = tolower(*r);
+    *p   = '\0';
+  }
+  
+  if (size < 2) return;
+  if (isdigit(buffer[0]))
+    buffer[1] = toupper(buffer[1]);
+  else
+    buffer[0] = toupper(buffer[0]);
+    
+  if (timed) start = lb_now();
+  book = lb_find_book(ptrans,buffer,&pbr->tier);
+  if (timed) pbr->nslookup = lb_now() - start;
+  if (book == NULL) return;
+  
+  pbr->name     = book->fullname;
+  pbr->book     = book - ptrans->books;
+  pbr->redirect = strncmp(or,pbr->name,strlen(pbr->name));
+  
+  if ((*r == '\0') || (*r == '-')) return;      /* 1. G or G- */
+  
+  pbr->c1 = strtol(r+1,&r,10);
+  if (pbr->c1 == 0)
+  {
+    pbr->name = NULL;
+    return;
+  }
+  
+  if (*r == '\0')                               /* 2. G.a */
+  {
+    pbr->c2 = pbr->c1;
+    return;
+  }
+  
+  if ((*r == '.') || (*r == ':'))
+  {
+    if (*r == '.') pbr->redirect = 1;
+    pbr->v1 = strtol(r+1,&r,10);                /* 3. G.a.b */
+    if (pbr->v1 == 0)
+    {
+      pbr->name = NULL;
+      return;
+    }
+    
+    if (*r++ != '-')
+    {
+      pbr->c2 = pbr->c1;
+      pbr->v2 = pbr->v1;
+      if (*(r-1)) pbr->redirect = 1;
+      return;
+    }
+    
+    if (!isdigit(*r))                           /* 4. G.a.b- */
+    {
+      if (*r) pbr->redirect = *r;
+      return;
+    }
+    
+    pbr->c2 = strtol(r,&r,10);                  /* 5. G.a.b-x */
+    if (pbr->c2 == 0)
+    {
+      pbr->name = NULL;
+      return;
+    }
+    
+    if ((*r != '.') && (*r != ':'))
+    {
+      pbr->v2       = pbr->c2;
+      pbr->c2       = pbr->c1;
+      if (*r) pbr->redirect = *r;
+      return;
+    }
+    
+    if (*r == '.') pbr->redirect = 1;
+    
+    pbr->v2       = strtol(r+1,&r,10);          /* 6. G.a.b-x.y */
+    if (pbr->v2 == 0)
+    {
+      pbr->name = NULL;
+      return;
+    }
+    
+    if (*r) pbr->redirect = *r;
+    return;
+  }
+  
+  if (*r++ != '-')                              /* 2. G.a */
+  {
+    pbr->c2 = pbr->c1;
+    if (*(r-1)) pbr->redirect = *(r-1);
+    return;
+  }
+  
+  if (!isdigit(*r))                             /* 7. G.a- */
+  {
+    if (*r) pbr->redirect = *r;
+    return;
+  }
+  
+  pbr->c2 = strtol(r,&r,10);                    /* 8. G.a-x */
+  if (pbr->c2 == 0)
+  {
+    pbr->name = NULL;
+    return;
+  }
+  
+  if ((*r != '.') && (*r != ':'))
+  {
+    if (*r) pbr->redirect = *r;
+    return;
+  }
+  
+  if (*r == '.') pbr->redirect = 1;
+  pbr->v2       = strtol(r+1,&r,10);            /* 9. G.a-x.y */
+  if (pbr->v2 == 0)
+  {
+    pbr->name = NULL;
+    return;
+  }
+  if (*r) pbr->redirect = *r;
+}
+
+/*******************************************************************/
+
+void lb_translate_request(
+                           struct lbrequest     *pbr,
+                           struct lbtrans const *ptrans,
+                           char const           *or
+                         )
+{
+  LB_PROBE1(translate__entry,or);
+  translate(pbr,ptrans,or,false);
+  LB_PROBE7(translate__exit,or,pbr->name,pbr->c1,pbr->v1,pbr->c2,pbr->v2,(int)pbr->tier);
+}
+
+/*******************************************************************
+;
+; Same, but record how long the book lookup took in pbr->nslookup.
+;
+********************************************************************/
+
+void lb_translate_timed(
+                         struct lbrequest     *pbr,
+                         struct lbtrans const *ptrans,
+                         char const           *or
+                       )
+{
+  LB_PROBE1(translate__entry,or);
+  translate(pbr,ptrans,or,true);
+  LB_PROBE7(translate__exit,or,pbr->name,pbr->c1,pbr->v1,pbr->c2,pbr->v2,(int)pbr->tier);
+}
+
+/*******************************************************************
+;
+; Build the canonical form of a request.  Like snprintf(), returns the
+; length of the full string even if it didn't fit.
+;
+********************************************************************/
+
+size_t lb_redirect_request(char *dest,size_t size,struct lbrequest const *pbr)
+{
+  unsigned long c1 = pbr->c1;
+  unsigned long c2 = pbr->c2;
+  unsigned long v1 = pbr->v1;
+  unsigned long v2 = pbr->v2;
+  int           len;
+  
+  if ((pbr->c2 == LB_END) && (pbr->v2 == LB_END))
+  {
+    if ((pbr->c1 == 1) && (pbr->v1 == 1))
+      len = snprintf(dest,size,"%s",pbr->name);
+    else if ((pbr->c1 != 1) && (pbr->v2 == 1))
+      len = snprintf(dest,size,"%s.%lu-",pbr->name,c1);
+    else
+      len = snprintf(dest,size,"%s.%lu:%lu-",pbr->name,c1,v1);
+  }
+  else if (pbr->c1 == pbr->c2)
+  {
+    /*--------------------------------------------------------------
+    ; (1.0.9) This redirect is incorrect.  I'm not sure why I got
+    ; it wrong, but THIS is the correct way to handle this case.
+    ; Sigh.
+    ;--------------------------------------------------------------*/
+    
+    if ((pbr->v1 == 1) && (pbr->v2 == LB_END))
+      len = snprintf(dest,size,"%s.%lu",pbr->name,c1);
+    else if (pbr->v1 == pbr->v2)
+      len = snprintf(dest,size,"%s.%lu:%lu",pbr->name,c1,v1);
+    else
+      len = snprintf(dest,size,"%s.%lu:%lu-%lu:%lu",pbr->name,c1,v1,c2,v2);
+  }
+  else if (pbr->v1 == 1)
+  {
+    if (pbr->v2 == LB_END)
+      len = snprintf(dest,size,"%s.%lu-%lu",pbr->name,c1,c2);
+    else
+      len = snprintf(dest,size,"%s.%lu-%lu:%lu",pbr->name,c1,c2,v2);
+  }
+  else
+  {
+    /*------------------------------------------------------------
+    ; This used to use c1 for the ending chapter, so Gen.1:5-3:4 was
+    ; redirected to Genesis.1:5-1:4.
+    ;-------------------------------------------------------------*/
+    
+    len = snprintf(dest,size,"%s.%lu:%lu-%lu:%lu",pbr->name,c1,v1,c2,v2);
+  }
+  
+  return len < 0 ? 0 : (size_t)len;
+}
+
+/*******************************************************************
+*       CHAPTERS
+*******************************************************************/
+
+int lb_chapter_open(
+                     struct lbchapter     *pch,
+                     struct lballoc const *alloc,
+                     char const           *bookdir,
+                     char const           *name,
+                     size_t                chapter
+                   )
+{
+  char    fname[FILENAME_MAX];
+  ssize_t bytes;
+  size_t  need;
+  int     fh;
+  
+  pch->number = chapter;
+  pch->max    = 0;
+  pch->index  = NULL;
+  pch->text   = NULL;
+  pch->vlow   = 0;
+  pch->vhigh  = 0;
+  pch->calls  = 0;
+  pch->bytes  = 0;
+  
+  snprintf(fname,sizeof(fname),"%s/%s/%lu.index",bookdir,name,(unsigned long)chapter);
+  pch->calls++;
+  if ((fh = open(fname,O_RDONLY)) == -1)
+    return 1;
+    
+  /*----------------------------------------------------------------
+  ; Most chapters have fewer than LB_IBUFSIZ - 2 verses, so one read
+  ; gets both the count and the offsets.
+  ;-----------------------------------------------------------------*/
+  
+  bytes       = read(fh,pch->ibuf,sizeof(pch->ibuf));
+  pch->calls += 2;                      /* the read() and the close() */
+  LB_PROBE3(read__index,name,chapter,bytes);
+  if (bytes > 0) pch->bytes += bytes;
+  if ((bytes < (ssize_t)(2 * sizeof(long))) || (pch->ibuf[0] < 1))
+  {
+    close(fh);
+    return 1;
+  }
+  
+  /*----------------------------------------------------------------
+  ; The count comes straight off the disk, so it's only believed if
+  ; the index is exactly (count + 2) longs long (and the size doesn't
+  ; overflow working that out).
+  ;-----------------------------------------------------------------*/
+  
+  if ((unsigned long)pch->ibuf[0] > (LONG_MAX / sizeof(long)) - 2)
+  {
+    close(fh);
+    return 1;
+  }
+  
+  pch->max = pch->ibuf[0];
+  need     = (pch->max + 2) * sizeof(long);
+  
+  if (need <= sizeof(pch->ibuf))
+  {
+    if ((size_t)bytes != need)
+    {
+      close(fh);
+      return 1;
+    }
+    pch->index = &pch->ibuf[1];
+  }
+  else
+  {
+    size_t      have = bytes - sizeof(long);
+    struct stat status;
+    
+    pch->calls++;
+    if ((fstat(fh,&status) < 0) || ((size_t)status.st_size != need))
+    {
+      close(fh);
+      return 1;
+    }
+    
+    pch->index = (*alloc->alloc)(alloc->ud,need - sizeof(long));
+    if (pch->index == NULL)
+    {
+      close(fh);
+      return 1;
+    }
+    memcpy(pch->index,&pch->ibuf[1],have);
+    bytes = pread(fh,(char *)pch->index + have,need - sizeof(long) - have,bytes);
+    pch->calls++;
+    LB_PROBE3(read__index,name,chapter,bytes);
+    if (bytes > 0) pch->bytes += bytes;
+    if ((bytes < 0) || ((size_t)bytes != need - sizeof(long) - have))
+    {
+      close(fh);
+      lb_chapter_close(pch,alloc);
+      return 1;
+    }
+  }
+  
+  close(fh);
+  
+  /*-----------------------------------------------------------------
+  ; A truncated or otherwise damaged index shouldn't send us seeking
+  ; off into the weeds.
+  ;------------------------------------------------------------------*/
+  
+  if (pch->index[0] != 0)
+  {
+    lb_chapter_close(pch,alloc);
+    return 1;
+  }
+  
+  for (size_t i = 1 ; i <= pch->max ; i++)
+  {
+    if (pch->index[i] < pch->index[i-1])
+    {
+      lb_chapter_close(pch,alloc);
+      return 1;
+    }
+  }
+  
+  return 0;
+}
+
+/*******************************************************************/
+
+int lb_chapter_read(
+                     struct lbchapter     *pch,
+                     struct lballoc const *alloc,
+                     char const           *bookdir,
+                     char const           *name,
+                     size_t                vlow,
+                     size_t                vhigh
+                   )
+{
+  char    fname[FILENAME_MAX];
+  size_t  len;
+  ssize_t bytes;
+  int     fh;
+  
+  if ((vlow < 1) || (vlow > pch->max))
+    return 1;
+  if (vhigh > pch->max) vhigh = pch->max;
+  if (vhigh < vlow)     vhigh = vlow;
+  
+  len       = pch->index[vhigh] - pch->index[vlow - 1];
+  pch->text = (*alloc->alloc)(alloc->ud,len + 1);
+  if (pch->text == NULL)
+    return 1;
+    
+  snprintf(fname,sizeof(fname),"%s/%s/%lu",bookdir,name,(unsigned long)pch->number);
+  pch->calls++;
+  if ((fh = open(fname,O_RDONLY)) == -1)
+    return 1;
+    
+  bytes       = pread(fh,pch->text,len,pch->index[vlow - 1]);
+  pch->calls += 2;
+  LB_PROBE4(read__text,name,pch->number,pch->index[vlow - 1],bytes);
+  close(fh);
+  if (bytes > 0) pch->bytes += bytes;
+  
+  if ((bytes < 0) || ((size_t)bytes != len))
+    return 1;
+    
+  pch->text[len] = '\0';
+  pch->vlow      = vlow;
+  pch->vhigh     = vhigh;
+  return 0;
+}
+
+/*******************************************************************/
+
+char const *lb_chapter_verse(struct lbchapter const *pch,size_t verse,size_t *plen)
+{
+  if ((pch->text == NULL) || (verse < pch->vlow) || (verse > pch->vhigh))
+    return NULL;
+    
+  *plen = pch->index[verse] - pch->index[verse - 1];
+  return &pch->text[pch->index[verse - 1] - pch->index[pch->vlow - 1]];
+}
+
+/*******************************************************************/
+
+void lb_chapter_close(struct lbchapter *pch,struct lballoc const *alloc)
+{
+  if (alloc->free != NULL)
+  {
+    if ((pch->index != NULL) && (pch->index != &pch->ibuf[1]))
+      (*alloc->free)(alloc->ud,pch->index);
+    if (pch->text != NULL)
+      (*alloc->free)(alloc->ud,pch->text);
+  }
+  
+  pch->index = NULL;
+  pch->text  = NULL;
+}
+
+/*******************************************************************
+;
+; Have the kernel start reading in a chapter, index and text, without
+; waiting for it.  Returns 0, or an errno value if the chapter isn't
+; there.
+;
+********************************************************************/
+
+int lb_chapter_prefetch(char const *bookdir,char const *name,size_t chapter)
+{
+  char fname[FILENAME_MAX];
+  int  fh;
+  
+  snprintf(fname,sizeof(fname),"%s/%s/%lu.index",bookdir,name,(unsigned long)chapter);
+  if ((fh = open(fname,O_RDONLY)) == -1)
+    return errno;
+#ifdef POSIX_FADV_WILLNEED
+  posix_fadvise(fh,0,0,POSIX_FADV_WILLNEED);
+#endif
+  close(fh);
+  
+  snprintf(fname,sizeof(fname),"%s/%s/%lu",bookdir,name,(unsigned long)chapter);
+  if ((fh = open(fname,O_RDONLY)) == -1)
+    return errno;
+#ifdef POSIX_FADV_WILLNEED
+  posix_fadvise(fh,0,0,POSIX_FADV_WILLNEED);
+#endif
+  close(fh);
+  return 0;
+}
+
+/*******************************************************************
+*       RENDERING
+*******************************************************************/
+
+int lb_write(struct lbctx *ctx,char const *s,size_t len)
+{
+  ctx->bytes += len;
+  return (*ctx->write)(ctx->ud,s,len);
+}
+
+/*******************************************************************/
+
+int lb_puts(struct lbctx *ctx,char const *s)
+{
+  return lb_write(ctx,s,strlen(s));
+}
+
+/*******************************************************************/
+
+int lb_printf(struct lbctx *ctx,char const *fmt,...)
+{
+  char    buffer[MBUFSIZ];
+  va_list args;
+  int     len;
+  
+  va_start(args,fmt);
+  len = vsnprintf(buffer,sizeof(buffer),fmt,args);
+  va_end(args);
+  
+  if (len < 0)
+    return -1;
+  if ((size_t)len >= sizeof(buffer))
+    len = sizeof(buffer) - 1;
+  return lb_write(ctx,buffer,len);
+}
+
+/******************************************************************/
+
+static int show_chapter(
+                        struct lbctx *ctx,
+                        char const   *bookdir,
+                        char const   *name,
+                        size_t        chapter,
+                        size_t        vlow,
+                        size_t        vhigh
+                      )
+{
+  struct lbchapter ch;
+  int              rc;
+  uint64_t         start = ctx->timed ? lb_now() : 0;
+  
+  rc                    = lb_chapter_open(&ch,ctx->alloc,bookdir,name,chapter);
+  ctx->stats.syscalls  += ch.calls;
+  ctx->stats.bytesread += ch.bytes;
+  if (rc != 0)
+  {
+    if (ctx->timed)
+      ctx->stats.nsio += lb_now() - start;
+    return 1;
+  }
+  
+  if (vlow > ch.max)
+  {
+    if (ctx->timed)
+      ctx->stats.nsio += lb_now() - start;
+    lb_chapter_close(&ch,ctx->alloc);
+    return 1;
+  }
+  
+  if (vhigh > ch.max) vhigh = ch.max;
+  
+  /*-------------------------------------------------------------
+  ; All the verses asked for are contiguous in the text file, so
+  ; read them all at once, instead of a seek and a read per verse.
+  ;-------------------------------------------------------------*/
+  
+  ch.calls              = 0;
+  ch.bytes              = 0;
+  rc                    = lb_chapter_read(&ch,ctx->alloc,bookdir,name,vlow,vhigh);
+  ctx->stats.syscalls  += ch.calls;
+  ctx->stats.bytesread += ch.bytes;
+  if (ctx->timed)
+    ctx->stats.nsio += lb_now() - start;
+  if (rc != 0)
+  {
+    lb_chapter_close(&ch,ctx->alloc);
+    return 1;
+  }
+  
+  ctx->stats.chapters++;
+  ctx->stats.verses += vhigh - vlow + 1;
+  (*ctx->render->chapter)(ctx,chapter,vlow > 1);
+  
+  for (size_t i = vlow ; i <= vhigh ; i++)
+  {
+    char const *text;
+    size_t      len;
+    
+    text = lb_chapter_verse(&ch,i,&len);
+    (*ctx->render->verse)(ctx,i,text,len);
+  }
+  
+  lb_chapter_close(&ch,ctx->alloc);
+  return 0;
+}
+
+/**********************************************************************/
+
+int lb_show_chapter(
+                     struct lbctx *ctx,
+                     char const   *bookdir,
+                     char const   *name,
+                     size_t        chapter,
+                     size_t        vlow,
+                     size_t        vhigh
+                   )
+{
+  int rc;
+  
+  LB_PROBE4(chapter__entry,name,chapter,vlow,vhigh);
+  rc = show_chapter(ctx,bookdir,name,chapter,vlow,vhigh);
+  LB_PROBE4(chapter__exit,name,chapter,rc,ctx->stats.bytesread);
+  return rc;
+}
+
+/*******************************************************************
+;
+; Verses out of a search, all in one chapter and in order, through the
+; renderer's hit().  One read covers them all.  Returns the number
+; shown.
+;
+********************************************************************/
+
+size_t lb_show_hits(
+                     struct lbctx *ctx,
+                     char const   *bookdir,
+                     char const   *name,
+                     size_t        chapter,
+                     size_t const *verses,
+                     size_t        n
+                   )
+{
+  struct lbchapter ch;
+  size_t           shown = 0;
+  int              rc;
+  uint64_t         start = ctx->timed ? lb_now() : 0;
+  
+  if (n == 0)
+    return 0;
+    
+  rc                    = lb_chapter_open(&ch,ctx->alloc,bookdir,name,chapter);
+  ctx->stats.syscalls  += ch.calls;
+  ctx->stats.bytesread += ch.bytes;
+  
+  if (rc == 0)
+  {
+    ch.calls              = 0;
+    ch.bytes              = 0;
+    rc                    = lb_chapter_read(&ch,ctx->alloc,bookdir,name,verses[0],verses[n - 1]);
+    ctx->stats.syscalls  += ch.calls;
+    ctx->stats.bytesread += ch.bytes;
+  }
+  
+  if (ctx->timed)
+    ctx->stats.nsio += lb_now() - start;
+    
+  if (rc != 0)
+  {
+    lb_chapter_close(&ch,ctx->alloc);
+    return 0;
+  }
+  
+  ctx->stats.chapters++;
+  
+  for (size_t i = 0 ; i < n ; i++)
+  {
+    char const *text;
+    size_t      len;
+    
+    text = lb_chapter_verse(&ch,verses[i],&len);
+    if (text != NULL)
+    {
+      (*ctx->render->hit)(ctx,name,chapter,verses[i],text,len);
+      ctx->stats.verses++;
+      shown++;
+    }
+  }
+  
+  lb_chapter_close(&ch,ctx->alloc);
+  return shown;
+}
+
+/*******************************************************************
+;
+; A translation's verses for one canonical chapter.  Numbered the same,
+; that's the one chapter; with a map, the verses can come from up to
+; LB_MAPSPAN of the translation's chapters, each read once.  max is how
+; many verses the canonical chapter has.
+;
+********************************************************************/
+
+struct vsource
+{
+  uint32_t  const *tab;                 /* NULL if numbered the same */
+  size_t           chapter;
+  size_t           max;
+  size_t           n;
+  size_t           number[LB_MAPSPAN];
+  size_t           lo    [LB_MAPSPAN];
+  size_t           hi    [LB_MAPSPAN];
+  struct lbchapter ch    [LB_MAPSPAN];
+};
+
+/*******************************************************************/
+
+static uint32_t vs_where(struct vsource const *src,size_t verse)
+{
+  uint32_t where;
+  
+  if (src->tab == NULL)
+    return LB_VPACK(src->chapter,verse);
+  if (verse > src->max)
+    return LB_VNONE;
+  where = src->tab[verse - 1];
+  return where == LB_VSAME ? LB_VPACK(src->chapter,verse) : where;
+}
+
+/*******************************************************************
+;
+; Returns 1 if none of the verses could be read.
+;
+********************************************************************/
+
+static int vs_open(
+                    struct lbctx         *ctx,
+                    struct vsource       *src,
+                    char           const *bookdir,
+                    char           const *name,
+                    struct lbvbook const *vb,
+                    size_t                chapter,
+                    size_t                vlow,
+                    size_t                vhigh
+                  )
+{
+  size_t   found = 0;
+  uint64_t start = ctx->timed ? lb_now() : 0;
+  
+  src->tab     = NULL;
+  src->chapter = chapter;
+  src->max     = 0;
+  src->n       = 0;
+  
+  if (name == NULL)
+    return 1;
+    
+  if ((vb != NULL) && (chapter <= vb->chapters) && (vb->start[chapter] > vb->start[chapter - 1]))
+  {
+    src->tab = &vb->verse[vb->start[chapter - 1]];
+    src->max = vb->start[chapter] - vb->start[chapter - 1];
+    if (vlow > src->max)
+      return 1;
+    if (vhigh > src->max)
+      vhigh = src->max;
+      
+    for (size_t v = vlow ; v <= vhigh ; v++)
+    {
+      uint32_t where = vs_where(src,v);
+      size_t   tc;
+      size_t   tv;
+      size_t   k;
+      
+      if (where == LB_VNONE)
+        continue;
+        
+      tc = where >> 16;
+      tv = where & LB_VMAX;
+      
+      for (k = 0 ; k < src->n ; k++)
+        if (src->number[k] == tc)
+          break;
+          
+      if (k == src->n)
+      {
+        if (k == LB_MAPSPAN)
+          continue;
+        src->number[k] = tc;
+        src->lo[k]     = tv;
+        src->hi[k]     = tv;
+        src->n++;
+      }
+      else if (tv < src->lo[k]) src->lo[k] = tv;
+      else if (tv > src->hi[k]) src->hi[k] = tv;
+    }
+  }
+  else
+  {
+    src->number[0] = chapter;
+    src->lo[0]     = vlow;
+    src->hi[0]     = vhigh;
+    src->n         = 1;
+  }
+  
+  for (size_t k = 0 ; k < src->n ; k++)
+  {
+    struct lbchapter *pch = &src->ch[k];
+    int               rc;
+    
+    rc                    = lb_chapter_open(pch,ctx->alloc,bookdir,name,src->number[k]);
+    ctx->stats.syscalls  += pch->calls;
+    ctx->stats.bytesread += pch->bytes;
+    
+    if ((rc != 0) || (src->lo[k] > pch->max))
+    {
+      lb_chapter_close(pch,ctx->alloc);
+      continue;
+    }
+    
+    if (src->hi[k] > pch->max) src->hi[k] = pch->max;
+    if (src->tab == NULL)      src->max   = pch->max;
+    
+    pch->calls            = 0;
+    pch->bytes            = 0;
+    rc                    = lb_chapter_read(pch,ctx->alloc,bookdir,name,src->lo[k],src->hi[k]);
+    ctx->stats.syscalls  += pch->calls;
+    ctx->stats.bytesread += pch->bytes;
+    
+    if (rc != 0)
+      lb_chapter_close(pch,ctx->alloc);
+    else
+      found++;
+  }
+  
+  if (ctx->timed)
+    ctx->stats.nsio += lb_now() - start;
+    
+  ctx->stats.chapters += found;
+  return found == 0;
+}
+
+/*******************************************************************/
+
+static char const *vs_verse(struct vsource const *src,size_t verse,size_t *plen)
+{
+  uint32_t where = vs_where(src,verse);
+  
+  if (where == LB_VNONE)
+    return NULL;
+    
+  for (size_t k = 0 ; k < src->n ; k++)
+    if (src->number[k] == (where >> 16))
+      return lb_chapter_verse(&src->ch[k],where & LB_VMAX,plen);
+  return NULL;
+}
+
+/*******************************************************************/
+
+static void vs_close(struct lbctx *ctx,struct vsource *src)
+{
+  for (size_t k = 0 ; k < src->n ; k++)
+    lb_chapter_close(&src->ch[k],ctx->alloc);
+  src->n = 0;
+}
+
+/*******************************************************************/
+
+static int show_mapped(
+                        struct lbctx         *ctx,
+                        struct vsource       *src,
+                        char           const *bookdir,
+                        char           const *name,
+                        struct lbvbook const *vb,
+                        size_t                chapter,
+                        size_t                vlow,
+                        size_t                vhigh
+                      )
+{
+  if (vs_open(ctx,src,bookdir,name,vb,chapter,vlow,vhigh))
+    return 1;
+    
+  if (vhigh > src->max) vhigh = src->max;
+  (*ctx->render->chapter)(ctx,chapter,vlow > 1);
+  
+  for (size_t v = vlow ; v <= vhigh ; v++)
+  {
+    char const *text;
+    size_t      len;
+    
+    if ((text = vs_verse(src,v,&len)) != NULL)
+    {
+      (*ctx->render->verse)(ctx,v,text,len);
+      ctx->stats.verses++;
+    }
+  }
+  
+  vs_close(ctx,src);
+  return 0;
+}
+
+/*******************************************************************
+;
+; A request is in the canonical numbering; with a map for the book, the
+; verses are found through that, otherwise straight from the chapters.
+;
+********************************************************************/
+
+void lb_print_request(
+                       struct lbctx           *ctx,
+                       struct lbrequest const *pbr,
+                       char             const *bookdir,
+                       struct lbvmap    const *map
+                     )
+{
+  struct lbvbook const *vb = lb_vmap_book(map,pbr->book);
+  
+  (*ctx->render->book)(ctx,pbr->name);
+  
+  if (vb != NULL)
+  {
+    struct vsource *src = (*ctx->alloc->alloc)(ctx->alloc->ud,sizeof(struct vsource));
+    
+    if (src == NULL)
+      return;
+      
+    for (size_t i = pbr->c1 ; i <= pbr->c2 ; i++)
+    {
+      size_t vlow  = i == pbr->c1 ? pbr->v1 : 1;
+      size_t vhigh = i == pbr->c2 ? pbr->v2 : LB_END;
+      
+      if (show_mapped(ctx,src,bookdir,pbr->name,vb,i,vlow,vhigh))
+        break;
+    }
+    
+    if (ctx->alloc->free != NULL)
+      (*ctx->alloc->free)(ctx->alloc->ud,src);
+  }
+  else if (pbr->c1 == pbr->c2)
+    lb_show_chapter(ctx,bookdir,pbr->name,pbr->c1,pbr->v1,pbr->v2);
+  else
+  {
+    for (size_t i = pbr->c1 ; i <= pbr->c2 ; i++)
+    {
+      if (i == pbr->c1)
+      {
+        if (lb_show_chapter(ctx,bookdir,pbr->name,i,pbr->v1,LB_END)) break;
+      }
+      else if (i == pbr->c2)
+      {
+        if (lb_show_chapter(ctx,bookdir,pbr->name,i,1,pbr->v2)) break;
+      }
+      else
+      {
+        if (lb_show_chapter(ctx,bookdir,pbr->name,i,1,LB_END)) break;
+      }
+    }
+  }
+}
+
+/*******************************************************************
+;
+; One chapter in parallel.  Each translation's verses are read first,
+; then the rows go out verse by verse, as many as the longest chapter
+; has.  Returns 1 if no translation has the chapter.
+;
+********************************************************************/
+
+static int parallel_chapter(
+                             struct lbctx          *ctx,
+                             struct vsource        *src,
+                             struct lbcolumn const *cols,
+                             size_t                 n,
+                             size_t                 chapter,
+                             size_t                 vlow,
+                             size_t                 vhigh
+                           )
+{
+  struct lbcell cell[LB_PARMAX];
+  size_t        top   = 0;
+  size_t        found = 0;
+  
+  for (size_t i = 0 ; i < n ; i++)
+  {
+    if (vs_open(ctx,&src[i],cols[i].bookdir,cols[i].name,cols[i].map,chapter,vlow,vhigh) == 0)
+    {
+      size_t high = vhigh > src[i].max ? src[i].max : vhigh;
+      
+      if (high > top) top = high;
+      found++;
+    }
+  }
+  
+  if (found == 0)
+    return 1;
+    
+  ctx->stats.verses += top - vlow + 1;
+  (*ctx->render->chapter)(ctx,chapter,vlow > 1);
+  (*ctx->render->columns)(ctx,cols,n);
+  
+  for (size_t v = vlow ; v <= top ; v++)
+  {
+    for (size_t i = 0 ; i < n ; i++)
+    {
+      cell[i].len  = 0;
+      cell[i].text = vs_verse(&src[i],v,&cell[i].len);
+    }
+    (*ctx->render->row)(ctx,v,cols,cell,n);
+  }
+  
+  (*ctx->render->columns)(ctx,NULL,0);
+  
+  for (size_t i = 0 ; i < n ; i++)
+    vs_close(ctx,&src[i]);
+  return 0;
+}
+
+/*******************************************************************
+;
+; A request in several translations at once.  The reference has already
+; been looked up; each column has that translation's name for the book
+; (or NULL) and its map for the book (or NULL).  Every translation's
+; files for a chapter are read once, and the verses are interleaved as
+; they go out.
+;
+********************************************************************/
+
+int lb_show_parallel(
+                      struct lbctx           *ctx,
+                      struct lbcolumn const  *cols,
+                      size_t                  n,
+                      struct lbrequest const *pbr
+                    )
+{
+  struct vsource *src;
+  
+  if ((n == 0) || (n > LB_PARMAX))
+    return 1;
+    
+  src = (*ctx->alloc->alloc)(ctx->alloc->ud,n * sizeof(struct vsource));
+  if (src == NULL)
+    return 1;
+    
+  (*ctx->render->book)(ctx,pbr->name);
+  
+  for (size_t i = pbr->c1 ; i <= pbr->c2 ; i++)
+  {
+    size_t vlow  = i == pbr->c1 ? pbr->v1 : 1;
+    size_t vhigh = i == pbr->c2 ? pbr->v2 : LB_END;
+    
+    if (parallel_chapter(ctx,src,cols,n,i,vlow,vhigh))
+      break;
+  }
+  
+  if (ctx->alloc->free != NULL)
+    (*ctx->alloc->free)(ctx->alloc->ud,src);
+  return 0;
+}
+
+/**********************************************************************/
+
+static int html_book(struct lbctx *ctx,char const *name)
+{
+  return lb_printf(ctx,"<h1>%s</h1>\n",name);
+}
+
+/**********************************************************************/
+
+static int html_chapter(struct lbctx *ctx,size_t chapter,bool skip)
+{
+  lb_printf(ctx,"<h2>Chapter %lu</h2>\n",(unsigned long)chapter);
+  if (skip)
+    lb_puts(ctx,"<p class=\"skip\">.<br>.<br>.</p>\n");
+  return 0;
+}
+
+/**********************************************************************/
+
+static int html_verse(struct lbctx *ctx,size_t verse,char const *text,size_t len)
+{
+  lb_printf(ctx,"<p>%lu. ",(unsigned long)verse);
+  lb_write(ctx,text,len);
+  return lb_puts(ctx,"</p>\n\n");
+}
+
+/**********************************************************************/
+
+static int html_hit(
+                     struct lbctx *ctx,
+                     char const   *name,
+                     size_t        chapter,
+                     size_t        verse,
+                     char const   *text,
+                     size_t        len
+                   )
+{
+  lb_printf(
+             ctx,
+             "<p><a href=\"%s.%lu:%lu\">%s %lu:%lu</a> ",
+             name,(unsigned long)chapter,(unsigned long)verse,
+             name,(unsigned long)chapter,(unsigned long)verse
+           );
+  lb_write(ctx,text,len);
+  return lb_puts(ctx,"</p>\n\n");
+}
+
+/**********************************************************************/
+
+static int html_count(
+                       struct lbctx *ctx,
+                       char const   *name,
+                       size_t        chapter,
+                       size_t        verses,
+                       size_t        count
+                     )
+{
+  if (chapter == 0)
+    return lb_printf(
+                      ctx,
+                      "<h2><a href=\"%s\">%s</a></h2>\n"
+                      "<p>%lu times in %lu verses</p>\n\n",
+                      name,name,
+                      (unsigned long)count,(unsigned long)verses
+                    );
+  else
+    return lb_printf(
+                      ctx,
+                      "<p><a href=\"%s.%lu\">%s %lu</a>: %lu times in %lu verses</p>\n",
+                      name,(unsigned long)chapter,
+                      name,(unsigned long)chapter,
+                      (unsigned long)count,(unsigned long)verses
+                    );
+}
+
+/**********************************************************************/
+
+static int html_kwic(struct lbctx *ctx,struct lbkwic const *pk)
+{
+  lb_printf(
+             ctx,
+             "<p><a href=\"%s.%lu:%lu\">%s %lu:%lu</a> %s",
+             pk->name,(unsigned long)pk->chapter,(unsigned long)pk->verse,
+             pk->name,(unsigned long)pk->chapter,(unsigned long)pk->verse,
+             pk->cutl ? "... " : ""
+           );
+  lb_write(ctx,pk->before,pk->blen);
+  lb_puts(ctx,"<b>");
+  lb_write(ctx,pk->word,pk->wlen);
+  lb_puts(ctx,"</b>");
+  lb_write(ctx,pk->after,pk->alen);
+  return lb_puts(ctx,pk->cutr ? " ...</p>\n" : "</p>\n");
+}
+
+/**********************************************************************/
+
+static int html_columns(struct lbctx *ctx,struct lbcolumn const *cols,size_t n)
+{
+  if (cols == NULL)
+    return lb_puts(ctx,"</table>\n\n");
+    
+  lb_puts(ctx,"<table class=\"parallel\">\n<tr><th></th>");
+  for (size_t i = 0 ; i < n ; i++)
+    lb_printf(ctx,"<th>%s</th>",cols[i].label);
+  return lb_puts(ctx,"</tr>\n");
+}
+
+/**********************************************************************/
+
+static int html_row(
+                     struct lbctx          *ctx,
+                     size_t                 verse,
+                     struct lbcolumn const *cols,
+                     struct lbcell   const *cell,
+                     size_t                 n
+                   )
+{
+  (void)cols;
+  
+  lb_printf(ctx,"<tr><td>%lu.</td>",(unsigned long)verse);
+  for (size_t i = 0 ; i < n ; i++)
+  {
+    lb_puts(ctx,"<td>");
+    if (cell[i].text != NULL)
+      lb_write(ctx,cell[i].text,cell[i].len);
+    lb_puts(ctx,"</td>");
+  }
+  return lb_puts(ctx,"</tr>\n");
+}
+
+/**********************************************************************/
+
+struct lbrender const lb_render_html =
+{
+  .book    = html_book,
+  .chapter = html_chapter,
+  .verse   = html_verse,
+  .hit     = html_hit,
+  .count   = html_count,
+  .kwic    = html_kwic,
+  .columns = html_columns,
+  .row     = html_row,
+};
+
+/**********************************************************************/
+
+static int text_book(struct lbctx *ctx,char const *name)
+{
+  return lb_printf(ctx,"\n%s\n",name);
+}
+
+/**********************************************************************/
+
+static int text_chapter(struct lbctx *ctx,size_t chapter,bool skip)
+{
+  lb_printf(ctx,"Chapter %lu\n\n",(unsigned long)chapter);
+  if (skip)
+    lb_puts(ctx,"\t.\n\t.\n\t.\n");
+  return 0;
+}
+
+/**********************************************************************/
+
+static int text_verse(struct lbctx *ctx,size_t verse,char const *text,size_t len)
+{
+  lb_printf(ctx,"%lu. ",(unsigned long)verse);
+  lb_write(ctx,text,len);
+  return lb_puts(ctx,"\n\n");
+}
+
+/**********************************************************************/
+
+static int text_hit(
+                     struct lbctx *ctx,
+                     char const   *name,
+                     size_t        chapter,
+                     size_t        verse,
+                     char const   *text,
+                     size_t        len
+                   )
+{
+  lb_printf(ctx,"%s %lu:%lu ",name,(unsigned long)chapter,(unsigned long)verse);
+  lb_write(ctx,text,len);
+  return lb_puts(ctx,"\n\n");
+}
+
+/**********************************************************************/
+
+static int text_count(
+                       struct lbctx *ctx,
+                       char const   *name,
+                       size_t        chapter,
+                       size_t        verses,
+                       size_t        count
+                     )
+{
+  if (chapter == 0)
+    return lb_printf(
+                      ctx,
+                      "\n%s: %lu times in %lu verses\n",
+                      name,
+                      (unsigned long)count,(unsigned long)verses
+                    );
+  else
+    return lb_printf(
+                      ctx,
+                      "%s %lu: %lu times in %lu verses\n",
+                      name,(unsigned long)chapter,
+                      (unsigned long)count,(unsigned long)verses
+                    );
+}
+
+/**********************************************************************/
+
+static int text_kwic(struct lbctx *ctx,struct lbkwic const *pk)
+{
+  lb_printf(
+             ctx,
+             "%s %lu:%lu %s",
+             pk->name,(unsigned long)pk->chapter,(unsigned long)pk->verse,
+             pk->cutl ? "... " : ""
+           );
+  lb_write(ctx,pk->before,pk->blen);
+  lb_puts(ctx,"[");
+  lb_write(ctx,pk->word,pk->wlen);
+  lb_puts(ctx,"]");
+  lb_write(ctx,pk->after,pk->alen);
+  return lb_puts(ctx,pk->cutr ? " ...\n" : "\n");
+}
+
+/**********************************************************************/
+
+static int text_columns(struct lbctx *ctx,struct lbcolumn const *cols,size_t n)
+{
+  (void)ctx;
+  (void)cols;
+  (void)n;
+  return 0;
+}
+
+/**********************************************************************/
+
+static int text_row(
+                     struct lbctx          *ctx,
+                     size_t                 verse,
+                     struct lbcolumn const *cols,
+                     struct lbcell   const *cell,
+                     size_t                 n
+                   )
+{
+  lb_printf(ctx,"%lu.\n",(unsigned long)verse);
+  for (size_t i = 0 ; i < n ; i++)
+  {
+    lb_printf(ctx,"\t%s: ",cols[i].label);
+    if (cell[i].text != NULL)
+      lb_write(ctx,cell[i].text,cell[i].len);
+    lb_puts(ctx,"\n");
+  }
+  return lb_puts(ctx,"\n");
+}
+
+/**********************************************************************/
+
+struct lbrender const lb_render_text =
+{
+  .book    = text_book,
+  .chapter = text_chapter,
+  .verse   = text_verse,
+  .hit     = text_hit,
+  .count   = text_count,
+  .kwic    = text_kwic,
+  .columns = text_columns,
+  .row     = text_row,
+};
+
+/**********************************************************************/
+
+uint64_t lb_now(void)
+{
+  struct timespec ts;
+  
+  clock_gettime(CLOCK_MONOTONIC,&ts);
+  return (uint64_t)ts.tv_sec * 1000000000uLL + ts.tv_nsec;
+}
+
+/**********************************************************************/
@@ -0,0 +1,261 @@
+/******************************************************************
+*
+* litbook.h             - API for the mod_litbook core (liblitbook):
+*                         translation tables, book lookup, reference
+*                         parsing, chapter reading and rendering.
+*
+* Copyright 2022 by Sean Conner.  All Rights Reserved.
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*
+* Comments, questions and criticisms can be sent to: sean@conman.org
+*
+*******************************************************************/
+
+#ifndef LITBOOK_H
+#define LITBOOK_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <limits.h>
+
+#include "soundex.h"
+
+#define LB_END          INT_MAX         /* "to the end" chapter/verse */
+#define LB_IBUFSIZ      256             /* index entries read w/o allocating */
+#define LB_PARMAX       8               /* translations shown in parallel */
+#define LB_MAPSPAN      4               /* chapters a mapped chapter draws on */
+
+/*******************************************************************
+;
+; The library never calls malloc() directly---everything goes through
+; one of these.  free() may be NULL for pool style allocators (like
+; Apache's), in which case nothing is ever freed.
+;
+********************************************************************/
+
+struct lballoc
+{
+  void  *(*alloc)(void *,size_t);
+  void   (*free) (void *,void *);
+  void    *ud;
+};
+
+struct lbbookname
+{
+  char    *abrev;
+  char    *fullname;
+  SOUNDEX  sdx;
+  char    *mp;
+};
+
+struct lbtrans
+{
+  struct lbbookname  *books;            /* translation file order */
+  struct lbbookname **abrev;
+  struct lbbookname **fullname;
+  struct lbbookname **soundex;
+  struct lbbookname **metaphone;
+  size_t              maxbook;
+};
+
+enum lbtier
+{
+  LB_TIER_NONE,
+  LB_TIER_FULLNAME,
+  LB_TIER_ABREV,
+  LB_TIER_SOUNDEX,
+  LB_TIER_METAPHONE,
+};
+
+struct lbrequest
+{
+  char        *name;
+  size_t       c1;
+  size_t       v1;
+  size_t       c2;
+  size_t       v2;
+  int          redirect;
+  enum lbtier  tier;
+  size_t       book;                    /* index into lbtrans.books */
+  uint64_t     nslookup;                /* lb_translate_timed() only */
+};
+
+/*******************************************************************
+;
+; Versification.  References are always in the canonical numbering; a
+; translation that numbers some verses differently has a map.  For each
+; book that differs, start[] has where each canonical chapter begins in
+; verse[] (a chapter with nothing there is numbered the same), and
+; verse[] has the translation's chapter and verse for each canonical
+; verse, packed with LB_VPACK(), or LB_VSAME or LB_VNONE.  A mapped
+; chapter ends with the last canonical verse in the map.
+;
+********************************************************************/
+
+#define LB_VSAME        0u              /* numbered the same */
+#define LB_VNONE        0xFFFFFFFFu     /* not in this translation */
+#define LB_VMAX         0xFFFFu         /* largest chapter or verse */
+#define LB_VPACK(c,v)   (((uint32_t)(c) << 16) | (uint32_t)(v))
+
+struct lbvbook
+{
+  size_t    chapters;                   /* 0 if numbered the same */
+  uint32_t *start;                      /* start[0] .. start[chapters] */
+  uint32_t *verse;
+};
+
+struct lbvmap
+{
+  struct lbvbook *books;                /* translation file order */
+  size_t          maxbook;
+};
+
+/*******************************************************************
+;
+; A chapter.  After lb_chapter_open() the index is loaded; after
+; lb_chapter_read() the text for verses vlow through vhigh is in memory
+; (one read), and lb_chapter_verse() returns pointers into it.
+;
+********************************************************************/
+
+struct lbchapter
+{
+  size_t    number;
+  size_t    max;                        /* verses in chapter */
+  long     *index;                      /* index[0] .. index[max] */
+  char     *text;
+  size_t    vlow;
+  size_t    vhigh;
+  size_t    calls;                      /* system calls made */
+  size_t    bytes;                      /* bytes read from disk */
+  long      ibuf[LB_IBUFSIZ];
+};
+
+/*******************************************************************
+;
+; Rendering.  The renderer callbacks format a request; everything they
+; produce goes out through lbctx.write().  The context carries whatever
+; else a request needs.  hit() is a single verse out of a search, with
+; the book and chapter given.  count() is how often a word appears in a
+; book (chapter 0) or chapter, and kwic() is one line of a concordance,
+; the word with some of the verse on either side.  A chapter shown in
+; parallel starts with columns(), has a row() per verse (a cell's text is
+; NULL if that translation doesn't have the verse), and ends with
+; columns() given no columns.
+;
+********************************************************************/
+
+struct lbctx;
+
+struct lbkwic
+{
+  char const *name;
+  size_t      chapter;
+  size_t      verse;
+  char const *before;
+  size_t      blen;
+  char const *word;
+  size_t      wlen;
+  char const *after;
+  size_t      alen;
+  bool        cutl;                     /* verse goes on past before */
+  bool        cutr;                     /* verse goes on past after */
+};
+
+struct lbcolumn
+{
+  char           const *label;
+  char           const *bookdir;
+  char           const *name;           /* NULL if not in this translation */
+  struct lbvbook const *map;            /* NULL if numbered the same */
+};
+
+struct lbcell
+{
+  char const *text;
+  size_t      len;
+};
+
+struct lbstats
+{
+  size_t   syscalls;
+  size_t   bytesread;
+  size_t   chapters;
+  size_t   verses;
+  uint64_t nsio;                        /* if lbctx.timed */
+};
+
+struct lbrender
+{
+  int (*book)   (struct lbctx *,char const *);
+  int (*chapter)(struct lbctx *,size_t,bool);
+  int (*verse)  (struct lbctx *,size_t,char const *,size_t);
+  int (*hit)    (struct lbctx *,char const *,size_t,size_t,char const *,size_t);
+  int (*count)  (struct lbctx *,char const *,size_t,size_t,size_t);
+  int (*kwic)   (struct lbctx *,struct lbkwic const *);
+  int (*columns)(struct lbctx *,struct lbcolumn const *,size_t);
+  int (*row)    (struct lbctx *,size_t,struct lbcolumn const *,struct lbcell const *,size_t);
+};
+
+struct lbctx
+{
+  struct lballoc  const *alloc;
+  struct lbrender const *render;
+  int                  (*write)(void *,char const *,size_t);
+  void                  *ud;
+  size_t                 bytes;         /* bytes rendered */
+  bool                   timed;         /* time the chapter I/O */
+  struct lbstats         stats;
+};
+
+/************************************************************************/
+
+extern struct lballoc  const lb_malloc;
+extern struct lbrender const lb_render_html;
+extern struct lbrender const lb_render_text;
+
+extern int                   lb_trans_load       (struct lbtrans *,char const *,struct lballoc const *,size_t *);
+extern void                  lb_trans_free       (struct lbtrans *,struct lballoc const *);
+extern struct lbbookname    *lb_find_book        (struct lbtrans const *,char const *,enum lbtier *);
+extern char const           *lb_tier_name        (enum lbtier);
+
+extern int                   lb_vmap_load        (struct lbvmap *,struct lbtrans const *,char const *,struct lballoc const *,size_t *);
+extern void                  lb_vmap_free        (struct lbvmap *,struct lballoc const *);
+extern struct lbvbook const *lb_vmap_book        (struct lbvmap const *,size_t);
+
+extern void                  lb_translate_request(struct lbrequest *,struct lbtrans const *,char const *);
+extern void                  lb_translate_timed  (struct lbrequest *,struct lbtrans const *,char const *);
+extern size_t                lb_redirect_request (char *,size_t,struct lbrequest const *);
+
+extern int                   lb_chapter_open     (struct lbchapter *,struct lballoc const *,char const *,char const *,size_t);
+extern int                   lb_chapter_read     (struct lbchapter *,struct lballoc const *,char const *,char const *,size_t,size_t);
+extern char const           *lb_chapter_verse    (struct lbchapter const *,size_t,size_t *);
+extern void                  lb_chapter_close    (struct lbchapter *,struct lballoc const *);
+extern int                   lb_chapter_prefetch (char const *,char const *,size_t);
+
+extern int                   lb_show_chapter     (struct lbctx *,char const *,char const *,size_t,size_t,size_t);
+extern size_t                lb_show_hits        (struct lbctx *,char const *,char const *,size_t,size_t const *,size_t);
+extern int                   lb_show_parallel    (struct lbctx *,struct lbcolumn const *,size_t,struct lbrequest const *);
+extern void                  lb_print_request    (struct lbctx *,struct lbrequest const *,char const *,struct lbvmap const *);
+
+extern int                   lb_write            (struct lbctx *,char const *,size_t);
+extern int                   lb_puts             (struct lbctx *,char const *);
+extern int                   lb_printf           (struct lbctx *,char const *,...) __attribute__((format(printf,2,3)));
+
+extern uint64_t              lb_now              (void);
+
+#endif
@@ -10,49 +10,102 @@
 *
 *********************************************************************/
 
-#include <ctype.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "metaphone.h"
 
-static char vsfn[26] =
+/*******************************************************************
+;
+; Letter flags, indexed by any byte so the lookbehind and lookahead
+; at the ends of the word (which see NULs) don't index off the table.
+; Only upper case letters are ever looked up.
+;
+********************************************************************/
+
+enum
 {
-   1,16,4,16,9,2,4,16,9,2,0,2,2,2,1,4,0,2,4,4,1,0,0,0,8,0
-/* A  B C  D E F G  H I J K L M N O P Q R S T U V W X Y Z */
+  VOWEL  =  1,
+  SAME   =  2,
+  VARSON =  4,
+  FRONTV =  8,
+  NOGHF  = 16,
+};
+
+static unsigned char const vsfn[256] =
+{
+  ['A'] = VOWEL,          ['B'] = NOGHF,          ['C'] = VARSON,
+  ['D'] = NOGHF,          ['E'] = VOWEL | FRONTV, ['F'] = SAME,
+  ['G'] = VARSON,         ['H'] = NOGHF,          ['I'] = VOWEL | FRONTV,
+  ['J'] = SAME,           ['L'] = SAME,           ['M'] = SAME,
+  ['N'] = SAME,           ['O'] = VOWEL,          ['P'] = VARSON,
+  ['R'] = SAME,           ['S'] = VARSON,         ['T'] = VARSON,
+  ['U'] = VOWEL,          ['Y'] = FRONTV,
 };
 
 /* Testing macros */
-#define vowel(x)   (vsfn[(x) - 'A'] & 1)
-#define same(x)    (vsfn[(x) - 'A'] & 2)
-#define varson(x)  (vsfn[(x) - 'A'] & 4)
-#define frontv(x)  (vsfn[(x) - 'A'] & 8)
-#define noghf(x)   (vsfn[(x) - 'A'] & 16)
+#define vowel(x)   (vsfn[(unsigned char)(x)] & VOWEL)
+#define same(x)    (vsfn[(unsigned char)(x)] & SAME)
+#define varson(x)  (vsfn[(unsigned char)(x)] & VARSON)
+#define frontv(x)  (vsfn[(unsigned char)(x)] & FRONTV)
+#define noghf(x)   (vsfn[(unsigned char)(x)] & NOGHF)
+
+/* Upper case for letters, 0 for everything else (dropped) */
+#define UC(c)   [c] = c , [(c) + ('a' - 'A')] = c
 
-#define MAX_WORD_BUF   32
+static char const c_upper[256] =
+{
+  UC('A') , UC('B') , UC('C') , UC('D') , UC('E') , UC('F') , UC('G') ,
+  UC('H') , UC('I') , UC('J') , UC('K') , UC('L') , UC('M') , UC('N') ,
+  UC('O') , UC('P') , UC('Q') , UC('R') , UC('S') , UC('T') , UC('U') ,
+  UC('V') , UC('W') , UC('X') , UC('Y') , UC('Z') ,
+};
+
+/*******************************************************************
+;
+; The word is copied with PAD NULs on either side, since the rules look
+; up to four letters back and three ahead.  Words too long for the
+; local buffer get one from malloc() (the original silently truncated
+; them at 29 letters).
+;
+********************************************************************/
 
-bool make_metaphone(char *word, char *metaph, int maxmet)
+#define PAD             4
+#define MAX_WORD_BUF    128
+
+bool make_metaphone(char const *word, char *metaph, int maxmet)
 {
   char *n, *n_start, *n_end;
   char *metaph_end;
-  char  ntrans[MAX_WORD_BUF];
+  char const *w;
+  char  buf[MAX_WORD_BUF];
+  char *ntrans;
+  size_t len;
   bool  KSFlag;
   
   memset(metaph,0,maxmet);
+  
+  for (len = 0 , w = word ; *w != '\0' ; w++)
+    len += c_upper[(unsigned char)*w] != '\0';
+    
+  if (len == 0)
+    return false;
+    
+  if (len + 2 * PAD <= sizeof(buf))
+    ntrans = buf;
+  else if ((ntrans = malloc(len + 2 * PAD)) == NULL)
+    return false;
+    
   /* Transform word to upper case and remove non-alpha characters */
-  for(n = ntrans + 1, n_end = ntrans + MAX_WORD_BUF - 2;
-      (*word != '\0') && (n < n_end);
-      word++)
-   if (isalpha(*word))
-      *n++ = toupper(*word);
-      
-  if (n == ntrans + 1)
-      return false;
-      
+  memset(ntrans,0,PAD);
+  for (n = ntrans + PAD ; *word != '\0' ; word++)
+    if ((*n = c_upper[(unsigned char)*word]) != '\0')
+      n++;
+  memset(n,0,PAD);
+  
   /* Begin preprocessing */
   n_end = n;
-  *n++  = '\0';
-  *n    = '\0';
-  n     = ntrans + 1;
+  n     = ntrans + PAD;
   
   switch (*n)
    {
@@ -200,7 +253,33 @@ bool make_metaphone(char *word, char *metaph, int maxmet)
       
    }
    
+  /*-----------------------------------------------------------------
+  ; The loop can fill the buffer, in which case the last character gives
+  ; way to the NUL (this used to write one past the end).
+  ;------------------------------------------------------------------*/
+  
+  if (metaph == metaph_end)
+    metaph--;
   *metaph = '\0';
+  
+  if (ntrans != buf)
+    free(ntrans);
   return true;
 }
 
+/*******************************************************************
+;
+; Code a list of words at once, each into its own maxmet sized slot of
+; metaph.  Returns the number of words that had any letters at all;
+; the rest get an empty code.
+;
+********************************************************************/
+
+size_t make_metaphones(char const *const *words,size_t n,char *metaph,int maxmet)
+{
+  size_t coded = 0;
+  
+  for (size_t i = 0 ; i < n ; i++ , metaph += maxmet)
+    coded += make_metaphone(words[i],metaph,maxmet);
+  return coded;
+}
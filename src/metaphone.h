@@ -12,8 +12,10 @@
 #ifndef METAPHONE_H
 #define METAPHONE_H
 
+#include <stddef.h>
 #include <stdbool.h>
-extern bool make_metaphone (char *,char *,int);
+extern bool   make_metaphone  (char const *,char *,int);
+extern size_t make_metaphones (char const *const *,size_t,char *,int);
 
 #endif
 
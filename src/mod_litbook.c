@@ -23,14 +23,26 @@
 *
 *******************************************************************/
 
+#include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 #include <stdbool.h>
 #include <ctype.h>
+#include <errno.h>
+
+#include <sys/types.h>
+#include <sys/socket.h>
 
 #include "apr_errno.h"
 #include "apr_file_io.h"
 #include "apr_strings.h"
 #include "apr_hash.h"
+#include "apr_shm.h"
+#include "apr_atomic.h"
+#include "apr_portable.h"
+#include "apr_thread_mutex.h"
+#include "apr_thread_proc.h"
+#include "apr_global_mutex.h"
 #include "ap_config.h"
 #include "ap_provider.h"
 #include "httpd.h"
@@ -39,808 +51,3030 @@
 #include "http_log.h"
 #include "http_protocol.h"
 #include "http_request.h"
-
-#include "metaphone.h"
-#include "soundex.h"
-
-#define MBUFSIZ 512
+#include "ap_socache.h"
+#include "util_mutex.h"
+
+#include "litbook.h"
+#include "search.h"
+#include "scan.h"
+#include "probes.h"
+
+#define MBUFSIZ         512
+#define LB_HBUCKETS     32
+#define LB_SEARCHMAX    200             /* verses shown per search page */
+#define LB_SCANDEF      1               /* LitbookScanThreads */
+#define LB_LIBDEF       32              /* LitbookLibraryCache */
+#define LB_TRANSREG     "litbook-trans" /* process pool userdata */
+#define LB_LIBTRANS     "thebooks"      /* in each work's directory */
+#define LB_LIBTITLE     "title"         /* ditto, optional */
+#define LB_FILEPFX      "litbook:"      /* r->filename of a claimed URL */
+#define LB_CACHEID      "litbook-cache" /* mutex type and socache name */
+#define LB_CACHEDEF     3600            /* LitbookCache seconds */
+#define LB_CACHEMAX     (128 * 1024)    /* largest page cached */
+#define LB_HOTID        "litbook-hot"   /* mutex type */
+#define LB_HOTMAX       256             /* pages tracked */
+#define LB_HOTKEY       96              /* longest key tracked */
+#define LB_HOTSHOW      32              /* pages on the status page */
+#define LB_HOTDEF       300             /* LitbookHotList seconds */
+#define LB_PFSLOTS      1024            /* chapters prefetched, tracked */
 
 extern module AP_MODULE_DECLARE_DATA litbook_module;
 
 /*****************************************************************/
 
-struct bookname
+struct litconfig
 {
-  char    *abrev;
-  char    *fullname;
-  SOUNDEX  sdx;
-  char    *mp;
+  char               *bookindex;
+  char               *booktrans;
+  char               *bookdir;
+  char               *booktld;
+  char               *booktitle;
+  struct lbtrans     *trans;
+  struct lbindex     *index;
+  struct lbvmap      *vmap;
+  int                 timing;
+  char               *timinghdr;
+  int                 scanthreads;      /* -1 if not set */
+  int                 prefetch;         /* -1 if not set */
+  apr_array_header_t *parallel;         /* of struct litpar */
+  struct litlib      *library;
 };
 
-struct bookrequest
+/*******************************************************************
+;
+; Library mode.  Works are directories under the library's root, each
+; with its own translation file, loaded the first time they're asked
+; for.  Each process keeps up to max of them, the least recently used
+; going first, although one in use by a request stays until it's done.
+;
+********************************************************************/
+
+struct litwork
 {
-  char   *name;
-  size_t  c1;
-  size_t  v1;
-  size_t  c2;
-  size_t  v2;
-  int     redirect;
+  struct litwork *prev;                 /* most recently used first */
+  struct litwork *next;
+  struct litlib  *lib;
+  char           *name;
+  char           *bookdir;
+  char           *title;                /* NULL if none */
+  struct lbtrans  trans;
+  unsigned        refs;                 /* requests using it */
 };
 
-struct litconfig
+struct litlib
 {
-  char             *bookindex;
-  char             *booktrans;
-  char             *bookdir;
-  char             *booktld;
-  char             *booktitle;
-  struct bookname  *books;
-  struct bookname **abrev;
-  struct bookname **fullname;
-  struct bookname **soundex;
-  struct bookname **metaphone;
-  size_t            maxbook;
+  char               *root;
+  size_t              max;
+  apr_pool_t         *pool;
+  apr_thread_mutex_t *lock;
+  apr_hash_t         *works;
+  struct litwork     *head;
+  struct litwork     *tail;
+  size_t              n;
 };
 
-/************************************************************************
-*       MISC UTIL SUBROUTINES
-************************************************************************/
-
-static char *trim_lspace(char *s)
+struct litpar
 {
-  for ( ; (*s) && (isspace(*s)) ; s++)
-    ;
-  return s;
-}
-
-/********************************************************************/
+  char           *label;
+  char           *bookdir;
+  struct lbtrans *trans;
+  struct lbvmap  *vmap;
+};
 
-static char *trim_tspace(char *s)
+/*******************************************************************
+;
+; A translation file, loaded once no matter how many <Location>s (or
+; passes over the configuration) name it.  Each is in a pool of its own
+; under the process pool, so a changed file can replace it on a restart.
+;
+********************************************************************/
+
+struct litreg
 {
-  char *p;
-  
-  for (p = s + strlen(s) - 1 ; (p > s) && (isspace(*p)) ; p--)
-    ;
-  p[1] = '\0';
-  return s;
-}
-
-/********************************************************************/
+  apr_pool_t     *pool;
+  apr_time_t      mtime;
+  apr_off_t       size;
+  struct lbtrans  trans;
+};
 
-static char *trim_space(char *s)
+enum
 {
-  return trim_tspace(trim_lspace(s));
-}
-
-/********************************************************************/
+  TIMING_UNSET,
+  TIMING_OFF,
+  TIMING_ON,
+  TIMING_HEADER,
+};
 
-static int empty_string(char *s)
+/*******************************************************************
+;
+; Statistics, shared by all the children.  Everything is updated with
+; atomic adds, no locks.  Times are kept in nanoseconds, and the
+; histograms are in powers of two (of microseconds for times, of bytes
+; for sizes).
+;
+********************************************************************/
+
+enum
 {
-  for ( ; *s ; s++)
-  {
-    if (isprint(*s)) return 0;
-  }
-  return 1;
-}
-
-/******************************************************************
-*       CONFIGURATION SUBROUTINES
-******************************************************************/
+  ST_PARSE,
+  ST_LOOKUP,
+  ST_IO,
+  ST_RENDER,
+  ST_TOTAL,
+  ST_MAX
+};
 
-static void clt_linecount(apr_file_t *fp,size_t *pcount,size_t *plsize)
+enum
 {
-  size_t lcount = 0;
-  size_t lsize  = 0;
-  size_t lmax   = 0;
-  char   c;
-  
-  while(apr_file_getc(&c,fp) == APR_SUCCESS)
-  {
-    lsize++;
-    if (c == '\n')
-    {
-      lcount++;
-      if (lsize > lmax)
-        lmax = lsize;
-      lsize = 0;
-    }
-  }
-  
-  /*----------------------------------------------------
-  ; (1.0.5) if lsize > 0 then the last line in the file
-  ; does not end with a '\n'.  Adjust accordingly.
-  ;
-  ; (1.0.7) if the last line doesn't end with a '\n' and
-  ; it's the longest line, lmax isn't the maximum line
-  ; size.
-  ;
-  ; (1.0.8) adjust lsize by 1 to adjust for
-  ; fgets()/strtok() interaction.
-  ;-----------------------------------------------------*/
-  
-  *pcount = lcount + ((lsize > 0) ? 1 : 0) ;
-  *plsize = 1 + ((lsize > lmax) ? lsize : lmax);
-  apr_file_seek(fp,APR_SET,&(apr_off_t){0});
-}
+  OUT_200,
+  OUT_301,
+  OUT_404,
+  OUT_MAX
+};
 
-/**********************************************************************/
+struct lbhist
+{
+  apr_uint64_t count;
+  apr_uint64_t sum;
+  apr_uint64_t bucket[LB_HBUCKETS];
+};
 
-static int clt_sort_abrev(const void *o1,const void *o2)
+struct lbhot
 {
-  return strcmp(
-                 (*((struct bookname **)o1))->abrev,
-                 (*((struct bookname **)o2))->abrev
-               );
-}
+  apr_uint32_t hash;
+  apr_uint32_t count;
+  apr_uint32_t error;                   /* count is over by at most this */
+  char         key[LB_HOTKEY];
+};
 
-/*******************************************************************/
+struct lbshared
+{
+  apr_uint32_t  watched;                /* status page has been asked for */
+  apr_uint64_t  outcome[OUT_MAX];
+  apr_uint64_t  tier[LB_TIER_METAPHONE + 1];
+  struct lbhist stage[ST_MAX];
+  struct lbhist size;
+  apr_uint64_t  bytesread;
+  apr_uint64_t  chapters;
+  apr_uint64_t  verses;
+  apr_uint64_t  cache[2];               /* hits, misses */
+  apr_uint32_t  cachemax;               /* largest entry stored */
+  apr_uint64_t  hotskipped;             /* not counted, table was busy */
+  apr_uint32_t  hotsaved;               /* seconds, last time saved */
+  apr_uint32_t  nhot;
+  struct lbhot  hot[LB_HOTMAX];         /* under m_hotlock */
+  apr_uint64_t  prefetch[2];            /* issued, used */
+  apr_uint32_t  prefetched[LB_PFSLOTS];
+};
 
-static int clt_sort_fullname(const void *o1,const void *o2)
+struct lbtiming
 {
-  return strcmp(
-                 (*((struct bookname **)o1))->fullname,
-                 (*((struct bookname **)o2))->fullname
-               );
-}
+  uint64_t start;
+  uint64_t ns[ST_MAX];
+};
 
-/*********************************************************************/
+/*****************************************************************/
 
-static int clt_sort_soundex(const void *o1,const void *o2)
+static char const *const c_stages[ST_MAX] =
 {
-  return SoundexCompare(
-                         (*((struct bookname **)o1))->sdx,
-                         (*((struct bookname **)o2))->sdx
-                       );
-}
+  "parse",
+  "lookup",
+  "io",
+  "render",
+  "total",
+};
 
-/********************************************************************/
+static char const *const c_outcomes[OUT_MAX] = { "200" , "301" , "404" };
 
-static int clt_sort_metaphone(const void *o1,const void *o2)
-{
-  return strcmp(
-                 (*((struct bookname **)o1))->mp,
-                 (*((struct bookname **)o2))->mp
-               );
-}
+static struct lbshared             *m_stats;
+static ap_socache_provider_t const *m_cache;        /* LitbookCache */
+static ap_socache_instance_t       *m_cacheinst;
+static apr_global_mutex_t          *m_cachelock;    /* if the provider needs one */
+static apr_interval_time_t          m_cachetime;
+static apr_array_header_t          *m_cachetlds;    /* <Location>s to look up */
+static char const                  *m_hotfile;      /* LitbookHotList */
+static apr_global_mutex_t          *m_hotlock;
+static apr_uint32_t                 m_hotsave;      /* seconds */
+static apr_uint32_t                 m_hotstop;      /* hot_saver() to exit */
 
-/*******************************************************************
-*       HANDLER SUBROUTINES
-*******************************************************************/
+/************************************************************************
+*       LIBLITBOOK GLUE
+************************************************************************/
 
-static int hr_find_abrev(const void *key,const void *datum)
+static void *lbapr_alloc(void *ud,size_t size)
 {
-  return strcmp(key,(*((struct bookname **)datum))->abrev);
+  return apr_palloc(ud,size);
 }
 
-/**********************************************************************/
+/************************************************************************/
 
-static int hr_find_fullname(const void *key,const void *datum)
+static int lbapr_write(void *ud,char const *buf,size_t len)
 {
-  return strcmp(key,(*((struct bookname **)datum))->fullname);
+  return ap_rwrite(buf,len,ud) < 0 ? -1 : 0;
 }
 
-/*********************************************************************/
+/************************************************************************/
 
-static int hr_find_soundex(const void *key,const void *datum)
+static int lbapr_bbwrite(void *ud,char const *buf,size_t len)
 {
-  return SoundexCompare(*((SOUNDEX *)key),(*((struct bookname **)datum))->sdx);
+  return apr_brigade_write(ud,NULL,NULL,buf,len) == APR_SUCCESS ? 0 : -1;
 }
 
-/**********************************************************************/
+/************************************************************************
+*       STATISTICS
+************************************************************************/
 
-static int hr_find_metaphone(const void *key,const void *datum)
+static void stats_hist(struct lbhist *ph,apr_uint64_t value,apr_uint64_t unit)
 {
-  return strcmp(key,(*((struct bookname **)datum))->mp);
+  apr_uint64_t v = value / unit;
+  size_t       i = 0;
+  
+  while((v > 0) && (i < LB_HBUCKETS - 1))
+  {
+    v >>= 1;
+    i++;
+  }
+  
+  apr_atomic_inc64(&ph->count);
+  apr_atomic_add64(&ph->sum,value);
+  apr_atomic_inc64(&ph->bucket[i]);
 }
 
-/******************************************************************/
+/************************************************************************/
 
-static int hr_show_chapter(
-                            size_t            chapter,
-                            size_t            vlow,
-                            size_t            vhigh,
-                            struct litconfig *plc,
-                            char             *name,
-                            request_rec      *r
-                          )
+static void stats_request(
+                           int                     outcome,
+                           struct lbrequest const *pbr,
+                           struct lbctx     const *ctx,
+                           struct lbtiming        *ptm
+                         )
 {
-  long int     *iarray;
-  apr_file_t   *fp;
-  char          fname[MBUFSIZ];
-  size_t        max;
-  long          s;
-  long          maxs = 0;
-  char         *p    = NULL;
-  apr_status_t  rc;
-  
-  sprintf(fname,"%s/%s/%lu.index",plc->bookdir,name,(unsigned long)chapter);
-  if ((rc = apr_file_open(&fp,fname,APR_FOPEN_READ | APR_FOPEN_BINARY,APR_FPROT_OS_DEFAULT,r->pool)) != APR_SUCCESS)
-    return 1;
+  if (m_stats == NULL)
+    return;
     
-  apr_file_read(fp,&max,&(size_t){sizeof(max)});
-  if (max < 1)
-  {
-    apr_file_close(fp);
-    return 1;
-  }
+  /*-------------------------------------------------------------------
+  ; These are gathered whether or not the request was timed; only the
+  ; stage times cost anything extra to collect.
+  ;--------------------------------------------------------------------*/
   
-  if (vlow > max)
+  apr_atomic_inc64(&m_stats->outcome[outcome]);
+  if (pbr != NULL)
+    apr_atomic_inc64(&m_stats->tier[pbr->tier]);
+    
+  if (ctx != NULL)
   {
-    apr_file_close(fp);
-    return 1;
+    stats_hist(&m_stats->size,ctx->bytes,1);
+    apr_atomic_add64(&m_stats->bytesread,ctx->stats.bytesread);
+    apr_atomic_add64(&m_stats->chapters, ctx->stats.chapters);
+    apr_atomic_add64(&m_stats->verses,   ctx->stats.verses);
   }
   
-  if (vhigh > max) vhigh = max;
+  if (ptm == NULL)
+    return;
+    
+  ptm->ns[ST_TOTAL] = lb_now() - ptm->start;
+  stats_hist(&m_stats->stage[ST_PARSE], ptm->ns[ST_PARSE], 1000);
+  stats_hist(&m_stats->stage[ST_LOOKUP],ptm->ns[ST_LOOKUP],1000);
+  stats_hist(&m_stats->stage[ST_TOTAL], ptm->ns[ST_TOTAL], 1000);
   
-  iarray = apr_palloc(r->pool,(max + 1) * sizeof(long));
-  if (iarray == NULL)
+  if (ctx != NULL)
   {
-    apr_file_close(fp);
-    return 1;
+    stats_hist(&m_stats->stage[ST_IO],    ptm->ns[ST_IO],    1000);
+    stats_hist(&m_stats->stage[ST_RENDER],ptm->ns[ST_RENDER],1000);
   }
+}
+
+/************************************************************************
+;
+; Approximate a percentile from a histogram, as the upper bound of the
+; bucket it falls in.
+;
+*************************************************************************/
+
+static double stats_percentile(struct lbhist const *ph,double p,double unit)
+{
+  apr_uint64_t want = (apr_uint64_t)(p * (double)ph->count + 0.5);
+  apr_uint64_t seen = 0;
   
-  apr_file_read(fp,iarray,&(size_t){sizeof(long) * (max + 1)});
-  apr_file_close(fp);
+  if (ph->count == 0)
+    return 0.0;
+  if (want == 0) want = 1;
   
-  sprintf(fname,"%s/%s/%lu",plc->bookdir,name,(unsigned long)chapter);
-  if (apr_file_open(&fp,fname,APR_FOPEN_READ | APR_FOPEN_BINARY,APR_FPROT_OS_DEFAULT,r->pool) != APR_SUCCESS)
-    return 1;
-    
-  ap_rprintf(r,"<h2>Chapter %lu</h2>\n",(unsigned long)chapter);
-  if (vlow > 1)
-    ap_rprintf(r,"<p class=\"skip\">.<br>.<br>.</p>\n");
-    
-  for (size_t i = vlow ; i <= vhigh ; i++)
+  for (size_t i = 0 ; i < LB_HBUCKETS ; i++)
   {
-    s = iarray[i] - iarray[i-1];
-    
-    /*-------------------------------------------------------------
-    ; In the original (non-module) version of this code, I allocate
-    ; memory for each line, read it in, the free it up.  Since Apache
-    ; doesn't have a free() call per say, and since I don't want to
-    ; end up allocating memory for each line (it could be a significant
-    ; number of lines being read) I reuse the memory I allocate if it's
-    ; big enough.  It should only waste a few lines worth of memory.
-    ;-----------------------------------------------------------------*/
-    
-    if (s > maxs)
-    {
-      p = apr_palloc(r->pool,s + 1);
-      if (p == NULL)
-      {
-        apr_file_close(fp);
-        return 0;
-      }
-      maxs = s;
-    }
-    
-    p[s] = '\0';
-    apr_file_seek(fp,APR_SET,&(apr_off_t){iarray[i-1]});
-    apr_file_read(fp,p,&(size_t){s});
-    ap_rprintf(r,"<p>%lu. ",(unsigned long)i);
-    ap_rputs(p,r);
-    ap_rputs("</p>\n\n",r);
+    seen += ph->bucket[i];
+    if (seen >= want)
+      return (double)(1uLL << i) * unit;
   }
-  
-  apr_file_close(fp);
-  return 0;
+  return (double)(1uLL << (LB_HBUCKETS - 1)) * unit;
 }
 
-/**********************************************************************/
+/************************************************************************/
 
-static void hr_print_request(
-                              struct bookrequest *pbr,
-                              struct litconfig   *plc,
-                              request_rec        *r
-                            )
+static void stats_prom_hist(
+                             request_rec         *r,
+                             char const          *name,
+                             char const          *label,
+                             struct lbhist const *ph,
+                             double               bound,
+                             double               scale
+                           )
 {
-  ap_rprintf(r,"<h1>%s</h1>\n",pbr->name);
+  char const   *sep   = *label ? ","  : "";
+  char const   *lb    = *label ? apr_pstrcat(r->pool,"{",label,"}",NULL) : "";
+  apr_uint64_t  total = 0;
   
-  if (pbr->c1 == pbr->c2)
-    hr_show_chapter(pbr->c1,pbr->v1,pbr->v2,plc,pbr->name,r);
-  else
+  for (size_t i = 0 ; i < LB_HBUCKETS - 1 ; i++)
   {
-    for (size_t i = pbr->c1 ; i <= pbr->c2 ; i++)
-    {
-      if (i == pbr->c1)
-      {
-        if (hr_show_chapter(i,pbr->v1,INT_MAX,plc,pbr->name,r)) break;
-      }
-      else if (i == pbr->c2)
-      {
-        if (hr_show_chapter(i,1,pbr->v2,plc,pbr->name,r)) break;
-      }
-      else
-      {
-        if (hr_show_chapter(i,1,INT_MAX,plc,pbr->name,r)) break;
-      }
-    }
+    total += ph->bucket[i];
+    ap_rprintf(r,"%s_bucket{%s%sle=\"%g\"} %" APR_UINT64_T_FMT "\n",name,label,sep,(double)(1uLL << i) * bound,total);
   }
+  
+  ap_rprintf(r,"%s_bucket{%s%sle=\"+Inf\"} %" APR_UINT64_T_FMT "\n",name,label,sep,ph->count);
+  ap_rprintf(r,"%s_sum%s %g\n",name,lb,(double)ph->sum * scale);
+  ap_rprintf(r,"%s_count%s %" APR_UINT64_T_FMT "\n",name,lb,ph->count);
 }
 
-/***********************************************************************/
+/************************************************************************
+;
+; A label value in the text format can't have a bare quote, backslash or
+; newline.  Hot list keys come from the request URL, so they might.
+;
+*************************************************************************/
 
-static void hr_translate_request(
-                                  struct bookrequest *pbr,
-                                  struct litconfig   *plc,
-                                  char               *r
-                                )
+static char const *stats_prom_escape(apr_pool_t *pool,char const *s)
 {
-  char              buffer[MBUFSIZ];
-  char             *p;
-  size_t            size;
-  struct bookname **pres;
-  char             *or = r;
+  char *out = apr_palloc(pool,2 * strlen(s) + 1);
+  char *p   = out;
   
-  pbr->name     = NULL;
-  pbr->c1       = 1;
-  pbr->v1       = 1;
-  pbr->c2       = INT_MAX;
-  pbr->v2       = INT_MAX;
-  pbr->redirect = 0;
-  
-  for (p = buffer , size = 0 ; (*r) && (!ispunct(*r)) ; r++ , size++)
+  for ( ; *s != '\0' ; s++)
   {
-    *p++ = tolower(*r);
-    *p   = '\0';
-  }
-  
-  if (size < 2) return;
-  if (isdigit(buffer[0]))
-    buffer[1] = toupper(buffer[1]);
-  else
-    buffer[0] = toupper(buffer[0]);
-    
-  /*--------------------------------------------------------
-  ; quickly:
-  ;
-  ;     if not found fullname
-  ;       if not found abrev
-  ;         if not found soundex
-  ;           if not found metaphone
-  ;             return NOT FOUND;
-  ;---------------------------------------------------------*/
-  
-  pres = bsearch(
-                  buffer,
-                  plc->fullname,
-                  plc->maxbook,
-                  sizeof(struct bookname *),
-                  hr_find_fullname
-                );
-  if (pres == NULL)
-  {
-    pres = bsearch(
-                    buffer,
-                    plc->abrev,
-                    plc->maxbook,
-                    sizeof(struct bookname *),
-                    hr_find_abrev
-                  );
-    if (pres == NULL)
+    switch(*s)
     {
-      SOUNDEX sdx = Soundex(buffer);
-      
-      pres = bsearch(
-                      &sdx,
-                      plc->soundex,
-                      plc->maxbook,
-                      sizeof(struct bookname *),
-                      hr_find_soundex
-                    );
-      if (pres == NULL)
-      {
-        char mp[MBUFSIZ];
-        int  rc;
-        
-        rc = make_metaphone(buffer,mp,sizeof(mp));
-        if (rc == 0) return;
-        pres = bsearch(
-                        mp,
-                        plc->metaphone,
-                        plc->maxbook,
-                        sizeof(struct bookname *),
-                        hr_find_metaphone
-                      );
-        if (pres == NULL) return;
-      }
+      case '\\': *p++ = '\\'; *p++ = '\\'; break;
+      case '"':  *p++ = '\\'; *p++ = '"';  break;
+      case '\n': *p++ = '\\'; *p++ = 'n';  break;
+      default:   *p++ = *s;               break;
     }
   }
   
-  pbr->name     = (*pres)->fullname;
-  pbr->redirect = strncmp(or,pbr->name,strlen(pbr->name));
-  
-  if ((*r == '\0') || (*r == '-')) return;      /* 1. G or G- */
-  
-  pbr->c1 = strtol(r+1,&r,10);
-  if (pbr->c1 == 0)
-  {
-    pbr->name = NULL;
-    return;
-  }
-  
-  if (*r == '\0')                               /* 2. G.a */
-  {
-    pbr->c2 = pbr->c1;
-    return;
-  }
+  *p = '\0';
+  return out;
+}
+
+/************************************************************************/
+
+static void stats_prometheus(request_rec *r,struct lbshared const *ps)
+{
+  r->content_type = "text/plain; version=0.0.4";
   
-  if ((*r == '.') || (*r == ':'))
-  {
-    if (*r == '.') pbr->redirect = 1;
-    pbr->v1 = strtol(r+1,&r,10);                /* 3. G.a.b */
-    if (pbr->v1 == 0)
-    {
-      pbr->name = NULL;
-      return;
-    }
-    
-    if (*r++ != '-')
-    {
-      pbr->c2 = pbr->c1;
-      pbr->v2 = pbr->v1;
-      if (*(r-1)) pbr->redirect = 1;
-      return;
-    }
-    
-    if (!isdigit(*r))                           /* 4. G.a.b- */
-    {
-      if (*r) pbr->redirect = *r;
-      return;
-    }
-    
-    pbr->c2 = strtol(r,&r,10);                  /* 5. G.a.b-x */
-    if (pbr->c2 == 0)
-    {
-      pbr->name = NULL;
-      return;
-    }
-    
-    if ((*r != '.') && (*r != ':'))
-    {
-      pbr->v2       = pbr->c2;
-      pbr->c2       = pbr->c1;
-      if (*r) pbr->redirect = *r;
-      return;
-    }
+  ap_rputs("# HELP litbook_requests_total Requests handled, by response code.\n",r);
+  ap_rputs("# TYPE litbook_requests_total counter\n",r);
+  for (size_t i = 0 ; i < OUT_MAX ; i++)
+    ap_rprintf(r,"litbook_requests_total{code=\"%s\"} %" APR_UINT64_T_FMT "\n",c_outcomes[i],ps->outcome[i]);
     
-    if (*r == '.') pbr->redirect = 1;
+  ap_rputs("# HELP litbook_lookup_tier_total Book name lookups, by the tier that matched.\n",r);
+  ap_rputs("# TYPE litbook_lookup_tier_total counter\n",r);
+  for (size_t i = 0 ; i <= LB_TIER_METAPHONE ; i++)
+    ap_rprintf(r,"litbook_lookup_tier_total{tier=\"%s\"} %" APR_UINT64_T_FMT "\n",lb_tier_name(i),ps->tier[i]);
     
-    pbr->v2       = strtol(r+1,&r,10);          /* 6. G.a.b-x.y */
-    if (pbr->v2 == 0)
-    {
-      pbr->name = NULL;
-      return;
-    }
+  ap_rputs("# HELP litbook_stage_seconds Time spent in each stage of a request.\n",r);
+  ap_rputs("# TYPE litbook_stage_seconds histogram\n",r);
+  for (size_t i = 0 ; i < ST_MAX ; i++)
+    stats_prom_hist(r,"litbook_stage_seconds",apr_psprintf(r->pool,"stage=\"%s\"",c_stages[i]),&ps->stage[i],1.0e-6,1.0e-9);
     
-    if (*r) pbr->redirect = *r;
-    return;
-  }
-  
-  if (*r++ != '-')                              /* 2. G.a */
-  {
-    pbr->c2 = pbr->c1;
-    if (*(r-1)) pbr->redirect = *(r-1);
-    return;
-  }
+  ap_rputs("# HELP litbook_response_bytes Size of rendered responses.\n",r);
+  ap_rputs("# TYPE litbook_response_bytes histogram\n",r);
+  stats_prom_hist(r,"litbook_response_bytes","",&ps->size,1.0,1.0);
   
-  if (!isdigit(*r))                             /* 7. G.a- */
-  {
-    if (*r) pbr->redirect = *r;
-    return;
-  }
+  ap_rputs("# HELP litbook_read_bytes_total Bytes read from the data files.\n",r);
+  ap_rputs("# TYPE litbook_read_bytes_total counter\n",r);
+  ap_rprintf(r,"litbook_read_bytes_total %" APR_UINT64_T_FMT "\n",ps->bytesread);
+  ap_rputs("# TYPE litbook_chapters_total counter\n",r);
+  ap_rprintf(r,"litbook_chapters_total %" APR_UINT64_T_FMT "\n",ps->chapters);
+  ap_rputs("# TYPE litbook_verses_total counter\n",r);
+  ap_rprintf(r,"litbook_verses_total %" APR_UINT64_T_FMT "\n",ps->verses);
   
-  pbr->c2 = strtol(r,&r,10);                    /* 8. G.a-x */
-  if (pbr->c2 == 0)
-  {
-    pbr->name = NULL;
-    return;
-  }
+  ap_rputs("# HELP litbook_cache_total Response cache lookups.\n",r);
+  ap_rputs("# TYPE litbook_cache_total counter\n",r);
+  ap_rprintf(r,"litbook_cache_total{result=\"hit\"} %" APR_UINT64_T_FMT "\n",ps->cache[0]);
+  ap_rprintf(r,"litbook_cache_total{result=\"miss\"} %" APR_UINT64_T_FMT "\n",ps->cache[1]);
   
-  if ((*r != '.') && (*r != ':'))
-  {
-    if (*r) pbr->redirect = *r;
-    return;
-  }
+  ap_rputs("# HELP litbook_prefetch_total Next chapters prefetched, and later asked for.\n",r);
+  ap_rputs("# TYPE litbook_prefetch_total counter\n",r);
+  ap_rprintf(r,"litbook_prefetch_total{result=\"issued\"} %" APR_UINT64_T_FMT "\n",ps->prefetch[0]);
+  ap_rprintf(r,"litbook_prefetch_total{result=\"used\"} %" APR_UINT64_T_FMT "\n",ps->prefetch[1]);
   
-  if (*r == '.') pbr->redirect = 1;
-  pbr->v2       = strtol(r+1,&r,10);            /* 9. G.a-x.y */
-  if (pbr->v2 == 0)
-  {
-    pbr->name = NULL;
+  if (ps->nhot == 0)
     return;
-  }
-  if (*r) pbr->redirect = *r;
+    
+  ap_rputs("# HELP litbook_hot_requests Requests for the most asked for pages (an upper bound, halved at each LitbookHotList save).\n",r);
+  ap_rputs("# TYPE litbook_hot_requests gauge\n",r);
+  for (size_t i = 0 ; (i < ps->nhot) && (i < LB_HOTSHOW) ; i++)
+    ap_rprintf(r,"litbook_hot_requests{page=\"%s\"} %u\n",stats_prom_escape(r->pool,ps->hot[i].key),ps->hot[i].count);
+  ap_rputs("# TYPE litbook_hot_skipped_total counter\n",r);
+  ap_rprintf(r,"litbook_hot_skipped_total %" APR_UINT64_T_FMT "\n",ps->hotskipped);
 }
 
-/*******************************************************************/
+/************************************************************************/
 
-static char *hr_redirect_request(struct bookrequest *pbr,apr_pool_t *p)
+static void stats_html(request_rec *r,struct lbshared const *ps)
 {
-  char tc1[64];
-  char tc2[64];
-  char tv1[64];
-  char tv2[64];
+  apr_uint64_t requests = 0;
+  apr_uint64_t lookups  = ps->cache[0] + ps->cache[1];
   
-  sprintf(tc1,"%lu",(unsigned long)pbr->c1);
-  sprintf(tc2,"%lu",(unsigned long)pbr->c2);
-  sprintf(tv1,"%lu",(unsigned long)pbr->v1);
-  sprintf(tv2,"%lu",(unsigned long)pbr->v2);
+  r->content_type = "text/html";
   
-  if ((pbr->c2 == INT_MAX) && (pbr->v2 == INT_MAX))
-  {
-    if ((pbr->c1 == 1) && (pbr->v1 == 1))
-      return apr_pstrdup(p,pbr->name);
-      
-    if ((pbr->c1 != 1) && (pbr->v2 == 1))
-      return apr_pstrcat(p,pbr->name,".",tc1,"-",NULL);
-      
-    return apr_pstrcat(p,pbr->name,".",tc1,":",tv1,"-",NULL);
-  }
+  for (size_t i = 0 ; i < OUT_MAX ; i++)
+    requests += ps->outcome[i];
+    
+  ap_rputs(DOCTYPE_HTML_4_0S,r);
+  ap_rputs(
+            "<html>\n"
+            "<head>\n"
+            "  <title>mod_litbook status</title>\n"
+            "</head>\n"
+            "\n"
+            "<body>\n"
+            "<h1>mod_litbook status</h1>\n"
+            "\n",
+            r
+          );
+          
+  ap_rputs("<h2>Requests</h2>\n<table>\n",r);
+  for (size_t i = 0 ; i < OUT_MAX ; i++)
+    ap_rprintf(r,"<tr><td>%s</td><td>%" APR_UINT64_T_FMT "</td></tr>\n",c_outcomes[i],ps->outcome[i]);
+  ap_rprintf(r,"<tr><td>total</td><td>%" APR_UINT64_T_FMT "</td></tr>\n</table>\n\n",requests);
   
-  if (pbr->c1 == pbr->c2)
+  ap_rputs("<h2>Lookups by tier</h2>\n<table>\n",r);
+  for (size_t i = 0 ; i <= LB_TIER_METAPHONE ; i++)
+    ap_rprintf(r,"<tr><td>%s</td><td>%" APR_UINT64_T_FMT "</td></tr>\n",lb_tier_name(i),ps->tier[i]);
+  ap_rputs("</table>\n\n",r);
+  
+  ap_rputs(
+            "<h2>Stages (microseconds)</h2>\n"
+            "<table>\n"
+            "<tr><th>stage</th><th>count</th><th>mean</th><th>p50</th><th>p99</th><th>p99.9</th></tr>\n",
+            r
+          );
+  for (size_t i = 0 ; i < ST_MAX ; i++)
   {
-    /*--------------------------------------------------------------
-    ; (1.0.9) This redirect is incorrect.  I'm not sure why I got
-    ; it wrong, but THIS is the correct way to handle this case.
-    ; Sigh.
-    ;--------------------------------------------------------------*/
+    struct lbhist const *ph = &ps->stage[i];
     
-    if ((pbr->v1 == 1) && (pbr->v2 == INT_MAX))
-      return apr_pstrcat(p,pbr->name,".",tc1,NULL);
-      
-    if (pbr->v1 == pbr->v2)
-      return apr_pstrcat(p,pbr->name,".",tc1,":",tv1,NULL);
-      
-    return apr_pstrcat(p,pbr->name,".",tc1,":",tv1,"-",tc2,":",tv2,NULL);
+    ap_rprintf(
+                r,
+                "<tr><td>%s</td><td>%" APR_UINT64_T_FMT "</td><td>%.1f</td><td>&lt;%.0f</td><td>&lt;%.0f</td><td>&lt;%.0f</td></tr>\n",
+                c_stages[i],
+                ph->count,
+                ph->count ? (double)ph->sum / (double)ph->count / 1000.0 : 0.0,
+                stats_percentile(ph,0.50, 1.0),
+                stats_percentile(ph,0.99, 1.0),
+                stats_percentile(ph,0.999,1.0)
+              );
   }
+  ap_rputs("</table>\n\n",r);
   
-  if (pbr->v1 == 1)
+  ap_rputs("<h2>Data</h2>\n<table>\n",r);
+  ap_rprintf(
+              r,
+              "<tr><td>mean response</td><td>%.0f bytes</td></tr>\n"
+              "<tr><td>p99 response</td><td>&lt;%.0f bytes</td></tr>\n"
+              "<tr><td>bytes read</td><td>%" APR_UINT64_T_FMT "</td></tr>\n"
+              "<tr><td>chapters</td><td>%" APR_UINT64_T_FMT "</td></tr>\n"
+              "<tr><td>verses</td><td>%" APR_UINT64_T_FMT "</td></tr>\n"
+              "<tr><td>cache hit ratio</td><td>%.1f%% (%" APR_UINT64_T_FMT " of %" APR_UINT64_T_FMT ")</td></tr>\n"
+              "<tr><td>prefetches used</td><td>%.1f%% (%" APR_UINT64_T_FMT " of %" APR_UINT64_T_FMT ")</td></tr>\n"
+              "</table>\n",
+              ps->size.count ? (double)ps->size.sum / (double)ps->size.count : 0.0,
+              stats_percentile(&ps->size,0.99,1.0),
+              ps->bytesread,
+              ps->chapters,
+              ps->verses,
+              lookups ? (double)ps->cache[0] * 100.0 / (double)lookups : 0.0,
+              ps->cache[0],
+              lookups,
+              ps->prefetch[0] ? (double)ps->prefetch[1] * 100.0 / (double)ps->prefetch[0] : 0.0,
+              ps->prefetch[1],
+              ps->prefetch[0]
+            );
+            
+  if (ps->nhot > 0)
   {
-    if (pbr->v2 == INT_MAX)
-      return apr_pstrcat(p,pbr->name,".",tc1,"-",tc2,NULL);
-    else
-      return apr_pstrcat(p,pbr->name,".",tc1,"-",tc2,":",tv2,NULL);
+    ap_rputs(
+              "\n<h2>Hot pages</h2>\n"
+              "<table>\n"
+              "<tr><th>page</th><th>requests</th><th>over by at most</th></tr>\n",
+              r
+            );
+    for (size_t i = 0 ; (i < ps->nhot) && (i < LB_HOTSHOW) ; i++)
+      ap_rprintf(
+                  r,
+                  "<tr><td>%s</td><td>%u</td><td>%u</td></tr>\n",
+                  ap_escape_html(r->pool,ps->hot[i].key),
+                  ps->hot[i].count,
+                  ps->hot[i].error
+                );
+    ap_rprintf(r,"</table>\n<p>%" APR_UINT64_T_FMT " requests not counted</p>\n",ps->hotskipped);
   }
   
-  return apr_pstrcat(p,pbr->name,".",tc1,":",tv1,"-",tc1,":",tv2,NULL);
+  ap_rputs("\n</body>\n</html>\n",r);
 }
 
-/*********************************************************************/
+/************************************************************************
+*       HOT LIST
+************************************************************************/
 
-static const char *config_litbookdir(cmd_parms *cmd,void *mconfig,char const *arg)
+/*-----------------------------------------------------------------------
+; The most asked for pages, kept by Space-Saving: LB_HOTMAX counters, and
+; a page without one takes over the smallest, starting from its count.
+; So a count is never under the true count, and is over by no more than
+; its error.  The key is the same as for the response cache.
+;
+; All the children update the one table, so it's under a global
+; mutex---but if another process has it, the request just isn't counted.
+;-----------------------------------------------------------------------*/
+
+static apr_uint64_t fnv1a(char const *data,size_t len)
 {
-  struct litconfig   *plc = mconfig;
-  struct apr_finfo_t  dstatus;
-  apr_status_t        rc;
-  char                buffer[MBUFSIZ];
+  apr_uint64_t hash = 0xCBF29CE484222325uLL;
   
-  if ((rc = apr_stat(&dstatus,arg,APR_FINFO_NORM,cmd->pool)) != APR_SUCCESS)
-    return apr_psprintf(cmd->pool,"%s : %s %s",cmd->cmd->name,arg,apr_strerror(rc,buffer,sizeof(buffer)));
-  if (dstatus.filetype != APR_DIR)
-    return apr_psprintf(cmd->pool,"%s : %s is not a directory",cmd->cmd->name,arg);
-  if ((dstatus.protection & APR_FPROT_WREAD) == 0)
-    return apr_psprintf(cmd->pool,"%s : %s cannot read directory",cmd->cmd->name,arg);
-  plc->bookdir = apr_pstrdup(cmd->pool,arg);
+  for (size_t i = 0 ; i < len ; i++)
+  {
+    hash ^= (unsigned char)data[i];
+    hash *= 0x00000100000001B3uLL;
+  }
   
-  return NULL;
+  return hash;
 }
 
-/*******************************************************************/
+/************************************************************************/
 
-static const char *config_litbooktrans(cmd_parms *cmd,void *mconfig,char const *arg)
+static void hot_count(char const *key,apr_uint32_t n)
 {
-  struct litconfig *plc = mconfig;
-  apr_file_t       *fp;
-  char             *buffer;
-  apr_status_t      rc;
-  char              err[MBUFSIZ];
-  size_t            lsize;
-  size_t            i;
+  struct lbhot *hot;
+  apr_uint32_t  hash;
+  size_t        len = strlen(key);
+  size_t        min = 0;
   
-  if ((rc = apr_file_open(&fp,arg,APR_FOPEN_READ,APR_FPROT_OS_DEFAULT,cmd->pool)) != APR_SUCCESS)
-    return apr_psprintf(cmd->pool,"%s : %s %s",cmd->cmd->name,arg,apr_strerror(rc,err,sizeof(err)));
+  if ((m_hotlock == NULL) || (m_stats == NULL) || (len >= LB_HOTKEY))
+    return;
     
-  clt_linecount(fp,&plc->maxbook,&lsize); /* because we can't realloc */
-  buffer         = apr_palloc(cmd->pool,lsize + 1); /* ptrans is static ! */
-  plc->booktrans = apr_pstrdup(cmd->pool,arg);
-  plc->books     = apr_palloc(cmd->pool,plc->maxbook * sizeof(struct bookname));
-  plc->abrev     = apr_palloc(cmd->pool,plc->maxbook * sizeof(struct bookname *));
-  plc->fullname  = apr_palloc(cmd->pool,plc->maxbook * sizeof(struct bookname *));
-  plc->soundex   = apr_palloc(cmd->pool,plc->maxbook * sizeof(struct bookname *));
-  plc->metaphone = apr_palloc(cmd->pool,plc->maxbook * sizeof(struct bookname *));
+  hot  = m_stats->hot;
+  hash = (apr_uint32_t)fnv1a(key,len);
   
-  for (i = 0 ; (i < plc->maxbook) && (apr_file_gets(buffer,lsize+1,fp) == APR_SUCCESS) ; i++)
+  if (apr_global_mutex_trylock(m_hotlock) != APR_SUCCESS)
   {
-    char *abrev;
-    char *fulln;
-    char  mp[MBUFSIZ];
-    int   rc;
-    
-    if (empty_string(buffer))
+    apr_atomic_inc64(&m_stats->hotskipped);
+    return;
+  }
+  
+  for (size_t i = 0 ; i < m_stats->nhot ; i++)
+  {
+    if ((hot[i].hash == hash) && (strcmp(hot[i].key,key) == 0))
     {
-      plc->maxbook--;
-      break;
+      hot[i].count += n;
+      apr_global_mutex_unlock(m_hotlock);
+      return;
     }
-    abrev = strtok(buffer,",");
-    fulln = strtok(NULL,",\n");
-    
-    if ((abrev == NULL) || (fulln == NULL)) break;
-    
-    abrev = apr_pstrdup(cmd->pool,trim_space(abrev));
-    fulln = apr_pstrdup(cmd->pool,trim_space(fulln));
-    rc    = make_metaphone(fulln,mp,sizeof(mp));
-    
-    plc->books[i].abrev    = abrev;
-    plc->books[i].fullname = fulln;
-    plc->books[i].sdx      = isdigit(*fulln) ? Soundex(fulln+1) : Soundex(fulln);
-    plc->books[i].mp       = apr_pstrdup(cmd->pool,mp);
-    plc->abrev[i]          = plc->fullname [i] = plc->soundex[i] = plc->metaphone[i] = &plc->books [i];
+    if (hot[i].count < hot[min].count)
+      min = i;
   }
   
-  apr_file_close(fp);
-  
-  if (i != plc->maxbook)
+  if (m_stats->nhot < LB_HOTMAX)
   {
-    snprintf(err,sizeof(err),"%zu",i);
-    return apr_pstrcat(cmd->pool,cmd->cmd->name," : translation file ",arg," is corrupted on or around line ",err,NULL);
+    min            = m_stats->nhot++;
+    hot[min].count = 0;
   }
   
-  qsort(plc->abrev,    plc->maxbook,sizeof(struct bookname *),clt_sort_abrev);
-  qsort(plc->fullname, plc->maxbook,sizeof(struct bookname *),clt_sort_fullname);
-  qsort(plc->soundex,  plc->maxbook,sizeof(struct bookname *),clt_sort_soundex);
-  qsort(plc->metaphone,plc->maxbook,sizeof(struct bookname *),clt_sort_metaphone);
-  
-  return NULL;
+  hot[min].hash   = hash;
+  hot[min].error  = hot[min].count;
+  hot[min].count += n;
+  memcpy(hot[min].key,key,len + 1);
+  apr_global_mutex_unlock(m_hotlock);
 }
 
-/********************************************************************/
+/************************************************************************/
 
-static const char *config_litbookindex(cmd_parms *cmd,void *mconfig,char const *arg)
+static int hot_cmp(void const *o1,void const *o2)
 {
-  ((struct litconfig *)mconfig)->bookindex = apr_pstrdup(cmd->pool,arg);
-  return NULL;
+  struct lbhot const *h1 = o1;
+  struct lbhot const *h2 = o2;
+  
+  return h1->count < h2->count ?  1
+       : h1->count > h2->count ? -1
+       : 0;
 }
 
-/*******************************************************************/
+/*******************************************************************
+;
+; A copy of the list, most asked for first.  Returns how many there are.
+;
+********************************************************************/
 
-static const char *config_litbooktitle(cmd_parms *cmd,void *mconfig,char const *arg)
+static size_t hot_snapshot(struct lbhot *list)
 {
-  ((struct litconfig *)mconfig)->booktitle = apr_pstrdup(cmd->pool,arg);
+  size_t n;
+  
+  apr_global_mutex_lock(m_hotlock);
+  n = m_stats->nhot;
+  memcpy(list,m_stats->hot,n * sizeof(struct lbhot));
+  apr_global_mutex_unlock(m_hotlock);
+  
+  qsort(list,n,sizeof(struct lbhot),hot_cmp);
+  return n;
+}
+
+/*******************************************************************
+;
+; Write out the list, a count and a key per line, for init_hot() to
+; read on the next start.  It's written to the side and renamed, so a
+; crash doesn't leave half a list.
+;
+********************************************************************/
+
+static void hot_save(apr_pool_t *pool,server_rec *s)
+{
+  struct lbhot *list = apr_palloc(pool,LB_HOTMAX * sizeof(struct lbhot));
+  char const   *tmp  = apr_pstrcat(pool,m_hotfile,".tmp",NULL);
+  size_t        n    = hot_snapshot(list);
+  apr_file_t   *fp;
+  apr_status_t  rc;
+  
+  rc = apr_file_open(
+                      &fp,
+                      tmp,
+                      APR_FOPEN_WRITE | APR_FOPEN_CREATE | APR_FOPEN_TRUNCATE | APR_FOPEN_BUFFERED,
+                      APR_OS_DEFAULT,
+                      pool
+                    );
+                    
+  if (rc == APR_SUCCESS)
+  {
+    for (size_t i = 0 ; i < n ; i++)
+      apr_file_printf(fp,"%u %s\n",list[i].count,list[i].key);
+    rc = apr_file_close(fp);
+  }
+  
+  if (rc == APR_SUCCESS)
+    rc = apr_file_rename(tmp,m_hotfile,pool);
+  if (rc != APR_SUCCESS)
+    ap_log_error(APLOG_MARK,APLOG_WARNING,rc,s,"mod_litbook: can't save %s",m_hotfile);
+}
+
+/*******************************************************************
+;
+; Halve every count, so a page has to keep being asked for to stay on
+; the list.
+;
+********************************************************************/
+
+static void hot_age(void)
+{
+  apr_global_mutex_lock(m_hotlock);
+  for (size_t i = 0 ; i < m_stats->nhot ; i++)
+  {
+    m_stats->hot[i].count /= 2;
+    m_stats->hot[i].error /= 2;
+  }
+  apr_global_mutex_unlock(m_hotlock);
+}
+
+/*******************************************************************
+;
+; Each server process runs one of these, so the list is saved (and
+; aged) off to the side of any request.  Whichever process gets there
+; first when it's time does the saving.
+;
+********************************************************************/
+
+static void *APR_THREAD_FUNC hot_saver(apr_thread_t *thread,void *data)
+{
+  server_rec *s = data;
+  apr_pool_t *pool;
+  
+  apr_pool_create(&pool,apr_thread_pool_get(thread));
+  
+  while(apr_atomic_read32(&m_hotstop) == 0)
+  {
+    apr_uint32_t now  = (apr_uint32_t)apr_time_sec(apr_time_now());
+    apr_uint32_t last = apr_atomic_read32(&m_stats->hotsaved);
+    
+    if ((now - last >= m_hotsave) && (apr_atomic_cas32(&m_stats->hotsaved,now,last) == last))
+    {
+      hot_save(pool,s);
+      hot_age();
+      apr_pool_clear(pool);
+    }
+    
+    apr_sleep(apr_time_from_sec(1));
+  }
+  
+  apr_thread_exit(thread,APR_SUCCESS);
+  return NULL;
+}
+
+/*********************************************************************/
+
+static apr_status_t hot_stop(void *data)
+{
+  apr_status_t rc;
+  
+  apr_atomic_set32(&m_hotstop,1);
+  apr_thread_join(&rc,data);
+  return APR_SUCCESS;
+}
+
+/************************************************************************
+*       PREFETCH
+************************************************************************/
+
+/*-----------------------------------------------------------------------
+; People read on: after a request that runs to the end of a chapter, the
+; next one is usually for the chapter after it (or the first chapter of
+; the next book).  With LitbookPrefetch on, the kernel is asked to start
+; reading that in.  To see if it pays, what was prefetched goes into a
+; table in the shared memory, a slot per hash with the newest winning,
+; and a request for one of them counts it as used.
+;-----------------------------------------------------------------------*/
+
+static apr_uint32_t prefetch_hash(char const *bookdir,char const *name,size_t chapter)
+{
+  char buffer[MBUFSIZ];
+  
+  snprintf(buffer,sizeof(buffer),"%s/%s/%lu",bookdir,name,(unsigned long)chapter);
+  return (apr_uint32_t)fnv1a(buffer,strlen(buffer)) | 1; /* 0 is an empty slot */
+}
+
+/************************************************************************/
+
+static void prefetch_used(struct litconfig const *plc,struct lbrequest const *pbr)
+{
+  apr_uint32_t hash;
+  
+  if (m_stats == NULL)
+    return;
+    
+  hash = prefetch_hash(plc->bookdir,pbr->name,pbr->c1);
+  if (apr_atomic_cas32(&m_stats->prefetched[hash % LB_PFSLOTS],0,hash) == hash)
+    apr_atomic_inc64(&m_stats->prefetch[1]);
+}
+
+/************************************************************************/
+
+static void prefetch_next(struct litconfig const *plc,struct lbrequest const *pbr)
+{
+  char const   *name    = pbr->name;
+  size_t        chapter = pbr->c2 + 1;
+  apr_uint32_t  hash;
+  
+  if ((pbr->v2 != LB_END) || (plc->vmap != NULL)) /* too hard to guess */
+    return;
+    
+  if ((pbr->c2 == LB_END) || (lb_chapter_prefetch(plc->bookdir,name,chapter) != 0))
+  {
+    if (pbr->book + 1 >= plc->trans->maxbook)
+      return;
+    name    = plc->trans->books[pbr->book + 1].fullname;
+    chapter = 1;
+    if (lb_chapter_prefetch(plc->bookdir,name,chapter) != 0)
+      return;
+  }
+  
+  if (m_stats == NULL)
+    return;
+    
+  hash = prefetch_hash(plc->bookdir,name,chapter);
+  apr_atomic_set32(&m_stats->prefetched[hash % LB_PFSLOTS],hash);
+  apr_atomic_inc64(&m_stats->prefetch[0]);
+}
+
+/************************************************************************
+*       RESPONSE CACHE
+************************************************************************/
+
+/*-----------------------------------------------------------------------
+; Is uri under the <Location> tld?  If so, *plen is how much of uri the
+; <Location> takes up.
+;-----------------------------------------------------------------------*/
+
+static bool tld_under(char const *uri,char const *tld,size_t *plen)
+{
+  size_t len = strlen(tld);
+  
+  if ((len > 0) && (tld[len - 1] == '/'))
+    len--;
+    
+  if (strncmp(uri,tld,len) != 0)
+    return false;
+  if ((uri[len] != '/') && (uri[len] != '\0'))
+    return false;
+    
+  if (plen != NULL)
+    *plen = len;
+  return true;
+}
+
+/*-----------------------------------------------------------------------
+; Only the canonical URL of a passage gets a page---every other spelling
+; is redirected to it---so the canonical URL is the key, and all the
+; spellings of a reference end up at the one entry.  An entry is the
+; ETag, a NUL, then the page.
+;-----------------------------------------------------------------------*/
+
+static char *cache_key(
+                        apr_pool_t *pool,
+                        server_rec *s,
+                        char const *tld,
+                        char const *path
+                      )
+{
+  size_t len = strlen(tld);
+  
+  if ((len > 0) && (tld[len - 1] == '/'))
+    len--;
+    
+  return apr_psprintf(pool,"%s:%u%.*s%s",s->server_hostname,s->port,(int)len,tld,path);
+}
+
+/************************************************************************/
+
+static char *page_key(request_rec *r,struct litconfig const *plc,struct lbrequest const *pbr)
+{
+  char ref[MBUFSIZ];
+  
+  lb_redirect_request(ref,sizeof(ref),pbr);
+  return cache_key(r->pool,r->server,plc->booktld,apr_pstrcat(r->pool,"/",ref,NULL));
+}
+
+/************************************************************************/
+
+static char *cache_etag(apr_pool_t *pool,char const *body,size_t len)
+{
+  return apr_psprintf(pool,"\"%016" APR_UINT64_T_HEX_FMT "\"",fnv1a(body,len));
+}
+
+/************************************************************************
+;
+; A cached entry is the response headers, one "Name: value\n" to a line
+; and Content-Type first, then a NUL, then the body.  Headers that
+; belong to one response (or that Apache sets itself) aren't kept.
+;
+*************************************************************************/
+
+static char const *const c_nocache[] =
+{
+  "Connection",
+  "Content-Length",
+  "Content-Type",
+  "Date",
+  "ETag",
+  "Keep-Alive",
+  "Server",
+  "Server-Timing",
+  "Set-Cookie",
+  "Transfer-Encoding",
+};
+
+static char *cache_head(
+                         apr_pool_t        *pool,
+                         char const        *type,
+                         char const        *etag,
+                         apr_table_t const *headers
+                       )
+{
+  char *head = apr_pstrcat(pool,"Content-Type: ",type,"\nETag: ",etag,"\n",NULL);
+  
+  if (headers != NULL)
+  {
+    apr_array_header_t const *elts = apr_table_elts(headers);
+    apr_table_entry_t  const *pe   = (apr_table_entry_t const *)elts->elts;
+    
+    for (int i = 0 ; i < elts->nelts ; i++)
+    {
+      bool keep = (pe[i].key != NULL) && (pe[i].val != NULL) && (strchr(pe[i].val,'\n') == NULL);
+      
+      for (size_t n = 0 ; keep && (n < sizeof(c_nocache) / sizeof(c_nocache[0])) ; n++)
+        keep = strcasecmp(pe[i].key,c_nocache[n]) != 0;
+        
+      if (keep)
+        head = apr_pstrcat(pool,head,pe[i].key,": ",pe[i].val,"\n",NULL);
+    }
+  }
+  
+  return head;
+}
+
+/************************************************************************/
+
+static bool cache_get(request_rec *r,char const *key,unsigned char *buf,unsigned int *plen)
+{
+  apr_status_t rc;
+  
+  if (m_cachelock != NULL)
+    apr_global_mutex_lock(m_cachelock);
+  rc = (*m_cache->retrieve)(m_cacheinst,r->server,(unsigned char const *)key,strlen(key),buf,plen,r->pool);
+  if (m_cachelock != NULL)
+    apr_global_mutex_unlock(m_cachelock);
+  return rc == APR_SUCCESS;
+}
+
+/************************************************************************/
+
+static void cache_put(
+                       server_rec *s,
+                       apr_pool_t *pool,
+                       char const *key,
+                       char const *head,
+                       char const *body,
+                       size_t      len
+                     )
+{
+  size_t         elen = strlen(head) + 1;
+  unsigned char *data;
+  apr_status_t   rc;
+  
+  if (elen + len > LB_CACHEMAX)
+    return;
+    
+  data = apr_palloc(pool,elen + len);
+  memcpy(data,head,elen);
+  memcpy(&data[elen],body,len);
+  
+  if (m_cachelock != NULL)
+    apr_global_mutex_lock(m_cachelock);
+  rc = (*m_cache->store)(
+                          m_cacheinst,
+                          s,
+                          (unsigned char const *)key,
+                          strlen(key),
+                          apr_time_now() + m_cachetime,
+                          data,
+                          elen + len,
+                          pool
+                        );
+  if (m_cachelock != NULL)
+    apr_global_mutex_unlock(m_cachelock);
+    
+  if (rc != APR_SUCCESS)
+  {
+    ap_log_error(APLOG_MARK,APLOG_DEBUG,rc,s,"mod_litbook: %s not cached",key);
+    return;
+  }
+  
+  /*-------------------------------------------------------------------
+  ; handle_cached() only needs a buffer as big as the biggest entry.
+  ;--------------------------------------------------------------------*/
+  
+  if (m_stats != NULL)
+  {
+    apr_uint32_t max = apr_atomic_read32(&m_stats->cachemax);
+    
+    while ((max < elen + len) && (apr_atomic_cas32(&m_stats->cachemax,elen + len,max) != max))
+      max = apr_atomic_read32(&m_stats->cachemax);
+  }
+}
+
+/*******************************************************************
+;
+; Called by handle_request() with the page built up in a brigade.  It
+; goes into the cache, along with the headers set so far, and gets an
+; ETag.  Returns what ap_meets_conditions() does---if it isn't OK, the
+; page isn't sent.
+;
+********************************************************************/
+
+static int cache_page(request_rec *r,char const *key,apr_bucket_brigade *bb)
+{
+  char       *body;
+  char       *etag;
+  apr_size_t  len;
+  
+  if (apr_brigade_pflatten(bb,&body,&len,r->pool) != APR_SUCCESS)
+    return OK;
+    
+  etag = cache_etag(r->pool,body,len);
+  cache_put(r->server,r->pool,key,cache_head(r->pool,r->content_type,etag,r->headers_out),body,len);
+  
+  if (m_stats != NULL)
+    apr_atomic_inc64(&m_stats->cache[1]);
+    
+  apr_table_setn(r->notes,"litbook-cache","miss");
+  apr_table_setn(r->headers_out,"ETag",etag);
+  return ap_meets_conditions(r);
+}
+
+/*********************************************************************
+;
+; The quick handler.  A cached page goes out before Apache does anything
+; else with the request, and that includes access control---don't use
+; LitbookCache for passages that need it.
+;
+; It runs for every request to the server, so anything that isn't under
+; a <Location> handle_request() serves is turned away before going near
+; the cache (and its lock).
+;
+**********************************************************************/
+
+static int handle_cached(request_rec *r,int lookup)
+{
+  unsigned char *buf;
+  unsigned char *body;
+  char          *key;
+  char          *line;
+  unsigned int   len;
+  bool           ours = false;
+  int            rc;
+  
+  if ((m_cache == NULL) || lookup || (r->method_number != M_GET) || (r->args != NULL))
+    return DECLINED;
+    
+  for (int i = 0 ; !ours && (i < m_cachetlds->nelts) ; i++)
+    ours = tld_under(r->uri,APR_ARRAY_IDX(m_cachetlds,i,char const *),NULL);
+    
+  if (!ours)
+    return DECLINED;
+    
+  len = (m_stats != NULL) ? apr_atomic_read32(&m_stats->cachemax) : LB_CACHEMAX;
+  if (len == 0)
+    return DECLINED;
+    
+  buf = apr_palloc(r->pool,len);
+  key = cache_key(r->pool,r->server,"",r->uri);
+  
+  if (!cache_get(r,key,buf,&len))
+    return DECLINED;
+  if ((body = memchr(buf,'\0',len)) == NULL)
+    return DECLINED;
+  body++;
+  
+  if (m_stats != NULL)
+    apr_atomic_inc64(&m_stats->cache[0]);
+    
+  apr_table_setn(r->notes,"litbook-cache","hit");
+  r->content_type = "text/html";
+  
+  for (line = (char *)buf ; *line != '\0' ; )
+  {
+    char *eol = strchr(line,'\n');
+    char *val;
+    
+    if (eol == NULL)
+      break;
+    *eol = '\0';
+    
+    if ((val = strstr(line,": ")) != NULL)
+    {
+      *val = '\0';
+      val += 2;
+      if (strcasecmp(line,"Content-Type") == 0)
+        r->content_type = val;
+      else
+        apr_table_addn(r->headers_out,line,val);
+    }
+    line = eol + 1;
+  }
+  
+  hot_count(key,1);
+  
+  if ((rc = ap_meets_conditions(r)) != OK)
+    return rc;
+    
+  ap_set_content_length(r,len - (body - buf));
+  if (!r->header_only)
+    ap_rwrite(body,len - (body - buf),r);
+    
+  stats_request(OUT_200,NULL,NULL,NULL);
+  return OK;
+}
+
+/*********************************************************************/
+
+static apr_status_t index_cleanup(void *data)
+{
+  lb_index_close(data);
+  return APR_SUCCESS;
+}
+
+/*********************************************************************/
+
+static char const *check_dir(cmd_parms *cmd,char const *arg)
+{
+  struct apr_finfo_t dstatus;
+  apr_status_t       rc;
+  char               buffer[MBUFSIZ];
+  
+  if ((rc = apr_stat(&dstatus,arg,APR_FINFO_NORM,cmd->pool)) != APR_SUCCESS)
+    return apr_psprintf(cmd->pool,"%s : %s %s",cmd->cmd->name,arg,apr_strerror(rc,buffer,sizeof(buffer)));
+  if (dstatus.filetype != APR_DIR)
+    return apr_psprintf(cmd->pool,"%s : %s is not a directory",cmd->cmd->name,arg);
+  if ((dstatus.protection & APR_FPROT_WREAD) == 0)
+    return apr_psprintf(cmd->pool,"%s : %s cannot read directory",cmd->cmd->name,arg);
+  return NULL;
+}
+
+/*********************************************************************/
+
+static apr_status_t trans_cleanup(void *data)
+{
+  apr_pool_destroy(data);
+  return APR_SUCCESS;
+}
+
+/*********************************************************************
+;
+; The tables are kept in a registry (path to struct litreg) hung off
+; the process pool, which outlasts the configuration---and the module,
+; which Apache unloads and loads again each time it reads the
+; configuration, so a static variable won't do.  Apache reads the
+; configuration twice on startup, and again on each restart; after the
+; first time, the table comes straight from the registry unless the
+; file changed.  They're loaded before the children fork, so the
+; children share them.
+;
+; Nothing in the process pool may point back into the module, since it
+; may not be loaded when the pool goes.  So no cleanup there; the
+; tables are freed with their pools.
+;
+**********************************************************************/
+
+static char const *load_trans(cmd_parms *cmd,char const *arg,struct lbtrans **pptrans)
+{
+  apr_pool_t         *pool = cmd->server->process->pool;
+  apr_hash_t         *registry;
+  struct apr_finfo_t  status;
+  struct litreg      *reg;
+  struct lballoc      alloc;
+  apr_pool_t         *sub;
+  void               *data;
+  apr_status_t        ars;
+  char                err[MBUFSIZ];
+  size_t              line;
+  int                 rc;
+  
+  if ((ars = apr_stat(&status,arg,APR_FINFO_MTIME | APR_FINFO_SIZE,cmd->pool)) != APR_SUCCESS)
+    return apr_psprintf(cmd->pool,"%s : %s %s",cmd->cmd->name,arg,apr_strerror(ars,err,sizeof(err)));
+    
+  apr_pool_userdata_get(&data,LB_TRANSREG,pool);
+  if ((registry = data) == NULL)
+  {
+    registry = apr_hash_make(pool);
+    apr_pool_userdata_set(registry,LB_TRANSREG,apr_pool_cleanup_null,pool);
+  }
+  
+  reg = apr_hash_get(registry,arg,APR_HASH_KEY_STRING);
+  
+  if ((reg != NULL) && (reg->mtime == status.mtime) && (reg->size == status.size))
+  {
+    *pptrans = &reg->trans;
+    return NULL;
+  }
+  
+  /*-------------------------------------------------------------------
+  ; The file changed.  Something in this configuration may already be
+  ; using the old table, so it goes when the configuration does.
+  ;--------------------------------------------------------------------*/
+  
+  if (reg != NULL)
+  {
+    apr_hash_set(registry,arg,APR_HASH_KEY_STRING,NULL);
+    apr_pool_cleanup_register(cmd->pool,reg->pool,trans_cleanup,apr_pool_cleanup_null);
+  }
+  
+  if ((ars = apr_pool_create(&sub,pool)) != APR_SUCCESS)
+    return apr_psprintf(cmd->pool,"%s : %s %s",cmd->cmd->name,arg,apr_strerror(ars,err,sizeof(err)));
+    
+  alloc.alloc = lbapr_alloc;
+  alloc.free  = NULL;
+  alloc.ud    = sub;
+  reg         = apr_palloc(sub,sizeof(struct litreg));
+  rc          = lb_trans_load(&reg->trans,arg,&alloc,&line);
+  
+  if (rc != 0)
+    apr_pool_destroy(sub);
+    
+  if (rc == EINVAL)
+  {
+    snprintf(err,sizeof(err),"%zu",line);
+    return apr_pstrcat(cmd->pool,cmd->cmd->name," : translation file ",arg," is corrupted on or around line ",err,NULL);
+  }
+  
+  if (rc != 0)
+    return apr_psprintf(cmd->pool,"%s : %s %s",cmd->cmd->name,arg,apr_strerror(rc,err,sizeof(err)));
+    
+  reg->pool  = sub;
+  reg->mtime = status.mtime;
+  reg->size  = status.size;
+  apr_hash_set(registry,apr_pstrdup(sub,arg),APR_HASH_KEY_STRING,reg);
+  *pptrans   = &reg->trans;
+  return NULL;
+}
+
+/*********************************************************************/
+
+static const char *config_litbookdir(cmd_parms *cmd,void *mconfig,char const *arg)
+{
+  struct litconfig *plc = mconfig;
+  struct lbindex   *ix;
+  char const       *fname;
+  char const       *msg;
+  char              buffer[MBUFSIZ];
+  int               err;
+  
+  if ((msg = check_dir(cmd,arg)) != NULL)
+    return msg;
+  plc->bookdir = apr_pstrdup(cmd->pool,arg);
+  
+  /*-------------------------------------------------------------------
+  ; The search index is optional---without it there's just no searching.
+  ; But one that's there and can't be used is an error.
+  ;-------------------------------------------------------------------*/
+  
+  ix    = apr_palloc(cmd->pool,sizeof(struct lbindex));
+  fname = apr_pstrcat(cmd->pool,arg,"/",LB_INDEX_NAME,NULL);
+  err   = lb_index_open(ix,fname);
+  
+  if (err == ENOENT)
+    plc->index = NULL;
+  else if (err != 0)
+    return apr_psprintf(cmd->pool,"%s : %s %s",cmd->cmd->name,fname,apr_strerror(err,buffer,sizeof(buffer)));
+  else
+  {
+    plc->index = ix;
+    apr_pool_cleanup_register(cmd->pool,ix,index_cleanup,apr_pool_cleanup_null);
+  }
+  
+  return NULL;
+}
+
+/*******************************************************************/
+
+static const char *config_litbooktrans(cmd_parms *cmd,void *mconfig,char const *arg)
+{
+  struct litconfig *plc = mconfig;
+  char const       *msg;
+  
+  if ((msg = load_trans(cmd,arg,&plc->trans)) != NULL)
+    return msg;
+  plc->booktrans = apr_pstrdup(cmd->pool,arg);
   return NULL;
 }
 
-/*****************************************************************
-*       HANDLER HOOK
-******************************************************************/
+/*******************************************************************
+;
+; LitbookParallel label dir translation, once for each translation that
+; can be shown side by side.  The first one given is the default for
+; reading references.
+;
+********************************************************************/
+
+static const char *config_litbookpar(
+                                      cmd_parms  *cmd,
+                                      void       *mconfig,
+                                      char const *label,
+                                      char const *dir,
+                                      char const *trans
+                                    )
+{
+  struct litconfig *plc = mconfig;
+  struct litpar    *par;
+  char const       *msg;
+  
+  if ((msg = check_dir(cmd,dir)) != NULL)
+    return msg;
+    
+  if (plc->parallel == NULL)
+    plc->parallel = apr_array_make(cmd->pool,LB_PARMAX,sizeof(struct litpar));
+  else if (plc->parallel->nelts == LB_PARMAX)
+    return apr_psprintf(cmd->pool,"%s : no more than %d translations",cmd->cmd->name,LB_PARMAX);
+    
+  for (int i = 0 ; i < plc->parallel->nelts ; i++)
+    if (strcmp(APR_ARRAY_IDX(plc->parallel,i,struct litpar).label,label) == 0)
+      return apr_psprintf(cmd->pool,"%s : %s given twice",cmd->cmd->name,label);
+      
+  par          = apr_array_push(plc->parallel);
+  par->label   = apr_pstrdup(cmd->pool,label);
+  par->bookdir = apr_pstrdup(cmd->pool,dir);
+  par->vmap    = NULL;
+  return load_trans(cmd,trans,&par->trans);
+}
+
+/*******************************************************************
+;
+; LitbookVersification [label] file.  Without a label, it's for the
+; translation given by LitbookTranslation; with one, for that
+; LitbookParallel translation.  Either has to come first.
+;
+********************************************************************/
+
+static const char *config_litbookvmap(
+                                       cmd_parms  *cmd,
+                                       void       *mconfig,
+                                       char const *arg1,
+                                       char const *arg2
+                                     )
+{
+  struct litconfig  *plc   = mconfig;
+  struct lballoc     alloc = { .alloc = lbapr_alloc , .free = NULL , .ud = cmd->pool };
+  struct lbtrans    *trans = plc->trans;
+  struct lbvmap    **pmap  = &plc->vmap;
+  char const        *fname = arg1;
+  char               err[MBUFSIZ];
+  size_t             line;
+  int                rc;
+  
+  if (arg2 != NULL)
+  {
+    struct litpar *par = NULL;
+    
+    for (int i = 0 ; (plc->parallel != NULL) && (i < plc->parallel->nelts) ; i++)
+      if (strcmp(APR_ARRAY_IDX(plc->parallel,i,struct litpar).label,arg1) == 0)
+        par = &APR_ARRAY_IDX(plc->parallel,i,struct litpar);
+        
+    if (par == NULL)
+      return apr_psprintf(cmd->pool,"%s : %s needs a LitbookParallel first",cmd->cmd->name,arg1);
+      
+    trans = par->trans;
+    pmap  = &par->vmap;
+    fname = arg2;
+  }
+  else if (trans == NULL)
+    return apr_psprintf(cmd->pool,"%s : needs a LitbookTranslation first",cmd->cmd->name);
+    
+  *pmap = apr_palloc(cmd->pool,sizeof(struct lbvmap));
+  rc    = lb_vmap_load(*pmap,trans,fname,&alloc,&line);
+  
+  if (rc == EINVAL)
+    return apr_psprintf(cmd->pool,"%s : %s is corrupted on or around line %" APR_SIZE_T_FMT,cmd->cmd->name,fname,line);
+  if (rc != 0)
+    return apr_psprintf(cmd->pool,"%s : %s %s",cmd->cmd->name,fname,apr_strerror(rc,err,sizeof(err)));
+  return NULL;
+}
+
+/********************************************************************/
+
+static const char *config_litbookindex(cmd_parms *cmd,void *mconfig,char const *arg)
+{
+  ((struct litconfig *)mconfig)->bookindex = apr_pstrdup(cmd->pool,arg);
+  return NULL;
+}
+
+/*******************************************************************/
+
+static const char *config_litbooktitle(cmd_parms *cmd,void *mconfig,char const *arg)
+{
+  ((struct litconfig *)mconfig)->booktitle = apr_pstrdup(cmd->pool,arg);
+  return NULL;
+}
+
+/*******************************************************************/
+
+static const char *config_litbooktiming(cmd_parms *cmd,void *mconfig,char const *arg)
+{
+  struct litconfig *plc = mconfig;
+  
+  /*-------------------------------------------------------------------
+  ; On, Off, or the name of a request header that has to be present,
+  ; presumably one a trusted proxy adds or strips.
+  ;-------------------------------------------------------------------*/
+  
+  if (strcasecmp(arg,"on") == 0)
+    plc->timing = TIMING_ON;
+  else if (strcasecmp(arg,"off") == 0)
+    plc->timing = TIMING_OFF;
+  else
+  {
+    plc->timing    = TIMING_HEADER;
+    plc->timinghdr = apr_pstrdup(cmd->pool,arg);
+  }
+  return NULL;
+}
+
+/*******************************************************************/
+
+static const char *config_litbookscan(cmd_parms *cmd,void *mconfig,char const *arg)
+{
+  struct litconfig *plc = mconfig;
+  char             *end;
+  long              threads;
+  
+  threads = strtol(arg,&end,10);
+  if ((end == arg) || (*end != '\0') || (threads < 0) || (threads > LB_SCANTHREADS))
+    return apr_psprintf(cmd->pool,"%s : %s should be 0 to %d",cmd->cmd->name,arg,LB_SCANTHREADS);
+  plc->scanthreads = threads;
+  return NULL;
+}
+
+/*******************************************************************/
+
+static const char *config_litbookprefetch(cmd_parms *cmd,void *mconfig,int flag)
+{
+  struct litconfig *plc = mconfig;
+  
+  (void)cmd;
+  plc->prefetch = flag;
+  return NULL;
+}
+
+/*******************************************************************/
+
+static const char *config_litbooklib(cmd_parms *cmd,void *mconfig,char const *arg)
+{
+  struct litconfig *plc = mconfig;
+  struct litlib    *lib;
+  char const       *msg;
+  char              err[MBUFSIZ];
+  apr_status_t      rc;
+  
+  if ((msg = check_dir(cmd,arg)) != NULL)
+    return msg;
+    
+  lib       = apr_palloc(cmd->pool,sizeof(struct litlib));
+  lib->root = apr_pstrdup(cmd->pool,arg);
+  lib->max  = LB_LIBDEF;
+  lib->head = NULL;
+  lib->tail = NULL;
+  lib->n    = 0;
+  
+  if ((rc = apr_pool_create(&lib->pool,cmd->pool)) != APR_SUCCESS)
+    return apr_psprintf(cmd->pool,"%s : %s",cmd->cmd->name,apr_strerror(rc,err,sizeof(err)));
+  if ((rc = apr_thread_mutex_create(&lib->lock,APR_THREAD_MUTEX_DEFAULT,cmd->pool)) != APR_SUCCESS)
+    return apr_psprintf(cmd->pool,"%s : %s",cmd->cmd->name,apr_strerror(rc,err,sizeof(err)));
+    
+  lib->works   = apr_hash_make(lib->pool);
+  plc->library = lib;
+  return NULL;
+}
+
+/*******************************************************************
+;
+; LitbookCache type[:args] [seconds].  The type is any socache provider
+; (shmcb, memcache, ...) and the arguments are its own.  There's one
+; cache for the whole server.
+;
+********************************************************************/
+
+static const char *config_litbookcache(
+                                        cmd_parms  *cmd,
+                                        void       *mconfig,
+                                        char const *arg1,
+                                        char const *arg2
+                                      )
+{
+  char const *name = arg1;
+  char const *args = NULL;
+  char const *sep;
+  char const *msg;
+  
+  (void)mconfig;
+  
+  if ((msg = ap_check_cmd_context(cmd,GLOBAL_ONLY)) != NULL)
+    return msg;
+    
+  if ((sep = strchr(arg1,':')) != NULL)
+  {
+    name = apr_pstrndup(cmd->pool,arg1,sep - arg1);
+    args = sep + 1;
+  }
+  
+  if (arg2 != NULL)
+  {
+    char *end;
+    long  secs = strtol(arg2,&end,10);
+    
+    if ((end == arg2) || (*end != '\0') || (secs <= 0))
+      return apr_psprintf(cmd->pool,"%s : %s should be a number of seconds",cmd->cmd->name,arg2);
+    m_cachetime = apr_time_from_sec(secs);
+  }
+  
+  m_cache = ap_lookup_provider(AP_SOCACHE_PROVIDER_GROUP,name,AP_SOCACHE_PROVIDER_VERSION);
+  if (m_cache == NULL)
+    return apr_psprintf(cmd->pool,"%s : unknown type %s (is mod_socache_%s loaded?)",cmd->cmd->name,name,name);
+    
+  if ((msg = (*m_cache->create)(&m_cacheinst,args,cmd->temp_pool,cmd->pool)) != NULL)
+  {
+    m_cache = NULL;
+    return apr_psprintf(cmd->pool,"%s : %s",cmd->cmd->name,msg);
+  }
+  return NULL;
+}
+
+/*******************************************************************
+;
+; LitbookHotList file [seconds].  Track the most asked for pages, save
+; the list every so often, and render them on startup.
+;
+********************************************************************/
+
+static const char *config_litbookhot(
+                                      cmd_parms  *cmd,
+                                      void       *mconfig,
+                                      char const *arg1,
+                                      char const *arg2
+                                    )
+{
+  char const *msg;
+  
+  (void)mconfig;
+  
+  if ((msg = ap_check_cmd_context(cmd,GLOBAL_ONLY)) != NULL)
+    return msg;
+    
+  if (arg2 != NULL)
+  {
+    char *end;
+    long  secs = strtol(arg2,&end,10);
+    
+    if ((end == arg2) || (*end != '\0') || (secs <= 0))
+      return apr_psprintf(cmd->pool,"%s : %s should be a number of seconds",cmd->cmd->name,arg2);
+    m_hotsave = secs;
+  }
+  
+  m_hotfile = ap_server_root_relative(cmd->pool,arg1);
+  if (m_hotfile == NULL)
+    return apr_psprintf(cmd->pool,"%s : bad path %s",cmd->cmd->name,arg1);
+  return NULL;
+}
+
+/*******************************************************************/
+
+static const char *config_litbooklibcache(cmd_parms *cmd,void *mconfig,char const *arg)
+{
+  struct litconfig *plc = mconfig;
+  char             *end;
+  long              max;
+  
+  if (plc->library == NULL)
+    return apr_psprintf(cmd->pool,"%s : needs a LitbookLibrary first",cmd->cmd->name);
+    
+  max = strtol(arg,&end,10);
+  if ((end == arg) || (*end != '\0') || (max < 1))
+    return apr_psprintf(cmd->pool,"%s : %s should be 1 or more",cmd->cmd->name,arg);
+  plc->library->max = max;
+  return NULL;
+}
+
+/*****************************************************************
+*       SERVER TIMING
+******************************************************************/
+
+static bool timing_wanted(request_rec *r,struct litconfig const *plc)
+{
+  switch(plc->timing)
+  {
+    case TIMING_ON:     return true;
+    case TIMING_HEADER: return apr_table_get(r->headers_in,plc->timinghdr) != NULL;
+    default:            return false;
+  }
+}
+
+/*****************************************************************/
+
+static void timing_header(
+                           request_rec            *r,
+                           struct lbrequest const *pbr,
+                           struct lbctx     const *ctx,
+                           struct lbtiming  const *ptm
+                         )
+{
+  char const *hdr;
+  
+  /*-------------------------------------------------------------------
+  ; Durations are in milliseconds per the spec.  This goes into
+  ; err_headers_out so it survives the redirect and not found responses.
+  ;-------------------------------------------------------------------*/
+  
+  hdr = apr_psprintf(
+                      r->pool,
+                      "parse;dur=%.3f, lookup;dur=%.3f, tier;desc=\"%s\"",
+                      ptm->ns[ST_PARSE]  / 1e6,
+                      ptm->ns[ST_LOOKUP] / 1e6,
+                      lb_tier_name(pbr->tier)
+                    );
+                    
+  if (ctx != NULL)
+    hdr = apr_psprintf(
+                        r->pool,
+                        "%s, io;dur=%.3f, render;dur=%.3f, chapters;desc=\"%" APR_SIZE_T_FMT "\", verses;desc=\"%" APR_SIZE_T_FMT "\"",
+                        hdr,
+                        ptm->ns[ST_IO]     / 1e6,
+                        ptm->ns[ST_RENDER] / 1e6,
+                        ctx->stats.chapters,
+                        ctx->stats.verses
+                      );
+                      
+  apr_table_setn(r->err_headers_out,"Server-Timing",hdr);
+}
+
+/*****************************************************************
+*       REQUEST NOTES
+******************************************************************/
+
+static void request_notes(
+                           request_rec            *r,
+                           struct lbrequest const *pbr,
+                           struct lbctx     const *ctx
+                         )
+{
+  char ref[MBUFSIZ];
+  
+  /*-------------------------------------------------------------------
+  ; For the access log, e.g. %{litbook-tier}n.  litbook-cache is "none"
+  ; unless cache_page() or handle_cached() says otherwise.  Searches
+  ; have no reference (pbr is NULL) and set litbook-query themselves.
+  ;-------------------------------------------------------------------*/
+  
+  apr_table_setn(r->notes,"litbook-tier",lb_tier_name(pbr != NULL ? pbr->tier : LB_TIER_NONE));
+  
+  if (pbr != NULL)
+  {
+    apr_table_setn(r->notes,"litbook-query","ref");
+    if (pbr->name == NULL)
+      return;
+    lb_redirect_request(ref,sizeof(ref),pbr);
+    apr_table_set(r->notes,"litbook-ref",ref);
+  }
+  
+  if (ctx == NULL)
+    return;
+    
+  apr_table_setn(r->notes,"litbook-chapters",  apr_psprintf(r->pool,"%" APR_SIZE_T_FMT,ctx->stats.chapters));
+  apr_table_setn(r->notes,"litbook-verses",    apr_psprintf(r->pool,"%" APR_SIZE_T_FMT,ctx->stats.verses));
+  apr_table_setn(r->notes,"litbook-bytes-read",apr_psprintf(r->pool,"%" APR_SIZE_T_FMT,ctx->stats.bytesread));
+  apr_table_setn(r->notes,"litbook-bytes-sent",apr_psprintf(r->pool,"%" APR_SIZE_T_FMT,ctx->bytes));
+  apr_table_setn(r->notes,"litbook-cache",     "none");
+}
+
+/*****************************************************************
+*       SEARCH
+******************************************************************/
+
+static char *query_arg(request_rec *r,char const *name)
+{
+  size_t  len = strlen(name);
+  char   *args;
+  char   *arg;
+  char   *state;
+  
+  if (r->args == NULL)
+    return NULL;
+    
+  args = apr_pstrdup(r->pool,r->args);
+  
+  for (arg = apr_strtok(args,"&;",&state) ; arg != NULL ; arg = apr_strtok(NULL,"&;",&state))
+  {
+    if ((strncmp(arg,name,len) == 0) && (arg[len] == '='))
+    {
+      char *value = &arg[len + 1];
+      char *p;
+      
+      for (p = value ; *p != '\0' ; p++)
+        if (*p == '+')
+          *p = ' ';
+      if (ap_unescape_url(value) != OK)
+        return NULL;
+      return value;
+    }
+  }
+  
+  return NULL;
+}
+
+/*******************************************************************
+;
+; Called from the scan threads.  The connection isn't being read while
+; we scan, so peek at the socket---a client that's gone away shows up as
+; end of file.
+;
+********************************************************************/
+
+static bool client_gone(void *ud)
+{
+  request_rec   *r = ud;
+  apr_os_sock_t  fd;
+  char           c;
+  
+  if (r->connection->aborted)
+    return true;
+  if (apr_os_sock_get(&fd,ap_get_conn_socket(r->connection)) != APR_SUCCESS)
+    return false;
+  return recv(fd,&c,1,MSG_PEEK | MSG_DONTWAIT) == 0;
+}
+
+/*****************************************************************
+*       PAGES
+******************************************************************/
+
+/*******************************************************************
+;
+; The top of a page, up to the start of the body, and the bottom.
+;
+********************************************************************/
+
+static void page_head(struct lbctx *ctx,char const *title)
+{
+  lb_puts(ctx,DOCTYPE_HTML_4_0S);
+  lb_puts(
+           ctx,
+           "<html>\n"
+           "<head>\n"
+           "  <title>"
+         );
+  if (title != NULL)
+    lb_puts(ctx,title);
+  lb_puts(
+           ctx,
+           "</title>\n"
+           "  <link rel=\"stylesheet\" type=\"text/css\" media=\"screen\" href=\"/screen.css\">\n"
+           "</head>\n"
+           "\n"
+           "<body>\n"
+           "\n"
+         );
+}
+
+/*****************************************************************/
+
+static void page_foot(struct lbctx *ctx)
+{
+  lb_puts(
+           ctx,
+           "\n"
+           "</body>\n"
+           "</html>\n"
+           "\n"
+         );
+}
+
+/*****************************************************************/
+
+static int handle_search(
+                          request_rec            *r,
+                          struct litconfig const *plc,
+                          char             const *query,
+                          bool                    scan
+                        )
+{
+  struct lballoc   alloc;
+  struct lbctx     ctx;
+  struct lbhits    hits;
+  struct lbscope   scope;
+  struct lbscan    sc;
+  struct lbscanreq req;
+  char            *in = NULL;
+  size_t           found;
+  size_t           shown;
+  int              rc;
+  
+  /*-------------------------------------------------------------------
+  ; With the index (?q=), terms are ANDed together; "OR" (or "|")
+  ; between two terms makes them alternatives, and &in= limits the
+  ; search to a list of references.  Without (?s=), the text is scanned
+  ; for the string as is, and the scan stops once it has LB_SEARCHMAX
+  ; verses.  Only the first LB_SEARCHMAX verses are shown either way.
+  ;-------------------------------------------------------------------*/
+  
+  apr_table_setn(r->notes,"litbook-query",scan ? "s" : "q");
+  
+  alloc.alloc = lbapr_alloc;
+  alloc.free  = NULL;
+  alloc.ud    = r->pool;
+  
+  if (scan)
+  {
+    req.trans   = plc->trans;
+    req.bookdir = plc->bookdir;
+    req.pattern = query;
+    req.max     = LB_SEARCHMAX;
+    req.threads = plc->scanthreads > 0 ? plc->scanthreads : LB_SCANDEF;
+    req.cancel  = client_gone;
+    req.ud      = r;
+    rc          = lb_scan(&sc,&req,&alloc);
+    found       = sc.n;
+    
+    if ((rc == 0) && sc.cancelled)
+    {
+      r->connection->aborted = 1;
+      return OK;
+    }
+  }
+  else
+  {
+    if ((plc->trans != NULL) && ((in = query_arg(r,"in")) != NULL))
+      rc = lb_index_scope(plc->index,plc->trans,in,&scope);
+    else
+      rc = 0;
+      
+    if (rc == 0)
+      rc = lb_search(plc->index,&alloc,query,in != NULL ? &scope : NULL,&hits);
+    found = rc == 0 ? hits.n : 0;
+  }
+  
+  if (rc == ENOMEM)
+    return HTTP_INTERNAL_SERVER_ERROR;
+  if (rc != 0)
+    found = 0;
+    
+  r->content_type = "text/html";
+  ctx.alloc       = &alloc;
+  ctx.render      = &lb_render_html;
+  ctx.write       = lbapr_write;
+  ctx.ud          = r;
+  ctx.bytes       = 0;
+  ctx.timed       = false;
+  memset(&ctx.stats,0,sizeof(ctx.stats));
+  
+  page_head(&ctx,plc->booktitle);
+  lb_puts(&ctx,"<h1>");
+  lb_puts(&ctx,ap_escape_html(r->pool,query));
+  if (in != NULL)
+  {
+    lb_puts(&ctx," <small>in ");
+    lb_puts(&ctx,ap_escape_html(r->pool,in));
+    lb_puts(&ctx,"</small>");
+  }
+  lb_puts(&ctx,"</h1>\n");
+  
+  if (scan && (rc == 0) && sc.more)
+    lb_puts(&ctx,apr_psprintf(r->pool,"<p>%" APR_SIZE_T_FMT " or more verses</p>\n",found));
+  else
+    lb_puts(&ctx,apr_psprintf(r->pool,"<p>%" APR_SIZE_T_FMT " verses</p>\n",found));
+    
+  if (found == 0)
+    shown = 0;
+  else if (scan)
+  {
+    shown                 = lb_print_scan(&ctx,&sc,plc->bookdir,0,LB_SEARCHMAX);
+    ctx.stats.chapters   += sc.chapters;
+    ctx.stats.bytesread  += sc.bytes;
+  }
+  else
+    shown = lb_print_hits(&ctx,plc->index,&hits,plc->bookdir,0,LB_SEARCHMAX);
+    
+  if (shown < found)
+    lb_puts(&ctx,apr_psprintf(r->pool,"<p>(first %" APR_SIZE_T_FMT " shown)</p>\n",shown));
+    
+  page_foot(&ctx);
+  request_notes(r,NULL,&ctx);
+  stats_request(OUT_200,NULL,&ctx,NULL);
+  return OK;
+}
+
+/*******************************************************************
+;
+; A concordance (?c=) or the counts by book and chapter (?f=) of a
+; word, all out of the index.  The concordance has no limit; it goes
+; out as it's made.
+;
+********************************************************************/
+
+static int handle_words(
+                         request_rec            *r,
+                         struct litconfig const *plc,
+                         char             const *text,
+                         bool                    freq
+                       )
+{
+  struct lballoc         alloc;
+  struct lbctx           ctx;
+  char                   word[LB_WORDMAX];
+  char            const *s  = text;
+  struct lbixword const *pw = NULL;
+  
+  if (lb_token(word,sizeof(word),&s) > 0)
+    pw = lb_index_word(plc->index,word);
+    
+  alloc.alloc     = lbapr_alloc;
+  alloc.free      = NULL;
+  alloc.ud        = r->pool;
+  r->content_type = "text/html";
+  ctx.alloc       = &alloc;
+  ctx.render      = &lb_render_html;
+  ctx.write       = lbapr_write;
+  ctx.ud          = r;
+  ctx.bytes       = 0;
+  ctx.timed       = false;
+  memset(&ctx.stats,0,sizeof(ctx.stats));
+  
+  page_head(&ctx,plc->booktitle);
+  lb_puts(&ctx,"<h1>");
+  lb_puts(&ctx,ap_escape_html(r->pool,text));
+  lb_puts(&ctx,"</h1>\n");
+  
+  if (pw == NULL)
+    lb_puts(&ctx,"<p>0 verses</p>\n");
+  else
+  {
+    lb_printf(
+               &ctx,
+               "<p>%lu times in %lu verses</p>\n",
+               (unsigned long)pw->count,
+               (unsigned long)pw->verses
+             );
+    if (freq)
+      lb_print_frequency(&ctx,plc->index,pw);
+    else
+      lb_print_concordance(&ctx,plc->index,pw);
+  }
+  
+  page_foot(&ctx);
+  apr_table_setn(r->notes,"litbook-query",freq ? "f" : "c");
+  request_notes(r,NULL,&ctx);
+  stats_request(OUT_200,NULL,&ctx,NULL);
+  return OK;
+}
+
+/*****************************************************************
+*       HANDLER HOOK
+******************************************************************/
+
+static int handle_request(request_rec *r)
+{
+  struct litconfig   *plc;
+  struct lbrequest    br;
+  struct lballoc      alloc;
+  struct lbctx        ctx;
+  struct lbtiming     tm;
+  bool                timed;
+  bool                servertiming;
+  bool                cached;
+  uint64_t            start;
+  int                 status;
+  char               *key;
+  apr_bucket_brigade *bb;
+  
+  if (strcmp(r->handler,"litbook-handler") != 0)
+    return DECLINED;
+    
+  if (r->method_number == M_OPTIONS)
+  {
+    r->allowed = 1 << M_GET;
+    return DECLINED;
+  }
+  
+  if (r->method_number != M_GET)
+    return DECLINED;
+    
+  plc = ap_get_module_config(r->per_dir_config,&litbook_module);
+  
+  /*------------------------------------------------------------
+  ; if there's no path to search down, redirect (permanently)
+  ; to the book index (which is elsewhere ... )
+  ;
+  ; TODO:       If we set a handler for `/' then there doesn't
+  ;             seem to be a r->path_info set.  I think it's
+  ;             in r->uri or some other similar field we have
+  ;             to then check.  I wonder if there's a way to
+  ;             get the location of the handler in which we've
+  ;             been installed in ...
+  ;
+  ;             (1.0.3) see comment below
+  ;------------------------------------------------------------*/
+  
+  if ((r->path_info[0] == '/') && (r->path_info[1] == '\0'))
+  {
+    char const *query;
+    
+    if ((plc->index != NULL) && ((query = query_arg(r,"q")) != NULL))
+      return handle_search(r,plc,query,false);
+    if ((plc->index != NULL) && ((query = query_arg(r,"c")) != NULL))
+      return handle_words(r,plc,query,false);
+    if ((plc->index != NULL) && ((query = query_arg(r,"f")) != NULL))
+      return handle_words(r,plc,query,true);
+    if ((plc->scanthreads != 0) && (plc->trans != NULL) && (plc->bookdir != NULL) && ((query = query_arg(r,"s")) != NULL))
+      return handle_search(r,plc,query,true);
+    if (plc->bookindex == NULL)
+      return DECLINED;
+    apr_table_setn(r->headers_out,"Location",plc->bookindex);
+    stats_request(OUT_301,NULL,NULL,NULL);
+    return HTTP_MOVED_PERMANENTLY;
+  }
+  
+  /*--------------------------------------------------------------
+  ; Translate the request.  If it isn't in canonical form, do that
+  ; redirect thang.  If it isn't found, do that not found thang.
+  ;
+  ; TODO:       Related to the one above---we don't know (or rather,
+  ;             I don't know at this time) how to determine (well,
+  ;             not without a lot of hassle) what the top level
+  ;             directory is that we're handling.  See ``hack.''
+  ;
+  ; (1.0.3) Added directive LitbookTLD to easily get the location of the
+  ; handler.  Not pretty, but saves some code.  Hopefully Apache 2.0 will
+  ; have a better module design.
+  ;
+  ; (1.0.3) Also added directive LitbookTitle so I don't have to embed the
+  ; title here either.  This WILL go away once I figure out how to handle
+  ; HTML template.
+  ;
+  ; (1.0.6) Get the hostname AND the port to redirect to.
+  ;--------------------------------------------------------------*/
+  
+  if ((plc->trans == NULL) || (plc->bookdir == NULL))
+    return DECLINED;
+    
+  LB_PROBE1(request__entry,r->uri);
+  servertiming = timing_wanted(r,plc);
+  
+  /*-------------------------------------------------------------------
+  ; The timings only go anywhere if they're sent back, or once someone
+  ; has looked at the status page; until then don't spend the time.
+  ;--------------------------------------------------------------------*/
+  
+  timed = servertiming || ((m_stats != NULL) && (apr_atomic_read32(&m_stats->watched) != 0));
+  
+  if (timed)
+  {
+    tm.start = lb_now();
+    lb_translate_timed(&br,plc->trans,&r->path_info[1]);
+    tm.ns[ST_LOOKUP] = br.nslookup;
+    tm.ns[ST_PARSE]  = lb_now() - tm.start - br.nslookup;
+  }
+  else
+    lb_translate_request(&br,plc->trans,&r->path_info[1]);
+    
+  if (br.name == NULL)
+  {
+    request_notes(r,&br,NULL);
+    if (servertiming)
+      timing_header(r,&br,NULL,&tm);
+    stats_request(OUT_404,&br,NULL,timed ? &tm : NULL);
+    LB_PROBE3(request__exit,r->uri,HTTP_NOT_FOUND,0);
+    return HTTP_NOT_FOUND;
+  }
+  
+  if (br.redirect)
+  {
+    char tportnum[MBUFSIZ];
+    char ref     [MBUFSIZ];
+    
+    if ((r->server->port != 80) && (r->server->port != 0))
+      sprintf(tportnum,":%u",r->server->port);
+    else
+      tportnum[0] = '\0';
+      
+    lb_redirect_request(ref,sizeof(ref),&br);
+    request_notes(r,&br,NULL);
+    
+    apr_table_setn(
+                   r->headers_out,
+                   "Location",
+                   apr_psprintf(
+                                 r->pool,
+                                 "http://%s%s%s%s",
+                                 r->server->server_hostname,
+                                 tportnum,
+                                 plc->booktld,
+                                 ref
+                               )
+                 );
+    if (servertiming)
+      timing_header(r,&br,NULL,&tm);
+    stats_request(OUT_301,&br,NULL,timed ? &tm : NULL);
+    LB_PROBE3(request__exit,r->uri,HTTP_MOVED_PERMANENTLY,0);
+    return HTTP_MOVED_PERMANENTLY;
+  }
+  
+  /*-------------------------------------------------------------
+  ; Handle the request now that we have everything in place
+  ;
+  ; TODO:       How to remove the HTML formatting from the source
+  ;             code to an external file.
+  ;
+  ;             More immediate:  better <META> tags.
+  ;
+  ; If a Server-Timing header is wanted, the page is built up in a
+  ; brigade first, since the headers go out with the first write and the
+  ; timings aren't known until the end.  Same if it's to be cached.
+  ;-------------------------------------------------------------*/
+  
+  r->content_type = "text/html";
+  cached          = (m_cache != NULL) && (r->args == NULL);
+  
+  alloc.alloc = lbapr_alloc;
+  alloc.free  = NULL;
+  alloc.ud    = r->pool;
+  ctx.alloc   = &alloc;
+  ctx.render  = &lb_render_html;
+  ctx.bytes   = 0;
+  ctx.timed   = timed;
+  memset(&ctx.stats,0,sizeof(ctx.stats));
+  
+  if (servertiming || cached)
+  {
+    bb        = apr_brigade_create(r->pool,r->connection->bucket_alloc);
+    ctx.write = lbapr_bbwrite;
+    ctx.ud    = bb;
+  }
+  else
+  {
+    bb        = NULL;
+    ctx.write = lbapr_write;
+    ctx.ud    = r;
+  }
+  
+  if (plc->prefetch > 0)
+    prefetch_used(plc,&br);
+    
+  start = timed ? lb_now() : 0;
+  LB_PROBE3(render__entry,br.name,br.c1,br.c2);
+  
+  page_head(&ctx,plc->booktitle);
+  lb_print_request(&ctx,&br,plc->bookdir,plc->vmap);
+  page_foot(&ctx);
+  LB_PROBE2(render__exit,br.name,ctx.bytes);
+  
+  if (timed)
+  {
+    tm.ns[ST_IO]     = ctx.stats.nsio;
+    tm.ns[ST_RENDER] = lb_now() - start - ctx.stats.nsio;
+  }
+  
+  request_notes(r,&br,&ctx);
+  key    = (cached || (m_hotlock != NULL)) ? page_key(r,plc,&br) : NULL;
+  status = cached ? cache_page(r,key,bb) : OK;
+  
+  if (servertiming)
+    timing_header(r,&br,&ctx,&tm);
+  if ((bb != NULL) && (status == OK))
+    ap_pass_brigade(r->output_filters,bb);
+    
+  stats_request(OUT_200,&br,&ctx,timed ? &tm : NULL);
+  if (key != NULL)
+    hot_count(key,1);
+  if (plc->prefetch > 0)
+    prefetch_next(plc,&br);
+  LB_PROBE3(request__exit,r->uri,HTTP_OK,ctx.bytes);
+  return status;
+}
+
+/*******************************************************************
+;
+; A full URL for a path under the <Location>, for redirects.
+;
+********************************************************************/
+
+static char *tld_url(request_rec *r,struct litconfig const *plc,char const *path)
+{
+  size_t len = strlen(plc->booktld);
+  
+  return ap_construct_url(
+                           r->pool,
+                           apr_pstrcat(
+                                        r->pool,
+                                        plc->booktld,
+                                        (len > 0) && (plc->booktld[len - 1] == '/') ? "" : "/",
+                                        path,
+                                        NULL
+                                      ),
+                           r
+                         );
+}
+
+/*******************************************************************
+;
+; The same passage in several translations, side by side.  ?t= picks
+; which (by their LitbookParallel labels) and in what order; without it,
+; all of them.  The reference is read with the first translation's
+; names; the others find the book by its full name or abbreviation, and
+; a translation without it gets an empty column.
+;
+********************************************************************/
+
+static int handle_parallel(request_rec *r)
+{
+  struct litconfig *plc;
+  struct litpar    *par[LB_PARMAX];
+  struct lbcolumn   cols[LB_PARMAX];
+  struct lbrequest  br;
+  struct lballoc    alloc;
+  struct lbctx      ctx;
+  char             *list;
+  size_t            n = 0;
+  
+  if (strcmp(r->handler,"litbook-parallel") != 0)
+    return DECLINED;
+    
+  if (r->method_number != M_GET)
+    return DECLINED;
+    
+  plc = ap_get_module_config(r->per_dir_config,&litbook_module);
+  if ((plc->parallel == NULL) || (r->path_info[0] != '/'))
+    return DECLINED;
+    
+  if ((list = query_arg(r,"t")) != NULL)
+  {
+    char *label;
+    char *state;
+    
+    for (label = apr_strtok(list,",",&state) ; label != NULL ; label = apr_strtok(NULL,",",&state))
+    {
+      int i;
+      
+      for (i = 0 ; i < plc->parallel->nelts ; i++)
+        if (strcmp(APR_ARRAY_IDX(plc->parallel,i,struct litpar).label,label) == 0)
+          break;
+      if ((i == plc->parallel->nelts) || (n == LB_PARMAX))
+        return HTTP_NOT_FOUND;
+      par[n++] = &APR_ARRAY_IDX(plc->parallel,i,struct litpar);
+    }
+  }
+  else
+  {
+    for (n = 0 ; n < (size_t)plc->parallel->nelts ; n++)
+      par[n] = &APR_ARRAY_IDX(plc->parallel,n,struct litpar);
+  }
+  
+  if (n == 0)
+    return HTTP_NOT_FOUND;
+    
+  lb_translate_request(&br,par[0]->trans,&r->path_info[1]);
+  
+  if (br.name == NULL)
+  {
+    request_notes(r,&br,NULL);
+    stats_request(OUT_404,&br,NULL,NULL);
+    return HTTP_NOT_FOUND;
+  }
+  
+  if (br.redirect)
+  {
+    char ref[MBUFSIZ];
+    
+    lb_redirect_request(ref,sizeof(ref),&br);
+    request_notes(r,&br,NULL);
+    apr_table_setn(
+                    r->headers_out,
+                    "Location",
+                    tld_url(r,plc,apr_pstrcat(r->pool,ref,r->args != NULL ? "?" : "",r->args,NULL))
+                  );
+    stats_request(OUT_301,&br,NULL,NULL);
+    return HTTP_MOVED_PERMANENTLY;
+  }
+  
+  for (size_t i = 0 ; i < n ; i++)
+  {
+    cols[i].label   = ap_escape_html(r->pool,par[i]->label);
+    cols[i].bookdir = par[i]->bookdir;
+    cols[i].name    = NULL;
+    cols[i].map     = NULL;
+    
+    if (i == 0)
+    {
+      cols[i].name = br.name;
+      cols[i].map  = lb_vmap_book(par[i]->vmap,br.book);
+    }
+    else
+    {
+      struct lbbookname *book;
+      enum lbtier        tier;
+      
+      book = lb_find_book(par[i]->trans,br.name,&tier);
+      if ((book != NULL) && ((tier == LB_TIER_FULLNAME) || (tier == LB_TIER_ABREV)))
+      {
+        cols[i].name = book->fullname;
+        cols[i].map  = lb_vmap_book(par[i]->vmap,book - par[i]->trans->books);
+      }
+    }
+  }
+  
+  r->content_type = "text/html";
+  alloc.alloc     = lbapr_alloc;
+  alloc.free      = NULL;
+  alloc.ud        = r->pool;
+  ctx.alloc       = &alloc;
+  ctx.render      = &lb_render_html;
+  ctx.write       = lbapr_write;
+  ctx.ud          = r;
+  ctx.bytes       = 0;
+  ctx.timed       = false;
+  memset(&ctx.stats,0,sizeof(ctx.stats));
+  
+  page_head(&ctx,plc->booktitle);
+  lb_show_parallel(&ctx,cols,n,&br);
+  page_foot(&ctx);
+  
+  request_notes(r,&br,&ctx);
+  stats_request(OUT_200,&br,&ctx,NULL);
+  return OK;
+}
+
+/*****************************************************************
+*       LIBRARY
+******************************************************************/
+
+static bool work_name_ok(char const *name)
+{
+  if ((*name == '\0') || (*name == '.') || (strlen(name) > FILENAME_MAX / 4))
+    return false;
+    
+  for ( ; *name != '\0' ; name++)
+    if (!isalnum((unsigned char)*name) && (strchr("._-",*name) == NULL))
+      return false;
+  return true;
+}
+
+/*****************************************************************/
+
+static void work_free(struct litwork *pw)
+{
+  if (pw->trans.books != NULL)
+    lb_trans_free(&pw->trans,&lb_malloc);
+  free(pw->title);
+  free(pw->bookdir);
+  free(pw->name);
+  free(pw);
+}
+
+/*******************************************************************
+;
+; Load a work.  This is done without holding the lock, since it reads
+; files; it's not in the library until work_get() puts it there.
+;
+********************************************************************/
+
+static int work_load(struct litlib *lib,char const *name,struct litwork **ppw)
+{
+  struct litwork *pw;
+  char            fname[FILENAME_MAX];
+  char            title[MBUFSIZ];
+  FILE           *fp;
+  int             rc;
+  
+  if ((pw = calloc(1,sizeof(struct litwork))) == NULL)
+    return ENOMEM;
+    
+  snprintf(fname,sizeof(fname),"%s/%s",lib->root,name);
+  pw->lib     = lib;
+  pw->name    = strdup(name);
+  pw->bookdir = strdup(fname);
+  
+  if ((pw->name == NULL) || (pw->bookdir == NULL))
+  {
+    work_free(pw);
+    return ENOMEM;
+  }
+  
+  snprintf(fname,sizeof(fname),"%s/%s",pw->bookdir,LB_LIBTRANS);
+  if ((rc = lb_trans_load(&pw->trans,fname,&lb_malloc,NULL)) != 0)
+  {
+    work_free(pw);
+    return rc;
+  }
+  
+  snprintf(fname,sizeof(fname),"%s/%s",pw->bookdir,LB_LIBTITLE);
+  if ((fp = fopen(fname,"r")) != NULL)
+  {
+    if (fgets(title,sizeof(title),fp) != NULL)
+    {
+      title[strcspn(title,"\r\n")] = '\0';
+      pw->title = strdup(title);
+    }
+    fclose(fp);
+  }
+  
+  *ppw = pw;
+  return 0;
+}
+
+/*****************************************************************/
+
+static void work_unlink(struct litlib *lib,struct litwork *pw)
+{
+  if (pw->prev != NULL) pw->prev->next = pw->next; else lib->head = pw->next;
+  if (pw->next != NULL) pw->next->prev = pw->prev; else lib->tail = pw->prev;
+  pw->prev = NULL;
+  pw->next = NULL;
+}
+
+/*****************************************************************/
+
+static void work_push(struct litlib *lib,struct litwork *pw)
+{
+  pw->prev = NULL;
+  pw->next = lib->head;
+  if (lib->head != NULL) lib->head->prev = pw; else lib->tail = pw;
+  lib->head = pw;
+}
+
+/*****************************************************************/
+
+static apr_status_t work_release(void *data)
+{
+  struct litwork *pw = data;
+  
+  apr_thread_mutex_lock(pw->lib->lock);
+  pw->refs--;
+  apr_thread_mutex_unlock(pw->lib->lock);
+  return APR_SUCCESS;
+}
+
+/*******************************************************************
+;
+; Get a work for a request, loading it if need be.  It's held until the
+; request is done.  Works pushed out to make room are freed after the
+; lock is let go.
+;
+********************************************************************/
+
+static int work_get(request_rec *r,struct litlib *lib,char const *name,struct litwork **ppw)
+{
+  struct litwork *pw;
+  struct litwork *old;
+  struct litwork *gone = NULL;
+  int             rc;
+  
+  apr_thread_mutex_lock(lib->lock);
+  pw = apr_hash_get(lib->works,name,APR_HASH_KEY_STRING);
+  if (pw != NULL)
+  {
+    work_unlink(lib,pw);
+    work_push(lib,pw);
+    pw->refs++;
+  }
+  apr_thread_mutex_unlock(lib->lock);
+  
+  if (pw == NULL)
+  {
+    if ((rc = work_load(lib,name,&pw)) != 0)
+      return rc;
+      
+    apr_thread_mutex_lock(lib->lock);
+    old = apr_hash_get(lib->works,name,APR_HASH_KEY_STRING);
+    
+    if (old != NULL)                    /* someone beat us to it */
+    {
+      gone = pw;
+      pw   = old;
+      work_unlink(lib,pw);
+    }
+    else
+    {
+      apr_hash_set(lib->works,pw->name,APR_HASH_KEY_STRING,pw);
+      lib->n++;
+    }
+    
+    work_push(lib,pw);
+    pw->refs++;
+    
+    for (old = lib->tail ; (old != NULL) && (lib->n > lib->max) ; )
+    {
+      struct litwork *prev = old->prev;
+      
+      if (old->refs == 0)
+      {
+        work_unlink(lib,old);
+        apr_hash_set(lib->works,old->name,APR_HASH_KEY_STRING,NULL);
+        lib->n--;
+        old->next = gone;
+        gone      = old;
+      }
+      old = prev;
+    }
+    
+    apr_thread_mutex_unlock(lib->lock);
+    
+    while(gone != NULL)
+    {
+      old  = gone;
+      gone = gone->next;
+      work_free(old);
+    }
+  }
+  
+  apr_pool_cleanup_register(r->pool,pw,work_release,apr_pool_cleanup_null);
+  *ppw = pw;
+  return 0;
+}
+
+/*******************************************************************
+;
+; /<work>/ gives a list of the books, /<work>/<reference> the text.
+;
+********************************************************************/
+
+static int handle_library(request_rec *r)
+{
+  struct litconfig *plc;
+  struct litwork   *pw;
+  struct lbrequest  br;
+  struct lballoc    alloc;
+  struct lbctx      ctx;
+  char const       *slash;
+  char const       *ref;
+  char const       *title;
+  char             *work;
+  int               rc;
+  
+  if (strcmp(r->handler,"litbook-library") != 0)
+    return DECLINED;
+    
+  if (r->method_number != M_GET)
+    return DECLINED;
+    
+  plc = ap_get_module_config(r->per_dir_config,&litbook_module);
+  if ((plc->library == NULL) || (r->path_info[0] != '/'))
+    return DECLINED;
+    
+  slash = strchr(&r->path_info[1],'/');
+  work  = slash != NULL
+        ? apr_pstrndup(r->pool,&r->path_info[1],slash - &r->path_info[1])
+        : apr_pstrdup(r->pool,&r->path_info[1]);
+        
+  if (!work_name_ok(work))
+    return HTTP_NOT_FOUND;
+    
+  if ((rc = work_get(r,plc->library,work,&pw)) != 0)
+  {
+    if (rc == ENOENT)
+      return HTTP_NOT_FOUND;
+    ap_log_rerror(APLOG_MARK,APLOG_ERR,rc,r,"mod_litbook: %s/%s/%s",plc->library->root,work,LB_LIBTRANS);
+    return HTTP_INTERNAL_SERVER_ERROR;
+  }
+  
+  if (slash == NULL)
+  {
+    apr_table_setn(r->headers_out,"Location",tld_url(r,plc,apr_pstrcat(r->pool,work,"/",NULL)));
+    return HTTP_MOVED_PERMANENTLY;
+  }
+  
+  r->content_type = "text/html";
+  alloc.alloc     = lbapr_alloc;
+  alloc.free      = NULL;
+  alloc.ud        = r->pool;
+  ctx.alloc       = &alloc;
+  ctx.render      = &lb_render_html;
+  ctx.write       = lbapr_write;
+  ctx.ud          = r;
+  ctx.bytes       = 0;
+  ctx.timed       = false;
+  memset(&ctx.stats,0,sizeof(ctx.stats));
+  
+  /*-------------------------------------------------------------------
+  ; The title and book names come from the work's files, not from the
+  ; server configuration.
+  ;--------------------------------------------------------------------*/
+  
+  title = pw->title != NULL ? ap_escape_html(r->pool,pw->title) : plc->booktitle;
+  ref   = slash + 1;
+  
+  if (*ref == '\0')
+  {
+    page_head(&ctx,title);
+    lb_printf(&ctx,"<h1>%s</h1>\n<ul>\n",ap_escape_html(r->pool,pw->title != NULL ? pw->title : work));
+    for (size_t i = 0 ; i < pw->trans.maxbook ; i++)
+    {
+      char const *name = pw->trans.books[i].fullname;
+      
+      lb_printf(
+                 &ctx,
+                 "  <li><a href=\"%s\">%s</a></li>\n",
+                 ap_escape_html(r->pool,ap_escape_uri(r->pool,name)),
+                 ap_escape_html(r->pool,name)
+               );
+    }
+    lb_puts(&ctx,"</ul>\n");
+    page_foot(&ctx);
+    return OK;
+  }
+  
+  lb_translate_request(&br,&pw->trans,ref);
+  
+  if (br.name == NULL)
+  {
+    request_notes(r,&br,NULL);
+    stats_request(OUT_404,&br,NULL,NULL);
+    return HTTP_NOT_FOUND;
+  }
+  
+  if (br.redirect)
+  {
+    char buffer[MBUFSIZ];
+    
+    lb_redirect_request(buffer,sizeof(buffer),&br);
+    request_notes(r,&br,NULL);
+    apr_table_setn(r->headers_out,"Location",tld_url(r,plc,apr_pstrcat(r->pool,work,"/",buffer,NULL)));
+    stats_request(OUT_301,&br,NULL,NULL);
+    return HTTP_MOVED_PERMANENTLY;
+  }
+  
+  page_head(&ctx,title);
+  lb_print_request(&ctx,&br,pw->bookdir,NULL);
+  page_foot(&ctx);
+  
+  request_notes(r,&br,&ctx);
+  stats_request(OUT_200,&br,&ctx,NULL);
+  return OK;
+}
+
+/**********************************************************************/
 
-static int handle_request(request_rec *r)
+static int handle_status(request_rec *r)
 {
-  struct litconfig  *plc;
-  struct bookrequest  br;
+  struct lbshared snap;
   
-  if (strcmp(r->handler,"litbook-handler") != 0)
+  if (strcmp(r->handler,"litbook-status") != 0)
     return DECLINED;
     
-  if (r->method_number == M_OPTIONS)
-  {
-    r->allowed = 1 << M_GET;
+  if (r->method_number != M_GET)
     return DECLINED;
+    
+  if (m_stats == NULL)
+    return HTTP_NOT_FOUND;
+    
+  if (apr_atomic_read32(&m_stats->watched) == 0)
+    apr_atomic_set32(&m_stats->watched,1);
+    
+  /*-------------------------------------------------------------------
+  ; The counters keep moving while we format them, so work from a copy.
+  ; It's not an atomic snapshot, but each counter is read once.
+  ;-------------------------------------------------------------------*/
+  
+  memcpy(&snap,m_stats,sizeof(snap));
+  snap.nhot = m_hotlock != NULL ? hot_snapshot(snap.hot) : 0;
+  
+  if ((r->args != NULL) && (strcmp(r->args,"auto") == 0))
+    stats_prometheus(r,&snap);
+  else
+    stats_html(r,&snap);
+  return OK;
+}
+
+/***********************************************************************
+*       CONFIGURATION HOOKS
+***********************************************************************/
+
+static int init_stats(apr_pool_t *pconf,apr_pool_t *plog,apr_pool_t *ptemp,server_rec *s)
+{
+  static char const key[] = "litbook-init";
+  apr_shm_t        *shm;
+  void             *data;
+  apr_status_t      rc;
+  
+  (void)plog;
+  
+  /*-------------------------------------------------------------------
+  ; Apache reads the configuration twice on startup; don't bother with
+  ; the shared memory the first time through.
+  ;-------------------------------------------------------------------*/
+  
+  apr_pool_userdata_get(&data,key,s->process->pool);
+  if (data == NULL)
+  {
+    apr_pool_userdata_set((void *)1,key,apr_pool_cleanup_null,s->process->pool);
+    return OK;
   }
   
-  if (r->method_number != M_GET)
-    return DECLINED;
+  rc = apr_shm_create(&shm,sizeof(struct lbshared),NULL,pconf);
+  if (APR_STATUS_IS_ENOTIMPL(rc))
+  {
+    char const *fname = ap_runtime_dir_relative(ptemp,"litbook.shm");
     
-  plc = ap_get_module_config(r->per_dir_config,&litbook_module);
+    apr_shm_remove(fname,ptemp);
+    rc = apr_shm_create(&shm,sizeof(struct lbshared),fname,pconf);
+  }
   
-  /*------------------------------------------------------------
-  ; if there's no path to search down, redirect (permanently)
-  ; to the book index (which is elsewhere ... )
-  ;
-  ; TODO:       If we set a handler for `/' then there doesn't
-  ;             seem to be a r->path_info set.  I think it's
-  ;             in r->uri or some other similar field we have
-  ;             to then check.  I wonder if there's a way to
-  ;             get the location of the handler in which we've
-  ;             been installed in ...
-  ;
-  ;             (1.0.3) see comment below
-  ;------------------------------------------------------------*/
+  if (rc != APR_SUCCESS)
+  {
+    ap_log_error(APLOG_MARK,APLOG_ERR,rc,s,"mod_litbook: no shared memory for statistics");
+    m_stats = NULL;
+    return OK;
+  }
   
-  if ((r->path_info[0] == '/') && (r->path_info[1] == '\0'))
+  m_stats = apr_shm_baseaddr_get(shm);
+  memset(m_stats,0,sizeof(struct lbshared));
+  return OK;
+}
+
+/*********************************************************************
+;
+; LitbookCache and LitbookHotList set things up as the configuration is
+; read, so they're reset before each time that happens.
+;
+**********************************************************************/
+
+static int init_pre(apr_pool_t *pconf,apr_pool_t *plog,apr_pool_t *ptemp)
+{
+  (void)plog;
+  (void)ptemp;
+  
+  m_cache     = NULL;
+  m_cacheinst = NULL;
+  m_cachelock = NULL;
+  m_cachetime = apr_time_from_sec(LB_CACHEDEF);
+  m_cachetlds = apr_array_make(pconf,8,sizeof(char const *));
+  m_hotfile   = NULL;
+  m_hotlock   = NULL;
+  m_hotsave   = LB_HOTDEF;
+  
+  if (ap_mutex_register(pconf,LB_CACHEID,NULL,APR_LOCK_DEFAULT,0) != APR_SUCCESS)
+    return !OK;
+  if (ap_mutex_register(pconf,LB_HOTID,NULL,APR_LOCK_DEFAULT,0) != APR_SUCCESS)
+    return !OK;
+  return OK;
+}
+
+/*********************************************************************/
+
+static apr_status_t cache_cleanup(void *data)
+{
+  (*m_cache->destroy)(m_cacheinst,data);
+  return APR_SUCCESS;
+}
+
+/*********************************************************************/
+
+static int init_cache(apr_pool_t *pconf,apr_pool_t *plog,apr_pool_t *ptemp,server_rec *s)
+{
+  struct ap_socache_hints hints;
+  apr_status_t            rc;
+  
+  (void)plog;
+  (void)ptemp;
+  
+  if (m_cache == NULL)
+    return OK;
+    
+  if ((m_cache->flags & AP_SOCACHE_FLAG_NOTMPSAFE) != 0)
   {
-    if (plc->bookindex == NULL)
-      return DECLINED;
-    apr_table_setn(r->headers_out,"Location",plc->bookindex);
-    return HTTP_MOVED_PERMANENTLY;
+    rc = ap_global_mutex_create(&m_cachelock,NULL,LB_CACHEID,NULL,s,pconf,0);
+    if (rc != APR_SUCCESS)
+    {
+      ap_log_error(APLOG_MARK,APLOG_ERR,rc,s,"mod_litbook: no mutex for LitbookCache");
+      return HTTP_INTERNAL_SERVER_ERROR;
+    }
   }
   
-  /*--------------------------------------------------------------
-  ; Translate the request.  If it isn't in canonical form, do that
-  ; redirect thang.  If it isn't found, do that not found thang.
-  ;
-  ; TODO:       Related to the one above---we don't know (or rather,
-  ;             I don't know at this time) how to determine (well,
-  ;             not without a lot of hassle) what the top level
-  ;             directory is that we're handling.  See ``hack.''
-  ;
-  ; (1.0.3) Added directive LitbookTLD to easily get the location of the
-  ; handler.  Not pretty, but saves some code.  Hopefully Apache 2.0 will
-  ; have a better module design.
-  ;
-  ; (1.0.3) Also added directive LitbookTitle so I don't have to embed the
-  ; title here either.  This WILL go away once I figure out how to handle
-  ; HTML template.
-  ;
-  ; (1.0.6) Get the hostname AND the port to redirect to.
-  ;--------------------------------------------------------------*/
+  hints.avg_id_len      = 32;
+  hints.avg_obj_size    = 8192;
+  hints.expiry_interval = m_cachetime;
   
-  hr_translate_request(&br,plc,&r->path_info[1]);
-  if (br.name == NULL) return HTTP_NOT_FOUND;
-  if (br.redirect)
+  if ((rc = (*m_cache->init)(m_cacheinst,LB_CACHEID,&hints,s,pconf)) != APR_SUCCESS)
   {
-    char tportnum[MBUFSIZ];
+    ap_log_error(APLOG_MARK,APLOG_ERR,rc,s,"mod_litbook: LitbookCache not set up");
+    return HTTP_INTERNAL_SERVER_ERROR;
+  }
+  
+  apr_pool_cleanup_register(pconf,s,cache_cleanup,apr_pool_cleanup_null);
+  
+  /*-------------------------------------------------------------------
+  ; Note the <Location>s handle_request() serves, for handle_cached().
+  ;--------------------------------------------------------------------*/
+  
+  for (server_rec *vs = s ; vs != NULL ; vs = vs->next)
+  {
+    core_server_config *core = ap_get_core_module_config(vs->module_config);
     
-    if ((r->server->port != 80) && (r->server->port != 0))
-      sprintf(tportnum,":%u",r->server->port);
-    else
-      tportnum[0] = '\0';
+    for (int i = 0 ; i < core->sec_url->nelts ; i++)
+    {
+      struct litconfig *plc = ap_get_module_config(APR_ARRAY_IDX(core->sec_url,i,ap_conf_vector_t *),&litbook_module);
       
-    apr_table_setn(
-                   r->headers_out,
-                   "Location",
-                   apr_psprintf(
-                                 r->pool,
-                                 "http://%s%s%s%s",
-                                 r->server->server_hostname,
-                                 tportnum,
-                                 plc->booktld,
-                                 hr_redirect_request(&br,r->pool)
-                               )
-                 );
-    return HTTP_MOVED_PERMANENTLY;
+      if ((plc == NULL) || (plc->booktld == NULL))
+        continue;
+      if ((plc->bookdir == NULL) && (plc->parallel == NULL) && (plc->library == NULL))
+        continue;
+      APR_ARRAY_PUSH(m_cachetlds,char const *) = plc->booktld;
+    }
   }
   
-  /*-------------------------------------------------------------
-  ; Handle the request now that we have everything in place
-  ;
-  ; TODO:       How to remove the HTML formatting from the source
-  ;             code to an external file.
-  ;
-  ;             More immediate:  better <META> tags.
-  ;-------------------------------------------------------------*/
+  return OK;
+}
+
+/*********************************************************************/
+
+/*******************************************************************
+;
+; Render a page ahead of time.  That reads its chapter files into the
+; page cache, and the page goes into LitbookCache if there is one.
+;
+********************************************************************/
+
+static bool hot_render(
+                        server_rec             *s,
+                        apr_pool_t             *pool,
+                        struct litconfig const *plc,
+                        char const             *key,
+                        char const             *ref
+                      )
+{
+  struct lbrequest    br;
+  struct lballoc      alloc;
+  struct lbctx        ctx;
+  apr_bucket_brigade *bb;
+  char               *body;
+  apr_size_t          len;
   
-  r->content_type = "text/html";
+  lb_translate_request(&br,plc->trans,ref);
+  if ((br.name == NULL) || br.redirect)
+    return false;
+    
+  bb          = apr_brigade_create(pool,apr_bucket_alloc_create(pool));
+  alloc.alloc = lbapr_alloc;
+  alloc.free  = NULL;
+  alloc.ud    = pool;
+  ctx.alloc   = &alloc;
+  ctx.render  = &lb_render_html;
+  ctx.write   = lbapr_bbwrite;
+  ctx.ud      = bb;
+  ctx.bytes   = 0;
+  ctx.timed   = false;
+  memset(&ctx.stats,0,sizeof(ctx.stats));
   
-  ap_rputs(DOCTYPE_HTML_4_0S,r);
-  ap_rprintf(
-              r,
-              "<html>\n"
-              "<head>\n"
-              "  <title>%s</title>\n"
-              "  <link rel=\"stylesheet\" type=\"text/css\" media=\"screen\" href=\"/screen.css\">\n"
-              "</head>\n"
-              "\n"
-              "<body>\n"
-              "\n",
-              plc->booktitle
-          );
-          
-  hr_print_request(&br,plc,r);
+  page_head(&ctx,plc->booktitle);
+  lb_print_request(&ctx,&br,plc->bookdir,plc->vmap);
+  page_foot(&ctx);
   
-  ap_rputs(
-            "\n"
-            "</body>\n"
-            "</html>\n"
-            "\n",
-            r
-          );
+  if ((m_cache != NULL) && (apr_brigade_pflatten(bb,&body,&len,pool) == APR_SUCCESS))
+    cache_put(s,pool,key,cache_head(pool,"text/html",cache_etag(pool,body,len),NULL),body,len);
+  return true;
+}
+
+/*******************************************************************
+;
+; Find the virtual host and <Location> a key came from.  The key is
+; host:port/path, and the <Location> is found the way hook_translate()
+; would find it.
+;
+********************************************************************/
+
+static bool hot_warm(server_rec *s,apr_pool_t *pool,char const *key)
+{
+  for (server_rec *vs = s ; vs != NULL ; vs = vs->next)
+  {
+    core_server_config *core = ap_get_core_module_config(vs->module_config);
+    char const         *host = apr_psprintf(pool,"%s:%u",vs->server_hostname,vs->port);
+    size_t              hlen = strlen(host);
+    char const         *path = &key[hlen];
+    
+    if ((strncmp(key,host,hlen) != 0) || (*path != '/'))
+      continue;
+      
+    for (int i = 0 ; i < core->sec_url->nelts ; i++)
+    {
+      struct litconfig *plc = ap_get_module_config(APR_ARRAY_IDX(core->sec_url,i,ap_conf_vector_t *),&litbook_module);
+      size_t            len;
+      
+      if ((plc == NULL) || (plc->booktld == NULL) || (plc->trans == NULL) || (plc->bookdir == NULL))
+        continue;
+        
+      len = strlen(plc->booktld);
+      if ((len > 0) && (plc->booktld[len - 1] == '/'))
+        len--;
+        
+      if ((strncmp(path,plc->booktld,len) == 0) && (path[len] == '/'))
+        return hot_render(vs,pool,plc,key,&path[len + 1]);
+    }
+  }
+  
+  return false;
+}
+
+/*********************************************************************
+;
+; Read back the list LitbookHotList saved, counts and all, and render
+; each page on it so the first requests after a start (or a restart,
+; say for new data) don't all go to disk.
+;
+**********************************************************************/
+
+static int init_hot(apr_pool_t *pconf,apr_pool_t *plog,apr_pool_t *ptemp,server_rec *s)
+{
+  apr_file_t   *fp;
+  apr_pool_t   *pool;
+  apr_status_t  rc;
+  size_t        warmed = 0;
+  char          line[MBUFSIZ];
+  
+  (void)plog;
+  
+  if ((m_hotfile == NULL) || (m_stats == NULL))
+    return OK;
+    
+  if ((rc = ap_global_mutex_create(&m_hotlock,NULL,LB_HOTID,NULL,s,pconf,0)) != APR_SUCCESS)
+  {
+    ap_log_error(APLOG_MARK,APLOG_ERR,rc,s,"mod_litbook: no mutex for LitbookHotList");
+    return HTTP_INTERNAL_SERVER_ERROR;
+  }
+  
+  apr_atomic_set32(&m_stats->hotsaved,(apr_uint32_t)apr_time_sec(apr_time_now()));
+  
+  rc = apr_file_open(&fp,m_hotfile,APR_FOPEN_READ | APR_FOPEN_BUFFERED,APR_OS_DEFAULT,ptemp);
+  if (rc != APR_SUCCESS)
+  {
+    if (!APR_STATUS_IS_ENOENT(rc))
+      ap_log_error(APLOG_MARK,APLOG_WARNING,rc,s,"mod_litbook: can't read %s",m_hotfile);
+    return OK;
+  }
+  
+  if ((rc = apr_pool_create(&pool,ptemp)) != APR_SUCCESS)
+  {
+    apr_file_close(fp);
+    return OK;
+  }
+  
+  while (apr_file_gets(line,sizeof(line),fp) == APR_SUCCESS)
+  {
+    char          *key;
+    unsigned long  count = strtoul(line,&key,10);
+    
+    key += strspn(key," \t");
+    key[strcspn(key,"\r\n")] = '\0';
+    
+    if ((count == 0) || (*key == '\0'))
+      continue;
+      
+    hot_count(key,count > 0xFFFFFFFFuL ? 0xFFFFFFFFu : (apr_uint32_t)count);
+    if (hot_warm(s,pool,key))
+      warmed++;
+    apr_pool_clear(pool);
+  }
+  
+  apr_file_close(fp);
+  ap_log_error(APLOG_MARK,APLOG_INFO,0,s,"mod_litbook: %" APR_SIZE_T_FMT " pages from %s rendered",warmed,m_hotfile);
   return OK;
 }
 
-/***********************************************************************
-*       CONFIGURATION HOOKS
-***********************************************************************/
+/*********************************************************************/
+
+static void init_child(apr_pool_t *p,server_rec *s)
+{
+  apr_status_t rc;
+  
+  if (m_cachelock != NULL)
+  {
+    rc = apr_global_mutex_child_init(&m_cachelock,apr_global_mutex_lockfile(m_cachelock),p);
+    if (rc != APR_SUCCESS)
+      ap_log_error(APLOG_MARK,APLOG_ERR,rc,s,"mod_litbook: LitbookCache mutex not usable");
+  }
+  
+  if (m_hotlock != NULL)
+  {
+    apr_thread_t *thread;
+    
+    rc = apr_global_mutex_child_init(&m_hotlock,apr_global_mutex_lockfile(m_hotlock),p);
+    if (rc != APR_SUCCESS)
+    {
+      ap_log_error(APLOG_MARK,APLOG_ERR,rc,s,"mod_litbook: LitbookHotList mutex not usable");
+      return;
+    }
+    
+    /*-----------------------------------------------------------------
+    ; A pre-cleanup, since the thread's pool (a child of p) is gone by
+    ; the time the ordinary cleanups run.
+    ;------------------------------------------------------------------*/
+    
+    m_hotstop = 0;
+    rc        = apr_thread_create(&thread,NULL,hot_saver,s,p);
+    if (rc != APR_SUCCESS)
+      ap_log_error(APLOG_MARK,APLOG_ERR,rc,s,"mod_litbook: LitbookHotList won't be saved");
+    else
+      apr_pool_pre_cleanup_register(p,thread,hot_stop);
+  }
+}
+
+/*********************************************************************
+;
+; A litbook URL never names a file, so there's no point in having the
+; core walk the filesystem looking for one.  translate_name claims
+; anything under a <Location> with mod_litbook configured, and sets the
+; r->path_info the handlers would otherwise get from the walk;
+; map_to_storage then skips the walk for what was claimed.
+;
+**********************************************************************/
+
+static int hook_translate(request_rec *r)
+{
+  struct litconfig *plc = ap_get_module_config(r->per_dir_config,&litbook_module);
+  size_t            len;
+  
+  if ((plc == NULL) || (plc->booktld == NULL) || (r->uri[0] != '/'))
+    return DECLINED;
+    
+  if ((plc->bookdir == NULL) && (plc->parallel == NULL) && (plc->library == NULL))
+    return DECLINED;
+    
+  /*-------------------------------------------------------------------
+  ; booktld is the <Location> path.  A <LocationMatch> (or <Directory>)
+  ; won't be a prefix of the URL, and is left to the core.
+  ;--------------------------------------------------------------------*/
+  
+  if (!tld_under(r->uri,plc->booktld,&len))
+    return DECLINED;
+    
+  r->filename  = apr_pstrcat(r->pool,LB_FILEPFX,r->uri,NULL);
+  r->path_info = &r->uri[len];
+  return OK;
+}
+
+/*********************************************************************/
+
+static int hook_storage(request_rec *r)
+{
+  if ((r->filename != NULL) && (strncmp(r->filename,LB_FILEPFX,sizeof(LB_FILEPFX) - 1) == 0))
+    return OK;
+  return DECLINED;
+}
+
+/*********************************************************************/
 
 static void *create_dir_config(apr_pool_t *p,char *dirspec)
 {
@@ -851,18 +3085,21 @@ static void *create_dir_config(apr_pool_t *p,char *dirspec)
   if (dirspec == NULL)
     return NULL;
     
-  plc            = apr_palloc(p,sizeof(struct litconfig));
-  plc->bookindex = NULL;
-  plc->booktrans = NULL;
-  plc->bookdir   = NULL;
-  plc->booktld   = apr_pstrdup(p,dirspec);
-  plc->booktitle = NULL;
-  plc->books     = NULL;
-  plc->abrev     = NULL;
-  plc->fullname  = NULL;
-  plc->soundex   = NULL;
-  plc->metaphone = NULL;
-  plc->maxbook   = 0;
+  plc              = apr_palloc(p,sizeof(struct litconfig));
+  plc->bookindex   = NULL;
+  plc->booktrans   = NULL;
+  plc->bookdir     = NULL;
+  plc->booktld     = apr_pstrdup(p,dirspec);
+  plc->booktitle   = NULL;
+  plc->trans       = NULL;
+  plc->index       = NULL;
+  plc->vmap        = NULL;
+  plc->timing      = TIMING_UNSET;
+  plc->timinghdr   = NULL;
+  plc->scanthreads = -1;
+  plc->prefetch    = -1;
+  plc->parallel    = NULL;
+  plc->library     = NULL;
   return plc;
 }
 
@@ -879,12 +3116,25 @@ static void *merge_dir_config(apr_pool_t *p,void *base,void *add)
   plc->bookdir   = plca->bookdir   != NULL ? plca->bookdir   : plcb->bookdir;
   plc->booktld   = plca->booktld   != NULL ? plca->booktld   : plcb->booktld;
   plc->booktitle = plca->booktitle != NULL ? plca->booktitle : plcb->booktitle;
-  plc->books     = plca->books     != NULL ? plca->books     : plcb->books;
-  plc->abrev     = plca->abrev     != NULL ? plca->abrev     : plcb->abrev;
-  plc->fullname  = plca->fullname  != NULL ? plca->fullname  : plcb->fullname;
-  plc->soundex   = plca->soundex   != NULL ? plca->soundex   : plcb->soundex;
-  plc->metaphone = plca->metaphone != NULL ? plca->metaphone : plcb->metaphone;
-  plc->maxbook   = plca->maxbook   >  0    ? plca->maxbook   : plcb->maxbook;
+  plc->trans     = plca->trans     != NULL ? plca->trans     : plcb->trans;
+  plc->index     = plca->index     != NULL ? plca->index     : plcb->index;
+  plc->vmap      = plca->vmap      != NULL ? plca->vmap      : plcb->vmap;
+  
+  if (plca->timing != TIMING_UNSET)
+  {
+    plc->timing    = plca->timing;
+    plc->timinghdr = plca->timinghdr;
+  }
+  else
+  {
+    plc->timing    = plcb->timing;
+    plc->timinghdr = plcb->timinghdr;
+  }
+  
+  plc->scanthreads = plca->scanthreads != -1 ? plca->scanthreads : plcb->scanthreads;
+  plc->prefetch    = plca->prefetch    != -1 ? plca->prefetch    : plcb->prefetch;
+  plc->parallel    = plca->parallel    != NULL ? plca->parallel    : plcb->parallel;
+  plc->library     = plca->library     != NULL ? plca->library     : plcb->library;
   return plc;
 }
 
@@ -893,17 +3143,37 @@ static void *merge_dir_config(apr_pool_t *p,void *base,void *add)
 static void modlitbook_hooks(apr_pool_t *p)
 {
   (void)p;
+  ap_hook_pre_config(init_pre,NULL,NULL,APR_HOOK_MIDDLE);
+  ap_hook_post_config(init_stats,NULL,NULL,APR_HOOK_MIDDLE);
+  ap_hook_post_config(init_cache,NULL,NULL,APR_HOOK_MIDDLE);
+  ap_hook_post_config(init_hot,NULL,NULL,APR_HOOK_LAST);
+  ap_hook_child_init(init_child,NULL,NULL,APR_HOOK_MIDDLE);
+  ap_hook_quick_handler(handle_cached,NULL,NULL,APR_HOOK_MIDDLE);
+  ap_hook_translate_name(hook_translate,NULL,NULL,APR_HOOK_MIDDLE);
+  ap_hook_map_to_storage(hook_storage,NULL,NULL,APR_HOOK_FIRST);
   ap_hook_handler(handle_request,NULL,NULL,APR_HOOK_MIDDLE);
+  ap_hook_handler(handle_parallel,NULL,NULL,APR_HOOK_MIDDLE);
+  ap_hook_handler(handle_library,NULL,NULL,APR_HOOK_MIDDLE);
+  ap_hook_handler(handle_status,NULL,NULL,APR_HOOK_MIDDLE);
 }
 
 /******************************************************************/
 
 static command_rec const modlitbook_cmds[] =
 {
-  AP_INIT_TAKE1("LitbookDir" ,        config_litbookdir,   NULL, ACCESS_CONF | OR_OPTIONS, "Specifies base location of book contents"),
-  AP_INIT_TAKE1("LitbookTranslation", config_litbooktrans, NULL, ACCESS_CONF | OR_OPTIONS, "Specifies the location of book/chapter titles and abbreviations"),
-  AP_INIT_TAKE1("LitbookIndex",       config_litbookindex, NULL, ACCESS_CONF | OR_OPTIONS, "The URL for the main indexpage for this book"),
-  AP_INIT_TAKE1("LitbookTitle",       config_litbooktitle, NULL, ACCESS_CONF | OR_OPTIONS, "Set the title of pages output by this module"),
+  AP_INIT_TAKE1( "LitbookDir",           config_litbookdir,      NULL, ACCESS_CONF | OR_OPTIONS, "Specifies base location of book contents"),
+  AP_INIT_TAKE1( "LitbookTranslation",   config_litbooktrans,    NULL, ACCESS_CONF | OR_OPTIONS, "Specifies the location of book/chapter titles and abbreviations"),
+  AP_INIT_TAKE1( "LitbookIndex",         config_litbookindex,    NULL, ACCESS_CONF | OR_OPTIONS, "The URL for the main indexpage for this book"),
+  AP_INIT_TAKE1( "LitbookTitle",         config_litbooktitle,    NULL, ACCESS_CONF | OR_OPTIONS, "Set the title of pages output by this module"),
+  AP_INIT_TAKE1( "LitbookServerTiming",  config_litbooktiming,   NULL, ACCESS_CONF | OR_OPTIONS, "On, Off, or a request header that turns on the Server-Timing header"),
+  AP_INIT_TAKE1( "LitbookScanThreads",   config_litbookscan,     NULL, ACCESS_CONF | OR_OPTIONS, "Threads for ?s= substring searches, 0 to turn them off"),
+  AP_INIT_FLAG(  "LitbookPrefetch",      config_litbookprefetch, NULL, ACCESS_CONF | OR_OPTIONS, "On to have the next chapter read in after one that's read to the end"),
+  AP_INIT_TAKE3( "LitbookParallel",      config_litbookpar,      NULL, ACCESS_CONF | OR_OPTIONS, "A label, data directory and translation file to show in parallel"),
+  AP_INIT_TAKE12("LitbookVersification", config_litbookvmap,     NULL, ACCESS_CONF | OR_OPTIONS, "A versification map, optionally for a LitbookParallel label"),
+  AP_INIT_TAKE1( "LitbookLibrary",       config_litbooklib,      NULL, ACCESS_CONF | OR_OPTIONS, "A directory of works, each in a directory of its own"),
+  AP_INIT_TAKE1( "LitbookLibraryCache",  config_litbooklibcache, NULL, ACCESS_CONF | OR_OPTIONS, "Works each process keeps loaded"),
+  AP_INIT_TAKE12("LitbookCache",         config_litbookcache,    NULL, RSRC_CONF,                "A socache type[:args] for whole pages, and seconds to keep them"),
+  AP_INIT_TAKE12("LitbookHotList",       config_litbookhot,      NULL, RSRC_CONF,                "A file to save the most asked for pages in, and seconds between saves"),
   { .name = NULL }
 };
 
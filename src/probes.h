@@ -0,0 +1,67 @@
+/******************************************************************
+*
+* probes.h              - Static tracepoints (USDT) for mod_litbook.
+*
+* Copyright 2022 by Sean Conner.  All Rights Reserved.
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*
+* Comments, questions and criticisms can be sent to: sean@conman.org
+*
+* -----------------------------------------------------------------
+*
+* Built with `make PROBES=-DHAVE_SYS_SDT_H' these become SystemTap style
+* probes (see <sys/sdt.h>) under the provider "litbook", which perf,
+* bpftrace and friends can attach to in a running process, for example
+*
+*       usdt:/path/to/mod_litbook.so:litbook:chapter__exit
+*
+* Each one is a single nop until something does.  Without
+* HAVE_SYS_SDT_H, they compile to nothing.
+*
+* Probes (arguments in order):
+*
+*       translate__entry        reference
+*       translate__exit         reference, book, c1, v1, c2, v2, tier
+*       chapter__entry          book, chapter, vlow, vhigh
+*       chapter__exit           book, chapter, status, bytes read so far
+*       read__index             book, chapter, bytes
+*       read__text              book, chapter, offset, bytes
+*       request__entry          uri
+*       render__entry           book, c1, c2
+*       render__exit            book, bytes rendered
+*       request__exit           uri, status, bytes sent
+*
+*******************************************************************/
+
+#ifndef LB_PROBES_H
+#define LB_PROBES_H
+
+#ifdef HAVE_SYS_SDT_H
+#  include <sys/sdt.h>
+#  define LB_PROBE1(n,a)                   DTRACE_PROBE1(litbook,n,a)
+#  define LB_PROBE2(n,a,b)                 DTRACE_PROBE2(litbook,n,a,b)
+#  define LB_PROBE3(n,a,b,c)               DTRACE_PROBE3(litbook,n,a,b,c)
+#  define LB_PROBE4(n,a,b,c,d)             DTRACE_PROBE4(litbook,n,a,b,c,d)
+#  define LB_PROBE7(n,a,b,c,d,e,f,g)       DTRACE_PROBE7(litbook,n,a,b,c,d,e,f,g)
+#else
+#  define LB_PROBE1(n,a)                   ((void)0)
+#  define LB_PROBE2(n,a,b)                 ((void)0)
+#  define LB_PROBE3(n,a,b,c)               ((void)0)
+#  define LB_PROBE4(n,a,b,c,d)             ((void)0)
+#  define LB_PROBE7(n,a,b,c,d,e,f,g)       ((void)0)
+#endif
+
+#endif
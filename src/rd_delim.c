@@ -0,0 +1,163 @@
+/******************************************************************
+*
+* rd_delim.c            - Reader for generic delimited text, one verse
+*                         per line.
+*
+* Copyright 2022 by Sean Conner.  All Rights Reserved.
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*
+* Comments, questions and criticisms can be sent to: sean@conman.org
+*
+* -----------------------------------------------------------------
+*
+* Each line is
+*
+*       book<d>chapter<d>verse<d>text
+*
+* where <d> defaults to a tab and can be changed with the reader
+* argument (breakout -d).  Blank lines and lines starting with '#' are
+* ignored.  The text is everything after the third delimiter, so it may
+* contain the delimiter.
+*
+********************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "util.h"
+#include "reader.h"
+
+/*****************************************************************/
+
+typedef struct delim
+{
+  struct reader  base;
+  int            delim;
+  char          *line;
+  size_t         lmax;
+  Size           lineno;
+} *Delim;
+
+/*****************************************************************/
+
+static bool      delim_next             (Reader,Record *);
+static void      delim_close            (Reader);
+static char     *delim_field            (char **,int);
+
+/*****************************************************************/
+
+Reader DelimOpen(FILE *fpin,char const *arg)
+{
+  Delim rdr;
+  
+  assert(fpin != NULL);
+  
+  rdr = malloc(sizeof(struct delim));
+  if (rdr == NULL) return(NULL);
+  
+  rdr->base.next  = delim_next;
+  rdr->base.close = delim_close;
+  rdr->delim      = ((arg != NULL) && (*arg != '\0')) ? *arg : '\t';
+  rdr->line       = NULL;
+  rdr->lmax       = 0;
+  rdr->lineno     = 0;
+  return(&rdr->base);
+}
+
+/*****************************************************************/
+
+static bool delim_next(Reader base,Record *rec)
+{
+  Delim rdr = (Delim)base;
+  
+  assert(rdr != NULL);
+  assert(rec != NULL);
+  
+  while(getline(&rdr->line,&rdr->lmax,base->fpin) > 0)
+  {
+    char *p = rdr->line;
+    char *book;
+    char *chapter;
+    char *verse;
+    
+    rdr->lineno++;
+    p[strcspn(p,"\r\n")] = '\0';
+    if ((*p == '#') || empty_string(p))
+      continue;
+      
+    book    = delim_field(&p,rdr->delim);
+    chapter = delim_field(&p,rdr->delim);
+    verse   = delim_field(&p,rdr->delim);
+    
+    if ((book == NULL) || (chapter == NULL) || (verse == NULL) || (p == NULL))
+    {
+      fprintf(stderr,"line %lu: missing fields---skipped\n",rdr->lineno);
+      continue;
+    }
+    
+    rec->book    = trim_space(book);
+    rec->chapter = strtoul(chapter,NULL,10);
+    rec->verse   = strtoul(verse,NULL,10);
+    rec->text    = trim_space(p);
+    
+    if ((rec->chapter == 0) || (rec->verse == 0))
+    {
+      fprintf(stderr,"line %lu: bad chapter or verse---skipped\n",rdr->lineno);
+      continue;
+    }
+    
+    return(true);
+  }
+  
+  return(false);
+}
+
+/*****************************************************************/
+
+static char *delim_field(char **pp,int delim)
+{
+  char *start = *pp;
+  char *p;
+  
+  if (start == NULL)
+    return(NULL);
+    
+  p = strchr(start,delim);
+  if (p == NULL)
+  {
+    *pp = NULL;
+    return(start);
+  }
+  
+  *p  = '\0';
+  *pp = p + 1;
+  return(start);
+}
+
+/*****************************************************************/
+
+static void delim_close(Reader base)
+{
+  Delim rdr = (Delim)base;
+  
+  assert(rdr != NULL);
+  free(rdr->line);
+  free(rdr);
+}
+
+/*****************************************************************/
@@ -0,0 +1,160 @@
+/******************************************************************
+*
+* rd_gutenberg.c        - Reader for the Project Gutenberg King James
+*                         Bible layout.
+*
+* Copyright 1999 by Sean Conner.  All Rights Reserved.
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*
+* Comments, questions and criticisms can be sent to: sean@conman.org
+*
+* -----------------------------------------------------------------
+*
+* The input is a series of paragraphs separated by blank lines.  A
+* paragraph is either a book heading:
+*
+*       Book 01 Genesis
+*
+* or a verse, prefixed with its chapter and verse number:
+*
+*       001:001 In the beginning God created the heaven and the earth.
+*
+* This is the code that used to be Genesis() in breakout.c.
+*
+********************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "util.h"
+#include "reader.h"
+
+/*****************************************************************/
+
+typedef struct gutenberg
+{
+  struct reader  base;
+  char          *book;
+  char          *buffer;
+} *Gutenberg;
+
+/*****************************************************************/
+
+static bool      gutenberg_next         (Reader,Record *);
+static void      gutenberg_close        (Reader);
+static char     *my_fgets               (FILE *);
+
+/*****************************************************************/
+
+Reader GutenbergOpen(FILE *fpin,char const *arg)
+{
+  Gutenberg rdr;
+  
+  (void)arg;
+  assert(fpin != NULL);
+  
+  rdr = malloc(sizeof(struct gutenberg));
+  if (rdr == NULL) return(NULL);
+  
+  rdr->base.next  = gutenberg_next;
+  rdr->base.close = gutenberg_close;
+  rdr->book       = NULL;
+  rdr->buffer     = NULL;
+  return(&rdr->base);
+}
+
+/*****************************************************************/
+
+static bool gutenberg_next(Reader base,Record *rec)
+{
+  Gutenberg rdr = (Gutenberg)base;
+  
+  assert(rdr != NULL);
+  assert(rec != NULL);
+  
+  while(true)
+  {
+    free(rdr->buffer);
+    rdr->buffer = my_fgets(base->fpin);
+    if (rdr->buffer == NULL)
+      return(false);
+      
+    if (strncmp(rdr->buffer,"Book ",5) == 0)
+    {
+      free(rdr->book);
+      rdr->book   = rdr->buffer;
+      rdr->buffer = NULL;
+      continue;
+    }
+    
+    if ((rdr->book == NULL) || (strlen(rdr->buffer) < 8))
+      continue;
+      
+    rec->book    = &rdr->book[8];
+    rec->chapter = strtoul(rdr->buffer,NULL,10);
+    rec->verse   = strtoul(&rdr->buffer[4],NULL,10);
+    rec->text    = &rdr->buffer[8];
+    return(true);
+  }
+}
+
+/*****************************************************************/
+
+static void gutenberg_close(Reader base)
+{
+  Gutenberg rdr = (Gutenberg)base;
+  
+  assert(rdr != NULL);
+  free(rdr->book);
+  free(rdr->buffer);
+  free(rdr);
+}
+
+/****************************************************************/
+
+static char *my_fgets(FILE *fpin)
+{
+  static char  rbuffer[BUFSIZ];
+  static char  sbuffer[65536UL];
+  char        *p;
+  
+  memset(rbuffer,0,sizeof(rbuffer));
+  memset(sbuffer,0,sizeof(sbuffer));
+  
+  for (p = sbuffer ; ; )
+  {
+    if (fgets(rbuffer,sizeof(rbuffer),fpin) == NULL) break;
+    if (empty_string(rbuffer))
+    {
+      if (p == sbuffer) continue;
+      return(dup_string(&sbuffer[1]));
+    }
+    
+    p += sprintf(p," %s",remove_ctrl(trim_space(rbuffer)));
+  }
+  
+  /*---------------------------------------------------------------
+  ; The last paragraph in the file may not be followed by a blank line.
+  ;----------------------------------------------------------------*/
+  
+  if (p != sbuffer)
+    return(dup_string(&sbuffer[1]));
+  return(NULL);
+}
+
+/********************************************************************/
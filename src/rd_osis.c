@@ -0,0 +1,558 @@
+/******************************************************************
+*
+* rd_osis.c             - Reader for OSIS XML documents.
+*
+* Copyright 2022 by Sean Conner.  All Rights Reserved.
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*
+* Comments, questions and criticisms can be sent to: sean@conman.org
+*
+* -----------------------------------------------------------------
+*
+* This is not a general XML parser.  It's a character at a time scanner
+* that knows just enough about OSIS to pull out verses, in either the
+* container form:
+*
+*       <verse osisID="Gen.1.1">In the beginning ...</verse>
+*
+* or the milestone form:
+*
+*       <verse sID="Gen.1.1" osisID="Gen.1.1"/>In the beginning ...
+*       <verse eID="Gen.1.1"/>
+*
+* Only the current tag and the current verse are ever held in memory, so
+* the size of the document doesn't matter.  The text of <note> and
+* <title> elements is dropped; all other markup is stripped and the text
+* kept.
+*
+********************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <assert.h>
+
+#include "reader.h"
+
+/*****************************************************************/
+
+typedef struct buffer
+{
+  char   *data;
+  size_t  len;
+  size_t  max;
+} Buffer;
+
+typedef struct osis
+{
+  struct reader base;
+  Buffer        tag;
+  Buffer        text;
+  char          book[64];
+  char          next[64];
+  char          pending[64];            /* verse that started before the last ended */
+  bool          pendempty;
+  Size          chapter;
+  Size          verse;
+  bool          inverse;
+  int           skip;
+  bool          space;
+} *Osis;
+
+/*****************************************************************/
+
+static bool      osis_next              (Reader,Record *);
+static void      osis_close             (Reader);
+static bool      osis_tag               (Osis);
+static void      osis_char              (Osis,int);
+static void      osis_entity            (Osis);
+static bool      osis_attr              (char const *,char const *,char *,size_t);
+static bool      osis_id                (Osis,char const *);
+static bool      osis_start             (Osis,char const *,bool);
+static void      osis_record            (Osis,Record *);
+static void      buf_add                (Buffer *,int);
+static void      buf_utf8               (Buffer *,unsigned long);
+
+/*****************************************************************/
+
+Reader OsisOpen(FILE *fpin,char const *arg)
+{
+  Osis rdr;
+  
+  (void)arg;
+  assert(fpin != NULL);
+  
+  rdr = calloc(1,sizeof(struct osis));
+  if (rdr == NULL) return(NULL);
+  
+  rdr->base.next  = osis_next;
+  rdr->base.close = osis_close;
+  return(&rdr->base);
+}
+
+/*****************************************************************/
+
+static bool osis_next(Reader base,Record *rec)
+{
+  Osis rdr = (Osis)base;
+  int  c;
+  
+  assert(rdr != NULL);
+  assert(rec != NULL);
+  
+  /*-------------------------------------------------------------
+  ; A verse that started while the last one was still open had to
+  ; wait for that one to be handed back; start it now.
+  ;--------------------------------------------------------------*/
+  
+  if (rdr->pending[0] != '\0')
+  {
+    bool done = osis_start(rdr,rdr->pending,rdr->pendempty);
+    
+    rdr->pending[0] = '\0';
+    if (done)
+    {
+      osis_record(rdr,rec);
+      return(true);
+    }
+  }
+  
+  while((c = getc(base->fpin)) != EOF)
+  {
+    if (c == '<')
+    {
+      if (osis_tag(rdr))
+      {
+        osis_record(rdr,rec);
+        return(true);
+      }
+    }
+    else if (c == '&')
+      osis_entity(rdr);
+    else
+      osis_char(rdr,c);
+  }
+  
+  return(false);
+}
+
+/*****************************************************************/
+
+/*****************************************************************
+;
+; A verse just ended.  Trim the trailing space (if any) and hand it
+; back.
+;
+******************************************************************/
+
+static void osis_record(Osis rdr,Record *rec)
+{
+  assert(rdr != NULL);
+  assert(rec != NULL);
+  
+  if ((rdr->text.len > 0) && (rdr->text.data[rdr->text.len - 1] == ' '))
+    rdr->text.data[--rdr->text.len] = '\0';
+    
+  rec->book    = rdr->book;
+  rec->chapter = rdr->chapter;
+  rec->verse   = rdr->verse;
+  rec->text    = rdr->text.data;
+}
+
+/*****************************************************************/
+
+static void osis_close(Reader base)
+{
+  Osis rdr = (Osis)base;
+  
+  assert(rdr != NULL);
+  free(rdr->tag.data);
+  free(rdr->text.data);
+  free(rdr);
+}
+
+/*****************************************************************
+;
+; Read in a tag (the leading '<' has been consumed) and act upon it.
+; Returns true if the tag ends a verse.
+;
+******************************************************************/
+
+static bool osis_tag(Osis rdr)
+{
+  char  name[32];
+  char  id[64];
+  char *p;
+  bool  close;
+  bool  empty;
+  int   c;
+  int   quote = 0;
+  
+  assert(rdr != NULL);
+  
+  rdr->tag.len = 0;
+  while((c = getc(rdr->base.fpin)) != EOF)
+  {
+    if (quote)
+    {
+      if (c == quote) quote = 0;
+    }
+    else if ((c == '"') || (c == '\''))
+      quote = c;
+    else if (c == '>')
+    {
+      /*------------------------------------------------------------
+      ; Comments may contain '>', so keep going until we see "-->".
+      ;-------------------------------------------------------------*/
+      
+      if (
+              (rdr->tag.len >= 3)
+           && (strncmp(rdr->tag.data,"!--",3) == 0)
+           && (
+                   (rdr->tag.len < 5)
+                || (strncmp(&rdr->tag.data[rdr->tag.len - 2],"--",2) != 0)
+              )
+         )
+      {
+        buf_add(&rdr->tag,c);
+        continue;
+      }
+      break;
+    }
+    
+    buf_add(&rdr->tag,c);
+  }
+  
+  buf_add(&rdr->tag,'\0');
+  rdr->tag.len--;
+  p = rdr->tag.data;
+  
+  if ((*p == '!') || (*p == '?'))
+    return(false);
+    
+  close = (*p == '/');
+  if (close) p++;
+  empty = (rdr->tag.len > 0) && (rdr->tag.data[rdr->tag.len - 1] == '/');
+  
+  for (size_t i = 0 ; i < sizeof(name) - 1 ; i++)
+  {
+    if ((*p == '\0') || isspace(*p) || (*p == '/') || (*p == '>'))
+    {
+      name[i] = '\0';
+      break;
+    }
+    name[i]     = *p++;
+    name[i + 1] = '\0';
+  }
+  
+  /*--------------------------------------------------------------
+  ; Element content we don't want in the verse text.  Nesting is
+  ; tracked by a simple counter.
+  ;---------------------------------------------------------------*/
+  
+  if ((strcmp(name,"note") == 0) || (strcmp(name,"title") == 0))
+  {
+    if (close)
+    {
+      if (rdr->skip > 0) rdr->skip--;
+    }
+    else if (!empty)
+      rdr->skip++;
+    return(false);
+  }
+  
+  if (strcmp(name,"verse") != 0)
+  {
+    /*-----------------------------------------------------------
+    ; Block level elements separate words even though there's no
+    ; whitespace in the source.
+    ;------------------------------------------------------------*/
+    
+    if (
+            (strcmp(name,"p")  == 0)
+         || (strcmp(name,"l")  == 0)
+         || (strcmp(name,"lb") == 0)
+         || (strcmp(name,"lg") == 0)
+       )
+      osis_char(rdr,' ');
+    return(false);
+  }
+  
+  if (close)
+  {
+    if (!rdr->inverse) return(false);
+    rdr->inverse = false;
+    return(true);
+  }
+  
+  if (osis_attr(p,"eID",id,sizeof(id)))
+  {
+    if (!rdr->inverse) return(false);
+    rdr->inverse = false;
+    return(true);
+  }
+  
+  if (!osis_attr(p,"osisID",id,sizeof(id)) && !osis_attr(p,"sID",id,sizeof(id)))
+    return(false);
+    
+  /*-------------------------------------------------------------
+  ; An empty <verse/> without an sID is a verse with no text.
+  ;--------------------------------------------------------------*/
+  
+  {
+    char sid[64];
+    
+    empty = empty && !osis_attr(p,"sID",sid,sizeof(sid));
+  }
+  
+  /*-------------------------------------------------------------
+  ; A new verse with the last one still open (a missing eID, or a
+  ; missing </verse>) ends the open one.  It goes back first, and the
+  ; new one is started on the next call.
+  ;--------------------------------------------------------------*/
+  
+  if (rdr->inverse)
+  {
+    strcpy(rdr->pending,id);
+    rdr->pendempty = empty;
+    rdr->inverse   = false;
+    return(true);
+  }
+  
+  return(osis_start(rdr,id,empty));
+}
+
+/*****************************************************************
+;
+; Start a verse.  Returns true if it's already over (an empty verse).
+;
+******************************************************************/
+
+static bool osis_start(Osis rdr,char const *id,bool empty)
+{
+  assert(rdr != NULL);
+  assert(id  != NULL);
+  
+  if (!osis_id(rdr,id))
+    return(false);
+    
+  rdr->text.len = 0;
+  buf_add(&rdr->text,'\0');
+  rdr->text.len = 0;
+  rdr->inverse  = true;
+  rdr->space    = false;
+  rdr->skip     = 0;
+  
+  if (empty)
+  {
+    rdr->inverse = false;
+    return(true);
+  }
+  
+  return(false);
+}
+
+/*****************************************************************/
+
+static void osis_char(Osis rdr,int c)
+{
+  assert(rdr != NULL);
+  
+  if (!rdr->inverse || (rdr->skip > 0))
+    return;
+    
+  if (isspace(c))
+  {
+    if ((rdr->text.len > 0) && !rdr->space)
+    {
+      buf_add(&rdr->text,' ');
+      rdr->space = true;
+    }
+  }
+  else
+  {
+    buf_add(&rdr->text,c);
+    rdr->space = false;
+  }
+  
+  buf_add(&rdr->text,'\0');
+  rdr->text.len--;
+}
+
+/*****************************************************************/
+
+static void osis_entity(Osis rdr)
+{
+  char          name[16];
+  size_t        len = 0;
+  unsigned long cp;
+  int           c;
+  
+  assert(rdr != NULL);
+  
+  while(((c = getc(rdr->base.fpin)) != EOF) && (c != ';') && (len < sizeof(name) - 1))
+    name[len++] = c;
+  name[len] = '\0';
+  
+  if (!rdr->inverse || (rdr->skip > 0))
+    return;
+    
+  if      (strcmp(name,"amp")  == 0) osis_char(rdr,'&');
+  else if (strcmp(name,"lt")   == 0) osis_char(rdr,'<');
+  else if (strcmp(name,"gt")   == 0) osis_char(rdr,'>');
+  else if (strcmp(name,"quot") == 0) osis_char(rdr,'"');
+  else if (strcmp(name,"apos") == 0) osis_char(rdr,'\'');
+  else if (name[0] == '#')
+  {
+    if ((name[1] == 'x') || (name[1] == 'X'))
+      cp = strtoul(&name[2],NULL,16);
+    else
+      cp = strtoul(&name[1],NULL,10);
+      
+    if (cp < 128)
+      osis_char(rdr,(int)cp);
+    else
+    {
+      buf_utf8(&rdr->text,cp);
+      buf_add(&rdr->text,'\0');
+      rdr->text.len--;
+      rdr->space = false;
+    }
+  }
+}
+
+/*****************************************************************/
+
+static bool osis_attr(char const *tag,char const *attr,char *dest,size_t max)
+{
+  size_t len = strlen(attr);
+  
+  assert(tag  != NULL);
+  assert(attr != NULL);
+  assert(dest != NULL);
+  assert(max  >  0);
+  
+  for (char const *p = tag ; (p = strstr(p,attr)) != NULL ; p += len)
+  {
+    char const *v;
+    int         quote;
+    size_t      i;
+    
+    if ((p > tag) && !isspace(p[-1]))
+      continue;
+      
+    for (v = p + len ; isspace(*v) ; v++)
+      ;
+    if (*v++ != '=')
+      continue;
+    for ( ; isspace(*v) ; v++)
+      ;
+    if ((*v != '"') && (*v != '\''))
+      continue;
+      
+    quote = *v++;
+    for (i = 0 ; (*v) && (*v != quote) && (i < max - 1) ; i++)
+      dest[i] = *v++;
+    dest[i] = '\0';
+    return(true);
+  }
+  
+  return(false);
+}
+
+/*****************************************************************
+;
+; Parse an osisID like "Gen.1.1" (or the first of "Gen.1.1 Gen.1.2").
+;
+******************************************************************/
+
+static bool osis_id(Osis rdr,char const *id)
+{
+  char  *p;
+  size_t len;
+  
+  assert(rdr != NULL);
+  assert(id  != NULL);
+  
+  len = strcspn(id,". ");
+  if ((len == 0) || (len >= sizeof(rdr->next)) || (id[len] != '.'))
+    return(false);
+    
+  memcpy(rdr->next,id,len);
+  rdr->next[len] = '\0';
+  
+  rdr->chapter = strtoul(&id[len + 1],&p,10);
+  if ((rdr->chapter == 0) || (*p != '.'))
+    return(false);
+  rdr->verse = strtoul(p + 1,NULL,10);
+  if (rdr->verse == 0)
+    return(false);
+    
+  strcpy(rdr->book,ReaderBookName(rdr->next));
+  return(true);
+}
+
+/*****************************************************************/
+
+static void buf_add(Buffer *buf,int c)
+{
+  assert(buf != NULL);
+  
+  if (buf->len == buf->max)
+  {
+    size_t  max  = buf->max ? buf->max * 2 : 256;
+    char   *data = realloc(buf->data,max);
+    
+    if (data == NULL)
+    {
+      perror("out of memory---aborting");
+      exit(1);
+    }
+    buf->data = data;
+    buf->max  = max;
+  }
+  
+  buf->data[buf->len++] = c;
+}
+
+/*****************************************************************/
+
+static void buf_utf8(Buffer *buf,unsigned long cp)
+{
+  assert(buf != NULL);
+  
+  if (cp < 0x800)
+  {
+    buf_add(buf,0xC0 | (cp >> 6));
+    buf_add(buf,0x80 | (cp & 0x3F));
+  }
+  else if (cp < 0x10000)
+  {
+    buf_add(buf,0xE0 | (cp >> 12));
+    buf_add(buf,0x80 | ((cp >> 6) & 0x3F));
+    buf_add(buf,0x80 | (cp & 0x3F));
+  }
+  else
+  {
+    buf_add(buf,0xF0 | (cp >> 18));
+    buf_add(buf,0x80 | ((cp >> 12) & 0x3F));
+    buf_add(buf,0x80 | ((cp >> 6) & 0x3F));
+    buf_add(buf,0x80 | (cp & 0x3F));
+  }
+}
+
+/*****************************************************************/
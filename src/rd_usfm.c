@@ -0,0 +1,387 @@
+/******************************************************************
+*
+* rd_usfm.c             - Reader for USFM (Unified Standard Format
+*                         Markers) documents.
+*
+* Copyright 2022 by Sean Conner.  All Rights Reserved.
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*
+* Comments, questions and criticisms can be sent to: sean@conman.org
+*
+* -----------------------------------------------------------------
+*
+* The markers we care about:
+*
+*       \id GEN         book (mapped through ReaderBookName())
+*       \c 1            chapter
+*       \v 1 text       verse, which runs until the next \v, \c or \id
+*
+* Headings and other "rest of line" markers are skipped, footnotes
+* (\f ... \f*) and cross references (\x ... \x*) are dropped, and
+* character markers (\wj, \add, \nd, \w word|attrs\w* etc) are removed
+* leaving their text.  Several books may be concatenated in one stream.
+*
+********************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <assert.h>
+
+#include "reader.h"
+
+/*****************************************************************/
+
+typedef struct usfm
+{
+  struct reader  base;
+  char          *line;
+  size_t         lmax;
+  char          *text;
+  size_t         tlen;
+  size_t         tmax;
+  char           book[64];
+  char           nbook[64];
+  Size           chapter;
+  Size           verse;
+  bool           inverse;
+  bool           eof;
+  char          *p;
+  char           skipto[20];
+} *Usfm;
+
+/*****************************************************************/
+
+static bool      usfm_next              (Reader,Record *);
+static void      usfm_close             (Reader);
+static bool      usfm_getline           (Usfm);
+static void      usfm_add               (Usfm,char const *,size_t);
+static bool      usfm_marker            (Usfm,char const *);
+static bool      usfm_restofline        (char const *);
+
+/*****************************************************************/
+
+Reader UsfmOpen(FILE *fpin,char const *arg)
+{
+  Usfm rdr;
+  
+  (void)arg;
+  assert(fpin != NULL);
+  
+  rdr = calloc(1,sizeof(struct usfm));
+  if (rdr == NULL) return(NULL);
+  
+  rdr->base.next  = usfm_next;
+  rdr->base.close = usfm_close;
+  return(&rdr->base);
+}
+
+/*****************************************************************/
+
+static bool usfm_next(Reader base,Record *rec)
+{
+  Usfm rdr = (Usfm)base;
+  
+  assert(rdr != NULL);
+  assert(rec != NULL);
+  
+  while(true)
+  {
+    if ((rdr->p == NULL) || (*rdr->p == '\0'))
+    {
+      if (!usfm_getline(rdr))
+      {
+        rdr->eof = true;
+        if (rdr->inverse)
+          break;
+        return(false);
+      }
+      rdr->p = rdr->line;
+      
+      /*--------------------------------------------------------------
+      ; Line breaks are word breaks.
+      ;---------------------------------------------------------------*/
+      
+      usfm_add(rdr," ",1);
+    }
+    
+    if (*rdr->p == '\\')
+    {
+      char   marker[16];
+      size_t len;
+      
+      rdr->p++;
+      for (len = 0 ; (len < sizeof(marker) - 1) && (*rdr->p) && !isspace(*rdr->p) && (*rdr->p != '\\') ; len++)
+      {
+        marker[len] = *rdr->p++;
+        if (marker[len] == '*')
+        {
+          len++;
+          break;
+        }
+      }
+      marker[len] = '\0';
+      
+      /*-------------------------------------------------------------
+      ; The space after an opening marker belongs to the marker; the
+      ; space after a closing marker (\wj*) is part of the text.
+      ;--------------------------------------------------------------*/
+      
+      if ((len > 0) && (marker[len - 1] != '*') && isspace(*rdr->p)) rdr->p++;
+      
+      if (usfm_marker(rdr,marker))
+        break;
+    }
+    else
+    {
+      size_t len = strcspn(rdr->p,"\\|");
+      
+      if (rdr->skipto[0] == '\0')
+        usfm_add(rdr,rdr->p,len);
+      rdr->p += len;
+      
+      /*-------------------------------------------------------------
+      ; \w word|lemma="..." strong="..."\w* --- drop the attributes.
+      ;--------------------------------------------------------------*/
+      
+      if (*rdr->p == '|')
+        rdr->p += strcspn(rdr->p,"\\");
+    }
+  }
+  
+  /*---------------------------------------------------------------
+  ; Collapse the whitespace in the verse we've accumulated.
+  ;----------------------------------------------------------------*/
+  
+  {
+    char *s = rdr->text;
+    char *d = rdr->text;
+    bool  sp = true;
+    
+    for ( ; s < rdr->text + rdr->tlen ; s++)
+    {
+      if (isspace(*s))
+      {
+        if (!sp) *d++ = ' ';
+        sp = true;
+      }
+      else
+      {
+        *d++ = *s;
+        sp   = false;
+      }
+    }
+    if ((d > rdr->text) && (d[-1] == ' ')) d--;
+    *d = '\0';
+  }
+  
+  rec->book    = rdr->book;
+  rec->chapter = rdr->chapter;
+  rec->verse   = rdr->verse;
+  rec->text    = rdr->text;
+  rdr->inverse = false;
+  rdr->tlen    = 0;
+  return(true);
+}
+
+/*****************************************************************
+;
+; Handle a marker.  Returns true if it ends the current verse.  The
+; marker that ends a verse is handled on the next call (we back up the
+; pointer to it).
+;
+******************************************************************/
+
+static bool usfm_marker(Usfm rdr,char const *marker)
+{
+  assert(rdr    != NULL);
+  assert(marker != NULL);
+  
+  if (rdr->skipto[0] != '\0')
+  {
+    if (strcmp(marker,rdr->skipto) == 0)
+      rdr->skipto[0] = '\0';
+    return(false);
+  }
+  
+  if ((strcmp(marker,"id") == 0) || (strcmp(marker,"c") == 0) || (strcmp(marker,"v") == 0))
+  {
+    char *start = rdr->p;
+    
+    if (rdr->inverse)
+    {
+      /*-----------------------------------------------------------
+      ; back up to the marker so we see it again next time around
+      ;------------------------------------------------------------*/
+      
+      for (rdr->p-- ; *rdr->p != '\\' ; rdr->p--)
+        ;
+      return(true);
+    }
+    
+    if (strcmp(marker,"id") == 0)
+    {
+      size_t len = strcspn(start," \t\r\n");
+      
+      if (len >= sizeof(rdr->nbook)) len = sizeof(rdr->nbook) - 1;
+      memcpy(rdr->nbook,start,len);
+      rdr->nbook[len] = '\0';
+      strcpy(rdr->book,ReaderBookName(rdr->nbook));
+      rdr->chapter = 0;
+      rdr->p = start + strlen(start);
+    }
+    else if (strcmp(marker,"c") == 0)
+      rdr->chapter = strtoul(start,&rdr->p,10);
+    else
+    {
+      rdr->verse = strtoul(start,&rdr->p,10);
+      
+      /*-----------------------------------------------------------
+      ; Verse bridges (\v 1-2) get reported as the first verse; the
+      ; writer leaves the rest of the bridge empty.
+      ;------------------------------------------------------------*/
+      
+      if (*rdr->p == '-')
+        strtoul(rdr->p + 1,&rdr->p,10);
+      if ((rdr->book[0] != '\0') && (rdr->chapter > 0) && (rdr->verse > 0))
+      {
+        rdr->inverse = true;
+        rdr->tlen    = 0;
+        usfm_add(rdr,"",0);
+      }
+    }
+    return(false);
+  }
+  
+  if ((strcmp(marker,"f") == 0) || (strcmp(marker,"fe") == 0) || (strcmp(marker,"x") == 0))
+  {
+    snprintf(rdr->skipto,sizeof(rdr->skipto),"%s*",marker);
+    return(false);
+  }
+  
+  if (usfm_restofline(marker))
+  {
+    rdr->p += strlen(rdr->p);
+    return(false);
+  }
+  
+  /*--------------------------------------------------------------
+  ; Paragraph and character markers just go away.
+  ;---------------------------------------------------------------*/
+  
+  return(false);
+}
+
+/*****************************************************************/
+
+static bool usfm_restofline(char const *marker)
+{
+  static char const *const rol[] =
+  {
+    "h" , "toc" , "mt" , "ms" , "mr" , "s" , "sr" , "r" , "d" , "sp" ,
+    "ide" , "rem" , "sts" , "cl" , "cp" , "cd" , "is" , "ip" , "imt" ,
+    "usfm" , "mte" , "periph" ,
+  };
+  
+  assert(marker != NULL);
+  
+  for (size_t i = 0 ; i < sizeof(rol) / sizeof(rol[0]) ; i++)
+  {
+    size_t len = strlen(rol[i]);
+    
+    if (strncmp(marker,rol[i],len) != 0)
+      continue;
+    if ((marker[len] == '\0') || isdigit(marker[len]))
+      return(true);
+  }
+  return(false);
+}
+
+/*****************************************************************/
+
+static bool usfm_getline(Usfm rdr)
+{
+  size_t len = 0;
+  
+  assert(rdr != NULL);
+  
+  if (rdr->eof) return(false);
+  if (rdr->line == NULL)
+  {
+    rdr->lmax = BUFSIZ;
+    rdr->line = malloc(rdr->lmax);
+    if (rdr->line == NULL) return(false);
+  }
+  
+  while(fgets(&rdr->line[len],rdr->lmax - len,rdr->base.fpin) != NULL)
+  {
+    len += strlen(&rdr->line[len]);
+    if ((len > 0) && (rdr->line[len - 1] == '\n'))
+      return(true);
+    if (len == rdr->lmax - 1)
+    {
+      char *n = realloc(rdr->line,rdr->lmax * 2);
+      if (n == NULL) return(false);
+      rdr->line  = n;
+      rdr->lmax *= 2;
+    }
+  }
+  
+  return(len > 0);
+}
+
+/*****************************************************************/
+
+static void usfm_add(Usfm rdr,char const *s,size_t len)
+{
+  assert(rdr != NULL);
+  assert(s   != NULL);
+  
+  if (!rdr->inverse)
+    return;
+    
+  if (rdr->tlen + len + 1 > rdr->tmax)
+  {
+    size_t  max  = (rdr->tlen + len + 1) * 2;
+    char   *text = realloc(rdr->text,max);
+    
+    if (text == NULL)
+    {
+      perror("out of memory---aborting");
+      exit(1);
+    }
+    rdr->text = text;
+    rdr->tmax = max;
+  }
+  
+  memcpy(&rdr->text[rdr->tlen],s,len);
+  rdr->tlen += len;
+}
+
+/*****************************************************************/
+
+static void usfm_close(Reader base)
+{
+  Usfm rdr = (Usfm)base;
+  
+  assert(rdr != NULL);
+  free(rdr->line);
+  free(rdr->text);
+  free(rdr);
+}
+
+/*****************************************************************/
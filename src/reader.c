@@ -0,0 +1,198 @@
+/******************************************************************
+*
+* reader.c              - Registry of input format readers and the
+*                         book code table they share.
+*
+* Copyright 2022 by Sean Conner.  All Rights Reserved.
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*
+* Comments, questions and criticisms can be sent to: sean@conman.org
+*
+********************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <assert.h>
+
+#include "reader.h"
+
+/*****************************************************************/
+
+static struct
+{
+  char const  *name;
+  ReaderOpenf  open;
+  char const  *desc;
+} const m_readers[] =
+{
+  { "gutenberg" , GutenbergOpen , "Project Gutenberg \"Book NN name\" / \"CCC:VVV text\"" } ,
+  { "osis"      , OsisOpen      , "OSIS XML (container or milestone verses)"             } ,
+  { "usfm"      , UsfmOpen      , "Unified Standard Format Markers"                      } ,
+  { "delim"     , DelimOpen     , "book<d>chapter<d>verse<d>text, one verse per line"    } ,
+};
+
+/*------------------------------------------------------------------
+; OSIS and USFM both identify books by short codes.  Map them to the
+; names used for the book directories (which are the full names used in
+; the translation file).
+;-------------------------------------------------------------------*/
+
+static struct
+{
+  char const *osis;
+  char const *usfm;
+  char const *name;
+} const m_books[] =
+{
+  { "Gen"    , "GEN" , "Genesis"         } ,
+  { "Exod"   , "EXO" , "Exodus"          } ,
+  { "Lev"    , "LEV" , "Leviticus"       } ,
+  { "Num"    , "NUM" , "Numbers"         } ,
+  { "Deut"   , "DEU" , "Deuteronomy"     } ,
+  { "Josh"   , "JOS" , "Joshua"          } ,
+  { "Judg"   , "JDG" , "Judges"          } ,
+  { "Ruth"   , "RUT" , "Ruth"            } ,
+  { "1Sam"   , "1SA" , "1Samuel"         } ,
+  { "2Sam"   , "2SA" , "2Samuel"         } ,
+  { "1Kgs"   , "1KI" , "1Kings"          } ,
+  { "2Kgs"   , "2KI" , "2Kings"          } ,
+  { "1Chr"   , "1CH" , "1Chronicles"     } ,
+  { "2Chr"   , "2CH" , "2Chronicles"     } ,
+  { "Ezra"   , "EZR" , "Ezra"            } ,
+  { "Neh"    , "NEH" , "Nehemiah"        } ,
+  { "Esth"   , "EST" , "Esther"          } ,
+  { "Job"    , "JOB" , "Job"             } ,
+  { "Ps"     , "PSA" , "Psalms"          } ,
+  { "Prov"   , "PRO" , "Proverbs"        } ,
+  { "Eccl"   , "ECC" , "Ecclesiastes"    } ,
+  { "Song"   , "SNG" , "Songsofsolomon"  } ,
+  { "Isa"    , "ISA" , "Isaiah"          } ,
+  { "Jer"    , "JER" , "Jeremiah"        } ,
+  { "Lam"    , "LAM" , "Lamentations"    } ,
+  { "Ezek"   , "EZK" , "Ezekiel"         } ,
+  { "Dan"    , "DAN" , "Daniel"          } ,
+  { "Hos"    , "HOS" , "Hosea"           } ,
+  { "Joel"   , "JOL" , "Joel"            } ,
+  { "Amos"   , "AMO" , "Amos"            } ,
+  { "Obad"   , "OBA" , "Obadiah"         } ,
+  { "Jonah"  , "JON" , "Jonah"           } ,
+  { "Mic"    , "MIC" , "Micah"           } ,
+  { "Nah"    , "NAM" , "Nahum"           } ,
+  { "Hab"    , "HAB" , "Habbakuk"        } ,
+  { "Zeph"   , "ZEP" , "Zephaniah"       } ,
+  { "Hag"    , "HAG" , "Haggai"          } ,
+  { "Zech"   , "ZEC" , "Zechariah"       } ,
+  { "Mal"    , "MAL" , "Malachi"         } ,
+  { "Matt"   , "MAT" , "Matthew"         } ,
+  { "Mark"   , "MRK" , "Mark"            } ,
+  { "Luke"   , "LUK" , "Luke"            } ,
+  { "John"   , "JHN" , "John"            } ,
+  { "Acts"   , "ACT" , "Acts"            } ,
+  { "Rom"    , "ROM" , "Romans"          } ,
+  { "1Cor"   , "1CO" , "1Corinthians"    } ,
+  { "2Cor"   , "2CO" , "2Corinthians"    } ,
+  { "Gal"    , "GAL" , "Galatians"       } ,
+  { "Eph"    , "EPH" , "Ephesians"       } ,
+  { "Phil"   , "PHP" , "Philippians"     } ,
+  { "Col"    , "COL" , "Colossians"      } ,
+  { "1Thess" , "1TH" , "1Thessalonians"  } ,
+  { "2Thess" , "2TH" , "2Thessalonians"  } ,
+  { "1Tim"   , "1TI" , "1Timothy"        } ,
+  { "2Tim"   , "2TI" , "2Timothy"        } ,
+  { "Titus"  , "TIT" , "Titus"           } ,
+  { "Phlm"   , "PHM" , "Philemon"        } ,
+  { "Heb"    , "HEB" , "Hebrews"         } ,
+  { "Jas"    , "JAS" , "James"           } ,
+  { "1Pet"   , "1PE" , "1Peter"          } ,
+  { "2Pet"   , "2PE" , "2Peter"          } ,
+  { "1John"  , "1JN" , "1John"           } ,
+  { "2John"  , "2JN" , "2John"           } ,
+  { "3John"  , "3JN" , "3John"           } ,
+  { "Jude"   , "JUD" , "Jude"            } ,
+  { "Rev"    , "REV" , "Revelation"      } ,
+};
+
+/*****************************************************************/
+
+Reader ReaderOpen(char const *name,FILE *fpin,char const *arg)
+{
+  assert(name != NULL);
+  assert(fpin != NULL);
+  
+  for (size_t i = 0 ; i < sizeof(m_readers) / sizeof(m_readers[0]) ; i++)
+  {
+    if (strcmp(name,m_readers[i].name) == 0)
+    {
+      Reader rdr = (*m_readers[i].open)(fpin,arg);
+      if (rdr != NULL)
+      {
+        rdr->name = m_readers[i].name;
+        rdr->fpin = fpin;
+      }
+      return(rdr);
+    }
+  }
+  
+  return(NULL);
+}
+
+/*****************************************************************/
+
+bool ReaderNext(Reader rdr,Record *rec)
+{
+  assert(rdr != NULL);
+  assert(rec != NULL);
+  
+  return((*rdr->next)(rdr,rec));
+}
+
+/*****************************************************************/
+
+void ReaderClose(Reader rdr)
+{
+  assert(rdr != NULL);
+  (*rdr->close)(rdr);
+}
+
+/*****************************************************************/
+
+void ReaderList(FILE *fpout)
+{
+  assert(fpout != NULL);
+  
+  for (size_t i = 0 ; i < sizeof(m_readers) / sizeof(m_readers[0]) ; i++)
+    fprintf(fpout,"\t%-10s %s\n",m_readers[i].name,m_readers[i].desc);
+}
+
+/*****************************************************************/
+
+char const *ReaderBookName(char const *code)
+{
+  assert(code != NULL);
+  
+  for (size_t i = 0 ; i < sizeof(m_books) / sizeof(m_books[0]) ; i++)
+  {
+    if (strcmp(code,m_books[i].osis) == 0)
+      return(m_books[i].name);
+    if (strcasecmp(code,m_books[i].usfm) == 0)
+      return(m_books[i].name);
+  }
+  
+  return(code);
+}
+
+/*****************************************************************/
@@ -0,0 +1,77 @@
+/******************************************************************
+*
+* reader.h              - API for the input format readers used by
+*                         breakout.
+*
+* Copyright 2022 by Sean Conner.  All Rights Reserved.
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*
+* Comments, questions and criticisms can be sent to: sean@conman.org
+*
+********************************************************************/
+
+#ifndef READER_H
+#define READER_H
+
+#include <stdio.h>
+#include <stdbool.h>
+
+#include "types.h"
+
+/*********************************************************************
+;
+; A reader streams verses out of some input format, one record at a
+; time.  The strings in a record belong to the reader and are only valid
+; until the next call to ReaderNext().  Records are expected in document
+; order---all the verses of a chapter together, all the chapters of a
+; book together.
+;
+**********************************************************************/
+
+typedef struct record
+{
+  char *book;
+  Size  chapter;
+  Size  verse;
+  char *text;
+} Record;
+
+typedef struct reader *Reader;
+
+struct reader
+{
+  char const *name;
+  FILE       *fpin;
+  bool      (*next)  (Reader,Record *);
+  void      (*close) (Reader);
+};
+
+typedef Reader (*ReaderOpenf)(FILE *,char const *);
+
+/***********************************************************************/
+
+Reader           ReaderOpen             (char const *,FILE *,char const *);
+bool             ReaderNext             (Reader,Record *);
+void             ReaderClose            (Reader);
+void             ReaderList             (FILE *);
+char const      *ReaderBookName         (char const *);
+
+Reader           GutenbergOpen          (FILE *,char const *);
+Reader           OsisOpen               (FILE *,char const *);
+Reader           UsfmOpen               (FILE *,char const *);
+Reader           DelimOpen              (FILE *,char const *);
+
+#endif
@@ -0,0 +1,537 @@
+/******************************************************************
+*
+* scan.c                - Brute force substring scan over the data files,
+*                         for when there's no index or the index can't
+*                         answer the question (part of liblitbook).
+*
+* Copyright 2022 by Sean Conner.  All Rights Reserved.
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*
+* Comments, questions and criticisms can be sent to: sean@conman.org
+*
+* -----------------------------------------------------------------
+*
+* Each chapter is read whole (one read, same as lb_show_chapter()) and
+* searched as one block of text; a match is then placed in a verse with
+* the chapter's index, and the search picks up again at the next verse.
+* A match that runs from one verse into the next doesn't count.
+*
+* The search itself looks for the first and last bytes of the pattern
+* sixteen (SSE2) or thirty-two (AVX2) positions at a time, and only
+* compares the rest where both line up.  AVX2 is used if the CPU has it;
+* anything not x86 gets a plain loop around memchr().
+*
+* The threads take books in order from a shared counter, same as
+* litbook-fsck.  Since the hits have to come out in book order, a scan
+* with a limit can only stop once the books finished from the front
+* have enough hits among them; books past that point are dropped as
+* soon as the threads notice.
+*
+* The threads allocate through lb_malloc, since the caller's allocator
+* (say, an Apache pool) can't be shared between threads.  Only the
+* final list of hits comes from the caller's allocator.
+*
+********************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include <pthread.h>
+
+#include "scan.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || (defined(__i386__) && defined(__SSE2__)))
+#  include <immintrin.h>
+#  define LB_SCAN_X86
+#endif
+
+/*************************************************************************/
+
+typedef char const *(*lbfind)(char const *,size_t,char const *,size_t);
+
+struct scanbook
+{
+  struct lbscanhit *hits;
+  size_t            n;
+  size_t            max;
+  size_t            chapters;
+  size_t            bytes;
+  bool              done;
+};
+
+struct scanstate
+{
+  struct lbscanreq const *req;
+  lbfind                  find;
+  size_t                  len;
+  struct scanbook        *books;
+  size_t                  nbooks;
+  size_t                  next;         /* next book to hand out */
+  size_t                  prefix;       /* books done from the front */
+  size_t                  found;        /* hits in those */
+  bool                    stop;
+  bool                    cancelled;
+  bool                    nomem;
+  pthread_mutex_t         lock;
+};
+
+/*******************************************************************
+*       SUBSTRING SEARCH
+*******************************************************************/
+
+static char const *find_scalar(char const *s,size_t n,char const *p,size_t m)
+{
+  char const *end = s + n;
+  
+  if (m == 0)
+    return s;
+    
+  while((size_t)(end - s) >= m)
+  {
+    s = memchr(s,p[0],end - s - m + 1);
+    if (s == NULL)
+      return NULL;
+    if (memcmp(s + 1,p + 1,m - 1) == 0)
+      return s;
+    s++;
+  }
+  
+  return NULL;
+}
+
+/************************************************************************/
+
+#ifdef LB_SCAN_X86
+
+static char const *find_sse2(char const *s,size_t n,char const *p,size_t m)
+{
+  __m128i first;
+  __m128i last;
+  size_t  i;
+  
+  if (m < 2)
+    return find_scalar(s,n,p,m);
+    
+  first = _mm_set1_epi8(p[0]);
+  last  = _mm_set1_epi8(p[m - 1]);
+  
+  for (i = 0 ; i + m - 1 + 16 <= n ; i += 16)
+  {
+    __m128i  a    = _mm_loadu_si128((__m128i const *)(s + i));
+    __m128i  b    = _mm_loadu_si128((__m128i const *)(s + i + m - 1));
+    unsigned mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(a,first),_mm_cmpeq_epi8(b,last)));
+    
+    while(mask != 0)
+    {
+      unsigned bit = __builtin_ctz(mask);
+      
+      if (memcmp(s + i + bit + 1,p + 1,m - 2) == 0)
+        return s + i + bit;
+      mask &= mask - 1;
+    }
+  }
+  
+  return find_scalar(s + i,n - i,p,m);
+}
+
+/************************************************************************/
+
+__attribute__((target("avx2")))
+static char const *find_avx2(char const *s,size_t n,char const *p,size_t m)
+{
+  __m256i first;
+  __m256i last;
+  size_t  i;
+  
+  if (m < 2)
+    return find_scalar(s,n,p,m);
+    
+  first = _mm256_set1_epi8(p[0]);
+  last  = _mm256_set1_epi8(p[m - 1]);
+  
+  for (i = 0 ; i + m - 1 + 32 <= n ; i += 32)
+  {
+    __m256i  a    = _mm256_loadu_si256((__m256i const *)(s + i));
+    __m256i  b    = _mm256_loadu_si256((__m256i const *)(s + i + m - 1));
+    unsigned mask = _mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(a,first),_mm256_cmpeq_epi8(b,last)));
+    
+    while(mask != 0)
+    {
+      unsigned bit = __builtin_ctz(mask);
+      
+      if (memcmp(s + i + bit + 1,p + 1,m - 2) == 0)
+        return s + i + bit;
+      mask &= mask - 1;
+    }
+  }
+  
+  return find_sse2(s + i,n - i,p,m);
+}
+
+#endif
+
+/************************************************************************/
+
+static lbfind find_kernel(void)
+{
+#ifdef LB_SCAN_X86
+  if (__builtin_cpu_supports("avx2"))
+    return find_avx2;
+  return find_sse2;
+#else
+  return find_scalar;
+#endif
+}
+
+/*******************************************************************
+;
+; The first place p (m bytes) appears in s (n bytes), or NULL.
+;
+********************************************************************/
+
+char const *lb_memmem(char const *s,size_t n,char const *p,size_t m)
+{
+  return (*find_kernel())(s,n,p,m);
+}
+
+/*******************************************************************
+*       THE THREADS
+*******************************************************************/
+
+static bool add_hit(struct scanbook *pb,char const *name,size_t chapter,size_t verse)
+{
+  if (pb->n == pb->max)
+  {
+    size_t            max  = pb->max ? pb->max * 2 : 64;
+    struct lbscanhit *hits = (*lb_malloc.alloc)(lb_malloc.ud,max * sizeof(struct lbscanhit));
+    
+    if (hits == NULL)
+      return false;
+    if (pb->hits != NULL)
+    {
+      memcpy(hits,pb->hits,pb->n * sizeof(struct lbscanhit));
+      (*lb_malloc.free)(lb_malloc.ud,pb->hits);
+    }
+    pb->hits = hits;
+    pb->max  = max;
+  }
+  
+  pb->hits[pb->n].name    = name;
+  pb->hits[pb->n].chapter = chapter;
+  pb->hits[pb->n].verse   = verse;
+  pb->n++;
+  return true;
+}
+
+/************************************************************************/
+
+static bool scan_chapter(
+                          struct scanstate       *st,
+                          struct scanbook        *pb,
+                          char const             *name,
+                          struct lbchapter const *pch
+                        )
+{
+  char const *pat  = st->req->pattern;
+  size_t      len  = pch->index[pch->max];
+  size_t      at   = 0;
+  size_t      v    = 1;
+  
+  while(at + st->len <= len)
+  {
+    char const *hit = (*st->find)(pch->text + at,len - at,pat,st->len);
+    size_t      off;
+    
+    if (hit == NULL)
+      break;
+      
+    off = hit - pch->text;
+    while((v < pch->max) && ((size_t)pch->index[v] <= off))
+      v++;
+      
+    if (off + st->len > (size_t)pch->index[v])
+    {
+      at = off + 1;
+      continue;
+    }
+    
+    if (!add_hit(pb,name,pch->number,v))
+      return false;
+    if ((st->req->max > 0) && (pb->n >= st->req->max))
+      break;
+      
+    at = pch->index[v];
+  }
+  
+  return true;
+}
+
+/*******************************************************************
+;
+; Whether to give up on book b:  the scan was cancelled, or the books
+; before it already have all the hits wanted.
+;
+********************************************************************/
+
+static bool scan_stop(struct scanstate *st,size_t b,size_t chapter)
+{
+  bool stop;
+  
+  if ((st->req->cancel != NULL) && (chapter % LB_SCANCHECK == 0) && (*st->req->cancel)(st->req->ud))
+  {
+    pthread_mutex_lock(&st->lock);
+    st->stop      = true;
+    st->cancelled = true;
+    pthread_mutex_unlock(&st->lock);
+  }
+  
+  pthread_mutex_lock(&st->lock);
+  stop = st->stop && (b >= st->prefix);
+  pthread_mutex_unlock(&st->lock);
+  return stop;
+}
+
+/************************************************************************/
+
+static void scan_book(struct scanstate *st,size_t b)
+{
+  struct scanbook *pb      = &st->books[b];
+  char const      *name    = st->req->trans->books[b].fullname;
+  char const      *bookdir = st->req->bookdir;
+  
+  for (size_t c = 1 ; !scan_stop(st,b,c) ; c++)
+  {
+    struct lbchapter ch;
+    bool             ok;
+    
+    ok         = lb_chapter_open(&ch,&lb_malloc,bookdir,name,c) == 0;
+    pb->bytes += ch.bytes;
+    if (!ok)
+      break;
+      
+    ch.bytes = 0;
+    ok       = lb_chapter_read(&ch,&lb_malloc,bookdir,name,1,LB_END) == 0;
+    pb->bytes += ch.bytes;
+    
+    if (ok)
+    {
+      pb->chapters++;
+      if (!scan_chapter(st,pb,name,&ch))
+      {
+        pthread_mutex_lock(&st->lock);
+        st->nomem = true;
+        st->stop  = true;
+        pthread_mutex_unlock(&st->lock);
+      }
+    }
+    
+    lb_chapter_close(&ch,&lb_malloc);
+    if ((st->req->max > 0) && (pb->n >= st->req->max))
+      break;
+  }
+}
+
+/************************************************************************/
+
+static void *scan_worker(void *data)
+{
+  struct scanstate *st = data;
+  
+  while(true)
+  {
+    size_t b;
+    
+    pthread_mutex_lock(&st->lock);
+    b = st->next++;
+    if (st->stop)
+      b = st->nbooks;
+    pthread_mutex_unlock(&st->lock);
+    
+    if (b >= st->nbooks)
+      return NULL;
+      
+    scan_book(st,b);
+    
+    /*---------------------------------------------------------------
+    ; Once the books from the front have enough hits, nothing after
+    ; them matters.
+    ;---------------------------------------------------------------*/
+    
+    pthread_mutex_lock(&st->lock);
+    st->books[b].done = true;
+    while((st->prefix < st->nbooks) && st->books[st->prefix].done)
+      st->found += st->books[st->prefix++].n;
+    if ((st->req->max > 0) && (st->found >= st->req->max))
+      st->stop = true;
+    pthread_mutex_unlock(&st->lock);
+  }
+}
+
+/*******************************************************************
+;
+; Run a scan.  Returns 0 (with the hits, possibly none, in ps), EINVAL
+; for an empty or overlong pattern, or ENOMEM.  A cancelled scan still
+; returns the hits found in the books it finished from the front.  The
+; hits are freed with lb_scan_free().
+;
+********************************************************************/
+
+int lb_scan(struct lbscan *ps,struct lbscanreq const *req,struct lballoc const *alloc)
+{
+  struct scanstate st;
+  pthread_t        tid[LB_SCANTHREADS];
+  unsigned         nthreads;
+  unsigned         started;
+  size_t           total;
+  int              rc = 0;
+  
+  memset(ps,0,sizeof(struct lbscan));
+  
+  st.len = strlen(req->pattern);
+  if ((st.len == 0) || (st.len > LB_SCANMAX))
+    return EINVAL;
+    
+  st.req       = req;
+  st.find      = find_kernel();
+  st.nbooks    = req->trans->maxbook;
+  st.next      = 0;
+  st.prefix    = 0;
+  st.found     = 0;
+  st.stop      = false;
+  st.cancelled = false;
+  st.nomem     = false;
+  st.books     = (*lb_malloc.alloc)(lb_malloc.ud,(st.nbooks + 1) * sizeof(struct scanbook));
+  if (st.books == NULL)
+    return ENOMEM;
+  memset(st.books,0,(st.nbooks + 1) * sizeof(struct scanbook));
+  pthread_mutex_init(&st.lock,NULL);
+  
+  nthreads = req->threads;
+  if (nthreads < 1)              nthreads = 1;
+  if (nthreads > LB_SCANTHREADS) nthreads = LB_SCANTHREADS;
+  if (nthreads > st.nbooks)      nthreads = st.nbooks;
+  
+  /*------------------------------------------------------------------
+  ; This thread works too, so start one less.  If we can't get as many
+  ; as wanted, we just make do with what we have.
+  ;------------------------------------------------------------------*/
+  
+  for (started = 0 ; started + 1 < nthreads ; started++)
+    if (pthread_create(&tid[started],NULL,scan_worker,&st) != 0)
+      break;
+      
+  scan_worker(&st);
+  for (unsigned i = 0 ; i < started ; i++)
+    pthread_join(tid[i],NULL);
+    
+  pthread_mutex_destroy(&st.lock);
+  
+  for (size_t b = 0 ; b < st.nbooks ; b++)
+  {
+    ps->chapters += st.books[b].chapters;
+    ps->bytes    += st.books[b].bytes;
+  }
+  
+  total = st.found;
+  if ((req->max > 0) && (total >= req->max))
+  {
+    total    = req->max;
+    ps->more = true;
+  }
+  
+  ps->cancelled = st.cancelled;
+  
+  if (st.nomem)
+    rc = ENOMEM;
+  else if (total > 0)
+  {
+    ps->hits = (*alloc->alloc)(alloc->ud,total * sizeof(struct lbscanhit));
+    if (ps->hits == NULL)
+      rc = ENOMEM;
+    else
+    {
+      for (size_t b = 0 ; (b < st.prefix) && (ps->n < total) ; b++)
+      {
+        size_t n = st.books[b].n;
+        
+        if (n > total - ps->n)
+          n = total - ps->n;
+        memcpy(&ps->hits[ps->n],st.books[b].hits,n * sizeof(struct lbscanhit));
+        ps->n += n;
+      }
+    }
+  }
+  
+  for (size_t b = 0 ; b < st.nbooks ; b++)
+    if (st.books[b].hits != NULL)
+      (*lb_malloc.free)(lb_malloc.ud,st.books[b].hits);
+  (*lb_malloc.free)(lb_malloc.ud,st.books);
+  
+  if (rc != 0)
+    lb_scan_free(ps,alloc);
+  return rc;
+}
+
+/************************************************************************/
+
+void lb_scan_free(struct lbscan *ps,struct lballoc const *alloc)
+{
+  if ((alloc->free != NULL) && (ps->hits != NULL))
+    (*alloc->free)(alloc->ud,ps->hits);
+  ps->hits = NULL;
+  ps->n    = 0;
+}
+
+/*******************************************************************
+;
+; Show hits first .. first + max - 1, a chapter at a time through
+; lb_show_hits().  Returns the number shown.
+;
+********************************************************************/
+
+size_t lb_print_scan(
+                      struct lbctx        *ctx,
+                      struct lbscan const *ps,
+                      char const          *bookdir,
+                      size_t               first,
+                      size_t               max
+                    )
+{
+  size_t verses[LB_IBUFSIZ];
+  size_t end   = first + max < ps->n ? first + max : ps->n;
+  size_t shown = 0;
+  size_t i     = first;
+  
+  while(i < end)
+  {
+    struct lbscanhit const *ph = &ps->hits[i];
+    size_t                  n  = 0;
+    
+    for ( ; (i < end) && (n < LB_IBUFSIZ) ; i++)
+    {
+      if ((ps->hits[i].name != ph->name) || (ps->hits[i].chapter != ph->chapter))
+        break;
+      verses[n++] = ps->hits[i].verse;
+    }
+    
+    shown += lb_show_hits(ctx,bookdir,ph->name,ph->chapter,verses,n);
+  }
+  
+  return shown;
+}
+
+/************************************************************************/
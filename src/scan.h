@@ -0,0 +1,85 @@
+/******************************************************************
+*
+* scan.h                - API for the brute force substring scan (part
+*                         of liblitbook).
+*
+* Copyright 2022 by Sean Conner.  All Rights Reserved.
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*
+* Comments, questions and criticisms can be sent to: sean@conman.org
+*
+*******************************************************************/
+
+#ifndef SCAN_H
+#define SCAN_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "litbook.h"
+
+#define LB_SCANMAX      256             /* longest pattern */
+#define LB_SCANTHREADS  64              /* most threads used */
+#define LB_SCANCHECK    16              /* chapters between cancel checks */
+
+/*******************************************************************
+;
+; A scan.  Every book in the translation file is read, chapter by
+; chapter, looking for the pattern as is (no case folding, no word
+; boundaries) within a single verse.  The books are split up among
+; threads; the hits still come back in translation file order.  With
+; max, the scan stops once the first max hits are known.  cancel(), if
+; given, is called every so often from the threads and stops the scan
+; if it returns true.
+;
+********************************************************************/
+
+struct lbscanreq
+{
+  struct lbtrans const *trans;
+  char           const *bookdir;
+  char           const *pattern;
+  size_t                max;            /* 0 for all */
+  unsigned              threads;
+  bool                (*cancel)(void *);
+  void                 *ud;
+};
+
+struct lbscanhit
+{
+  char const *name;                     /* from the translation */
+  size_t      chapter;
+  size_t      verse;
+};
+
+struct lbscan
+{
+  struct lbscanhit *hits;
+  size_t            n;
+  bool              more;               /* stopped at max */
+  bool              cancelled;
+  size_t            chapters;           /* chapters read */
+  size_t            bytes;              /* bytes read */
+};
+
+/************************************************************************/
+
+extern char const *lb_memmem       (char const *,size_t,char const *,size_t);
+extern int         lb_scan         (struct lbscan *,struct lbscanreq const *,struct lballoc const *);
+extern void        lb_scan_free    (struct lbscan *,struct lballoc const *);
+extern size_t      lb_print_scan   (struct lbctx *,struct lbscan const *,char const *,size_t,size_t);
+
+#endif
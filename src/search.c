@@ -0,0 +1,1695 @@
+/******************************************************************
+*
+* search.c              - Full text search over the index written by
+*                         breakout (part of liblitbook).
+*
+* Copyright 2022 by Sean Conner.  All Rights Reserved.
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*
+* Comments, questions and criticisms can be sent to: sean@conman.org
+*
+* -----------------------------------------------------------------
+*
+* The index is mapped read-only and used in place; nothing is copied
+* out of it except the postings lists of the words in a query, which are
+* decoded into arrays and then merged (OR) or intersected (AND).  A
+* query is a list of terms, all of which have to appear in a verse;
+* terms joined by OR (or |) are alternatives:
+*
+*       faith hope charity              all three
+*       love OR charity faith           (love or charity) and faith
+*       "in the beginning"              the phrase
+*       fear NEAR/3 lord                within three words of each other
+*       ~melchisedec                    any word that sounds like it
+*
+* Phrases and NEAR are first found as verses with all the words, then
+* checked against the word positions of just those verses.  An index
+* built without positions treats them as a plain list of words.
+*
+* A search can be limited to a scope, a few ranges of verses.  Then
+* only the parts of the postings lists in the scope are decoded, the
+* skip entries getting to the start of each range, so a search of a
+* few chapters costs about what those chapters hold.
+*
+* A word with ~ in front is looked up by sound in the tables breakout
+* made, and stands for any of the words found (up to LB_SOUNDMAX of
+* them).  Only the query word gets coded here.
+*
+* A concordance walks a word's postings and cuts each line out of the
+* verse text kept in the index, so no chapter files are read; the
+* counts by book come from the index too.
+*
+********************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "soundex.h"
+#include "metaphone.h"
+#include "search.h"
+
+/************************************************************************/
+
+static void *ix_alloc(struct lballoc const *alloc,size_t size)
+{
+  return (*alloc->alloc)(alloc->ud,size);
+}
+
+/************************************************************************/
+
+static void ix_free(struct lballoc const *alloc,void *ptr)
+{
+  if ((alloc->free != NULL) && (ptr != NULL))
+    (*alloc->free)(alloc->ud,ptr);
+}
+
+/*******************************************************************
+;
+; Words are runs of letters and digits (and anything with the high bit
+; set, so UTF-8 passes through), folded to lower case.  Everything else
+; separates words, including apostrophes, so "LORD'S" is "lord" and "s".
+; This is used both to build the index and to parse queries, so they
+; always agree.  Returns the length of the word, 0 at the end of the
+; string.
+;
+********************************************************************/
+
+static inline bool wordchar(unsigned char c)
+{
+  return ((c >= 'a') && (c <= 'z'))
+      || ((c >= 'A') && (c <= 'Z'))
+      || ((c >= '0') && (c <= '9'))
+      || (c >= 0x80);
+}
+
+/************************************************************************/
+
+size_t lb_token(char *word,size_t size,char const **ps)
+{
+  unsigned char const *s = (unsigned char const *)*ps;
+  size_t               len;
+  
+  while((*s != '\0') && !wordchar(*s))
+    s++;
+    
+  for (len = 0 ; wordchar(*s) ; s++)
+  {
+    if (len < size - 1)
+      word[len++] = ((*s >= 'A') && (*s <= 'Z')) ? *s + ('a' - 'A') : *s;
+  }
+  
+  word[len] = '\0';
+  *ps       = (char const *)s;
+  return len;
+}
+
+/*******************************************************************
+*       THE INDEX FILE
+*******************************************************************/
+
+static bool ix_range(struct lbindex const *ix,uint32_t off,size_t len)
+{
+  return (off <= ix->size) && (len <= ix->size - off);
+}
+
+/************************************************************************/
+
+static int ix_check(struct lbindex *ix)
+{
+  struct lbixhdr const *hdr = ix->hdr;
+  
+  if (ix->size < sizeof(struct lbixhdr))
+    return EINVAL;
+  if (memcmp(hdr->magic,LB_INDEX_MAGIC,sizeof(hdr->magic)) != 0)
+    return EINVAL;
+  if ((hdr->version != LB_INDEX_VER) || (hdr->size != ix->size))
+    return EINVAL;
+    
+  if (!ix_range(ix,hdr->booktab, (size_t)hdr->books          * sizeof(struct lbixbook))) return EINVAL;
+  if (!ix_range(ix,hdr->chaptab, ((size_t)hdr->chapters + 1) * sizeof(struct lbixchap))) return EINVAL;
+  if (!ix_range(ix,hdr->wordtab, (size_t)hdr->words          * sizeof(struct lbixword))) return EINVAL;
+  if (!ix_range(ix,hdr->skiptab, (size_t)hdr->skips          * sizeof(struct lbixskip))) return EINVAL;
+  if (!ix_range(ix,hdr->sdxtab,  (size_t)hdr->sounds         * sizeof(struct lbixsound)))return EINVAL;
+  if (!ix_range(ix,hdr->mphtab,  (size_t)hdr->sounds         * sizeof(struct lbixsound)))return EINVAL;
+  if (!ix_range(ix,hdr->freqtab, (size_t)hdr->freqs          * sizeof(struct lbixfreq))) return EINVAL;
+  if (!ix_range(ix,hdr->texttab, ((size_t)hdr->verses + 1)   * sizeof(uint32_t)))        return EINVAL;
+  if (!ix_range(ix,hdr->strings, 0))                                                    return EINVAL;
+  if (!ix_range(ix,hdr->postings,0))                                                    return EINVAL;
+  if (!ix_range(ix,hdr->positions,0))                                                   return EINVAL;
+  if ((hdr->strings >= hdr->postings) || (ix->base[hdr->postings - 1] != '\0'))
+    return EINVAL;
+    
+  ix->books   = (struct lbixbook const *)(ix->base + hdr->booktab);
+  ix->chaps   = (struct lbixchap const *)(ix->base + hdr->chaptab);
+  ix->words   = (struct lbixword const *)(ix->base + hdr->wordtab);
+  ix->skips   = (struct lbixskip const *)(ix->base + hdr->skiptab);
+  ix->sdx     = (struct lbixsound const *)(ix->base + hdr->sdxtab);
+  ix->mph     = (struct lbixsound const *)(ix->base + hdr->mphtab);
+  ix->freqs   = (struct lbixfreq const *)(ix->base + hdr->freqtab);
+  ix->texttab = (uint32_t const *)(ix->base + hdr->texttab);
+  ix->text    = (char const *)(ix->base + hdr->text);
+  ix->strings = (char const *)(ix->base + hdr->strings);
+  
+  /*------------------------------------------------------------------
+  ; Strings are only checked to start inside the string section (which
+  ; ends with a NUL), postings to lie inside the postings, skip entries
+  ; to point inside their word's lists, sounds and counts to name a
+  ; word, book or chapter, and each verse to end with a NUL.  Chapters
+  ; have to be in order, since they're searched.
+  ;------------------------------------------------------------------*/
+  
+  for (size_t i = 0 ; i < hdr->books ; i++)
+  {
+    if (ix->books[i].name >= hdr->postings - hdr->strings)
+      return EINVAL;
+    if (ix->books[i].chapter + (size_t)ix->books[i].chapters > hdr->chapters)
+      return EINVAL;
+  }
+  
+  for (size_t i = 0 ; i < hdr->chapters ; i++)
+  {
+    if (ix->chaps[i].book >= hdr->books)
+      return EINVAL;
+    if (ix->chaps[i].verse > ix->chaps[i + 1].verse)
+      return EINVAL;
+  }
+  
+  if (ix->chaps[hdr->chapters].verse != hdr->verses)
+    return EINVAL;
+    
+  for (size_t i = 0 ; i < hdr->sounds ; i++)
+  {
+    if ((ix->sdx[i].word >= hdr->words) || (ix->mph[i].word >= hdr->words))
+      return EINVAL;
+    if (ix->mph[i].code >= hdr->postings - hdr->strings)
+      return EINVAL;
+  }
+  
+  if (!ix_range(ix,hdr->text,ix->texttab[hdr->verses]))
+    return EINVAL;
+  for (size_t i = 0 ; i < hdr->verses ; i++)
+  {
+    if (ix->texttab[i] >= ix->texttab[i + 1])
+      return EINVAL;
+    if (ix->text[ix->texttab[i + 1] - 1] != '\0')
+      return EINVAL;
+  }
+  
+  for (size_t i = 0 ; i < hdr->words ; i++)
+  {
+    if (ix->words[i].word >= hdr->postings - hdr->strings)
+      return EINVAL;
+    if ((ix->words[i].post < hdr->postings) || !ix_range(ix,ix->words[i].post,ix->words[i].len))
+      return EINVAL;
+    if (ix->words[i].verses > ix->words[i].len)
+      return EINVAL;
+    if ((hdr->positions != 0) && ((ix->words[i].pos < hdr->positions) || !ix_range(ix,ix->words[i].pos,ix->words[i].poslen)))
+      return EINVAL;
+    if (ix->words[i].skips != (ix->words[i].verses > 0 ? (ix->words[i].verses - 1) / LB_SKIPSTEP : 0))
+      return EINVAL;
+    if (ix->words[i].skip + (size_t)ix->words[i].skips > hdr->skips)
+      return EINVAL;
+      
+    for (size_t s = 0 ; s < ix->words[i].skips ; s++)
+    {
+      struct lbixskip const *ps = &ix->skips[ix->words[i].skip + s];
+      
+      if ((ps->post > ix->words[i].len) || (ps->pos > ix->words[i].poslen))
+        return EINVAL;
+    }
+    
+    if (ix->words[i].freq + (size_t)ix->words[i].fbooks + ix->words[i].fchaps > hdr->freqs)
+      return EINVAL;
+    for (size_t f = 0 ; f < ix->words[i].fbooks + (size_t)ix->words[i].fchaps ; f++)
+      if (ix->freqs[ix->words[i].freq + f].unit >= (f < ix->words[i].fbooks ? hdr->books : hdr->chapters))
+        return EINVAL;
+  }
+  
+  return 0;
+}
+
+/************************************************************************/
+
+int lb_index_open(struct lbindex *ix,char const *fname)
+{
+  struct stat st;
+  void       *base;
+  int         fh;
+  int         rc;
+  
+  memset(ix,0,sizeof(struct lbindex));
+  
+  if ((fh = open(fname,O_RDONLY)) == -1)
+    return errno;
+    
+  if (fstat(fh,&st) == -1)
+  {
+    rc = errno;
+    close(fh);
+    return rc;
+  }
+  
+  if ((st.st_size < (off_t)sizeof(struct lbixhdr)) || (st.st_size > UINT32_MAX))
+  {
+    close(fh);
+    return EINVAL;
+  }
+  
+  base = mmap(NULL,st.st_size,PROT_READ,MAP_SHARED,fh,0);
+  rc   = errno;
+  close(fh);
+  if (base == MAP_FAILED)
+    return rc;
+    
+  ix->base = base;
+  ix->size = st.st_size;
+  ix->hdr  = base;
+  
+  if ((rc = ix_check(ix)) != 0)
+    lb_index_close(ix);
+  return rc;
+}
+
+/************************************************************************/
+
+void lb_index_close(struct lbindex *ix)
+{
+  if (ix->base != NULL)
+    munmap((void *)ix->base,ix->size);
+  memset(ix,0,sizeof(struct lbindex));
+}
+
+/************************************************************************/
+
+struct lbixword const *lb_index_word(struct lbindex const *ix,char const *word)
+{
+  size_t lo = 0;
+  size_t hi = ix->hdr->words;
+  
+  while(lo < hi)
+  {
+    size_t mid = lo + (hi - lo) / 2;
+    int    rc  = strcmp(word,&ix->strings[ix->words[mid].word]);
+    
+    if (rc == 0)
+      return &ix->words[mid];
+    else if (rc < 0)
+      hi = mid;
+    else
+      lo = mid + 1;
+  }
+  
+  return NULL;
+}
+
+/************************************************************************/
+
+static size_t add_sound(
+                         struct lbixword const **dest,
+                         size_t                  n,
+                         size_t                  max,
+                         struct lbixword const  *pw
+                       )
+{
+  if (n == max)
+    return n;
+  for (size_t i = 0 ; i < n ; i++)
+    if (dest[i] == pw)
+      return n;
+  dest[n++] = pw;
+  return n;
+}
+
+/*******************************************************************
+;
+; The words in the index that sound like word (which should be folded
+; to lower case, like lb_token() does), at most max of them:  the word
+; itself if it's there, then those with the same metaphone, then those
+; with the same Soundex, each group the most common first.
+;
+********************************************************************/
+
+size_t lb_index_sounds(
+                        struct lbindex const   *ix,
+                        char const             *word,
+                        struct lbixword const **dest,
+                        size_t                  max
+                      )
+{
+  char                   mph[LB_WORDMAX];
+  uint32_t               sdx;
+  struct lbixword const *pw;
+  size_t                 n = 0;
+  size_t                 lo;
+  size_t                 hi;
+  
+  if ((pw = lb_index_word(ix,word)) != NULL)
+    n = add_sound(dest,n,max,pw);
+    
+  if (!isalpha((unsigned char)word[0]))
+    return n;
+    
+  if (make_metaphone(word,mph,sizeof(mph)))
+  {
+    for (lo = 0 , hi = ix->hdr->sounds ; lo < hi ; )
+    {
+      size_t mid = lo + (hi - lo) / 2;
+      
+      if (strcmp(&ix->strings[ix->mph[mid].code],mph) < 0)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+    
+    for ( ; (lo < ix->hdr->sounds) && (strcmp(&ix->strings[ix->mph[lo].code],mph) == 0) ; lo++)
+      n = add_sound(dest,n,max,&ix->words[ix->mph[lo].word]);
+  }
+  
+  sdx = (uint32_t)Soundex(word).value;
+  for (lo = 0 , hi = ix->hdr->sounds ; lo < hi ; )
+  {
+    size_t mid = lo + (hi - lo) / 2;
+    
+    if (ix->sdx[mid].code < sdx)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  
+  for ( ; (lo < ix->hdr->sounds) && (ix->sdx[lo].code == sdx) ; lo++)
+    n = add_sound(dest,n,max,&ix->words[ix->sdx[lo].word]);
+    
+  return n;
+}
+
+/************************************************************************/
+
+static bool ix_varint(unsigned char const **pp,unsigned char const *end,uint32_t *pv)
+{
+  unsigned char const *p     = *pp;
+  uint32_t             value = 0;
+  int                  shift = 0;
+  
+  while((p < end) && (*p & 0x80))
+  {
+    value |= (uint32_t)(*p++ & 0x7F) << shift;
+    shift += 7;
+  }
+  
+  if ((p == end) || (shift > 28))
+    return false;
+    
+  *pv = value | ((uint32_t)*p++ << shift);
+  *pp = p;
+  return true;
+}
+
+/*******************************************************************
+;
+; Decode a postings list into dest, which needs room for pw->verses
+; entries.  Returns the number decoded, which is less only if the list
+; is damaged.
+;
+********************************************************************/
+
+size_t lb_index_postings(struct lbindex const *ix,struct lbixword const *pw,uint32_t *dest)
+{
+  unsigned char const *p   = ix->base + pw->post;
+  unsigned char const *end = p + pw->len;
+  uint32_t             ord = 0;
+  size_t               n;
+  
+  for (n = 0 ; n < pw->verses ; n++)
+  {
+    uint32_t delta;
+    
+    if (!ix_varint(&p,end,&delta))
+      break;
+    ord     = (n == 0) ? delta : ord + delta;
+    dest[n] = ord;
+  }
+  
+  return n;
+}
+
+/*******************************************************************
+;
+; The chapter (index into chaptab) holding a verse ordinal, which has
+; to be less than hdr->verses.
+;
+********************************************************************/
+
+static size_t ix_chapter(struct lbindex const *ix,uint32_t ord)
+{
+  size_t lo = 0;
+  size_t hi = ix->hdr->chapters;
+  
+  while(hi - lo > 1)
+  {
+    size_t mid = lo + (hi - lo) / 2;
+    
+    if (ix->chaps[mid].verse <= ord)
+      lo = mid;
+    else
+      hi = mid;
+  }
+  
+  return lo;
+}
+
+/*******************************************************************
+;
+; Verse ordinal to book, chapter and verse.  Returns 0 on success.
+;
+********************************************************************/
+
+int lb_index_locate(
+                     struct lbindex const  *ix,
+                     uint32_t               ord,
+                     char const           **pbook,
+                     size_t                *pchapter,
+                     size_t                *pverse
+                   )
+{
+  size_t c;
+  
+  if (ord >= ix->hdr->verses)
+    return 1;
+    
+  c         = ix_chapter(ix,ord);
+  *pbook    = &ix->strings[ix->books[ix->chaps[c].book].name];
+  *pchapter = ix->chaps[c].number;
+  *pverse   = ord - ix->chaps[c].verse + 1;
+  return 0;
+}
+
+/*******************************************************************
+;
+; The verses of a reference, as a range of ordinals.  Chapters or
+; verses past the end of the book are dropped; what's left may be
+; empty.
+;
+********************************************************************/
+
+static bool ix_span(struct lbindex const *ix,struct lbrequest const *pbr,struct lbspan *psp)
+{
+  struct lbixbook const *pb = NULL;
+  struct lbixchap const *pc1;
+  struct lbixchap const *pc2;
+  size_t                 c;
+  
+  for (size_t b = 0 ; b < ix->hdr->books ; b++)
+    if (strcmp(&ix->strings[ix->books[b].name],pbr->name) == 0)
+    {
+      pb = &ix->books[b];
+      break;
+    }
+    
+  if (pb == NULL)
+    return false;
+    
+  psp->lo = psp->hi = 0;
+  
+  for (c = 0 ; (c < pb->chapters) && (ix->chaps[pb->chapter + c].number < pbr->c1) ; c++)
+    ;
+  if (c == pb->chapters)
+    return true;
+  pc1 = &ix->chaps[pb->chapter + c];
+  
+  for (c = pb->chapters ; (c > 0) && (ix->chaps[pb->chapter + c - 1].number > pbr->c2) ; c--)
+    ;
+  if (c == 0)
+    return true;
+  pc2 = &ix->chaps[pb->chapter + c - 1];
+  
+  psp->lo = pc1->verse;
+  if ((pc1->number == pbr->c1) && (pbr->v1 - 1 < pc1[1].verse - pc1->verse))
+    psp->lo += pbr->v1 - 1;
+  else if (pc1->number == pbr->c1)
+    psp->lo = pc1[1].verse;
+    
+  psp->hi = pc2[1].verse;
+  if ((pc2->number == pbr->c2) && (pbr->v2 < pc2[1].verse - pc2->verse))
+    psp->hi = pc2->verse + pbr->v2;
+    
+  if (psp->hi < psp->lo)
+    psp->hi = psp->lo;
+  return true;
+}
+
+/*******************************************************************
+;
+; Turn a list of references, separated by commas, into a scope.  Each
+; reference is parsed by lb_translate_request(), so it's anything the
+; module takes in a URL:  "Genesis.12-22", "Ps.23", "Matthew,Mark,
+; Luke,John".  Returns 0, or EINVAL if a book isn't known (to the
+; translation or the index) or there are too many references.
+;
+********************************************************************/
+
+int lb_index_scope(
+                    struct lbindex const *ix,
+                    struct lbtrans const *trans,
+                    char const           *text,
+                    struct lbscope       *scope
+                  )
+{
+  char  buf[LB_WORDMAX * LB_SCOPEMAX];
+  char *ref;
+  char *next;
+  
+  scope->n = 0;
+  
+  if (strlen(text) >= sizeof(buf))
+    return EINVAL;
+  strcpy(buf,text);
+  
+  for (ref = buf ; ref != NULL ; ref = next)
+  {
+    struct lbrequest br;
+    struct lbspan    span;
+    size_t           i;
+    
+    if ((next = strchr(ref,',')) != NULL)
+      *next++ = '\0';
+      
+    while(isspace((unsigned char)*ref))
+      ref++;
+    if (*ref == '\0')
+      continue;
+      
+    lb_translate_request(&br,trans,ref);
+    if ((br.name == NULL) || !ix_span(ix,&br,&span))
+      return EINVAL;
+    if (span.lo == span.hi)
+      continue;
+    if (scope->n == LB_SCOPEMAX)
+      return EINVAL;
+      
+    /*--------------------------------------------------------------
+    ; keep them sorted, and fold in any the new one overlaps or
+    ; touches.
+    ;---------------------------------------------------------------*/
+    
+    for (i = scope->n ; (i > 0) && (scope->span[i - 1].lo > span.lo) ; i--)
+      scope->span[i] = scope->span[i - 1];
+    scope->span[i] = span;
+    scope->n++;
+    
+    for (i = 0 ; i + 1 < scope->n ; )
+    {
+      if (scope->span[i + 1].lo <= scope->span[i].hi)
+      {
+        if (scope->span[i + 1].hi > scope->span[i].hi)
+          scope->span[i].hi = scope->span[i + 1].hi;
+        memmove(&scope->span[i + 1],&scope->span[i + 2],(scope->n - i - 2) * sizeof(struct lbspan));
+        scope->n--;
+      }
+      else
+        i++;
+    }
+  }
+  
+  return 0;
+}
+
+/*******************************************************************
+*       QUERIES
+*******************************************************************/
+
+static size_t gallop(uint32_t const *a,size_t lo,size_t n,uint32_t key)
+{
+  size_t step = 1;
+  size_t hi;
+  
+  /*------------------------------------------------------------
+  ; first element >= key, searching forward from lo in doubling
+  ; steps, then binary searching the last step.
+  ;------------------------------------------------------------*/
+  
+  while((lo + step < n) && (a[lo + step] < key))
+  {
+    lo   += step;
+    step *= 2;
+  }
+  
+  hi = lo + step < n ? lo + step : n;
+  while(lo < hi)
+  {
+    size_t mid = lo + (hi - lo) / 2;
+    
+    if (a[mid] < key)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  
+  return lo;
+}
+
+/************************************************************************/
+
+static size_t intersect(uint32_t *a,size_t na,uint32_t const *b,size_t nb)
+{
+  size_t n = 0;
+  size_t j = 0;
+  
+  /* a is the shorter list, and gets overwritten with the result */
+  
+  for (size_t i = 0 ; (i < na) && (j < nb) ; i++)
+  {
+    j = gallop(b,j,nb,a[i]);
+    if ((j < nb) && (b[j] == a[i]))
+      a[n++] = a[i];
+  }
+  
+  return n;
+}
+
+/************************************************************************/
+
+static size_t merge(uint32_t *dest,uint32_t const *a,size_t na,uint32_t const *b,size_t nb)
+{
+  size_t n = 0;
+  size_t i = 0;
+  size_t j = 0;
+  
+  while((i < na) && (j < nb))
+  {
+    if (a[i] < b[j])
+      dest[n++] = a[i++];
+    else if (b[j] < a[i])
+      dest[n++] = b[j++];
+    else
+    {
+      dest[n++] = a[i++];
+      j++;
+    }
+  }
+  
+  while(i < na) dest[n++] = a[i++];
+  while(j < nb) dest[n++] = b[j++];
+  return n;
+}
+
+/*******************************************************************
+;
+; A query, parsed.  A term is a word or a phrase, each word looked up
+; in the index; a missing word means the term can't match anything.
+; For a ~word, the words are the ones that sound like it, any of which
+; will do.  An item is a term, or two terms with NEAR between them.
+;
+********************************************************************/
+
+struct term
+{
+  struct lbixword const *pw[LB_PHRASEMAX];
+  size_t                 n;
+  bool                   missing;
+  bool                   sound;
+};
+
+struct item
+{
+  struct term a;
+  struct term b;
+  bool        near;
+  uint32_t    dist;
+  bool        alt;                      /* ORed with the item before */
+};
+
+/*******************************************************************
+;
+; A cursor walks a word's postings, and its positions along with it
+; (if asked for).  The positions of the verses passed over are skipped
+; with memchr(), since they end with the only 0 byte (see search.h).
+; A seek far enough ahead jumps to the last skip entry before it first.
+;
+********************************************************************/
+
+struct cursor
+{
+  unsigned char   const *post0;
+  unsigned char   const *post;
+  unsigned char   const *pend;
+  unsigned char   const *pos0;
+  unsigned char   const *pos;
+  unsigned char   const *posend;
+  struct lbixskip const *skip;
+  uint32_t               skips;
+  uint32_t               next;          /* first skip entry not passed */
+  uint32_t               verses;
+  uint32_t               left;
+  uint32_t               ord;
+  bool                   positions;
+  bool                   valid;
+  bool                   unread;        /* positions of ord not read yet */
+};
+
+/************************************************************************/
+
+static void cur_init(
+                      struct cursor         *pc,
+                      struct lbindex  const *ix,
+                      struct lbixword const *pw,
+                      bool                   positions
+                    )
+{
+  pc->post0     = ix->base + pw->post;
+  pc->post      = pc->post0;
+  pc->pend      = pc->post + pw->len;
+  pc->pos0      = ix->base + pw->pos;
+  pc->pos       = pc->pos0;
+  pc->posend    = pc->pos  + pw->poslen;
+  pc->skip      = &ix->skips[pw->skip];
+  pc->skips     = pw->skips;
+  pc->next      = 0;
+  pc->verses    = pw->verses;
+  pc->left      = pw->verses;
+  pc->ord       = 0;
+  pc->positions = positions && (ix->hdr->positions != 0);
+  pc->valid     = false;
+  pc->unread    = false;
+}
+
+/*******************************************************************
+;
+; Move to the first verse at or past ord.  True if it's ord.  Past the
+; end of the list, the cursor sits at UINT32_MAX.
+;
+********************************************************************/
+
+static bool cur_seek(struct cursor *pc,uint32_t ord)
+{
+  if ((pc->next < pc->skips) && (pc->skip[pc->next].ord <= ord))
+  {
+    size_t lo = pc->next;
+    size_t hi = pc->skips;
+    
+    while(lo < hi)
+    {
+      size_t mid = lo + (hi - lo) / 2;
+      
+      if (pc->skip[mid].ord <= ord)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+    
+    /*--------------------------------------------------------------
+    ; skip[lo - 1] is the verse numbered lo * LB_SKIPSTEP in the list.
+    ; Don't go back if we've already gone past it.
+    ;---------------------------------------------------------------*/
+    
+    if (!pc->valid || (pc->skip[lo - 1].ord > pc->ord))
+    {
+      pc->post   = pc->post0 + pc->skip[lo - 1].post;
+      pc->pos    = pc->pos0  + pc->skip[lo - 1].pos;
+      pc->left   = pc->verses - lo * LB_SKIPSTEP - 1;
+      pc->ord    = pc->skip[lo - 1].ord;
+      pc->valid  = true;
+      pc->unread = pc->positions;
+    }
+    
+    pc->next = lo;
+  }
+  
+  while(!pc->valid || (pc->ord < ord))
+  {
+    uint32_t delta;
+    
+    if (pc->unread)
+    {
+      unsigned char const *z = memchr(pc->pos,0,pc->posend - pc->pos);
+      pc->pos = z != NULL ? z + 1 : pc->posend;
+    }
+    
+    if ((pc->left == 0) || !ix_varint(&pc->post,pc->pend,&delta))
+    {
+      pc->left   = 0;
+      pc->ord    = UINT32_MAX;
+      pc->valid  = true;
+      pc->unread = false;
+      return false;
+    }
+    
+    pc->ord    = pc->valid ? pc->ord + delta : delta;
+    pc->valid  = true;
+    pc->unread = pc->positions;
+    pc->left--;
+  }
+  
+  return pc->ord == ord;
+}
+
+/*******************************************************************
+;
+; Decode just the part of a postings list in a scope into dest, which
+; needs room for the smaller of pw->verses and the verses in scope.
+;
+********************************************************************/
+
+static size_t scope_postings(
+                              struct lbindex  const *ix,
+                              struct lbixword const *pw,
+                              struct lbscope  const *scope,
+                              uint32_t              *dest
+                            )
+{
+  struct cursor cur;
+  size_t        n = 0;
+  
+  cur_init(&cur,ix,pw,false);
+  
+  for (size_t s = 0 ; s < scope->n ; s++)
+  {
+    cur_seek(&cur,scope->span[s].lo);
+    while(cur.ord < scope->span[s].hi)
+    {
+      dest[n++] = cur.ord;
+      cur_seek(&cur,cur.ord + 1);
+    }
+  }
+  
+  return n;
+}
+
+/************************************************************************/
+
+static size_t scope_verses(struct lbscope const *scope)
+{
+  size_t n = 0;
+  
+  for (size_t s = 0 ; s < scope->n ; s++)
+    n += scope->span[s].hi - scope->span[s].lo;
+  return n;
+}
+
+/*******************************************************************
+;
+; The positions of the word in the current verse, at most LB_POSMAX
+; of them.
+;
+********************************************************************/
+
+static size_t cur_positions(struct cursor *pc,uint32_t *dest)
+{
+  uint32_t at = 0;
+  uint32_t v;
+  size_t   n  = 0;
+  
+  if (!pc->unread)
+    return 0;
+    
+  pc->unread = false;
+  while(ix_varint(&pc->pos,pc->posend,&v) && (v != 0))
+  {
+    at = (n == 0) ? v - 1 : at + v;
+    if (n < LB_POSMAX)
+      dest[n++] = at;
+  }
+  
+  return n;
+}
+
+/*******************************************************************
+;
+; Where in a verse a phrase starts, given the positions of each of its
+; words.
+;
+********************************************************************/
+
+static size_t phrase_starts(
+                             uint32_t const (*pos)[LB_POSMAX],
+                             size_t   const  *npos,
+                             size_t           words,
+                             uint32_t        *dest
+                           )
+{
+  size_t idx[LB_PHRASEMAX] = { 0 };
+  size_t n                 = 0;
+  
+  for (size_t i = 0 ; i < npos[0] ; i++)
+  {
+    uint32_t start = pos[0][i];
+    size_t   w;
+    
+    for (w = 1 ; w < words ; w++)
+    {
+      while((idx[w] < npos[w]) && (pos[w][idx[w]] < start + w))
+        idx[w]++;
+      if ((idx[w] == npos[w]) || (pos[w][idx[w]] != start + w))
+        break;
+    }
+    
+    if (w == words)
+      dest[n++] = start;
+  }
+  
+  return n;
+}
+
+/*******************************************************************
+;
+; NEAR/k:  the two terms don't overlap and there are fewer than k
+; words between them, in either order.
+;
+********************************************************************/
+
+static bool near(
+                  uint32_t const *sa,
+                  size_t          na,
+                  size_t          la,
+                  uint32_t const *sb,
+                  size_t          nb,
+                  size_t          lb,
+                  uint32_t        dist
+                )
+{
+  for (size_t i = 0 ; i < na ; i++)
+    for (size_t j = 0 ; j < nb ; j++)
+    {
+      if ((sa[i] + la <= sb[j]) && (sb[j] - (sa[i] + la) < dist))
+        return true;
+      if ((sb[j] + lb <= sa[i]) && (sa[i] - (sb[j] + lb) < dist))
+        return true;
+    }
+    
+  return false;
+}
+
+/*******************************************************************
+;
+; The verses all the given words appear in.
+;
+********************************************************************/
+
+static int words_hits(
+                       struct lbindex  const        *ix,
+                       struct lballoc  const        *alloc,
+                       struct lbixword const *const *words,
+                       size_t                        nwords,
+                       struct lbscope  const        *scope,
+                       struct lbhits                *ph
+                     )
+{
+  size_t inscope = scope != NULL ? scope_verses(scope) : SIZE_MAX;
+  
+  ph->ord = NULL;
+  ph->n   = 0;
+  
+  for (size_t i = 0 ; i < nwords ; i++)
+  {
+    uint32_t *ord;
+    size_t    n = words[i]->verses < inscope ? words[i]->verses : inscope;
+    
+    ord = ix_alloc(alloc,(n + 1) * sizeof(uint32_t));
+    if (ord == NULL)
+    {
+      lb_hits_free(ph,alloc);
+      return ENOMEM;
+    }
+    
+    if (scope != NULL)
+      n = scope_postings(ix,words[i],scope,ord);
+    else
+      n = lb_index_postings(ix,words[i],ord);
+      
+    if (ph->ord == NULL)
+    {
+      ph->ord = ord;
+      ph->n   = n;
+    }
+    else if (n < ph->n)
+    {
+      n = intersect(ord,n,ph->ord,ph->n);
+      ix_free(alloc,ph->ord);
+      ph->ord = ord;
+      ph->n   = n;
+    }
+    else
+    {
+      ph->n = intersect(ph->ord,ph->n,ord,n);
+      ix_free(alloc,ord);
+    }
+  }
+  
+  return 0;
+}
+
+/*******************************************************************
+;
+; The verses a phrase (or a NEAR) matches.  The cursors of all the
+; words are moved ahead together, the rarest word leading, and the
+; positions are only looked at in verses that have all the words.
+; With a scope, each range is gone through the same way in turn.
+;
+********************************************************************/
+
+static int item_scan(
+                      struct lbindex const *ix,
+                      struct lballoc const *alloc,
+                      struct item    const *pi,
+                      struct lbscope const *scope,
+                      struct lbhits        *ph
+                    )
+{
+  static struct lbscope const all = { .span = { { 0 , UINT32_MAX } } , .n = 1 };
+  
+  struct cursor   cur  [LB_PHRASEMAX * 2];
+  size_t          order[LB_PHRASEMAX * 2];
+  size_t          npos [LB_PHRASEMAX * 2];
+  uint32_t      (*pos)[LB_POSMAX];
+  size_t          nw  = pi->a.n + pi->b.n;
+  uint32_t        max = UINT32_MAX;
+  
+  ph->ord = NULL;
+  ph->n   = 0;
+  
+  if (scope == NULL)
+    scope = &all;
+    
+  for (size_t w = 0 ; w < pi->a.n ; w++)
+    cur_init(&cur[w],ix,pi->a.pw[w],true);
+  for (size_t w = 0 ; w < pi->b.n ; w++)
+    cur_init(&cur[pi->a.n + w],ix,pi->b.pw[w],true);
+    
+  for (size_t w = 0 ; w < nw ; w++)
+  {
+    size_t j;
+    
+    for (j = w ; (j > 0) && (cur[order[j - 1]].left > cur[w].left) ; j--)
+      order[j] = order[j - 1];
+    order[j] = w;
+    if (cur[w].left < max)
+      max = cur[w].left;
+  }
+  
+  /* two more for where each of the terms start */
+  
+  ph->ord = ix_alloc(alloc,((size_t)max + 1) * sizeof(uint32_t));
+  pos     = ix_alloc(alloc,(nw + 2) * sizeof(*pos));
+  if ((ph->ord == NULL) || (pos == NULL))
+  {
+    ix_free(alloc,pos);
+    lb_hits_free(ph,alloc);
+    return ENOMEM;
+  }
+  
+  for (size_t s = 0 ; s < scope->n ; s++)
+  {
+    uint32_t v = scope->span[s].lo;
+    
+    while(v < scope->span[s].hi)
+    {
+      size_t na;
+      size_t nb;
+      size_t w;
+      bool   keep;
+      
+      for (w = 0 ; w < nw ; w++)
+        if (!cur_seek(&cur[order[w]],v))
+          break;
+          
+      if (w < nw)
+      {
+        v = cur[order[w]].ord;
+        continue;
+      }
+      
+      for (w = 0 ; w < nw ; w++)
+        npos[w] = cur_positions(&cur[w],pos[w]);
+        
+      na = phrase_starts((uint32_t const (*)[LB_POSMAX])pos,npos,pi->a.n,pos[nw]);
+      
+      if (pi->near)
+      {
+        nb   = phrase_starts((uint32_t const (*)[LB_POSMAX])&pos[pi->a.n],&npos[pi->a.n],pi->b.n,pos[nw + 1]);
+        keep = near(pos[nw],na,pi->a.n,pos[nw + 1],nb,pi->b.n,pi->dist);
+      }
+      else
+        keep = na > 0;
+        
+      if (keep && (ph->n < max))
+        ph->ord[ph->n++] = v;
+      v++;
+    }
+  }
+  
+  ix_free(alloc,pos);
+  return 0;
+}
+
+/************************************************************************/
+
+static int hits_or(struct lballoc const *alloc,struct lbhits *pa,struct lbhits *pb)
+{
+  uint32_t *ord;
+  
+  if (pb->ord == NULL)
+    return 0;
+  if (pa->ord == NULL)
+  {
+    *pa     = *pb;
+    pb->ord = NULL;
+    return 0;
+  }
+  
+  ord = ix_alloc(alloc,(pa->n + pb->n + 1) * sizeof(uint32_t));
+  if (ord == NULL)
+    return ENOMEM;
+    
+  pa->n = merge(ord,pa->ord,pa->n,pb->ord,pb->n);
+  ix_free(alloc,pa->ord);
+  ix_free(alloc,pb->ord);
+  pa->ord = ord;
+  pb->ord = NULL;
+  return 0;
+}
+
+/************************************************************************/
+
+static void hits_and(struct lballoc const *alloc,struct lbhits *pa,struct lbhits *pb)
+{
+  if (pb->n < pa->n)
+  {
+    struct lbhits tmp = *pa;
+    *pa = *pb;
+    *pb = tmp;
+  }
+  
+  pa->n = intersect(pa->ord,pa->n,pb->ord,pb->n);
+  ix_free(alloc,pb->ord);
+  pb->ord = NULL;
+}
+
+/*******************************************************************
+;
+; The verses an item matches.
+;
+********************************************************************/
+
+static int item_hits(
+                      struct lbindex const *ix,
+                      struct lballoc const *alloc,
+                      struct item    const *pi,
+                      struct lbscope const *scope,
+                      struct lbhits        *ph
+                    )
+{
+  struct lbixword const *words[LB_PHRASEMAX * 2];
+  size_t                 nwords = 0;
+  
+  ph->ord = NULL;
+  ph->n   = 0;
+  
+  if (pi->a.missing || (pi->near && pi->b.missing))
+    return 0;
+  if ((scope != NULL) && (scope->n == 0))
+    return 0;
+    
+  if (pi->a.sound)
+  {
+    for (size_t w = 0 ; w < pi->a.n ; w++)
+    {
+      struct lbhits one;
+      int           rc;
+      
+      if ((rc = words_hits(ix,alloc,&pi->a.pw[w],1,scope,&one)) != 0)
+        return rc;
+      if ((rc = hits_or(alloc,ph,&one)) != 0)
+      {
+        lb_hits_free(&one,alloc);
+        return rc;
+      }
+    }
+    return 0;
+  }
+  
+  for (size_t w = 0 ; w < pi->a.n ; w++)
+    words[nwords++] = pi->a.pw[w];
+  for (size_t w = 0 ; w < pi->b.n ; w++)
+    words[nwords++] = pi->b.pw[w];
+    
+  if ((ix->hdr->positions != 0) && (pi->near || (pi->a.n > 1)))
+    return item_scan(ix,alloc,pi,scope,ph);
+  else
+    return words_hits(ix,alloc,words,nwords,scope,ph);
+}
+
+/*******************************************************************
+;
+; Split off the next piece of the query, a "quoted phrase" or a run of
+; non-blanks.  Returns NULL at the end.
+;
+********************************************************************/
+
+static char *query_token(char **ps,bool *pquoted)
+{
+  char *s = *ps;
+  char *tok;
+  
+  while(isspace((unsigned char)*s))
+    s++;
+    
+  if (*s == '\0')
+    return NULL;
+    
+  if (*s == '"')
+  {
+    tok = ++s;
+    while((*s != '\0') && (*s != '"'))
+      s++;
+    *pquoted = true;
+  }
+  else
+  {
+    tok = s;
+    while((*s != '\0') && !isspace((unsigned char)*s))
+      s++;
+    *pquoted = false;
+  }
+  
+  if (*s != '\0')
+    *s++ = '\0';
+  *ps = s;
+  return tok;
+}
+
+/*******************************************************************
+;
+; Look up the words of a term.  A word the tokenizer splits ("lord's")
+; is a phrase, same as a quoted one.  A ~word has to be a single word.
+;
+********************************************************************/
+
+static int query_term(struct lbindex const *ix,char const *text,bool sound,struct term *pt)
+{
+  char word[LB_WORDMAX];
+  
+  pt->n       = 0;
+  pt->missing = false;
+  pt->sound   = sound;
+  
+  if (sound)
+  {
+    char extra[LB_WORDMAX];
+    
+    if (lb_token(word,sizeof(word),&text) == 0)
+      return 0;
+    if (lb_token(extra,sizeof(extra),&text) > 0)
+      return EINVAL;
+    pt->n       = lb_index_sounds(ix,word,pt->pw,LB_SOUNDMAX);
+    pt->missing = pt->n == 0;
+    return 0;
+  }
+  
+  while(lb_token(word,sizeof(word),&text) > 0)
+  {
+    if (pt->n == LB_PHRASEMAX)
+      return EINVAL;
+    pt->pw[pt->n] = lb_index_word(ix,word);
+    if (pt->pw[pt->n] == NULL)
+      pt->missing = true;
+    pt->n++;
+  }
+  
+  return 0;
+}
+
+/************************************************************************/
+
+static int query_parse(
+                        struct lbindex const *ix,
+                        char                 *s,
+                        struct item          *items,
+                        size_t               *pn
+                      )
+{
+  size_t  n       = 0;
+  bool    alt     = false;
+  bool    pending = false;
+  char   *tok;
+  bool    quoted;
+  
+  while((tok = query_token(&s,&quoted)) != NULL)
+  {
+    struct term term;
+    
+    if (!quoted && ((strcmp(tok,"OR") == 0) || (strcmp(tok,"|") == 0)))
+    {
+      alt = true;
+      continue;
+    }
+    
+    if (!quoted && (strncmp(tok,"NEAR",4) == 0) && ((tok[4] == '\0') || (tok[4] == '/')))
+    {
+      if ((n == 0) || pending || items[n - 1].near || items[n - 1].a.sound)
+        return EINVAL;
+        
+      if (tok[4] == '/')
+      {
+        char          *end;
+        unsigned long  dist = strtoul(&tok[5],&end,10);
+        
+        if ((end == &tok[5]) || (*end != '\0') || (dist == 0) || (dist > LB_POSMAX))
+          return EINVAL;
+        items[n - 1].dist = dist;
+      }
+      else
+        items[n - 1].dist = LB_NEARDEF;
+        
+      pending = true;
+      continue;
+    }
+    
+    if (query_term(ix,tok[0] == '~' && !quoted ? tok + 1 : tok,tok[0] == '~' && !quoted,&term) != 0)
+      return EINVAL;
+    if ((term.n == 0) && !term.missing)
+      continue;
+      
+    if (pending)
+    {
+      if (term.sound)
+        return EINVAL;
+      items[n - 1].b    = term;
+      items[n - 1].near = true;
+      pending           = false;
+      alt               = false;
+      continue;
+    }
+    
+    if (n == LB_QUERYMAX)
+      return EINVAL;
+      
+    items[n].a    = term;
+    items[n].b.n  = 0;
+    items[n].near = false;
+    items[n].dist = 0;
+    items[n].alt  = alt && (n > 0);
+    alt           = false;
+    n++;
+  }
+  
+  if ((n == 0) || pending)
+    return EINVAL;
+    
+  *pn = n;
+  return 0;
+}
+
+/*******************************************************************
+;
+; Run a query, over the whole text if scope is NULL.  Returns 0 (with
+; the hits, possibly none, in ph), EINVAL for an empty, overlong or
+; malformed query, or ENOMEM.  The hits are freed with lb_hits_free().
+;
+********************************************************************/
+
+int lb_search(
+               struct lbindex const *ix,
+               struct lballoc const *alloc,
+               char const           *query,
+               struct lbscope const *scope,
+               struct lbhits        *ph
+             )
+{
+  char          buf[LB_WORDMAX * LB_QUERYMAX];
+  struct item  *items;
+  size_t        nitems;
+  struct lbhits clause;
+  bool          first  = true;
+  int           rc;
+  
+  ph->ord = NULL;
+  ph->n   = 0;
+  
+  if (strlen(query) >= sizeof(buf))
+    return EINVAL;
+  strcpy(buf,query);
+  
+  items = ix_alloc(alloc,LB_QUERYMAX * sizeof(struct item));
+  if (items == NULL)
+    return ENOMEM;
+    
+  if ((rc = query_parse(ix,buf,items,&nitems)) != 0)
+  {
+    ix_free(alloc,items);
+    return rc;
+  }
+  
+  /*------------------------------------------------------------------
+  ; Build up each clause (items joined by OR) and AND it into the
+  ; result once the clause ends.
+  ;------------------------------------------------------------------*/
+  
+  clause.ord = NULL;
+  clause.n   = 0;
+  
+  for (size_t i = 0 ; i < nitems ; i++)
+  {
+    struct lbhits term;
+    
+    if ((i > 0) && !items[i].alt)
+    {
+      if (first)
+      {
+        *ph   = clause;
+        first = false;
+      }
+      else
+        hits_and(alloc,ph,&clause);
+      clause.ord = NULL;
+      clause.n   = 0;
+    }
+    
+    if ((rc = item_hits(ix,alloc,&items[i],scope,&term)) != 0)
+      goto error;
+    if ((rc = hits_or(alloc,&clause,&term)) != 0)
+    {
+      lb_hits_free(&term,alloc);
+      goto error;
+    }
+  }
+  
+  if (first)
+    *ph = clause;
+  else
+    hits_and(alloc,ph,&clause);
+  ix_free(alloc,items);
+  return 0;
+  
+error:
+  lb_hits_free(&clause,alloc);
+  lb_hits_free(ph,alloc);
+  ix_free(alloc,items);
+  return rc;
+}
+
+/************************************************************************/
+
+void lb_hits_free(struct lbhits *ph,struct lballoc const *alloc)
+{
+  ix_free(alloc,ph->ord);
+  ph->ord = NULL;
+  ph->n   = 0;
+}
+
+/*******************************************************************
+;
+; Show hits first .. first + max - 1, a chapter at a time through
+; lb_show_hits().  Returns the number shown.
+;
+********************************************************************/
+
+size_t lb_print_hits(
+                      struct lbctx         *ctx,
+                      struct lbindex const *ix,
+                      struct lbhits  const *ph,
+                      char const           *bookdir,
+                      size_t                first,
+                      size_t                max
+                    )
+{
+  size_t verses[LB_IBUFSIZ];
+  size_t end   = first + max < ph->n ? first + max : ph->n;
+  size_t shown = 0;
+  size_t i     = first;
+  
+  while((i < end) && (ph->ord[i] < ix->hdr->verses))
+  {
+    size_t c = ix_chapter(ix,ph->ord[i]);
+    size_t n = 0;
+    
+    for ( ; (i < end) && (ph->ord[i] < ix->chaps[c + 1].verse) && (n < LB_IBUFSIZ) ; i++)
+      verses[n++] = ph->ord[i] - ix->chaps[c].verse + 1;
+      
+    shown += lb_show_hits(
+                           ctx,
+                           bookdir,
+                           &ix->strings[ix->books[ix->chaps[c].book].name],
+                           ix->chaps[c].number,
+                           verses,
+                           n
+                         );
+  }
+  
+  return shown;
+}
+
+/*******************************************************************
+;
+; Each place word is in a verse, as a concordance line with up to
+; LB_KWICWIDTH bytes on either side, cut back to a space.
+;
+********************************************************************/
+
+static void verse_kwic(
+                        struct lbctx  *ctx,
+                        struct lbkwic *pk,
+                        char const    *text,
+                        char const    *word
+                      )
+{
+  char const *end = text + strlen(text);
+  char const *s   = text;
+  char        tok[LB_WORDMAX];
+  
+  while(*s != '\0')
+  {
+    char const *start;
+    char const *b;
+    char const *a;
+    
+    while((*s != '\0') && !wordchar(*s))
+      s++;
+    start = s;
+    if (lb_token(tok,sizeof(tok),&s) == 0)
+      break;
+    if (strcmp(tok,word) != 0)
+      continue;
+      
+    b = text;
+    if (start - text > LB_KWICWIDTH)
+    {
+      for (b = start - LB_KWICWIDTH ; (b < start) && (*b != ' ') ; b++)
+        ;
+      if (b < start)
+        b++;
+    }
+    
+    a = end;
+    if (end - s > LB_KWICWIDTH)
+      for (a = s + LB_KWICWIDTH ; (a > s) && (*a != ' ') ; a--)
+        ;
+        
+    pk->before = b;
+    pk->blen   = start - b;
+    pk->word   = start;
+    pk->wlen   = s - start;
+    pk->after  = s;
+    pk->alen   = a - s;
+    pk->cutl   = b > text;
+    pk->cutr   = a < end;
+    (*ctx->render->kwic)(ctx,pk);
+  }
+}
+
+/*******************************************************************
+;
+; A concordance of a word:  every verse it's in, book by book, each
+; book started with its counts.  Returns the number of verses.
+;
+********************************************************************/
+
+size_t lb_print_concordance(
+                             struct lbctx          *ctx,
+                             struct lbindex  const *ix,
+                             struct lbixword const *pw
+                           )
+{
+  struct lbixfreq const *pf   = &ix->freqs[pw->freq];
+  struct lbixfreq const *pend = pf + pw->fbooks;
+  char            const *word = &ix->strings[pw->word];
+  struct cursor          cur;
+  struct lbkwic          kwic;
+  size_t                 c    = 0;
+  size_t                 book = SIZE_MAX;
+  size_t                 n    = 0;
+  
+  cur_init(&cur,ix,pw,false);
+  
+  for (cur_seek(&cur,0) ; cur.ord < ix->hdr->verses ; cur_seek(&cur,cur.ord + 1))
+  {
+    while(ix->chaps[c + 1].verse <= cur.ord)
+      c++;
+      
+    kwic.name    = &ix->strings[ix->books[ix->chaps[c].book].name];
+    kwic.chapter = ix->chaps[c].number;
+    kwic.verse   = cur.ord - ix->chaps[c].verse + 1;
+    
+    if (ix->chaps[c].book != book)
+    {
+      book = ix->chaps[c].book;
+      while((pf < pend) && (pf->unit < book))
+        pf++;
+      if ((pf < pend) && (pf->unit == book))
+        (*ctx->render->count)(ctx,kwic.name,0,pf->verses,pf->count);
+    }
+    
+    verse_kwic(ctx,&kwic,&ix->text[ix->texttab[cur.ord]],word);
+    n++;
+  }
+  
+  return n;
+}
+
+/*******************************************************************
+;
+; How often a word appears in each book, and each chapter of each book,
+; straight from the counts in the index.
+;
+********************************************************************/
+
+void lb_print_frequency(
+                         struct lbctx          *ctx,
+                         struct lbindex  const *ix,
+                         struct lbixword const *pw
+                       )
+{
+  struct lbixfreq const *pb   = &ix->freqs[pw->freq];
+  struct lbixfreq const *pc   = pb + pw->fbooks;
+  struct lbixfreq const *pend = pc + pw->fchaps;
+  
+  for (size_t i = 0 ; i < pw->fbooks ; i++)
+  {
+    char const *name = &ix->strings[ix->books[pb[i].unit].name];
+    
+    (*ctx->render->count)(ctx,name,0,pb[i].verses,pb[i].count);
+    for ( ; (pc < pend) && (ix->chaps[pc->unit].book == pb[i].unit) ; pc++)
+      (*ctx->render->count)(ctx,name,ix->chaps[pc->unit].number,pc->verses,pc->count);
+  }
+}
+
+/************************************************************************/
@@ -0,0 +1,226 @@
+/******************************************************************
+*
+* search.h              - API for the full text search index (part of
+*                         liblitbook).
+*
+* Copyright 2022 by Sean Conner.  All Rights Reserved.
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*
+* Comments, questions and criticisms can be sent to: sean@conman.org
+*
+*******************************************************************/
+
+#ifndef SEARCH_H
+#define SEARCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "litbook.h"
+
+#define LB_INDEX_NAME   "search.index"  /* in the top of the data files */
+#define LB_INDEX_MAGIC  "LBIX"
+#define LB_INDEX_VER    5
+#define LB_WORDMAX      64              /* longer words are truncated */
+#define LB_QUERYMAX     32              /* terms in a query */
+#define LB_PHRASEMAX    16              /* words in a phrase */
+#define LB_POSMAX       256             /* positions of a word in a verse */
+#define LB_NEARDEF      5               /* NEAR without a distance */
+#define LB_SKIPSTEP     64              /* postings between skip entries */
+#define LB_SCOPEMAX     16              /* ranges in a scope */
+#define LB_SOUNDMAX     LB_PHRASEMAX    /* words a ~word turns into */
+#define LB_KWICWIDTH    40              /* context each side of a word */
+
+/*******************************************************************
+;
+; The index file, written by breakout (indexer.c) and mapped as is.
+; Everything is a uint32_t in native byte order; offsets are from the
+; start of the file.  Verses are numbered (ordinals) from 0 in document
+; order.  Each word has a postings list, the ordinals of the verses it
+; appears in, stored as differences from the previous ordinal (the
+; first as is) in seven bit groups, low first, with the high bit set
+; on all but the last byte of each number.
+;
+; The positions are optional (hdr.positions is 0 if there are none).
+; For each verse in a word's postings, in the same order, there's a list
+; of where in the verse the word is (counting words from 0), encoded the
+; same way:  the first position plus one, then the differences from the
+; previous position, ending with a 0.  Since a 0 byte can't be part of
+; any other number, a verse's positions can be skipped with memchr().
+;
+; So a search needn't decode a whole postings list to get to the part
+; it wants, every LB_SKIPSTEP'th verse in a list (the LB_SKIPSTEP'th,
+; the 2 * LB_SKIPSTEP'th and so on, counting from 0) has a skip entry
+; with its ordinal and where the number after it, and its positions,
+; start.  A list of n verses has (n - 1) / LB_SKIPSTEP of them.
+;
+; For ~word searches there are two tables mapping sounds to words, one
+; by Soundex (the code as a number) and one by metaphone (the code as a
+; string), each sorted by code, then by the number of verses the word
+; is in, most first.  Only words starting with a letter are in them.
+;
+; Each word also has a count of the verses it's in and the times it
+; appears for each book and chapter it's in (the books first, then the
+; chapters, each in order).  And the text of every verse is kept, each
+; ending with a NUL, so concordance lines can be cut straight out of
+; the index; texttab[ord] is where a verse starts in the text.
+;
+********************************************************************/
+
+struct lbixhdr
+{
+  char     magic[4];
+  uint32_t version;
+  uint32_t size;                        /* of the whole file */
+  uint32_t books;
+  uint32_t chapters;
+  uint32_t verses;
+  uint32_t words;
+  uint32_t tokens;                      /* words in the text, all told */
+  uint32_t booktab;                     /* struct lbixbook[books] */
+  uint32_t chaptab;                     /* struct lbixchap[chapters + 1] */
+  uint32_t wordtab;                     /* struct lbixword[words], sorted */
+  uint32_t strings;                     /* NUL terminated strings */
+  uint32_t postings;
+  uint32_t positions;                   /* 0 if there are none */
+  uint32_t skips;
+  uint32_t skiptab;                     /* struct lbixskip[skips] */
+  uint32_t sounds;
+  uint32_t sdxtab;                      /* struct lbixsound[sounds] */
+  uint32_t mphtab;                      /* struct lbixsound[sounds] */
+  uint32_t freqs;
+  uint32_t freqtab;                     /* struct lbixfreq[freqs] */
+  uint32_t texttab;                     /* uint32_t[verses + 1] */
+  uint32_t text;
+};
+
+struct lbixbook
+{
+  uint32_t name;                        /* string offset */
+  uint32_t chapter;                     /* first entry in chaptab */
+  uint32_t chapters;
+};
+
+struct lbixchap
+{
+  uint32_t verse;                       /* ordinal of first verse */
+  uint32_t book;
+  uint32_t number;
+};
+
+struct lbixword
+{
+  uint32_t word;                        /* string offset */
+  uint32_t verses;                      /* length of the postings list */
+  uint32_t count;                       /* times it appears */
+  uint32_t post;                        /* offset of postings */
+  uint32_t len;                         /* bytes of postings */
+  uint32_t pos;                         /* offset of positions */
+  uint32_t poslen;                      /* bytes of positions */
+  uint32_t skip;                        /* first entry in skiptab */
+  uint32_t skips;
+  uint32_t freq;                        /* first entry in freqtab */
+  uint32_t fbooks;
+  uint32_t fchaps;
+};
+
+struct lbixskip
+{
+  uint32_t ord;
+  uint32_t post;                        /* from the start of the postings */
+  uint32_t pos;                         /* from the start of the positions */
+};
+
+struct lbixsound
+{
+  uint32_t code;                        /* Soundex, or metaphone string */
+  uint32_t word;                        /* entry in wordtab */
+};
+
+struct lbixfreq
+{
+  uint32_t unit;                        /* entry in booktab or chaptab */
+  uint32_t verses;
+  uint32_t count;
+};
+
+struct lbindex
+{
+  unsigned char    const *base;
+  size_t                  size;
+  struct lbixhdr   const *hdr;
+  struct lbixbook  const *books;
+  struct lbixchap  const *chaps;
+  struct lbixword  const *words;
+  struct lbixskip  const *skips;
+  struct lbixsound const *sdx;
+  struct lbixsound const *mph;
+  struct lbixfreq  const *freqs;
+  uint32_t         const *texttab;
+  char             const *text;
+  char             const *strings;
+};
+
+/*******************************************************************
+;
+; The result of a search, ordinals in ascending order.
+;
+********************************************************************/
+
+struct lbhits
+{
+  uint32_t *ord;
+  size_t    n;
+};
+
+/*******************************************************************
+;
+; Where to search:  ranges of verse ordinals, lo through hi - 1, in
+; order and not overlapping.  Made from references by lb_index_scope().
+;
+********************************************************************/
+
+struct lbspan
+{
+  uint32_t lo;
+  uint32_t hi;
+};
+
+struct lbscope
+{
+  struct lbspan span[LB_SCOPEMAX];
+  size_t        n;
+};
+
+/************************************************************************/
+
+extern size_t                 lb_token            (char *,size_t,char const **);
+
+extern int                    lb_index_open       (struct lbindex *,char const *);
+extern void                   lb_index_close      (struct lbindex *);
+extern struct lbixword const *lb_index_word       (struct lbindex const *,char const *);
+extern size_t                 lb_index_sounds     (struct lbindex const *,char const *,struct lbixword const **,size_t);
+extern size_t                 lb_index_postings   (struct lbindex const *,struct lbixword const *,uint32_t *);
+extern int                    lb_index_locate     (struct lbindex const *,uint32_t,char const **,size_t *,size_t *);
+extern int                    lb_index_scope      (struct lbindex const *,struct lbtrans const *,char const *,struct lbscope *);
+
+extern int                    lb_search           (struct lbindex const *,struct lballoc const *,char const *,struct lbscope const *,struct lbhits *);
+extern void                   lb_hits_free        (struct lbhits *,struct lballoc const *);
+extern size_t                 lb_print_hits       (struct lbctx *,struct lbindex const *,struct lbhits const *,char const *,size_t,size_t);
+extern size_t                 lb_print_concordance(struct lbctx *,struct lbindex const *,struct lbixword const *);
+extern void                   lb_print_frequency  (struct lbctx *,struct lbindex const *,struct lbixword const *);
+
+#endif
@@ -24,159 +24,109 @@
 *
 ********************************************************************/
 
-#include <stdbool.h>
-#include <ctype.h>
+#include <stddef.h>
 #include <string.h>
 
 #include "soundex.h"
 
-/*************************************************************************/
+/*************************************************************************
+;
+; Character classes.  1 through 6 are the codes themselves; SX_IGNORE are
+; the characters skipped between codes, of which SX_HW (H and W) are also
+; skipped inside a run of the same code.  Everything else (including NUL)
+; is SX_OTHER and codes as '0'.  Lower case is folded in the table.
+;
+**************************************************************************/
 
-static bool inset(char const *s,char const *set)
+enum
 {
-  return ((*s != '\0') && (strchr(set,toupper(*s)) != NULL));
-}
+  SX_OTHER  = 0,
+  SX_IGNORE = 7,
+  SX_HW     = 8,
+};
 
-/*************************************************************************/
+#define SX(c,v)         [c] = v , [(c) + ('a' - 'A')] = v
 
-static char const *nextchar(char const *s,char const *set)
+static unsigned char const c_class[256] =
 {
-  while(inset(s,set))
-    s++;
-  return s;
-}
-
-/*************************************************************************/
-
-static char const *ignore(char const *s)
-{
-  return nextchar(s,"AEIOUWYH'");
-}
-
-/*************************************************************************/
-
-static char const *skip(char const *s)
-{
-  return nextchar(s,"HW");
-}
-
-/*************************************************************************/
-
-static bool checkset(char const **ps,char const*set,char *d,char ret)
-{
-  char const *s = *ps;
+  SX('A',SX_IGNORE) , SX('E',SX_IGNORE) , SX('I',SX_IGNORE) ,
+  SX('O',SX_IGNORE) , SX('U',SX_IGNORE) , SX('Y',SX_IGNORE) ,
+  SX('H',SX_HW)     , SX('W',SX_HW)     , ['\''] = SX_IGNORE ,
   
-  if (!inset(s,set))
-    return false;
-    
-  s = nextchar(s,set);
-  s = skip(s);
-  if (inset(s,set))
-    s = nextchar(s,set);
-  *ps = s;
-  *d  = ret;
-  return true;
-}
-
-/*************************************************************************/
-
-static bool cs1(char const **s,char *d)
-{
-  return checkset(s,"BFPV",d,'1');
-}
-
-/*************************************************************************/
-
-static bool cs2(char const **s,char *d)
-{
-  return checkset(s,"CGJKQSXZ",d,'2');
-}
-
-/*************************************************************************/
-
-static bool cs3(char const **s,char *d)
-{
-  return checkset(s,"DT",d,'3');
-}
-
-/*************************************************************************/
-
-static bool cs4(char const **s,char *d)
-{
-  return checkset(s,"L",d,'4');
-}
-
-/*************************************************************************/
-
-static bool cs5(char const **s,char *d)
-{
-  return checkset(s,"MN",d,'5');
-}
-
-/*************************************************************************/
-
-static bool cs6(char const **s,char *d)
+  SX('B',1) , SX('F',1) , SX('P',1) , SX('V',1) ,
+  SX('C',2) , SX('G',2) , SX('J',2) , SX('K',2) ,
+  SX('Q',2) , SX('S',2) , SX('X',2) , SX('Z',2) ,
+  SX('D',3) , SX('T',3) ,
+  SX('L',4) ,
+  SX('M',5) , SX('N',5) ,
+  SX('R',6) ,
+};
+
+#define class(s)        c_class[(unsigned char)*(s)]
+
+/*************************************************************************
+;
+; Skip a run of a code, along with any H or W in the middle of it, so
+; "Ashcroft" is A261, not A226.
+;
+**************************************************************************/
+
+static char const *run(char const *s,int code)
 {
-  return checkset(s,"R",d,'6');
+  while(class(s) == code) s++;
+  while(class(s) == SX_HW) s++;
+  while(class(s) == code) s++;
+  return s;
 }
 
 /*************************************************************************/
 
 static char const *use(char const *s,char *d)
 {
-  s = ignore(s);
-  if (cs1(&s,d))
-    return s;
-  else if (cs2(&s,d))
-    return s;
-  else if (cs3(&s,d))
-    return s;
-  else if (cs4(&s,d))
-    return s;
-  else if (cs5(&s,d))
-    return s;
-  else if (cs6(&s,d))
-    return s;
-  else
+  int code;
+  
+  while(class(s) >= SX_IGNORE)
+    s++;
+    
+  code = class(s);
+  if (code != SX_OTHER)
   {
-    *d = '0';
-    return *s == '\0' ? s : ++s;
+    *d = '0' + code;
+    return run(s,code);
   }
+  
+  *d = '0';
+  return *s == '\0' ? s : s + 1;
 }
 
 /*************************************************************************/
 
-static char const *initial(char const *s,char *d)
+SOUNDEX (Soundex)(char const *name)
 {
-  char dummy;
+  SOUNDEX code;
+  int     c;
+  
+  if (*name == '\0')
+  {
+    memcpy(code.cval,"\0" "000",sizeof(code.cval));
+    return code;
+  }
   
-  *d = toupper(*s);
-  if (cs1(&s,&dummy))
-    return s;
-  else if (cs2(&s,&dummy))
-    return s;
-  else if (cs3(&s,&dummy))
-    return s;
-  else if (cs4(&s,&dummy))
-    return s;
-  else if (cs5(&s,&dummy))
-    return s;
-  else if (cs6(&s,&dummy))
-    return s;
-  else
-    return ++s;
+  code.cval[0] = (*name >= 'a') && (*name <= 'z') ? *name - ('a' - 'A') : *name;
+  c            = class(name);
+  name         = (c >= 1) && (c <= 6) ? run(name,c) : name + 1;
+  name         = use(name,&code.cval[1]);
+  name         = use(name,&code.cval[2]);
+                 use(name,&code.cval[3]);
+  return code;
 }
 
-/*************************************************************************/
+/**********************************************************************/
 
-SOUNDEX (Soundex)(char const *name)
+void (SoundexMany)(SOUNDEX *dest,char const *const *names,size_t n)
 {
-  SOUNDEX code;
-  name = initial(name,&code.cval[0]);
-  name = use(name,&code.cval[1]);
-  name = use(name,&code.cval[2]);
-         use(name,&code.cval[3]);
-  return code;
+  for (size_t i = 0 ; i < n ; i++)
+    dest[i] = Soundex(names[i]);
 }
 
 /**********************************************************************/
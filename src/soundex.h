@@ -26,6 +26,8 @@
 #ifndef SOUNDEX_H
 #define SOUNDEX_H
 
+#include <stddef.h>
+
 typedef union soundex
 {
   char cval[4];
@@ -35,6 +37,7 @@ typedef union soundex
 /************************************************************************/
 
 extern SOUNDEX  Soundex      (char const *);
+extern void     SoundexMany  (SOUNDEX *,char const *const *,size_t);
 extern char    *SoundexString(char *,SOUNDEX);
 
 /*************************************************************************/
@@ -29,105 +29,279 @@
 * 19991122.1712 1.0.0   spc
 *       Initial release
 *
+* 20221001      1.1.0   spc
+*       Use liblitbook instead of carrying a second copy of the module
+*       code.
+*
+* 20221002      1.2.0   spc
+*       Added --bench, to replay a list of references (or a synthetic
+*       Zipf distributed mix) through the same path the module uses and
+*       report throughput and latency.
+*
+* 20221205      1.3.0   spc
+*       Lines starting with `?' are run as searches against the full text
+*       index, if the data files have one.
+*
+* 20221207      1.4.0   spc
+*       Lines starting with `/' are scanned for as is, no index needed,
+*       with --threads threads.
+*
+* 20221209      1.4.1   spc
+*       A search can start with a scope in brackets, `?[Genesis.12-22]
+*       covenant'.
+*
+* 20221212      1.5.0   spc
+*       Lines starting with `=' give a concordance of a word, and `%' its
+*       counts by book and chapter, from the index.
+*
+* 20221214      1.6.0   spc
+*       More than one bookdir can be given; lines starting with `|' show
+*       the reference from all of them in parallel.
+*
+* 20221215      1.7.0   spc
+*       Added --map, a versification map for the first bookdir.
+*
 ********************************************************************/
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
 #include <string.h>
-#include <limits.h>
-#include <ctype.h>
+#include <math.h>
+#include <time.h>
+#include <errno.h>
 #include <assert.h>
 
-#include <unistd.h>
+#include <getopt.h>
+#include <pthread.h>
 
-#include "soundex.h"
-#include "metaphone.h"
+#include "litbook.h"
+#include "search.h"
+#include "scan.h"
 
-#define BUMPSIZE        10
+#define DEF_REQUESTS    100000uL
 
-/***************************************************************/
+/*************************************************************/
 
-struct bookname
+struct bench
 {
-  char    *s1;
-  char    *s2;
-  SOUNDEX  sdx;
-  char    *mp;
+  struct lbtrans  *trans;
+  char const      *bookdir;
+  char           **refs;
+  size_t           nrefs;
 };
 
-struct bookrequest
+struct worker
 {
-  char   *name;
-  size_t  c1;
-  size_t  v1;
-  size_t  c2;
-  size_t  v2;
-  int     redirect;
+  pthread_t        tid;
+  struct bench    *bench;
+  size_t           start;
+  size_t           step;
+  uint64_t        *lat;
+  size_t           n;
+  size_t           found;
+  size_t           redirect;
+  size_t           notfound;
+  size_t           bytes;
+  struct lbstats   stats;
+};
+
+struct chapref
+{
+  size_t book;
+  size_t chapter;
+  size_t verses;
 };
 
 /*************************************************************/
 
-static void      translate_request      (struct bookrequest *,char *);
-static void      read_booklist          (char *);
-static void      print_request          (struct bookrequest *);
-static int       show_chapter           (size_t,size_t,size_t);
-static int       sort_abrev             (const void *,const void *);
-static int       sort_fullname          (const void *,const void *);
-static int       sort_sounds            (const void *,const void *);
-static int       sort_metaphone         (const void *,const void *);
-static int       find_abrev             (const void *,const void *);
-static int       find_fullname          (const void *,const void *);
-static int       find_sounds            (const void *,const void *);
-static int       find_metaphone         (const void *,const void *);
-static char     *trim_lspace            (char *);
-static char     *trim_tspace            (char *);
-static char     *trim_space             (char *);
-static char     *m_strdup               (char *);
-
-static void      dump_list              (struct bookname **);
+static int       write_stdout           (void *,char const *,size_t);
+static int       write_null             (void *,char const *,size_t);
+static void      dump_list              (struct lbtrans *,struct lbbookname **);
+static int       bench                  (struct lbtrans *,char const *,char const *,size_t,long,unsigned long,double);
+static void     *bench_worker           (void *);
+static char    **read_log               (char const *,size_t *);
+static char    **make_zipf              (struct lbtrans *,char const *,size_t,unsigned long,double);
+static uint64_t  rnd                    (uint64_t *);
+static uint64_t  now                    (void);
+static int       cmp_u64                (void const *,void const *);
+static double    percentile             (uint64_t *,size_t,double);
+static void      search                 (struct lbctx *,struct lbindex const *,struct lbtrans const *,char *,char const *);
+static void      scan                   (struct lbctx *,struct lbtrans const *,char const *,char const *,long);
+static void      concordance            (struct lbctx *,struct lbindex const *,char const *,bool);
+static void      parallel               (struct lbctx *,struct lbtrans const *,struct lbvmap const *,char const *,char **,size_t);
 
 /*************************************************************/
 
-static struct bookname   *books     = NULL;
-static struct bookname  **abrev     = NULL;
-static struct bookname  **fullname  = NULL;
-static struct bookname  **sounds    = NULL;
-static struct bookname  **metaphone = NULL;
-static size_t             maxbook   = 0;
+static struct option const c_options[] =
+{
+  { "bench"    , no_argument       , NULL , 'b' } ,
+  { "log"      , required_argument , NULL , 'l' } ,
+  { "requests" , required_argument , NULL , 'n' } ,
+  { "threads"  , required_argument , NULL , 't' } ,
+  { "seed"     , required_argument , NULL , 's' } ,
+  { "zipf"     , required_argument , NULL , 'z' } ,
+  { "map"      , required_argument , NULL , 'm' } ,
+  { "help"     , no_argument       , NULL , 'h' } ,
+  { NULL       , 0                 , NULL , 0   }
+};
 
 /************************************************************/
 
 int main(int argc,char *argv[])
 {
-  char               buffer[BUFSIZ];
-  struct bookrequest br;
+  char             buffer[BUFSIZ];
+  struct lbtrans   trans;
+  struct lbrequest br;
+  struct lbctx     ctx;
+  struct lbindex   index;
+  char             fname[FILENAME_MAX];
+  size_t           line;
+  int              rc;
+  int              c;
+  bool             fbench   = false;
+  char const      *log      = NULL;
+  size_t           requests = DEF_REQUESTS;
+  long             threads  = 1;
+  unsigned long    seed     = 1;
+  double           zipf     = 1.0;
+  char const      *mapfile  = NULL;
+  struct lbvmap    map;
+  
+  while((c = getopt_long(argc,argv,"bl:n:t:s:z:m:h",c_options,NULL)) != EOF)
+  {
+    switch(c)
+    {
+      case 'b': fbench   = true;                      break;
+      case 'l': log      = optarg;                    break;
+      case 'n': requests = strtoul(optarg,NULL,10);   break;
+      case 't': threads  = strtol(optarg,NULL,10);    break;
+      case 's': seed     = strtoul(optarg,NULL,10);   break;
+      case 'z': zipf     = strtod(optarg,NULL);       break;
+      case 'm': mapfile  = optarg;                    break;
+      case 'h':
+      default:
+           fprintf(
+                    stderr,
+                    "usage: %s [options] <booklist> <bookdir> [bookdir...]\n"
+                    "\t-b | --bench        replay references and report timings\n"
+                    "\t-l | --log file     references to replay (default synthetic)\n"
+                    "\t-n | --requests n   synthetic requests (default %lu)\n"
+                    "\t-t | --threads n    threads (default 1)\n"
+                    "\t-s | --seed n       synthetic random seed (default 1)\n"
+                    "\t-z | --zipf s       synthetic Zipf exponent (default 1.0)\n"
+                    "\t-m | --map file     versification map for the first bookdir\n"
+                    "\t-h | --help         this text\n",
+                    argv[0],
+                    DEF_REQUESTS
+                  );
+           exit(1);
+    }
+  }
+  
+  if (argc - optind < 2)
+  {
+    fprintf(stderr,"%s [options] <booklist> <bookdir> [bookdir...]\n",argv[0]);
+    exit(1);
+  }
+  
+  argv += optind - 1;
+  argc -= optind - 1;
   
-  if (argc < 3)
+  rc = lb_trans_load(&trans,argv[1],&lb_malloc,&line);
+  if (rc != 0)
   {
-    fprintf(stderr,"%s <booklist> <bookdir>\n",argv[0]);
+    if (rc == EINVAL)
+      fprintf(stderr,"%s: corrupted on or around line %zu\n",argv[1],line);
+    else
+      fprintf(stderr,"%s: %s\n",argv[1],strerror(rc));
     exit(1);
   }
   
-  read_booklist(argv[1]);
-  dump_list(abrev);
+  memset(&map,0,sizeof(map));
+  if (mapfile != NULL)
+  {
+    rc = lb_vmap_load(&map,&trans,mapfile,&lb_malloc,&line);
+    if (rc != 0)
+    {
+      if (rc == EINVAL)
+        fprintf(stderr,"%s: corrupted on or around line %zu\n",mapfile,line);
+      else
+        fprintf(stderr,"%s: %s\n",mapfile,strerror(rc));
+      exit(1);
+    }
+  }
+  
+  if (fbench)
+  {
+    if (threads < 1) threads = 1;
+    rc = bench(&trans,argv[2],log,requests,threads,seed,zipf);
+    lb_trans_free(&trans,&lb_malloc);
+    return(rc);
+  }
+  
+  dump_list(&trans,trans.abrev);
 #if 0
-  dump_list(fullname);
-  dump_list(sounds);
+  dump_list(&trans,trans.fullname);
+  dump_list(&trans,trans.soundex);
 #endif
-  chdir(argv[2]);
-  
+
+  ctx.alloc  = &lb_malloc;
+  ctx.render = &lb_render_text;
+  ctx.write  = write_stdout;
+  ctx.ud     = stdout;
+  ctx.bytes  = 0;
+  ctx.timed  = false;
+  memset(&ctx.stats,0,sizeof(ctx.stats));
+  
+  snprintf(fname,sizeof(fname),"%s/%s",argv[2],LB_INDEX_NAME);
+  rc = lb_index_open(&index,fname);
+  if ((rc != 0) && (rc != ENOENT))
+    fprintf(stderr,"%s: %s\n",fname,strerror(rc));
+    
   while(fgets(buffer,sizeof(buffer),stdin))
   {
     char *p = strchr(buffer,'\n'); if (p) *p = '\0';
     
-    translate_request(&br,buffer);
+    if (buffer[0] == '?')
+    {
+      if (index.base == NULL)
+        printf("no search index\n");
+      else
+        search(&ctx,&index,&trans,&buffer[1],argv[2]);
+      continue;
+    }
+    
+    if (buffer[0] == '/')
+    {
+      scan(&ctx,&trans,&buffer[1],argv[2],threads);
+      continue;
+    }
+    
+    if ((buffer[0] == '=') || (buffer[0] == '%'))
+    {
+      if (index.base == NULL)
+        printf("no search index\n");
+      else
+        concordance(&ctx,&index,&buffer[1],buffer[0] == '%');
+      continue;
+    }
+    
+    if (buffer[0] == '|')
+    {
+      parallel(&ctx,&trans,&map,&buffer[1],&argv[2],argc - 2);
+      continue;
+    }
+    
+    lb_translate_request(&br,&trans,buffer);
     if (br.name == NULL)
     {
       printf("error in request\n");
       continue;
     }
 #if 1
-    print_request(&br);
+    lb_print_request(&ctx,&br,argv[2],&map);
 #else
     if (br.redirect)
       printf("%s->",buffer);
@@ -139,470 +313,663 @@ int main(int argc,char *argv[])
             (unsigned long)br.c2,
             (unsigned long)br.v2
           );
-    /*print_request(&br);*/
 #endif
   }
   
+  lb_index_close(&index);
+  if (map.books != NULL)
+    lb_vmap_free(&map,&lb_malloc);
+  lb_trans_free(&trans,&lb_malloc);
   return(0);
 }
 
-/********************************************************************/
+/*******************************************************************/
 
-static void translate_request(struct bookrequest *pbr,char *r)
+static void search(
+                    struct lbctx         *ctx,
+                    struct lbindex const *pix,
+                    struct lbtrans const *trans,
+                    char                 *query,
+                    char const           *bookdir
+                  )
 {
-  char    buffer[BUFSIZ];
-  char   *p;
-  size_t  size;
-  struct bookname **pres;
-  
-  assert(pbr != NULL);
-  assert(r   != NULL);
-  
-  pbr->name     = NULL;
-  pbr->c1       = 1;
-  pbr->v1       = 1;
-  pbr->c2       = INT_MAX;
-  pbr->v2       = INT_MAX;
-  pbr->redirect = 0;
-  
-  for (p = buffer , size = 0; (*r) && (!ispunct(*r)) ; r++ , size++)
+  struct lbscope  scope;
+  struct lbscope *ps = NULL;
+  struct lbhits   hits;
+  int             rc;
+  
+  assert(ctx     != NULL);
+  assert(pix     != NULL);
+  assert(trans   != NULL);
+  assert(query   != NULL);
+  assert(bookdir != NULL);
+  
+  if (query[0] == '[')
   {
-    *p++ = tolower(*r);
-    *p   = '\0';
-  }
-  
-  if (size < 2) return;
-  if (isdigit(buffer[0]))
-    buffer[1] = toupper(buffer[1]);
-  else
-    buffer[0] = toupper(buffer[0]);
+    char *end = strchr(query,']');
     
-  pres = bsearch(buffer,fullname,maxbook,sizeof(struct bookname *),find_fullname);
-  if (pres == NULL)
-  {
-    pbr->redirect = 1;
-    pres = bsearch(buffer,abrev,maxbook,sizeof(struct bookname *),find_abrev);
-    if (pres == NULL)
-    {
-      SOUNDEX sdx = Soundex(buffer);
-      
-      pres = bsearch(&sdx,sounds,maxbook,sizeof(struct bookname *),find_sounds);
-      if (pres == NULL)
-      {
-        char mp[BUFSIZ];
-        int  rc;
-        
-        rc = make_metaphone(buffer,mp,BUFSIZ);
-        if (rc == 0) return;
-        pres = bsearch(mp,metaphone,maxbook,sizeof(struct bookname *),find_metaphone);
-        if (pres == NULL) return;
-      }
-    }
-  }
-  
-  pbr->name = (*pres)->s2;
-  
-  if (*r == '\0') return;               /* 1. G or G- */
-  if (*r == '-')  return;
-  
-  pbr->c1 = strtoul(r+1,&r,10);
-  if (*r == '\0')                       /* 2. G.a */
-  {
-    pbr->c2 = pbr->c1;
-    return;
-  }
-  
-  if ((*r == '.') || (*r == ':'))
-  {
-    pbr->v1 = strtoul(r+1,&r,10);       /* 3. G.a.b */
-    if (*r++ != '-')
+    if (end == NULL)
     {
-      pbr->c2 = pbr->c1;
-      pbr->v2 = pbr->v1;
+      printf("error in scope\n");
       return;
     }
-    if (!isdigit(*r)) return;           /* 4. G.a.b- */
     
-    pbr->c2 = strtoul(r,&r,10);         /* 5. G.a.b-x */
-    if ((*r != '.') && (*r != ':'))
+    *end = '\0';
+    rc   = lb_index_scope(pix,trans,&query[1],&scope);
+    if (rc != 0)
     {
-      pbr->v2 = pbr->c2;
-      pbr->c2 = pbr->c1;
+      printf("error in scope: %s\n",strerror(rc));
       return;
     }
-    
-    pbr->v2 = strtoul(r+1,&r,10);       /* 6. G.a.b-x.y */
-    return;
+    ps    = &scope;
+    query = end + 1;
   }
   
-  if (*r++ != '-')                      /* 2. G.a */
+  rc = lb_search(pix,&lb_malloc,query,ps,&hits);
+  if (rc != 0)
   {
-    pbr->c2 = pbr->c1;
+    printf("error in search: %s\n",strerror(rc));
     return;
   }
   
-  if (!isdigit(*r)) return;             /* 7. G.a- */
-  
-  pbr->c2 = strtoul(r,&r,10);           /* 8. G.a-x */
-  if ((*r != '.') && (*r != ':')) return;
-  
-  pbr->v2 = strtoul(r+1,&r,10);         /* 9. G.a-x.y */
+  printf("%zu verses\n\n",hits.n);
+  lb_print_hits(ctx,pix,&hits,bookdir,0,hits.n);
+  lb_hits_free(&hits,&lb_malloc);
 }
 
-/********************************************************************/
+/*******************************************************************/
 
-static void print_request(struct bookrequest *pbr)
+static void concordance(
+                         struct lbctx         *ctx,
+                         struct lbindex const *pix,
+                         char const           *text,
+                         bool                  freq
+                       )
 {
-  int    rc;
-  size_t i;
+  char                   word[LB_WORDMAX];
+  struct lbixword const *pw;
   
-  assert(pbr != NULL);
+  assert(ctx  != NULL);
+  assert(pix  != NULL);
+  assert(text != NULL);
   
-  rc = chdir(pbr->name);
-  if (rc != 0)
+  if (lb_token(word,sizeof(word),&text) == 0)
   {
-    printf("error\n");
+    printf("error in word\n");
     return;
   }
   
-  printf("\n%s\n",pbr->name);
-  
-  if (pbr->c1 == pbr->c2)
-    show_chapter(pbr->c1,pbr->v1,pbr->v2);
-  else
+  pw = lb_index_word(pix,word);
+  if (pw == NULL)
   {
-    for (i = pbr->c1 ; i <= pbr->c2 ; i++ )
-    {
-      if (i == pbr->c1)
-      {
-        if (show_chapter(i,pbr->v1,INT_MAX)) break;
-      }
-      else if (i == pbr->c2)
-      {
-        if (show_chapter(i,1,pbr->v2)) break;
-      }
-      else
-      {
-        if (show_chapter(i,1,INT_MAX)) break;
-      }
-    }
+    printf("0 verses\n");
+    return;
   }
   
-  chdir("..");
+  printf("%s: %lu times in %lu verses\n",word,(unsigned long)pw->count,(unsigned long)pw->verses);
+  if (freq)
+    lb_print_frequency(ctx,pix,pw);
+  else
+    lb_print_concordance(ctx,pix,pw);
 }
 
-/********************************************************************/
+/*******************************************************************/
 
-static int show_chapter(size_t chapter,size_t vlow,size_t vhigh)
+static void parallel(
+                      struct lbctx         *ctx,
+                      struct lbtrans const *trans,
+                      struct lbvmap  const *map,
+                      char const           *ref,
+                      char                **dirs,
+                      size_t                n
+                    )
 {
-  long int *iarray;
-  FILE     *fp;
-  char      fname[BUFSIZ];
-  size_t    max;
-//  long      i;
-  long      s;
-  char     *p;
-  
-  assert(chapter > 0);
-  assert(vlow    > 0);
-  
-  sprintf(fname,"%lu.index",(unsigned long)chapter);
-  fp = fopen(fname,"rb");
-  
-  if (fp == NULL) return(1);
+  struct lbcolumn  cols[LB_PARMAX];
+  struct lbrequest br;
   
-  fread(&max,sizeof(max),1,fp);
-  if (max < 1)
-  {
-    fclose(fp);
-    return(1);
-  }
+  assert(ctx   != NULL);
+  assert(trans != NULL);
+  assert(ref   != NULL);
+  assert(dirs  != NULL);
   
-  if (vlow > max)
+  lb_translate_request(&br,trans,ref);
+  if (br.name == NULL)
   {
-    fclose(fp);
-    return(1);
+    printf("error in request\n");
+    return;
   }
   
-  if (vhigh > max) vhigh = max;
+  if (n > LB_PARMAX) n = LB_PARMAX;
   
-  iarray = malloc((max + 1) * sizeof(long));
-  if (iarray == NULL)
+  for (size_t i = 0 ; i < n ; i++)
   {
-    fclose(fp);
-    return(1);
+    cols[i].label   = dirs[i];
+    cols[i].bookdir = dirs[i];
+    cols[i].name    = br.name;
+    cols[i].map     = i == 0 ? lb_vmap_book(map,br.book) : NULL;
   }
   
-  fread(iarray,sizeof(long),max + 1,fp);
-  fclose(fp);
-  
-  sprintf(fname,"%lu",(unsigned long)chapter);
-  fp = fopen(fname,"rb");
-  
-  printf("Chapter %lu\n\n",(unsigned long)chapter);
-  if (vlow > 1)
-    printf("\t.\n\t.\n\t.\n");
-    
-  for (size_t i = vlow ; i <= vhigh ; i++)
-  {
-    s = iarray[i] - iarray[i-1];
-    p = malloc(s);
-    if (p == NULL)
-    {
-      fclose(fp);
-      free(iarray);
-      return(0);
-    }
-    
-    fseek(fp,iarray[i-1],SEEK_SET);
-    fread(p,sizeof(char),s,fp);
-    printf("%lu. ",(unsigned long)i);
-    fwrite(p,sizeof(char),s,stdout);
-    printf("\n\n");
-    free(p);
-  }
-  fclose(fp);
-  free(iarray);
-  return(0);
+  lb_show_parallel(ctx,cols,n,&br);
 }
 
-/********************************************************************/
+/*******************************************************************/
 
-static void read_booklist(char *fname)
+static void scan(
+                  struct lbctx         *ctx,
+                  struct lbtrans const *trans,
+                  char const           *pattern,
+                  char const           *bookdir,
+                  long                  threads
+                )
 {
-  size_t  size = 0;
-  FILE   *fp;
-  char    buffer[BUFSIZ];
-  
-  assert(fname != NULL);
-  
-  fp = fopen(fname,"r");
-  if (fp == NULL) return;
-  
-  while(fgets(buffer,BUFSIZ,fp))
+  struct lbscanreq req;
+  struct lbscan    hits;
+  int              rc;
+  
+  assert(ctx     != NULL);
+  assert(trans   != NULL);
+  assert(pattern != NULL);
+  assert(bookdir != NULL);
+  
+  req.trans   = trans;
+  req.bookdir = bookdir;
+  req.pattern = pattern;
+  req.max     = 0;
+  req.threads = threads;
+  req.cancel  = NULL;
+  req.ud      = NULL;
+  
+  rc = lb_scan(&hits,&req,&lb_malloc);
+  if (rc != 0)
   {
-    char *s1;
-    char *s2;
-    char *s11;
-    char *s22;
-    char  mp[BUFSIZ];
-    
-    if (maxbook == size)
-    {
-      size  += BUMPSIZE;
-      books  = realloc(books,size * sizeof(struct bookname));
-    }
-    
-    s1 = strtok(buffer,",");
-    s2 = strtok(NULL,",\n");
-    assert(s1 != NULL);
-    assert(s2 != NULL);
-    
-    s1 = trim_space(s1);
-    s2 = trim_space(s2);
-    s11 = m_strdup(s1);
-    s22 = m_strdup(s2);
-    
-    books[maxbook].s1  = s11;
-    books[maxbook].s2  = s22;
-    books[maxbook].sdx = isdigit(*s22) ? Soundex(s22+1) : Soundex(s22) ;
-    make_metaphone(s22,mp,sizeof(mp));
-    books[maxbook].mp  = m_strdup(mp);
-    maxbook++;
+    printf("error in scan: %s\n",strerror(rc));
+    return;
   }
   
-  abrev     = malloc(maxbook * sizeof(struct bookname *));
-  fullname  = malloc(maxbook * sizeof(struct bookname *));
-  sounds    = malloc(maxbook * sizeof(struct bookname *));
-  metaphone = malloc(maxbook * sizeof(struct bookname *));
-  
-  for (size_t i = 0 ; i < maxbook ; i++)
-    abrev[i] = fullname[i] = sounds[i] = metaphone[i] = &books[i];
-    
-  qsort(abrev,    maxbook,sizeof(struct bookname *),sort_abrev);
-  qsort(fullname, maxbook,sizeof(struct bookname *),sort_fullname);
-  qsort(sounds,   maxbook,sizeof(struct bookname *),sort_sounds);
-  qsort(metaphone,maxbook,sizeof(struct bookname *),sort_metaphone);
+  printf("%zu verses\n\n",hits.n);
+  lb_print_scan(ctx,&hits,bookdir,0,hits.n);
+  lb_scan_free(&hits,&lb_malloc);
 }
 
-/**************************************************************/
+/*******************************************************************/
 
-static int sort_abrev(const void *o1,const void *o2)
+static int write_stdout(void *ud,char const *buf,size_t len)
 {
-  const struct bookname *pbn1;
-  const struct bookname *pbn2;
+  assert(ud  != NULL);
+  assert(buf != NULL);
   
-  assert(o1 != NULL);
-  assert(o2 != NULL);
-  
-  pbn1 = *((struct bookname **)o1);
-  pbn2 = *((struct bookname **)o2);
-  
-  return(strcmp(pbn1->s1,pbn2->s1));
+  return(fwrite(buf,1,len,ud) == len ? 0 : -1);
 }
 
-/*****************************************************************/
+/*******************************************************************/
 
-static int sort_fullname(const void *o1,const void *o2)
+static int write_null(void *ud,char const *buf,size_t len)
 {
-  const struct bookname *pbn1;
-  const struct bookname *pbn2;
-  
-  assert(o1 != NULL);
-  assert(o2 != NULL);
-  
-  pbn1 = *((struct bookname **)o1);
-  pbn2 = *((struct bookname **)o2);
-  
-  return(strcmp(pbn1->s2,pbn2->s2));
+  (void)ud;
+  (void)buf;
+  (void)len;
+  return(0);
 }
 
 /*******************************************************************/
 
-static int sort_sounds(const void *o1,const void *o2)
+static void dump_list(struct lbtrans *ptrans,struct lbbookname **pa)
 {
-  const struct bookname *pbn1;
-  const struct bookname *pbn2;
-  
-  assert(o1 != NULL);
-  assert(o2 != NULL);
+  char buffer[BUFSIZ];
   
-  pbn1 = *((struct bookname **)o1);
-  pbn2 = *((struct bookname **)o2);
+  assert(ptrans != NULL);
+  assert(pa     != NULL);
   
-  return(SoundexCompare(pbn1->sdx,pbn2->sdx));
+  printf("Dump list\n");
+  for (size_t i = 0 ; i < ptrans->maxbook ; i++)
+  {
+    printf(
+            "\t%s\t, %s(%s)[%s]\n",
+            pa[i]->abrev,
+            pa[i]->fullname,
+            SoundexString(buffer,pa[i]->sdx),
+            pa[i]->mp
+          );
+  }
 }
 
-/********************************************************************/
+/*******************************************************************
+;
+; The benchmark.  Every request goes through what the module does: parse
+; the reference, look up the book, and either redirect, 404, or read and
+; render the chapters.  The rendered output is counted and discarded.
+;
+********************************************************************/
 
-static int sort_metaphone(const void *o1,const void *o2)
+static int bench(
+                  struct lbtrans *ptrans,
+                  char const     *bookdir,
+                  char const     *log,
+                  size_t          requests,
+                  long            threads,
+                  unsigned long   seed,
+                  double          zipf
+                )
 {
-  const struct bookname *pbn1;
-  const struct bookname *pbn2;
+  struct bench    b;
+  struct worker  *w;
+  struct lbstats  stats;
+  uint64_t       *lat;
+  uint64_t        start;
+  double          elapsed;
+  size_t          n;
+  size_t          found    = 0;
+  size_t          redirect = 0;
+  size_t          notfound = 0;
+  size_t          bytes    = 0;
+  
+  assert(ptrans  != NULL);
+  assert(bookdir != NULL);
+  assert(threads >  0);
+  
+  b.trans   = ptrans;
+  b.bookdir = bookdir;
+  b.refs    = log != NULL
+            ? read_log(log,&b.nrefs)
+            : make_zipf(ptrans,bookdir,requests,seed,zipf)
+            ;
+  if (log == NULL) b.nrefs = requests;
+  
+  if ((b.refs == NULL) || (b.nrefs == 0))
+  {
+    fprintf(stderr,"no references to replay\n");
+    return(1);
+  }
   
-  assert(o1 != NULL);
-  assert(o2 != NULL);
+  w = calloc(threads,sizeof(struct worker));
+  if (w == NULL)
+  {
+    perror("calloc()");
+    return(1);
+  }
   
-  pbn1 = *((struct bookname **)o1);
-  pbn2 = *((struct bookname **)o2);
+  start = now();
   
-  return(strcmp(pbn1->mp,pbn2->mp));
-}
-
-/********************************************************************/
-
-static int find_abrev(const void *key,const void *datum)
-{
-  const struct bookname *pbn = *((struct bookname **)datum);
-  const char            *k   = key;
+  for (long i = 0 ; i < threads ; i++)
+  {
+    w[i].bench = &b;
+    w[i].start = i;
+    w[i].step  = threads;
+    w[i].lat   = malloc((b.nrefs / threads + 1) * sizeof(uint64_t));
+    if (w[i].lat == NULL)
+    {
+      perror("malloc()");
+      exit(1);
+    }
+    if (pthread_create(&w[i].tid,NULL,bench_worker,&w[i]) != 0)
+    {
+      perror("pthread_create()");
+      exit(1);
+    }
+  }
+  
+  for (long i = 0 ; i < threads ; i++)
+    pthread_join(w[i].tid,NULL);
+    
+  elapsed = (double)(now() - start) / 1.0e9;
   
-  assert(pbn != NULL);
-  assert(k   != NULL);
+  /*---------------------------------------------------------------
+  ; Gather the results.  The latencies all go into one array to get
+  ; percentiles across all threads.
+  ;---------------------------------------------------------------*/
   
-  return(strcmp(k,pbn->s1));
+  memset(&stats,0,sizeof(stats));
+  lat = malloc(b.nrefs * sizeof(uint64_t));
+  if (lat == NULL)
+  {
+    perror("malloc()");
+    exit(1);
+  }
+  
+  n = 0;
+  for (long i = 0 ; i < threads ; i++)
+  {
+    memcpy(&lat[n],w[i].lat,w[i].n * sizeof(uint64_t));
+    n               += w[i].n;
+    found           += w[i].found;
+    redirect        += w[i].redirect;
+    notfound        += w[i].notfound;
+    bytes           += w[i].bytes;
+    stats.syscalls  += w[i].stats.syscalls;
+    stats.bytesread += w[i].stats.bytesread;
+    stats.chapters  += w[i].stats.chapters;
+    stats.verses    += w[i].stats.verses;
+    free(w[i].lat);
+  }
+  
+  qsort(lat,n,sizeof(uint64_t),cmp_u64);
+  
+  printf("requests         %zu\n",n);
+  printf("threads          %ld\n",threads);
+  printf("elapsed          %.3f s\n",elapsed);
+  printf("throughput       %.0f req/s\n",(double)n / elapsed);
+  printf("latency p50      %.2f us\n",percentile(lat,n,0.50)  / 1.0e3);
+  printf("latency p99      %.2f us\n",percentile(lat,n,0.99)  / 1.0e3);
+  printf("latency p999     %.2f us\n",percentile(lat,n,0.999) / 1.0e3);
+  printf("latency max      %.2f us\n",(double)lat[n - 1]      / 1.0e3);
+  printf("found            %zu\n",found);
+  printf("redirected       %zu\n",redirect);
+  printf("not found        %zu\n",notfound);
+  printf("chapters         %zu\n",stats.chapters);
+  printf("verses           %zu\n",stats.verses);
+  printf("bytes rendered   %zu (%.0f per request)\n",bytes,(double)bytes / n);
+  printf("bytes read       %zu (%.0f per request)\n",stats.bytesread,(double)stats.bytesread / n);
+  printf("syscalls         %zu (%.2f per request)\n",stats.syscalls,(double)stats.syscalls / n);
+  
+  for (size_t i = 0 ; i < b.nrefs ; i++)
+    free(b.refs[i]);
+  free(b.refs);
+  free(lat);
+  free(w);
+  return(0);
 }
 
 /*******************************************************************/
 
-static int find_fullname(const void *key,const void *datum)
+static void *bench_worker(void *data)
 {
-  const struct bookname *pbn = *((struct bookname **)datum);
-  const char            *k   = key;
-  
-  assert(pbn != NULL);
-  assert(k   != NULL);
+  struct worker    *pw = data;
+  struct bench     *pb = pw->bench;
+  struct lbrequest  br;
+  struct lbctx      ctx;
+  char              buffer[BUFSIZ];
+  
+  assert(pw != NULL);
+  
+  ctx.alloc  = &lb_malloc;
+  ctx.render = &lb_render_html;
+  ctx.write  = write_null;
+  ctx.ud     = NULL;
+  ctx.bytes  = 0;
+  ctx.timed  = false;
+  memset(&ctx.stats,0,sizeof(ctx.stats));
+  
+  for (size_t i = pw->start ; i < pb->nrefs ; i += pw->step)
+  {
+    uint64_t start = now();
+    
+    lb_translate_request(&br,pb->trans,pb->refs[i]);
+    if (br.name == NULL)
+      pw->notfound++;
+    else if (br.redirect)
+    {
+      lb_redirect_request(buffer,sizeof(buffer),&br);
+      pw->redirect++;
+    }
+    else
+    {
+      lb_print_request(&ctx,&br,pb->bookdir,NULL);
+      pw->found++;
+    }
+    
+    pw->lat[pw->n++] = now() - start;
+  }
   
-  return(strcmp(k,pbn->s2));
+  pw->bytes = ctx.bytes;
+  pw->stats = ctx.stats;
+  return(NULL);
 }
 
-/********************************************************************/
+/*******************************************************************
+;
+; Read references to replay, one per line.  Lines from an access log
+; work too---the last path component of the request is used.
+;
+********************************************************************/
 
-static int find_sounds(const void *key,const void *datum)
+static char **read_log(char const *fname,size_t *pn)
 {
-  const struct bookname *pbn = *((struct bookname **)datum);
-  const SOUNDEX         *k   = key;
+  FILE    *fp;
+  char   **refs = NULL;
+  size_t   size = 0;
+  char     buffer[BUFSIZ];
   
-  assert(pbn != NULL);
-  assert(k   != NULL);
+  assert(fname != NULL);
+  assert(pn    != NULL);
   
-  return(SoundexCompare(*k,pbn->sdx));
-}
-
-/**********************************************************************/
-
-static int find_metaphone(const void *key,const void *datum)
-{
-  const struct bookname *pbn = *((struct bookname **)datum);
-  const char            *k   = key;
+  *pn = 0;
+  fp  = fopen(fname,"r");
+  if (fp == NULL)
+  {
+    perror(fname);
+    return(NULL);
+  }
   
-  assert(pbn != NULL);
-  assert(k   != NULL);
+  while(fgets(buffer,sizeof(buffer),fp))
+  {
+    char *ref = buffer;
+    char *p;
+    
+    if ((p = strstr(buffer,"\"GET ")) != NULL)
+    {
+      ref = p + 5;
+      if ((p = strchr(ref,' ')) != NULL) *p = '\0';
+      if ((p = strrchr(ref,'/')) != NULL) ref = p + 1;
+    }
+    
+    ref[strcspn(ref,"\r\n")] = '\0';
+    if (*ref == '\0')
+      continue;
+      
+    if (*pn == size)
+    {
+      size += 1024;
+      refs  = realloc(refs,size * sizeof(char *));
+      if (refs == NULL)
+      {
+        perror("realloc()");
+        exit(1);
+      }
+    }
+    
+    refs[(*pn)++] = strdup(ref);
+  }
   
-  return(strcmp(k,pbn->mp));
+  fclose(fp);
+  return(refs);
 }
 
-/***********************************************************************/
+/*******************************************************************
+;
+; Make a synthetic mix of requests.  The popularity of each chapter
+; follows a Zipf distribution (with a random, but repeatable, order of
+; popularity) and the request forms are a mix of whole chapters, single
+; verses, verse ranges, chapter ranges and abbreviations.
+;
+********************************************************************/
 
-static char *trim_lspace(char *s)
+static char **make_zipf(
+                         struct lbtrans *ptrans,
+                         char const     *bookdir,
+                         size_t          requests,
+                         unsigned long   seed,
+                         double          s
+                       )
 {
-  assert(s != NULL);
-  for ( ; (*s) && (isspace(*s)) ; s++)
-    ;
-  return(s);
+  struct chapref  *chaps = NULL;
+  size_t           size  = 0;
+  size_t           max   = 0;
+  double          *cdf;
+  double           sum;
+  char           **refs;
+  uint64_t         state = seed ? seed : 1;
+  
+  assert(ptrans  != NULL);
+  assert(bookdir != NULL);
+  
+  for (size_t i = 0 ; i < ptrans->maxbook ; i++)
+  {
+    for (size_t c = 1 ; ; c++)
+    {
+      struct lbchapter ch;
+      
+      if (lb_chapter_open(&ch,&lb_malloc,bookdir,ptrans->books[i].fullname,c) != 0)
+        break;
+        
+      if (max == size)
+      {
+        size += 1024;
+        chaps = realloc(chaps,size * sizeof(struct chapref));
+        if (chaps == NULL)
+        {
+          perror("realloc()");
+          exit(1);
+        }
+      }
+      
+      chaps[max].book    = i;
+      chaps[max].chapter = c;
+      chaps[max].verses  = ch.max;
+      max++;
+      lb_chapter_close(&ch,&lb_malloc);
+    }
+  }
+  
+  if (max == 0)
+  {
+    fprintf(stderr,"%s: no chapters found\n",bookdir);
+    return(NULL);
+  }
+  
+  /*-----------------------------------------------------------
+  ; Shuffle to pick which chapters are popular, then build the
+  ; cumulative distribution over rank.
+  ;-----------------------------------------------------------*/
+  
+  for (size_t i = max - 1 ; i > 0 ; i--)
+  {
+    size_t         j   = rnd(&state) % (i + 1);
+    struct chapref tmp = chaps[i];
+    
+    chaps[i] = chaps[j];
+    chaps[j] = tmp;
+  }
+  
+  cdf = malloc(max * sizeof(double));
+  if (cdf == NULL)
+  {
+    perror("malloc()");
+    exit(1);
+  }
+  
+  sum = 0.0;
+  for (size_t i = 0 ; i < max ; i++)
+  {
+    sum   += 1.0 / pow((double)(i + 1),s);
+    cdf[i] = sum;
+  }
+  
+  refs = malloc(requests * sizeof(char *));
+  if (refs == NULL)
+  {
+    perror("malloc()");
+    exit(1);
+  }
+  
+  for (size_t i = 0 ; i < requests ; i++)
+  {
+    char               buffer[BUFSIZ];
+    double             u  = (double)(rnd(&state) >> 11) / 9007199254740992.0 * sum;
+    size_t             lo = 0;
+    size_t             hi = max - 1;
+    struct chapref    *pc;
+    struct lbbookname *pbn;
+    size_t             v1;
+    size_t             v2;
+    
+    while(lo < hi)
+    {
+      size_t mid = (lo + hi) / 2;
+      if (cdf[mid] < u)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+    
+    pc  = &chaps[lo];
+    pbn = &ptrans->books[pc->book];
+    v1  = rnd(&state) % pc->verses + 1;
+    v2  = v1 + rnd(&state) % (pc->verses - v1 + 1);
+    
+    switch(rnd(&state) % 8)
+    {
+      case 0:
+      case 1:
+      case 2:
+      case 3:
+           snprintf(buffer,sizeof(buffer),"%s.%zu",pbn->fullname,pc->chapter);
+           break;
+      case 4:
+           snprintf(buffer,sizeof(buffer),"%s.%zu:%zu",pbn->fullname,pc->chapter,v1);
+           break;
+      case 5:
+           snprintf(buffer,sizeof(buffer),"%s.%zu:%zu-%zu",pbn->fullname,pc->chapter,v1,v2);
+           break;
+      case 6:
+           snprintf(buffer,sizeof(buffer),"%s.%zu:%zu",pbn->abrev,pc->chapter,v1);
+           break;
+      case 7:
+           snprintf(buffer,sizeof(buffer),"%s.%zu-%zu",pbn->fullname,pc->chapter,pc->chapter + 1);
+           break;
+    }
+    
+    refs[i] = strdup(buffer);
+  }
+  
+  free(cdf);
+  free(chaps);
+  return(refs);
 }
 
-/******************************************************************/
+/*******************************************************************/
 
-static char *trim_tspace(char *s)
+static uint64_t rnd(uint64_t *state)
 {
-  char *p;
+  uint64_t x = *state;
   
-  assert(s != NULL);
-  for (p = s + strlen(s) - 1 ; (p > s) && (isspace(*p)) ; p--)
-    ;
-  *(p+1) = '\0';
-  return(s);
+  x ^= x >> 12;
+  x ^= x << 25;
+  x ^= x >> 27;
+  *state = x;
+  return(x * 2685821657736338717ULL);
 }
 
 /*******************************************************************/
 
-static char *trim_space(char *s)
+static uint64_t now(void)
 {
-  assert(s != NULL);
-  return(trim_tspace(trim_lspace(s)));
+  struct timespec ts;
+  
+  clock_gettime(CLOCK_MONOTONIC,&ts);
+  return((uint64_t)ts.tv_sec * 1000000000uLL + ts.tv_nsec);
 }
 
 /*******************************************************************/
 
-static char *m_strdup(char *s)
+static int cmp_u64(void const *o1,void const *o2)
 {
-  char *t;
+  uint64_t a = *(uint64_t const *)o1;
+  uint64_t b = *(uint64_t const *)o2;
   
-  assert(s != NULL);
-  
-  t = malloc(strlen(s) + 1);
-  if (t) strcpy(t,s);
-  return(t);
+  return(a < b ? -1 : a > b ? 1 : 0);
 }
 
 /*******************************************************************/
 
-static void dump_list(struct bookname **pa)
+static double percentile(uint64_t *lat,size_t n,double p)
 {
-  char buffer[BUFSIZ];
+  size_t i;
   
-  assert(pa != NULL);
+  assert(lat != NULL);
+  assert(n   >  0);
   
-  printf("Dump list\n");
-  for (size_t i = 0 ; i < maxbook ; i++)
-  {
-    printf(
-            "\t%s\t, %s(%s)[%s]\n",
-            pa[i]->s1,
-            pa[i]->s2,
-            SoundexString(buffer,pa[i]->sdx),
-            pa[i]->mp
-          );
-  }
+  i = (size_t)ceil(p * n);
+  if (i > 0) i--;
+  if (i >= n) i = n - 1;
+  return((double)lat[i]);
 }
-
@@ -0,0 +1,301 @@
+/******************************************************************
+*
+* writer.c              - Write out the mod_litbook data files (see
+*                         DATA-FORMAT) from a stream of verse records.
+*
+* Copyright 1999 by Sean Conner.  All Rights Reserved.
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*
+* Comments, questions and criticisms can be sent to: sean@conman.org
+*
+* -----------------------------------------------------------------
+*
+* This used to be BookWrite()/ChaptersWrite() in breakout.c, which
+* walked a tree of the entire work built up in memory.  Now the records
+* are written as they arrive, and the only thing kept around is the
+* offset table of the chapter currently being written.
+*
+********************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <assert.h>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "util.h"
+#include "writer.h"
+
+/*****************************************************************/
+
+struct writer
+{
+  char     *book;
+  Size      chapter;
+  FILE     *fp;
+  long int *offs;
+  Size      entries;
+  Size      max;
+  long int  pos;
+  Size      books;
+  Size      chapters;
+  Size      verses;
+};
+
+/*****************************************************************/
+
+static void      chapter_start          (Writer,Size);
+static void      chapter_end            (Writer);
+
+/*****************************************************************/
+
+Writer WriterCreate(void)
+{
+  Writer w = calloc(1,sizeof(struct writer));
+  
+  if (w == NULL)
+  {
+    perror("out of memory---aborting");
+    exit(1);
+  }
+  return(w);
+}
+
+/*****************************************************************/
+
+void WriterRecord(Writer w,Record const *rec)
+{
+  Size verse;
+  
+  assert(w          != NULL);
+  assert(rec        != NULL);
+  assert(rec->book  != NULL);
+  assert(rec->text  != NULL);
+  
+  /*------------------------------------------------------------
+  ; strip spaces from the book name, since it's a directory name
+  ;-------------------------------------------------------------*/
+  
+  {
+    char  name[BUFSIZ];
+    char *d = name;
+    
+    for (char const *s = rec->book ; (*s) && (d < &name[sizeof(name) - 1]) ; s++)
+      if (!isspace(*s))
+        *d++ = *s;
+    *d = '\0';
+    
+    if ((w->book == NULL) || (strcmp(w->book,name) != 0))
+    {
+      chapter_end(w);
+      if (w->book != NULL)
+      {
+        resetdir();
+        free(w->book);
+      }
+      w->book    = dup_string(name);
+      w->chapter = 0;
+      w->books++;
+      setdir(w->book);
+    }
+  }
+  
+  if (rec->chapter != w->chapter)
+  {
+    chapter_end(w);
+    chapter_start(w,rec->chapter);
+  }
+  
+  /*------------------------------------------------------------
+  ; The index is by verse number, so a verse the source skips (or
+  ; the rest of a bridge like \v 1-2, which is reported as its first
+  ; verse) gets an empty entry.  A verse number of 0 just means the
+  ; next one.  One that goes backwards can't be written.
+  ;-------------------------------------------------------------*/
+  
+  verse = rec->verse ? rec->verse : w->entries + 1;
+  if (verse <= w->entries)
+  {
+    fprintf(
+             stderr,
+             "%s %lu:%lu: after verse %lu---skipped\n",
+             w->book,
+             (unsigned long)rec->chapter,
+             (unsigned long)verse,
+             (unsigned long)w->entries
+           );
+    return;
+  }
+  
+  while (verse + 2 >= w->max)
+  {
+    w->max  = w->max ? w->max * 2 : 256;
+    w->offs = realloc(w->offs,w->max * sizeof(long int));
+    if (w->offs == NULL)
+    {
+      perror("out of memory---aborting");
+      exit(1);
+    }
+  }
+  
+  while (w->entries + 1 < verse)
+    w->offs[++w->entries] = w->pos;
+    
+  {
+    size_t len = strlen(rec->text);
+    
+    w->offs[++w->entries] = w->pos;
+    fwrite(rec->text,sizeof(char),len,w->fp);
+    w->pos += len;
+    w->verses++;
+  }
+}
+
+/*****************************************************************/
+
+void WriterFinish(Writer w)
+{
+  assert(w != NULL);
+  
+  chapter_end(w);
+  if (w->book != NULL)
+  {
+    resetdir();
+    free(w->book);
+  }
+  free(w->offs);
+  free(w);
+}
+
+/*****************************************************************/
+
+Size WriterBooks(Writer w)
+{
+  assert(w != NULL);
+  return(w->books);
+}
+
+/*****************************************************************/
+
+Size WriterChapters(Writer w)
+{
+  assert(w != NULL);
+  return(w->chapters);
+}
+
+/*****************************************************************/
+
+Size WriterVerses(Writer w)
+{
+  assert(w != NULL);
+  return(w->verses);
+}
+
+/*****************************************************************/
+
+static void chapter_start(Writer w,Size chapter)
+{
+  char fname[BUFSIZ];
+  
+  assert(w     != NULL);
+  assert(w->fp == NULL);
+  
+  sprintf(fname,"%lu",(unsigned long)chapter);
+  w->fp = fopen(fname,"wb");
+  if (w->fp == NULL)
+  {
+    perror(fname);
+    exit(1);
+  }
+  
+  w->chapter = chapter;
+  w->entries = 0;
+  w->pos     = 0;
+  w->chapters++;
+}
+
+/*****************************************************************/
+
+static void chapter_end(Writer w)
+{
+  char  fname[BUFSIZ];
+  FILE *fp;
+  
+  assert(w != NULL);
+  
+  if (w->fp == NULL)
+    return;
+    
+  fclose(w->fp);
+  w->fp = NULL;
+  
+  w->offs[0]              = (long)w->entries;
+  w->offs[w->entries + 1] = w->pos;
+  
+  sprintf(fname,"%lu.index",(unsigned long)w->chapter);
+  fp = fopen(fname,"wb");
+  if (fp == NULL)
+  {
+    perror(fname);
+    exit(1);
+  }
+  fwrite(w->offs,sizeof(long int),w->entries + 2,fp);
+  fclose(fp);
+}
+
+/*******************************************************************/
+
+void setdir(char *dir)
+{
+  int rc;
+  
+  assert(dir != NULL);
+  
+  rc = chdir(dir);
+  if (rc != 0)
+  {
+    rc = mkdir(dir,0777);       /* no proto in Linux */
+    if (rc != 0)
+    {
+      perror("can't create dir---aborting");
+      exit(1);
+    }
+    rc = chdir(dir);
+    if (rc != 0)
+    {
+      perror("can't deal with dir---aborting");
+      exit(1);
+    }
+  }
+}
+
+/********************************************************************/
+
+void resetdir(void)
+{
+  int rc = chdir("..");
+  if (rc != 0)
+  {
+    perror("can't get parent");
+    exit(1);
+  }
+}
+
+/********************************************************************/
@@ -0,0 +1,46 @@
+/******************************************************************
+*
+* writer.h              - API for writing out the mod_litbook data
+*                         files.
+*
+* Copyright 2022 by Sean Conner.  All Rights Reserved.
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*
+* Comments, questions and criticisms can be sent to: sean@conman.org
+*
+********************************************************************/
+
+#ifndef WRITER_H
+#define WRITER_H
+
+#include "types.h"
+#include "reader.h"
+
+typedef struct writer *Writer;
+
+/*********************************************************************/
+
+Writer           WriterCreate           (void);
+void             WriterRecord           (Writer,Record const *);
+void             WriterFinish           (Writer);
+Size             WriterBooks            (Writer);
+Size             WriterChapters         (Writer);
+Size             WriterVerses           (Writer);
+
+void             setdir                 (char *);
+void             resetdir               (void);
+
+#endif